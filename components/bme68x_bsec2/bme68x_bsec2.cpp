@@ -248,8 +248,6 @@ void BME68xBSEC2Component::run_() {
   if (curr_time_ns < this->bsec_settings_.next_call) {
     return;
   }
-  uint8_t status;
-
   ESP_LOGV(TAG, "Performing sensor run");
 
   struct bme68x_conf bme68x_conf;
@@ -275,11 +273,10 @@ void BME68xBSEC2Component::run_() {
         this->bsec_settings_.heater_temperature;
     this->bme68x_heatr_conf_.heatr_dur = this->bsec_settings_.heater_duration;
 
-    // status = bme68x_set_op_mode(this->bsec_settings_.op_mode,
-    // &this->bme68x_);
-    status = bme68x_set_heatr_conf(BME68X_FORCED_MODE,
-                                   &this->bme68x_heatr_conf_, &this->bme68x_);
-    status = bme68x_set_op_mode(BME68X_FORCED_MODE, &this->bme68x_);
+    this->bme68x_status_ = bme68x_set_heatr_conf(
+        BME68X_FORCED_MODE, &this->bme68x_heatr_conf_, &this->bme68x_);
+    this->bme68x_status_ =
+        bme68x_set_op_mode(BME68X_FORCED_MODE, &this->bme68x_);
     this->op_mode_ = BME68X_FORCED_MODE;
     ESP_LOGV(TAG, "Using forced mode");
 
@@ -306,10 +303,11 @@ void BME68xBSEC2Component::run_() {
                                &this->bme68x_) /
            INT64_C(1000));
 
-      status = bme68x_set_heatr_conf(BME68X_PARALLEL_MODE,
-                                     &this->bme68x_heatr_conf_, &this->bme68x_);
+      this->bme68x_status_ = bme68x_set_heatr_conf(
+          BME68X_PARALLEL_MODE, &this->bme68x_heatr_conf_, &this->bme68x_);
 
-      status = bme68x_set_op_mode(BME68X_PARALLEL_MODE, &this->bme68x_);
+      this->bme68x_status_ =
+          bme68x_set_op_mode(BME68X_PARALLEL_MODE, &this->bme68x_);
       this->op_mode_ = BME68X_PARALLEL_MODE;
       ESP_LOGV(TAG, "Using parallel mode");
     }
@@ -153,7 +153,7 @@ bool HOT EPaperSpectraE6::transfer_data() {
       this->start_data_();
       this->write_array(bytes_to_send, buf_idx);
       this->end_data_();
-      ESP_LOGV(TAG, "Wrote %d bytes at %ums", buf_idx, (unsigned)millis());
+      ESP_LOGV(TAG, "Wrote %zu bytes at %ums", buf_idx, (unsigned)millis());
       buf_idx = 0;
 
       if (millis() - start_time > MAX_TRANSFER_TIME) {
@@ -1,13 +1,23 @@
+import re
+
 import esphome.codegen as cg
 from esphome import automation
 from esphome.components import microphone
+from esphome.components.esp32 import get_esp32_variant
+from esphome.components.esp32.const import VARIANT_ESP32
 from esphome.automation import maybe_simple_id
 import esphome.config_validation as cv
 from esphome.const import (
+    CONF_BITS_PER_SAMPLE,
+    CONF_CHANNELS,
     CONF_ID,
     CONF_MICROPHONE,
 )
 
+AUTO_LOAD = ["pcm_utils"]
+
+CONF_MICROPHONE_RECORDER_ID = "microphone_recorder_id"
+
 mic_recorder_ns = cg.esphome_ns.namespace("microphone_recorder")
 MicrophoneRecorder = mic_recorder_ns.class_("MicrophoneRecorder", cg.Component)
 StartRecordingAction = mic_recorder_ns.class_(
@@ -16,6 +26,18 @@ StartRecordingAction = mic_recorder_ns.class_(
 StopRecordingAction = mic_recorder_ns.class_(
     "StopRecordingAction", automation.Action, cg.Parented.template(MicrophoneRecorder)
 )
+SpiDmaChannel = cg.global_ns.enum("spi_dma_chan_t")
+SPI_DMA_CHANNELS = {
+    "auto": SpiDmaChannel.SPI_DMA_CH_AUTO,
+    1: SpiDmaChannel.SPI_DMA_CH1,
+    2: SpiDmaChannel.SPI_DMA_CH2,
+}
+RecorderCodec = mic_recorder_ns.enum("RecorderCodec")
+CODEC_OPTIONS = {
+    "pcm": RecorderCodec.CODEC_PCM,
+    "ima_adpcm": RecorderCodec.CODEC_IMA_ADPCM,
+    "flac": RecorderCodec.CODEC_FLAC,
+}
 
 CONF_CLK_PIN = "clk_pin"
 CONF_CMD_PIN = "cmd_pin"
@@ -23,19 +45,180 @@ CONF_D0_PIN = "d0_pin"
 CONF_D1_PIN = "d1_pin"
 CONF_D2_PIN = "d2_pin"
 CONF_D3_PIN = "d3_pin"
+CONF_BUS_FREQUENCY = "bus_frequency"
+CONF_SPI_MAX_TRANSFER_SIZE = "spi_max_transfer_size"
+CONF_SPI_DMA_CHANNEL = "spi_dma_channel"
+CONF_SELF_TEST_SIZE = "self_test_size"
 CONF_MOUNT_POINT = "mount_point"
 CONF_FILENAME_PREFIX = "filename_prefix"
 CONF_MAX_DURATION = "max_duration"
 CONF_FORMAT_ON_FAIL = "format_if_mount_failed"
+CONF_ALLOCATION_UNIT_SIZE = "allocation_unit_size"
+CONF_MAX_FILES = "max_files"
+CONF_PREALLOCATE = "preallocate"
+CONF_CODEC = "codec"
+CONF_PRE_ROLL = "pre_roll"
+CONF_HEADER_COMMIT_INTERVAL = "header_commit_interval"
+CONF_SEGMENT = "segment"
+CONF_DURATION = "duration"
+CONF_SIZE = "size"
+CONF_MIN_FREE_SPACE = "min_free_space"
+CONF_BUFFER_DURATION = "buffer_duration"
+CONF_WRITE_BLOCK_SIZE = "write_block_size"
+CONF_WRITER_TASK = "writer_task"
+CONF_PRIORITY = "priority"
+CONF_CORE = "core"
+CONF_STACK_SIZE = "stack_size"
+CONF_RAW_REGION = "raw_region"
+CONF_START_SECTOR = "start_sector"
+
+SECTOR_SIZE = 512
+SIZE_UNITS = {"": 1, "K": 1 << 10, "M": 1 << 20, "G": 1 << 30}
+
+
+def _validate_write_block_size(value):
+    value = cv.int_range(min=4096, max=65536)(value)
+    if value % SECTOR_SIZE:
+        raise cv.Invalid(f"{CONF_WRITE_BLOCK_SIZE} must be a multiple of {SECTOR_SIZE}")
+    return value
+
+
+def _validate_allocation_unit_size(value):
+    value = cv.int_(value)
+    if value == 0:
+        return value
+    # FAT clusters are a power of two from one sector to 128 sectors.
+    if value < SECTOR_SIZE or value > 128 * SECTOR_SIZE or value & (value - 1):
+        raise cv.Invalid(
+            f"{CONF_ALLOCATION_UNIT_SIZE} must be 0 or a power of two from "
+            f"{SECTOR_SIZE} to {128 * SECTOR_SIZE}"
+        )
+    return value
+
+
+def _validate_header_commit_interval(value):
+    value = cv.positive_time_period_milliseconds(value)
+    if 0 < value.total_milliseconds < 1000:
+        raise cv.Invalid("Header commits must be at least 1s apart, or 0s to disable them")
+    return value
+
+
+def _validate_spi_dma_channel(value):
+    if isinstance(value, str) and value.lower() == "auto":
+        return "auto"
+    return cv.int_range(min=1, max=2)(value)
+
+
+def _byte_size(value):
+    """A byte count, optionally with a binary KB/MB/GB suffix."""
+    if isinstance(value, int):
+        return cv.positive_int(value)
+    match = re.fullmatch(r"\s*(\d+(?:\.\d+)?)\s*([KMG]?)B?\s*", str(value).upper())
+    if match is None:
+        raise cv.Invalid(f"Expected a size such as 512MB, got '{value}'")
+    return int(float(match.group(1)) * SIZE_UNITS[match.group(2)])
+
+
+def _validate_segment_size(value):
+    value = _byte_size(value)
+    if not 64 * 1024 <= value < 1 << 32:
+        raise cv.Invalid("Segment size must be at least 64KB and below 4GB")
+    return value
+
+
+SEGMENT_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.Optional(CONF_DURATION): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=cv.TimePeriod(seconds=1)),
+            ),
+            cv.Optional(CONF_SIZE): _validate_segment_size,
+            cv.Optional(CONF_MIN_FREE_SPACE, default=0): _byte_size,
+        }
+    ),
+    cv.has_exactly_one_key(CONF_DURATION, CONF_SIZE),
+)
+
+
+def _validate_raw_region_size(value):
+    value = _byte_size(value)
+    if value == 0:
+        return value
+    if value % SECTOR_SIZE or value < 1 << 20:
+        raise cv.Invalid(
+            f"The raw region must be 0 for the rest of the card, or at least 1MB and a multiple of {SECTOR_SIZE}"
+        )
+    return value
+
+
+RAW_REGION_SCHEMA = cv.Schema(
+    {
+        # Sector 0 holds the partition table, which the recorder leaves alone.
+        cv.Required(CONF_START_SECTOR): cv.int_range(min=1, max=0xFFFFFFFF),
+        cv.Optional(CONF_SIZE, default=0): _validate_raw_region_size,
+    }
+)
+
+
+def _finalize_config(config):
+    segmented = CONF_SEGMENT in config
+    spi = config[CONF_D1_PIN] < 0 and config[CONF_D2_PIN] < 0 and config[CONF_D3_PIN] >= 0
+    for key in (CONF_SPI_MAX_TRANSFER_SIZE, CONF_SPI_DMA_CHANNEL):
+        if key in config and not spi:
+            raise cv.Invalid(f"{key} only applies to a card wired for SPI (only {CONF_D3_PIN} among d1-d3)")
+    if config.get(CONF_SPI_DMA_CHANNEL, "auto") != "auto" and get_esp32_variant() != VARIANT_ESP32:
+        raise cv.Invalid(f"{CONF_SPI_DMA_CHANNEL} can only be chosen on the original ESP32; use auto")
+    if CONF_MAX_DURATION not in config:
+        # Segmented recordings are meant to run until stopped.
+        config[CONF_MAX_DURATION] = cv.positive_time_period_milliseconds("0s" if segmented else "10s")
+    if config[CONF_PREALLOCATE] and not segmented and config[CONF_MAX_DURATION].total_milliseconds == 0:
+        raise cv.Invalid(f"{CONF_PREALLOCATE} needs a non-zero {CONF_MAX_DURATION} or a {CONF_SEGMENT}")
+    if segmented and config[CONF_MAX_FILES] < 2:
+        raise cv.Invalid(f"{CONF_SEGMENT} keeps two files open; {CONF_MAX_FILES} must be at least 2")
+    if segmented and CONF_SIZE in config[CONF_SEGMENT] and config[CONF_CODEC] == "flac":
+        # FLAC frames vary in size, so a segment's file size can't be known up front.
+        raise cv.Invalid(f"{CONF_CODEC}: flac needs a {CONF_SEGMENT} {CONF_DURATION} rather than a {CONF_SIZE}")
+    if CONF_RAW_REGION in config:
+        # A raw region has no files to segment, preallocate or format, and
+        # stores whole frames of PCM that the extractor wraps in WAV headers.
+        for key in (CONF_SEGMENT, CONF_PREALLOCATE, CONF_FORMAT_ON_FAIL):
+            if config.get(key):
+                raise cv.Invalid(f"{key} can't be used with a {CONF_RAW_REGION}")
+        if config[CONF_CODEC] != "pcm":
+            raise cv.Invalid(f"A {CONF_RAW_REGION} records {CONF_CODEC}: pcm only")
+    mic_config = config[CONF_MICROPHONE]
+    if config[CONF_BITS_PER_SAMPLE] > 16:
+        # The encoders take 16-bit frames; wide samples are written as PCM only.
+        if config[CONF_CODEC] != "pcm":
+            raise cv.Invalid(f"{CONF_BITS_PER_SAMPLE}: {config[CONF_BITS_PER_SAMPLE]} needs {CONF_CODEC}: pcm")
+        if mic_config[CONF_BITS_PER_SAMPLE] != 32:
+            raise cv.Invalid(
+                f"{CONF_BITS_PER_SAMPLE}: {config[CONF_BITS_PER_SAMPLE]} needs a 32-bit {CONF_MICROPHONE} source"
+            )
+    if config[CONF_CODEC] == "ima_adpcm" and len(mic_config[CONF_CHANNELS]) > 2:
+        raise cv.Invalid(f"{CONF_CODEC}: ima_adpcm records at most two {CONF_CHANNELS}")
+    return config
+
+
+WRITER_TASK_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_PRIORITY, default=10): cv.int_range(min=1, max=24),
+        cv.Optional(CONF_CORE, default=1): cv.int_range(min=-1, max=1),
+        cv.Optional(CONF_STACK_SIZE, default=4096): cv.int_range(
+            min=3072, max=32768
+        ),
+    }
+)
 
 microphone_recorder_schema = cv.Schema(
     {
         cv.GenerateID(): cv.declare_id(MicrophoneRecorder),
         cv.Required(CONF_MICROPHONE): microphone.microphone_source_schema(
             min_bits_per_sample=16,
-            max_bits_per_sample=16,
+            max_bits_per_sample=32,
             min_channels=1,
-            max_channels=2,
+            max_channels=8,
         ),
         cv.Required(CONF_CLK_PIN): cv.int_,
         cv.Required(CONF_CMD_PIN): cv.int_,
@@ -43,14 +226,38 @@ microphone_recorder_schema = cv.Schema(
         cv.Optional(CONF_D1_PIN, default=-1): cv.int_,
         cv.Optional(CONF_D2_PIN, default=-1): cv.int_,
         cv.Optional(CONF_D3_PIN, default=-1): cv.int_,
+        cv.Optional(CONF_BUS_FREQUENCY, default="20MHz"): cv.All(
+            cv.frequency, cv.Range(min=400e3, max=40e6)
+        ),
+        cv.Optional(CONF_SPI_MAX_TRANSFER_SIZE): cv.int_range(min=4096, max=65536),
+        cv.Optional(CONF_SPI_DMA_CHANNEL): _validate_spi_dma_channel,
+        cv.Optional(CONF_SELF_TEST_SIZE, default=0): cv.All(_byte_size, cv.Range(max=4 << 20)),
         cv.Optional(CONF_MOUNT_POINT, default="/sdcard"): cv.string,
         cv.Optional(CONF_FILENAME_PREFIX, default="rec"): cv.string,
-        cv.Optional(CONF_MAX_DURATION, default="10s"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_MAX_DURATION): cv.positive_time_period_milliseconds,
         cv.Optional(CONF_FORMAT_ON_FAIL, default=False): cv.boolean,
+        cv.Optional(CONF_ALLOCATION_UNIT_SIZE, default=0): _validate_allocation_unit_size,
+        cv.Optional(CONF_MAX_FILES, default=8): cv.int_range(min=1, max=32),
+        cv.Optional(CONF_PREALLOCATE, default=False): cv.boolean,
+        cv.Optional(CONF_CODEC, default="pcm"): cv.enum(CODEC_OPTIONS, lower=True),
+        cv.Optional(CONF_BITS_PER_SAMPLE, default=16): cv.one_of(16, 24, 32, int=True),
+        cv.Optional(CONF_SEGMENT): SEGMENT_SCHEMA,
+        cv.Optional(CONF_RAW_REGION): RAW_REGION_SCHEMA,
+        cv.Optional(CONF_HEADER_COMMIT_INTERVAL, default="10s"): _validate_header_commit_interval,
+        cv.Optional(CONF_PRE_ROLL, default="0s"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(max=cv.TimePeriod(seconds=60)),
+        ),
+        cv.Optional(CONF_BUFFER_DURATION, default="2s"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(min=cv.TimePeriod(milliseconds=250)),
+        ),
+        cv.Optional(CONF_WRITE_BLOCK_SIZE, default=32768): _validate_write_block_size,
+        cv.Optional(CONF_WRITER_TASK, default={}): WRITER_TASK_SCHEMA,
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
-CONFIG_SCHEMA = microphone_recorder_schema
+CONFIG_SCHEMA = cv.All(microphone_recorder_schema, _finalize_config)
 
 MICROPHONE_RECORDER_ACTION_SCHEMA = maybe_simple_id({cv.GenerateID(): cv.use_id(MicrophoneRecorder)})
 
@@ -70,10 +277,45 @@ async def to_code(config):
         config[CONF_D2_PIN],
         config[CONF_D3_PIN],
     ))
+    cg.add(var.set_bus_frequency_khz(int(config[CONF_BUS_FREQUENCY] // 1000)))
+    cg.add(
+        var.set_spi_bus(
+            config.get(CONF_SPI_MAX_TRANSFER_SIZE, 4096),
+            SPI_DMA_CHANNELS[config.get(CONF_SPI_DMA_CHANNEL, "auto")],
+        )
+    )
+    cg.add(var.set_self_test_size(config[CONF_SELF_TEST_SIZE]))
     cg.add(var.set_mount_point(config[CONF_MOUNT_POINT]))
     cg.add(var.set_filename_prefix(config[CONF_FILENAME_PREFIX]))
     cg.add(var.set_max_duration_ms(config[CONF_MAX_DURATION].total_milliseconds))
     cg.add(var.set_format_if_mount_failed(config[CONF_FORMAT_ON_FAIL]))
+    cg.add(var.set_allocation_unit_size(config[CONF_ALLOCATION_UNIT_SIZE]))
+    cg.add(var.set_max_files(config[CONF_MAX_FILES]))
+    cg.add(var.set_preallocate(config[CONF_PREALLOCATE]))
+    cg.add(var.set_codec(config[CONF_CODEC]))
+    cg.add(var.set_bits_per_sample(config[CONF_BITS_PER_SAMPLE]))
+    if segment_config := config.get(CONF_SEGMENT):
+        cg.add(
+            var.set_segment(
+                segment_config[CONF_DURATION].total_milliseconds if CONF_DURATION in segment_config else 0,
+                segment_config.get(CONF_SIZE, 0),
+                segment_config[CONF_MIN_FREE_SPACE],
+            )
+        )
+    if raw_config := config.get(CONF_RAW_REGION):
+        cg.add(var.set_raw_region(raw_config[CONF_START_SECTOR], raw_config[CONF_SIZE]))
+    cg.add(var.set_header_commit_interval_ms(config[CONF_HEADER_COMMIT_INTERVAL].total_milliseconds))
+    cg.add(var.set_pre_roll_ms(config[CONF_PRE_ROLL].total_milliseconds))
+    cg.add(var.set_buffer_duration_ms(config[CONF_BUFFER_DURATION].total_milliseconds))
+    cg.add(var.set_write_block_size(config[CONF_WRITE_BLOCK_SIZE]))
+    task_config = config[CONF_WRITER_TASK]
+    cg.add(
+        var.set_writer_task(
+            task_config[CONF_PRIORITY],
+            task_config[CONF_CORE],
+            task_config[CONF_STACK_SIZE],
+        )
+    )
 
 
 @automation.register_action(
@@ -2,18 +2,90 @@
 
 #ifdef USE_ESP32
 
+#include "esphome/components/pcm_utils/pcm_convert.h"
+#include "esphome/components/pcm_utils/wav_header.h"
+#include "esphome/core/application.h"
 #include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 
 #include <driver/sdmmc_defs.h>
 #include <driver/sdmmc_host.h>
+#include <esp_timer.h>
 #include <esp_vfs_fat.h>
+#include <sdmmc_cmd.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 
 namespace esphome {
 namespace microphone_recorder {
 
 static const char *const TAG = "microphone_recorder";
 
+static constexpr uint32_t SENSOR_PUBLISH_INTERVAL_MS = 1000;
+// Write percentiles, speed and buffer headroom cover windows of this length,
+// and the writer task refreshes the card's free space this often.
+static constexpr uint32_t STATS_WINDOW_MS = 60000;
+// The callback wakes the writer task once a block is queued, and
+// stop_recording() wakes it to finish the file; this only bounds how long
+// stale audio can sit in the ring while idle.
+static constexpr uint32_t WRITER_IDLE_WAIT_MS = 100;
+// Enough of the start of a file to reach the data chunk of any header this
+// component writes.
+static constexpr size_t HEADER_READ_SIZE = 128;
+// The largest header of any codec.
+static constexpr size_t MAX_HEADER_SIZE =
+    std::max(pcm_utils::FLAC_STREAM_HEADER_SIZE,
+             pcm_utils::WAV_EXTENSIBLE_HEADER_SIZE);
+// IMA-ADPCM blocks of 512 bytes per channel hold 1017 frames each, the usual
+// choice for WAV files.
+static constexpr size_t ADPCM_BLOCK_ALIGN_PER_CHANNEL = 512;
+// libFLAC's default block size: each FLAC frame is a fixed amount of work.
+static constexpr uint16_t FLAC_BLOCK_FRAMES = 4096;
+// Bus errors halve the clock down to this; a card that fails even here has
+// a wiring problem rather than a marginal one.
+static constexpr uint32_t MIN_BUS_FREQ_KHZ = 5000;
+
+static const char *codec_to_string(RecorderCodec codec) {
+  switch (codec) {
+  case CODEC_IMA_ADPCM:
+    return "IMA-ADPCM";
+  case CODEC_FLAC:
+    return "FLAC";
+  default:
+    return "PCM";
+  }
+}
+
+// What the SD driver returns when the signal doesn't survive the bus at its
+// clock, as opposed to a card that is absent, full or unformatted.
+static bool is_bus_error(esp_err_t err) {
+  return err == ESP_ERR_INVALID_CRC || err == ESP_ERR_TIMEOUT ||
+         err == ESP_ERR_INVALID_RESPONSE;
+}
+
+#ifdef USE_SENSOR
+static void publish_if_changed(sensor::Sensor *sensor, float state) {
+  if (sensor == nullptr) {
+    return;
+  }
+  if (!sensor->has_state() || sensor->get_raw_state() != state) {
+    sensor->publish_state(state);
+  }
+}
+#endif
+
 void MicrophoneRecorder::setup() {
   if (this->mic_source_ == nullptr) {
     ESP_LOGE(TAG, "Microphone source not configured");
@@ -33,6 +105,90 @@ void MicrophoneRecorder::setup() {
     return;
   }
 
+  const auto info = this->mic_source_->get_audio_stream_info();
+  this->source_bits_per_sample_ = info.get_bits_per_sample();
+  this->source_frame_size_ = info.frames_to_bytes(1);
+  if (this->codec_ != CODEC_PCM) {
+    this->output_bits_per_sample_ = 16;
+  }
+  this->output_frame_size_ =
+      info.get_channels() * (this->output_bits_per_sample_ / 8);
+  this->pre_roll_bytes_ = this->ms_to_source_bytes_(this->pre_roll_ms_);
+
+  switch (this->codec_) {
+  case CODEC_IMA_ADPCM:
+    this->header_size_ = pcm_utils::IMA_ADPCM_WAV_HEADER_SIZE;
+    this->codec_frames_ = pcm_utils::ima_adpcm_wav_frames_per_block(
+        ADPCM_BLOCK_ALIGN_PER_CHANNEL * info.get_channels(),
+        info.get_channels());
+    break;
+  case CODEC_FLAC:
+    this->header_size_ = pcm_utils::FLAC_STREAM_HEADER_SIZE;
+    this->codec_frames_ = FLAC_BLOCK_FRAMES;
+    break;
+  default:
+    this->header_size_ = pcm_utils::wav_header_size(
+        info.get_channels(), this->output_bits_per_sample_);
+    this->codec_frames_ = 0;
+    break;
+  }
+
+  if (this->segment_duration_ms_ > 0 || this->segment_size_ > 0) {
+    // Segments are cut on a frame boundary in the source stream, counted in
+    // source bytes; the file size follows from the output frames.
+    uint64_t frames;
+    if (this->segment_duration_ms_ > 0) {
+      frames = this->ms_to_source_bytes_(this->segment_duration_ms_) /
+               this->source_frame_size_;
+    } else if (this->codec_ == CODEC_IMA_ADPCM) {
+      frames = (this->segment_size_ - this->header_size_) /
+               (ADPCM_BLOCK_ALIGN_PER_CHANNEL * info.get_channels()) *
+               this->codec_frames_;
+    } else {
+      frames =
+          (this->segment_size_ - this->header_size_) / this->output_frame_size_;
+    }
+    if (this->codec_frames_ > 0) {
+      // Cut on a codec frame boundary too, so only the last codec frame of a
+      // recording is ever short.
+      frames = std::max<uint64_t>(frames / this->codec_frames_, 1) *
+               this->codec_frames_;
+    }
+    this->segment_source_bytes_ = frames * this->source_frame_size_;
+    this->segment_file_size_ = this->file_size_for_frames_(frames);
+  }
+
+  if (this->raw_) {
+    // Raw recordings are bare PCM; the index holds their format.
+    this->header_size_ = 0;
+  } else {
+    this->recover_files_();
+  }
+
+  if (!this->allocate_buffers_()) {
+    ESP_LOGE(TAG, "Failed to allocate recording buffers");
+    this->mark_failed();
+    return;
+  }
+
+  if (this->raw_ && !this->open_raw_region_()) {
+    this->mark_failed();
+    return;
+  }
+
+  if (this->self_test_size_ > 0) {
+    this->run_self_test_();
+  }
+  // The first free space query can scan the whole allocation table; get it
+  // over with before anything is being recorded.
+  this->update_free_space_();
+
+  if (!this->start_writer_task_()) {
+    ESP_LOGE(TAG, "Failed to start writer task");
+    this->mark_failed();
+    return;
+  }
+
   auto recorder_callback = [this](const std::vector<uint8_t> &data) {
     this->handle_audio_data_(data);
   };
@@ -40,123 +196,405 @@ void MicrophoneRecorder::setup() {
 }
 
 void MicrophoneRecorder::loop() {
-  if (!this->recording_) {
-    return;
+  if (this->finished_.exchange(false, std::memory_order_acquire)) {
+    // Raw recordings may run past 4 GB, which no WAV file can.
+    const uint64_t data_bytes =
+        this->raw_ ? this->raw_recording_->length
+        : this->file_bytes_written_ > this->header_size_
+            ? this->file_bytes_written_ - this->header_size_
+            : 0;
+    ESP_LOGI(TAG, "Recording finished: %s (%llu bytes)",
+             this->active_path_.c_str(),
+             static_cast<unsigned long long>(data_bytes));
+    const uint32_t dropped =
+        this->bytes_dropped_total_.load(std::memory_order_relaxed) -
+        this->dropped_at_start_;
+    if (dropped > 0) {
+      ESP_LOGW(TAG, "%u bytes of audio were dropped while recording",
+               dropped);
+    }
   }
 
-  if (this->max_duration_ms_ > 0) {
-    uint32_t elapsed = millis() - this->recording_start_ms_;
-    if (elapsed >= this->max_duration_ms_) {
-      this->pending_stop_ = true;
-    }
+  // The pre-roll only exists if the microphone runs between recordings.
+  if (this->pre_roll_bytes_ > 0 && !this->mic_source_->is_running()) {
+    this->mic_source_->start();
   }
 
-  if (this->pending_stop_) {
-    this->stop_recording();
+  if (this->state_.load(std::memory_order_acquire) == STATE_RECORDING) {
+    if (this->write_failed_.load(std::memory_order_relaxed)) {
+      ESP_LOGW(TAG, "Stopping after a failed write");
+      this->stop_recording();
+    } else if (this->max_duration_ms_ > 0 &&
+               millis() - this->recording_start_ms_ >= this->max_duration_ms_) {
+      this->stop_recording();
+    }
   }
+
+  this->update_write_stats_();
+  this->publish_sensors_();
 }
 
 void MicrophoneRecorder::dump_config() {
   ESP_LOGCONFIG(TAG, "Microphone Recorder:");
-  ESP_LOGCONFIG(TAG, "  Mount point: %s", this->mount_point_.c_str());
-  ESP_LOGCONFIG(TAG, "  File prefix: %s", this->filename_prefix_.c_str());
+  if (this->raw_) {
+    ESP_LOGCONFIG(TAG, "  Raw region: %u MB from sector %u",
+                  static_cast<uint32_t>(
+                      static_cast<uint64_t>(this->raw_index_.data_sectors) *
+                      pcm_utils::RAW_SECTOR_SIZE >>
+                      20),
+                  this->raw_start_sector_);
+  } else {
+    ESP_LOGCONFIG(TAG, "  Mount point: %s", this->mount_point_.c_str());
+    ESP_LOGCONFIG(TAG, "  File prefix: %s", this->filename_prefix_.c_str());
+  }
+  ESP_LOGCONFIG(TAG, "  Codec: %s", codec_to_string(this->codec_));
+  ESP_LOGCONFIG(TAG, "  Bits per sample: %u", this->output_bits_per_sample_);
   ESP_LOGCONFIG(TAG, "  Max duration: %u ms", this->max_duration_ms_);
+  if (this->segment_duration_ms_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Segments: every %u ms (%u bytes)",
+                  this->segment_duration_ms_,
+                  static_cast<uint32_t>(this->segment_file_size_));
+  } else if (this->segment_size_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Segments: every %u bytes", this->segment_size_);
+  }
+  if (this->min_free_bytes_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Free space reserve: %u MB",
+                  static_cast<uint32_t>(this->min_free_bytes_ >> 20));
+  }
+  if (this->header_commit_interval_ms_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Header commit interval: %u ms",
+                  this->header_commit_interval_ms_);
+  }
+  if (this->pre_roll_bytes_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Pre-roll: %u ms (%zu bytes)", this->pre_roll_ms_,
+                  this->pre_roll_bytes_);
+  }
+  ESP_LOGCONFIG(TAG, "  Preallocate: %s", YESNO(this->preallocate_));
+  ESP_LOGCONFIG(TAG, "  Allocation unit size: %u bytes, max open files: %u",
+                this->allocation_unit_size_, this->max_files_);
+  ESP_LOGCONFIG(TAG, "  Buffer duration: %u ms (%zu bytes)",
+                this->buffer_duration_ms_, this->ring_size_);
+  ESP_LOGCONFIG(TAG, "  Write block size: %zu bytes", this->block_size_);
+  ESP_LOGCONFIG(TAG, "  Writer task: priority %u, core %d, stack %u bytes",
+                this->task_priority_, this->task_core_,
+                this->task_stack_size_);
   ESP_LOGCONFIG(TAG, "  Pins: CLK=%d CMD=%d D0=%d D1=%d D2=%d D3=%d",
                 this->clk_pin_, this->cmd_pin_, this->d0_pin_, this->d1_pin_,
                 this->d2_pin_, this->d3_pin_);
+  const uint32_t freq_khz = this->bus_freq_khz_.load(std::memory_order_relaxed);
+  if (this->mounted_ && this->using_spi_host_) {
+    ESP_LOGCONFIG(TAG,
+                  "  Bus: SPI at %u kHz (max %u kHz), max transfer %u bytes",
+                  freq_khz, this->max_bus_freq_khz_,
+                  this->spi_max_transfer_size_);
+  } else if (this->mounted_) {
+    ESP_LOGCONFIG(TAG, "  Bus: SDMMC %u-bit at %u kHz (max %u kHz)",
+                  1u << this->card_->log_bus_width, freq_khz,
+                  this->max_bus_freq_khz_);
+  }
+  if (this->self_test_mb_per_s_ > 0.0f) {
+    ESP_LOGCONFIG(TAG, "  Self-test: %.2f MB/s, longest write %.1f ms",
+                  this->self_test_mb_per_s_, this->self_test_max_us_ / 1000.0f);
+  }
+  if (this->mounted_) {
+    ESP_LOGCONFIG(TAG, "  Free space: %u MB",
+                  this->free_space_mb_.load(std::memory_order_relaxed));
+  }
+  pcm_utils::LatencyCounts latency;
+  this->write_latency_.snapshot(&latency);
+  if (latency.total() > 0) {
+    const uint32_t max_us = this->max_write_us_.load(std::memory_order_relaxed);
+    ESP_LOGCONFIG(TAG,
+                  "  Block writes: %u since boot, p50 %.1f ms, p99 %.1f ms, "
+                  "max %.1f ms",
+                  latency.total(),
+                  std::min(latency.percentile(0.5f), max_us) / 1000.0f,
+                  std::min(latency.percentile(0.99f), max_us) / 1000.0f,
+                  max_us / 1000.0f);
+  }
+  if (this->last_stats_ms_ != 0) {
+    ESP_LOGCONFIG(TAG,
+                  "  Last %u s: write speed %.2f MB/s, buffer headroom %u ms",
+                  STATS_WINDOW_MS / 1000, this->write_mb_per_s_,
+                  this->headroom_ms_);
+  }
 }
 
 bool MicrophoneRecorder::mount_sdcard_() {
   if (this->mounted_) {
     return true;
   }
+  const bool use_spi =
+      (this->d1_pin_ < 0 && this->d2_pin_ < 0 && this->d3_pin_ >= 0);
+  if (use_spi && !this->init_spi_bus_()) {
+    return false;
+  }
+
+  // Long or poorly routed lines show up as CRC errors and timeouts while the
+  // card is brought up; each retry halves the clock.
+  uint32_t freq_khz = this->max_bus_freq_khz_;
   esp_err_t ret;
-  esp_vfs_fat_sdmmc_mount_config_t mount_config = {
-      .format_if_mount_failed = this->format_if_failed_,
-      .max_files = 8,
-      .allocation_unit_size = 0,
+  while (true) {
+    ret = use_spi ? this->mount_spi_(freq_khz) : this->mount_sdmmc_(freq_khz);
+    if (ret == ESP_OK || !is_bus_error(ret) || freq_khz <= MIN_BUS_FREQ_KHZ) {
+      break;
+    }
+    const uint32_t lower = std::max(freq_khz / 2, MIN_BUS_FREQ_KHZ);
+    ESP_LOGW(TAG, "SD card failed at %u kHz (%s); retrying at %u kHz",
+             freq_khz, esp_err_to_name(ret), lower);
+    freq_khz = lower;
+  }
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "SD card over %s failed to %s (%s)",
+             use_spi ? "SPI" : "SDMMC", this->raw_ ? "initialise" : "mount",
+             esp_err_to_name(ret));
+    if (this->spi_bus_initialized_) {
+      spi_bus_free(this->spi_host_id_);
+      this->spi_bus_initialized_ = false;
+    }
+    return false;
+  }
+
+  this->using_spi_host_ = use_spi;
+  this->bus_freq_khz_.store(this->card_->real_freq_khz,
+                            std::memory_order_relaxed);
+  this->mounted_ = true;
+  if (this->raw_) {
+    ESP_LOGI(TAG, "Initialised SD card for raw recording at %u kHz",
+             this->card_->real_freq_khz);
+  } else {
+    ESP_LOGI(TAG, "Mounted SD card at %s, %u kHz", this->mount_point_.c_str(),
+             this->card_->real_freq_khz);
+  }
+  return true;
+}
+
+bool MicrophoneRecorder::init_spi_bus_() {
+  spi_bus_config_t bus_cfg = {
+      .mosi_io_num = this->cmd_pin_,
+      .miso_io_num = this->d0_pin_,
+      .sclk_io_num = this->clk_pin_,
+      .quadwp_io_num = -1,
+      .quadhd_io_num = -1,
+      .max_transfer_sz = static_cast<int>(this->spi_max_transfer_size_),
+      .flags = SPICOMMON_BUSFLAG_MASTER,
+      .intr_flags = 0,
   };
+  // A bus another component already brought up is shared as it is.
+  const esp_err_t ret = spi_bus_initialize(this->spi_host_id_, &bus_cfg,
+                                           this->spi_dma_channel_);
+  if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+    ESP_LOGE(TAG, "spi_bus_initialize failed (%s)", esp_err_to_name(ret));
+    return false;
+  }
+  this->spi_bus_initialized_ = (ret == ESP_OK);
+  return true;
+}
+
+esp_err_t MicrophoneRecorder::mount_spi_(uint32_t freq_khz) {
+  sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+  host.slot = this->spi_host_id_;
+  host.max_freq_khz = freq_khz;
 
-  bool use_spi = (this->d1_pin_ < 0 && this->d2_pin_ < 0 && this->d3_pin_ >= 0);
-
-  if (use_spi) {
-    sdmmc_host_t host = SDSPI_HOST_DEFAULT();
-    spi_bus_config_t bus_cfg = {
-        .mosi_io_num = this->cmd_pin_,
-        .miso_io_num = this->d0_pin_,
-        .sclk_io_num = this->clk_pin_,
-        .quadwp_io_num = -1,
-        .quadhd_io_num = -1,
-        .max_transfer_sz = 4096,
-        .flags = SPICOMMON_BUSFLAG_MASTER,
-        .intr_flags = 0,
+  sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
+  slot_config.gpio_cs = static_cast<gpio_num_t>(this->d3_pin_);
+  slot_config.host_id = this->spi_host_id_;
+
+  if (!this->raw_) {
+    esp_vfs_fat_sdmmc_mount_config_t mount_config = {
+        .format_if_mount_failed = this->format_if_failed_,
+        .max_files = this->max_files_,
+        .allocation_unit_size = this->allocation_unit_size_,
     };
+    return esp_vfs_fat_sdspi_mount(this->mount_point_.c_str(), &host,
+                                   &slot_config, &mount_config, &this->card_);
+  }
+  // Raw recording owns its sectors: bring up the card, but no FAT. The card
+  // addresses its device by handle rather than by bus.
+  sdspi_dev_handle_t handle;
+  esp_err_t ret = sdspi_host_init();
+  if (ret == ESP_OK) {
+    ret = sdspi_host_init_device(&slot_config, &handle);
+  }
+  if (ret == ESP_OK) {
+    host.slot = handle;
+    ret = this->init_raw_card_(&host);
+  }
+  if (ret != ESP_OK) {
+    sdspi_host_deinit();
+  }
+  return ret;
+}
 
-    ret = spi_bus_initialize(host.slot, &bus_cfg, SDSPI_DEFAULT_DMA);
-    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
-      ESP_LOGE(TAG, "spi_bus_initialize failed (%s)", esp_err_to_name(ret));
-      return false;
-    }
-    this->spi_bus_initialized_ = (ret == ESP_OK);
+esp_err_t MicrophoneRecorder::mount_sdmmc_(uint32_t freq_khz) {
+  const bool four_bit =
+      this->d3_pin_ >= 0 && this->d2_pin_ >= 0 && this->d1_pin_ >= 0;
+  sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+  host.flags = four_bit ? SDMMC_HOST_FLAG_4BIT : SDMMC_HOST_FLAG_1BIT;
+  // Above the default speed, the card is switched to high-speed timing.
+  host.max_freq_khz = freq_khz;
 
-    sdspi_device_config_t slot_config = SDSPI_DEVICE_CONFIG_DEFAULT();
-    slot_config.gpio_cs = this->d3_pin_;
-    slot_config.host_id = host.slot;
+  sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT();
+  slot_config.width = four_bit ? 4 : 1;
+  slot_config.clk = (gpio_num_t)this->clk_pin_;
+  slot_config.cmd = (gpio_num_t)this->cmd_pin_;
+  slot_config.d0 = (gpio_num_t)this->d0_pin_;
+  slot_config.d1 = (gpio_num_t)((this->d1_pin_ >= 0) ? this->d1_pin_ : -1);
+  slot_config.d2 = (gpio_num_t)((this->d2_pin_ >= 0) ? this->d2_pin_ : -1);
+  slot_config.d3 = (gpio_num_t)((this->d3_pin_ >= 0) ? this->d3_pin_ : -1);
+  slot_config.flags = SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
 
-    ret = esp_vfs_fat_sdspi_mount(this->mount_point_.c_str(), &host,
-                                  &slot_config, &mount_config, &this->card_);
-    if (ret != ESP_OK) {
-      ESP_LOGE(TAG, "esp_vfs_fat_sdspi_mount failed (%s)",
-               esp_err_to_name(ret));
-      if (this->spi_bus_initialized_) {
-        spi_bus_free(host.slot);
-        this->spi_bus_initialized_ = false;
-      }
-      return false;
+  if (!this->raw_) {
+    esp_vfs_fat_sdmmc_mount_config_t mount_config = {
+        .format_if_mount_failed = this->format_if_failed_,
+        .max_files = this->max_files_,
+        .allocation_unit_size = this->allocation_unit_size_,
+    };
+    return esp_vfs_fat_sdmmc_mount(this->mount_point_.c_str(), &host,
+                                   &slot_config, &mount_config, &this->card_);
+  }
+  esp_err_t ret = sdmmc_host_init();
+  if (ret == ESP_OK) {
+    ret = sdmmc_host_init_slot(host.slot, &slot_config);
+  }
+  if (ret == ESP_OK) {
+    ret = this->init_raw_card_(&host);
+  }
+  if (ret != ESP_OK) {
+    sdmmc_host_deinit();
+  }
+  return ret;
+}
+
+esp_err_t MicrophoneRecorder::init_raw_card_(sdmmc_host_t *host) {
+  this->card_ = static_cast<sdmmc_card_t *>(calloc(1, sizeof(sdmmc_card_t)));
+  if (this->card_ == nullptr) {
+    return ESP_ERR_NO_MEM;
+  }
+  const esp_err_t ret = sdmmc_card_init(host, this->card_);
+  if (ret != ESP_OK) {
+    free(this->card_);
+    this->card_ = nullptr;
+  }
+  return ret;
+}
+
+bool MicrophoneRecorder::lower_bus_speed_() {
+  const uint32_t freq_khz = this->bus_freq_khz_.load(std::memory_order_relaxed);
+  if (this->card_ == nullptr || freq_khz <= MIN_BUS_FREQ_KHZ) {
+    return false;
+  }
+  const uint32_t lower = std::max(freq_khz / 2, MIN_BUS_FREQ_KHZ);
+  // The card keeps its bus width and timing; only the host clock changes.
+  if (this->card_->host.set_card_clk(this->card_->host.slot, lower) !=
+      ESP_OK) {
+    return false;
+  }
+  this->bus_freq_khz_.store(lower, std::memory_order_relaxed);
+  ESP_LOGW(TAG, "SD writes failing at %u kHz; lowered the clock to %u kHz",
+           freq_khz, lower);
+  return true;
+}
+
+void MicrophoneRecorder::run_self_test_() {
+  uint64_t bytes = this->self_test_size_;
+  if (this->raw_) {
+    // The test writes ahead of the recording position, over audio a fresh
+    // index commit has already given up.
+    if (!this->commit_raw_index_()) {
+      ESP_LOGW(TAG, "Card self-test skipped: can't write the raw index");
+      return;
+    }
+    bytes = std::min(bytes, this->raw_reserve_bytes_);
+  }
+  const size_t blocks = std::max<size_t>(bytes / this->block_size_, 1);
+  std::memset(this->block_buffer_, 0xA5, this->block_size_);
+  while (true) {
+    uint32_t max_us = 0;
+    bool io_error = false;
+    const int64_t start_us = esp_timer_get_time();
+    if (this->self_test_pass_(blocks, &max_us, &io_error)) {
+      const int64_t elapsed_us = esp_timer_get_time() - start_us;
+      // Bytes per microsecond are megabytes per second.
+      this->self_test_mb_per_s_ =
+          static_cast<float>(blocks * this->block_size_) /
+          static_cast<float>(std::max<int64_t>(elapsed_us, 1));
+      this->self_test_max_us_ = max_us;
+      ESP_LOGI(TAG, "Card self-test: %.2f MB/s, longest write %.1f ms",
+               this->self_test_mb_per_s_, max_us / 1000.0f);
+      return;
+    }
+    if (!io_error || !this->lower_bus_speed_()) {
+      ESP_LOGW(TAG, "Card self-test failed");
+      return;
     }
+  }
+}
 
-    this->using_spi_host_ = true;
-    this->spi_host_id_ = host.slot;
-  } else {
-    sdmmc_host_t host = SDMMC_HOST_DEFAULT();
-    host.flags =
-        (this->d3_pin_ >= 0 && this->d2_pin_ >= 0 && this->d1_pin_ >= 0)
-            ? SDMMC_HOST_FLAG_4BIT
-            : SDMMC_HOST_FLAG_1BIT;
-    host.max_freq_khz = SDMMC_FREQ_DEFAULT;
-
-    sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT();
-    slot_config.width =
-        (this->d3_pin_ >= 0 && this->d2_pin_ >= 0 && this->d1_pin_ >= 0) ? 4
-                                                                         : 1;
-    slot_config.clk = (gpio_num_t)this->clk_pin_;
-    slot_config.cmd = (gpio_num_t)this->cmd_pin_;
-    slot_config.d0 = (gpio_num_t)this->d0_pin_;
-    slot_config.d1 = (gpio_num_t)((this->d1_pin_ >= 0) ? this->d1_pin_ : -1);
-    slot_config.d2 = (gpio_num_t)((this->d2_pin_ >= 0) ? this->d2_pin_ : -1);
-    slot_config.d3 = (gpio_num_t)((this->d3_pin_ >= 0) ? this->d3_pin_ : -1);
-    slot_config.flags = SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
-
-    ret = esp_vfs_fat_sdmmc_mount(this->mount_point_.c_str(), &host,
-                                  &slot_config, &mount_config, &this->card_);
-    if (ret != ESP_OK) {
-      ESP_LOGE(TAG, "esp_vfs_fat_sdmmc_mount failed (%s)",
-               esp_err_to_name(ret));
-      return false;
+bool MicrophoneRecorder::self_test_pass_(size_t blocks, uint32_t *max_us,
+                                         bool *io_error) {
+  if (this->raw_) {
+    // Raw writes already retry at lower clocks by themselves.
+    for (size_t i = 0; i < blocks; i++) {
+      const int64_t start_us = esp_timer_get_time();
+      if (!this->write_raw_sectors_(
+              this->raw_write_position_ + i * this->block_size_,
+              this->block_buffer_,
+              this->block_size_ / pcm_utils::RAW_SECTOR_SIZE)) {
+        return false;
+      }
+      *max_us = std::max(
+          *max_us, static_cast<uint32_t>(esp_timer_get_time() - start_us));
+      // Setup runs in the loop task, which the task watchdog is watching.
+      App.feed_wdt();
     }
-    this->using_spi_host_ = false;
+    return true;
   }
 
-  this->mounted_ = true;
-  ESP_LOGI(TAG, "Mounted SD card at %s", this->mount_point_.c_str());
-  return true;
+  // A scratch file grown block by block like an unpreallocated recording,
+  // then synced; the sync is timed as a write of its own.
+  const std::string path = this->mount_point_ + "/selftest.tmp";
+  const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = true;
+  for (size_t i = 0; i <= blocks && ok; i++) {
+    const int64_t start_us = esp_timer_get_time();
+    // errno only means something when the call itself failed; a short
+    // write leaves it as some earlier call set it.
+    ssize_t result;
+    if (i < blocks) {
+      result = ::write(fd, this->block_buffer_, this->block_size_);
+      ok = result == static_cast<ssize_t>(this->block_size_);
+    } else {
+      result = ::fsync(fd);
+      ok = result == 0;
+    }
+    *io_error = result < 0 && errno == EIO;
+    *max_us = std::max(
+        *max_us, static_cast<uint32_t>(esp_timer_get_time() - start_us));
+    App.feed_wdt();
+  }
+  ::close(fd);
+  ::unlink(path.c_str());
+  return ok;
 }
 
 void MicrophoneRecorder::unmount_sdcard_() {
   if (!this->mounted_) {
     return;
   }
-  esp_vfs_fat_sdcard_unmount(this->mount_point_.c_str(), this->card_);
+  if (this->raw_) {
+    if (this->using_spi_host_) {
+      sdspi_host_deinit();
+    } else {
+      sdmmc_host_deinit();
+    }
+    free(this->card_);
+  } else {
+    esp_vfs_fat_sdcard_unmount(this->mount_point_.c_str(), this->card_);
+  }
   if (this->using_spi_host_ && this->spi_bus_initialized_) {
     spi_bus_free(this->spi_host_id_);
     this->spi_bus_initialized_ = false;
@@ -165,11 +603,123 @@ void MicrophoneRecorder::unmount_sdcard_() {
   this->card_ = nullptr;
 }
 
+size_t MicrophoneRecorder::ms_to_source_bytes_(uint32_t ms) const {
+  // 64-bit, since minutes of 48 kHz audio overflow 32-bit frame counts
+  // scaled by milliseconds.
+  const auto info = this->mic_source_->get_audio_stream_info();
+  const uint64_t frames =
+      static_cast<uint64_t>(ms) * info.get_sample_rate() / 1000;
+  return frames * this->source_frame_size_;
+}
+
+bool MicrophoneRecorder::allocate_buffers_() {
+  const auto info = this->mic_source_->get_audio_stream_info();
+  const uint8_t channels = info.get_channels();
+  // Sources wider than the output are truncated on the way into the block,
+  // so a block takes more than its size from the ring. Codecs shrink the
+  // audio further: exactly fourfold for IMA-ADPCM, and typically about
+  // twofold for FLAC.
+  size_t block_frames = this->block_size_ / this->output_frame_size_;
+  if (this->codec_ == CODEC_IMA_ADPCM) {
+    block_frames = this->block_size_ /
+                   (ADPCM_BLOCK_ALIGN_PER_CHANNEL * channels) *
+                   this->codec_frames_;
+  } else if (this->codec_ == CODEC_FLAC) {
+    block_frames *= 2;
+  }
+  this->block_source_size_ = block_frames * this->source_frame_size_;
+  size_t ring_size = this->ms_to_source_bytes_(this->buffer_duration_ms_);
+  if (ring_size < this->block_source_size_ * 2) {
+    ring_size = this->block_source_size_ * 2;
+  }
+  // The pre-roll sits in the ring permanently, so it comes on top.
+  ring_size += this->pre_roll_bytes_;
+  this->ring_size_ = pcm_utils::SpscRing::round_capacity(ring_size);
+
+  // The staging ring is the large buffer, so it may live in PSRAM. The block
+  // buffer is what the SD driver reads from: keep it in internal RAM so the
+  // transfer can use DMA straight from it instead of bouncing each sector
+  // through a driver-side copy.
+  RAMAllocator<uint8_t> ring_allocator;
+  this->ring_storage_ = ring_allocator.allocate(this->ring_size_);
+  if (this->ring_storage_ == nullptr) {
+    ESP_LOGE(TAG, "Failed to allocate staging buffer (%zu bytes)",
+             this->ring_size_);
+    return false;
+  }
+  this->ring_ = std::make_unique<pcm_utils::SpscRing>(this->ring_storage_,
+                                                      this->ring_size_);
+
+  RAMAllocator<uint8_t> block_allocator(RAMAllocator<uint8_t>::ALLOC_INTERNAL);
+  this->block_buffer_ = block_allocator.allocate(this->block_size_);
+  if (this->block_buffer_ == nullptr) {
+    ESP_LOGE(TAG, "Failed to allocate write block (%zu bytes)",
+             this->block_size_);
+    return false;
+  }
+
+  if (this->codec_ == CODEC_PCM) {
+    return true;
+  }
+  // The encoder reads and writes its buffers front to back, which the cache
+  // handles well, so they may go to PSRAM like the ring.
+  size_t output_size;
+  size_t work_size = 0;
+  if (this->codec_ == CODEC_IMA_ADPCM) {
+    output_size = ADPCM_BLOCK_ALIGN_PER_CHANNEL * channels;
+  } else {
+    output_size = pcm_utils::flac_max_frame_size(FLAC_BLOCK_FRAMES, channels);
+    work_size = pcm_utils::flac_encoder_work_size(FLAC_BLOCK_FRAMES);
+  }
+  RAMAllocator<uint8_t> codec_allocator;
+  this->codec_input_ =
+      codec_allocator.allocate(this->codec_frames_ * this->output_frame_size_);
+  this->codec_output_ = codec_allocator.allocate(output_size);
+  if (work_size > 0) {
+    this->flac_work_ = codec_allocator.allocate(work_size);
+  }
+  if (this->codec_input_ == nullptr || this->codec_output_ == nullptr ||
+      (work_size > 0 && this->flac_work_ == nullptr)) {
+    ESP_LOGE(TAG, "Failed to allocate %s encoder buffers",
+             codec_to_string(this->codec_));
+    return false;
+  }
+  if (this->codec_ == CODEC_FLAC) {
+    this->flac_encoder_ = std::make_unique<pcm_utils::FlacEncoder>(
+        channels, info.get_sample_rate(), FLAC_BLOCK_FRAMES, this->flac_work_);
+  }
+  return true;
+}
+
+bool MicrophoneRecorder::start_writer_task_() {
+  BaseType_t core = this->task_core_;
+  if (core < 0 || core >= portNUM_PROCESSORS) {
+    core = tskNO_AFFINITY;
+  }
+  BaseType_t result = xTaskCreatePinnedToCore(
+      MicrophoneRecorder::writer_task_, "mic_rec_writer",
+      this->task_stack_size_, this, this->task_priority_, &this->task_handle_,
+      core);
+  if (result != pdPASS) {
+    this->task_handle_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
 bool MicrophoneRecorder::start_recording() {
-  if (this->recording_) {
+  const uint8_t state = this->state_.load(std::memory_order_acquire);
+  if (state == STATE_RECORDING) {
     ESP_LOGW(TAG, "Recording already in progress");
     return false;
   }
+  if (state == STATE_STOPPING) {
+    ESP_LOGW(TAG, "Previous recording is still being written out");
+    return false;
+  }
+  if (this->ring_ == nullptr) {
+    return false;
+  }
   if (!this->mounted_) {
     if (!this->mount_sdcard_()) {
       return false;
@@ -180,124 +730,1283 @@ bool MicrophoneRecorder::start_recording() {
     return false;
   }
 
-  this->data_bytes_written_ = 0;
+  this->begin_file_();
+  this->write_failed_.store(false, std::memory_order_relaxed);
+  this->dropped_at_start_ =
+      this->bytes_dropped_total_.load(std::memory_order_relaxed);
   this->recording_start_ms_ = millis();
-  this->recording_ = true;
-  this->pending_stop_ = false;
+  // The file starts pre_roll_bytes_ before this point in the stream.
+  this->start_position_ = this->ring_->write_position();
+  this->trim_pending_ = true;
+  this->state_.store(STATE_RECORDING, std::memory_order_release);
   ESP_LOGI(TAG, "Recording started: %s", this->active_path_.c_str());
   return true;
 }
 
 void MicrophoneRecorder::stop_recording() {
-  if (!this->recording_) {
+  if (this->state_.load(std::memory_order_acquire) != STATE_RECORDING) {
     return;
   }
+  // The file ends at this point in the stream. With a pre-roll the callback
+  // keeps queueing, and what follows becomes the next file's pre-roll.
+  this->stop_position_ = this->ring_->write_position();
+  this->state_.store(STATE_STOPPING, std::memory_order_release);
+  xTaskNotifyGive(this->task_handle_);
+}
 
-  {
-    std::lock_guard<std::mutex> lock(this->write_mutex_);
-    this->recording_ = false;
-    this->pending_stop_ = false;
-    this->update_wav_sizes_();
-    this->close_file_();
+bool MicrophoneRecorder::open_new_file_() {
+  if ((this->source_bits_per_sample_ != 16 &&
+       this->source_bits_per_sample_ != 32) ||
+      this->output_bits_per_sample_ > this->source_bits_per_sample_) {
+    ESP_LOGE(TAG, "Unsupported audio format for recording (%u-bit source, "
+                  "%u-bit output)",
+             this->source_bits_per_sample_, this->output_bits_per_sample_);
+    return false;
+  }
+  if (this->raw_) {
+    return this->begin_raw_recording_();
   }
 
-  ESP_LOGI(TAG, "Recording finished: %s (%u bytes)", this->active_path_.c_str(),
-           this->data_bytes_written_);
+  char filename[64];
+  if (this->segment_source_bytes_ > 0) {
+    if (!this->segments_scanned_) {
+      this->scan_segments_();
+    }
+    this->evict_segments_(this->sequence_);
+    this->active_sequence_ = this->sequence_++;
+    this->segment_path_(this->active_sequence_, filename, sizeof(filename));
+  } else {
+    snprintf(filename, sizeof(filename), "%s/%s-%lu%s",
+             this->mount_point_.c_str(), this->filename_prefix_.c_str(),
+             static_cast<unsigned long>(millis()), this->file_extension_());
+  }
+  this->active_path_ = filename;
+  this->fd_ = this->open_file_(filename, &this->preallocated_bytes_);
+  return this->fd_ >= 0;
 }
 
-bool MicrophoneRecorder::open_new_file_() {
+int MicrophoneRecorder::open_file_(const char *path, uint32_t *preallocated) {
+  *preallocated = 0;
+  if (this->preallocate_) {
+    *preallocated = this->preallocate_file_(path);
+  }
+
+  // Plain file descriptors: stdio would split each block into BUFSIZ-sized
+  // writes, which is exactly what the block buffer is there to avoid. A
+  // preallocated file is written over in place, keeping its clusters.
+  int flags = O_WRONLY | O_CREAT;
+  if (*preallocated == 0) {
+    flags |= O_TRUNC;
+  }
+  int fd = ::open(path, flags, 0644);
+  if (fd < 0) {
+    ESP_LOGE(TAG, "Failed to open %s for writing", path);
+    return fd;
+  }
+  // Commit an empty header before any audio, so a file cut short by a power
+  // loss is recognisably an unfinished recording rather than whatever the
+  // preallocated clusters held before. The first block overwrites it.
+  this->write_header_(fd, 0, 0, false);
+  ::fsync(fd);
+  ::lseek(fd, 0, SEEK_SET);
+  return fd;
+}
+
+uint64_t MicrophoneRecorder::file_size_for_frames_(uint64_t frames) const {
+  // FLAC has no fixed size, so it gets its worst case: every FLAC frame
+  // stored verbatim.
+  const auto info = this->mic_source_->get_audio_stream_info();
+  const uint64_t codec_frames =
+      this->codec_frames_ > 0
+          ? (frames + this->codec_frames_ - 1) / this->codec_frames_
+          : 0;
+  switch (this->codec_) {
+  case CODEC_IMA_ADPCM:
+    return this->header_size_ + codec_frames * ADPCM_BLOCK_ALIGN_PER_CHANNEL *
+                                    info.get_channels();
+  case CODEC_FLAC:
+    return this->header_size_ +
+           codec_frames * pcm_utils::flac_max_frame_size(FLAC_BLOCK_FRAMES,
+                                                         info.get_channels());
+  default:
+    return this->header_size_ + frames * this->output_frame_size_;
+  }
+}
+
+uint64_t MicrophoneRecorder::expected_file_size_() const {
+  if (this->segment_file_size_ > 0) {
+    return this->segment_file_size_;
+  }
+  if (this->max_duration_ms_ == 0) {
+    return 0;
+  }
   const auto info = this->mic_source_->get_audio_stream_info();
-  if (info.get_bits_per_sample() != 16 || info.get_channels() == 0) {
-    ESP_LOGE(TAG, "Unsupported audio format for recording");
+  return this->file_size_for_frames_(
+      static_cast<uint64_t>(info.get_sample_rate()) *
+      (this->pre_roll_ms_ + this->max_duration_ms_) / 1000);
+}
+
+uint32_t MicrophoneRecorder::preallocate_file_(const char *path) {
+  uint64_t size = this->expected_file_size_();
+  if (size == 0) {
+    return 0;
+  }
+  size = (size + this->block_size_ - 1) / this->block_size_ * this->block_size_;
+  if (size > UINT32_MAX) {
+    ESP_LOGW(TAG, "File would exceed the FAT size limit; not preallocating");
+    return 0;
+  }
+
+  // Claims one contiguous run of clusters now, so the writer task never
+  // walks or extends the cluster chain while recording.
+  const int64_t start_us = esp_timer_get_time();
+  esp_err_t err = esp_vfs_fat_create_contiguous_file(
+      this->mount_point_.c_str(), path, size, true);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Could not preallocate %u contiguous bytes for %s (%s)",
+             static_cast<uint32_t>(size), path, esp_err_to_name(err));
+    return 0;
+  }
+  ESP_LOGD(TAG, "Preallocated %u bytes in %u ms", static_cast<uint32_t>(size),
+           static_cast<uint32_t>((esp_timer_get_time() - start_us) / 1000));
+  return static_cast<uint32_t>(size);
+}
+
+void MicrophoneRecorder::begin_file_() {
+  // The header goes out with the first block, so every write starts on a
+  // block boundary in the file and stays cluster aligned on the card.
+  this->block_fill_ =
+      this->raw_ ? 0 : this->build_header_(this->block_buffer_, 0, 0, false);
+  this->file_bytes_written_ = 0;
+  // Every file is a stream of its own.
+  this->sample_carry_len_ = 0;
+  this->sample_carry_pos_ = 0;
+  this->codec_input_fill_ = 0;
+  this->codec_output_len_ = 0;
+  this->codec_output_pos_ = 0;
+  for (auto &state : this->adpcm_states_) {
+    state = pcm_utils::ImaAdpcmState{};
+  }
+  if (this->flac_encoder_ != nullptr) {
+    this->flac_encoder_->reset();
+  }
+  this->encoded_bytes_ = 0;
+  this->encoded_frames_ = 0;
+  this->previous_encoded_bytes_ = 0;
+  this->previous_encoded_frames_ = 0;
+  this->min_frame_bytes_ = UINT32_MAX;
+  this->max_frame_bytes_ = 0;
+  this->segment_remaining_ = this->segment_source_bytes_;
+  this->last_header_commit_ms_ = millis();
+}
+
+const char *MicrophoneRecorder::file_extension_() const {
+  return this->codec_ == CODEC_FLAC ? ".flac" : ".wav";
+}
+
+bool MicrophoneRecorder::parse_sequence_(const char *name,
+                                         uint32_t *sequence) const {
+  // FAT may hand back short names in upper case.
+  const size_t prefix_len = this->filename_prefix_.size();
+  if (strncasecmp(name, this->filename_prefix_.c_str(), prefix_len) != 0 ||
+      name[prefix_len] != '-') {
     return false;
   }
+  char *end;
+  const unsigned long value = std::strtoul(name + prefix_len + 1, &end, 10);
+  if (end == name + prefix_len + 1 ||
+      strcasecmp(end, this->file_extension_()) != 0 ||
+      value == 0 || value >= UINT32_MAX) {
+    return false;
+  }
+  *sequence = value;
+  return true;
+}
+
+void MicrophoneRecorder::recover_files_() {
+  // Only the newest two segments can have been open when power was lost: the
+  // one being written and the one prepared after it. Without segments, every
+  // recording on the card is checked.
+  const bool segmented = this->segment_source_bytes_ > 0;
+  std::vector<std::string> names;
+  uint32_t newest[2] = {0, 0};
+  std::string newest_names[2];
+  DIR *dir = ::opendir(this->mount_point_.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  while (struct dirent *entry = ::readdir(dir)) {
+    uint32_t sequence;
+    if (!this->parse_sequence_(entry->d_name, &sequence)) {
+      continue;
+    }
+    if (!segmented) {
+      names.emplace_back(entry->d_name);
+    } else if (sequence > newest[0]) {
+      newest[1] = newest[0];
+      newest_names[1] = std::move(newest_names[0]);
+      newest[0] = sequence;
+      newest_names[0] = entry->d_name;
+    } else if (sequence > newest[1]) {
+      newest[1] = sequence;
+      newest_names[1] = entry->d_name;
+    }
+  }
+  ::closedir(dir);
 
-  char filename[64];
-  snprintf(filename, sizeof(filename), "%s/%s-%lu.wav",
-           this->mount_point_.c_str(), this->filename_prefix_.c_str(),
-           static_cast<unsigned long>(millis()));
-  this->active_path_ = filename;
+  for (auto &name : newest_names) {
+    if (!name.empty()) {
+      names.push_back(std::move(name));
+    }
+  }
+  for (const auto &name : names) {
+    this->recover_file_((this->mount_point_ + "/" + name).c_str());
+  }
+}
+
+void MicrophoneRecorder::recover_file_(const char *path) {
+  int fd = ::open(path, O_RDWR);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  uint8_t header[HEADER_READ_SIZE];
+  ssize_t got = -1;
+  if (::fstat(fd, &st) == 0) {
+    got = ::read(fd, header, sizeof(header));
+  }
+  if (got > 0 && this->codec_ == CODEC_FLAC) {
+    this->recover_flac_file_(fd, path, header, got, st.st_size);
+    return;
+  }
+  pcm_utils::WavLayout layout;
+  if (got <= 0 || !pcm_utils::parse_wav_header(header, got, &layout)) {
+    ::close(fd);
+    if (got == 0) {
+      // Power was lost before even the empty header was committed.
+      ::unlink(path);
+      ESP_LOGI(TAG, "Removed empty %s", path);
+    } else if (got > 0) {
+      ESP_LOGW(TAG, "%s has no WAV header; leaving it", path);
+    }
+    return;
+  }
+
+  // Past the last commit, a file holds either audio whose length was never
+  // recorded or preallocated clusters, which can't be told apart, so it is
+  // cut back to the committed length. A file shorter than its header claims
+  // keeps what it has.
+  const uint64_t length = st.st_size;
+  uint64_t room = 0;
+  if (length > layout.data_offset) {
+    room = (length - layout.data_offset) / layout.block_align *
+           layout.block_align;
+  }
+  const uint32_t data_bytes =
+      static_cast<uint32_t>(std::min<uint64_t>(layout.data_bytes, room));
+  const uint32_t riff_size =
+      pcm_utils::wav_riff_size(layout.data_offset, data_bytes);
+  uint32_t fact_frames = 0;
+  if (layout.fact_offset > 0) {
+    // Blocks cut off take their frames with them; the count a clean close
+    // left also excludes the padding of the last block.
+    fact_frames = static_cast<uint32_t>(
+        std::min<uint64_t>(pcm_utils::get_le32(header + layout.fact_offset),
+                           static_cast<uint64_t>(data_bytes) /
+                               layout.block_align * layout.frames_per_block));
+  }
+  if (data_bytes == layout.data_bytes &&
+      length == layout.data_offset + data_bytes &&
+      pcm_utils::get_le32(header + pcm_utils::WAV_RIFF_SIZE_OFFSET) ==
+          riff_size) {
+    ::close(fd);
+    return;
+  }
+  if (data_bytes == 0) {
+    ::close(fd);
+    ::unlink(path);
+    ESP_LOGI(TAG, "Removed unfinished recording %s with no audio", path);
+    return;
+  }
+
+  pcm_utils::put_le32(header + pcm_utils::WAV_RIFF_SIZE_OFFSET, riff_size);
+  pcm_utils::put_le32(header + layout.data_offset - 4, data_bytes);
+  if (layout.fact_offset > 0) {
+    pcm_utils::put_le32(header + layout.fact_offset, fact_frames);
+  }
+  ::pwrite(fd, header, layout.data_offset, 0);
+  ::ftruncate(fd, layout.data_offset + data_bytes);
+  ::fsync(fd);
+  ::close(fd);
+  ESP_LOGW(TAG, "Recovered unfinished recording %s (%u bytes)", path,
+           data_bytes);
+}
 
-  this->file_ = std::fopen(filename, "wb");
-  if (this->file_ == nullptr) {
-    ESP_LOGE(TAG, "Failed to open %s for writing", filename);
+void MicrophoneRecorder::recover_flac_file_(int fd, const char *path,
+                                            uint8_t *header, size_t len,
+                                            uint64_t length) {
+  pcm_utils::FlacStreamInfo stream;
+  if (!pcm_utils::parse_flac_stream_header(header, len, &stream)) {
+    ::close(fd);
+    ESP_LOGW(TAG, "%s has no FLAC header; leaving it", path);
+    return;
+  }
+  if (stream.seek_frame == pcm_utils::FLAC_SEEK_PLACEHOLDER) {
+    // Closed cleanly.
+    ::close(fd);
+    return;
+  }
+
+  // An unfinished file's seek point marks the end of the last committed FLAC
+  // frame. Past it there may be part of a frame, or preallocated clusters.
+  const uint32_t data_bytes = static_cast<uint32_t>(stream.seek_offset);
+  const uint64_t end = pcm_utils::FLAC_STREAM_HEADER_SIZE + data_bytes;
+  if (data_bytes == 0) {
+    ::close(fd);
+    ::unlink(path);
+    ESP_LOGI(TAG, "Removed unfinished recording %s with no audio", path);
+    return;
+  }
+  if (length < end) {
+    ::close(fd);
+    ESP_LOGW(TAG, "%s is shorter than its last header commit; leaving it",
+             path);
+    return;
+  }
+
+  stream.total_frames = stream.seek_frame;
+  stream.seek_frame = pcm_utils::FLAC_SEEK_PLACEHOLDER;
+  stream.seek_offset = 0;
+  const size_t header_len = pcm_utils::write_flac_stream_header(header, stream);
+  ::pwrite(fd, header, header_len, 0);
+  ::ftruncate(fd, end);
+  ::fsync(fd);
+  ::close(fd);
+  ESP_LOGW(TAG, "Recovered unfinished recording %s (%u bytes)", path,
+           data_bytes);
+}
+
+bool MicrophoneRecorder::open_raw_region_() {
+  using pcm_utils::RAW_SECTOR_SIZE;
+  const uint64_t card_sectors = this->card_->csd.capacity;
+  uint64_t sectors = this->raw_size_ / RAW_SECTOR_SIZE;
+  if (sectors == 0 && card_sectors > this->raw_start_sector_) {
+    sectors = card_sectors - this->raw_start_sector_;
+  }
+  // At least two blocks of data, so a block is never written over itself.
+  const uint64_t min_sectors = pcm_utils::RAW_INDEX_SECTORS +
+                               2 * this->block_size_ / RAW_SECTOR_SIZE;
+  if (sectors < min_sectors ||
+      this->raw_start_sector_ + sectors > card_sectors) {
+    ESP_LOGE(TAG,
+             "Raw region of %u sectors from sector %u doesn't fit on the "
+             "card (%u sectors)",
+             static_cast<uint32_t>(sectors), this->raw_start_sector_,
+             static_cast<uint32_t>(card_sectors));
+    return false;
+  }
+  if (!this->check_raw_partitions_(sectors)) {
     return false;
   }
+  const uint32_t data_sectors = static_cast<uint32_t>(std::min<uint64_t>(
+      sectors - pcm_utils::RAW_INDEX_SECTORS, UINT32_MAX));
+  // Each index commit lets the writer run this far ahead of it. Larger means
+  // fewer extra commits, but the oldest audio is given up that much sooner.
+  const uint64_t capacity =
+      static_cast<uint64_t>(data_sectors) * RAW_SECTOR_SIZE;
+  this->raw_reserve_bytes_ = std::max<uint64_t>(
+      this->block_size_, capacity / 64 / RAW_SECTOR_SIZE * RAW_SECTOR_SIZE);
+
+  // The newer of the index copies that read back intact.
+  bool found = false;
+  pcm_utils::RawIndex copy;
+  for (size_t i = 0; i < pcm_utils::RAW_INDEX_SECTORS; i++) {
+    if (sdmmc_read_sectors(this->card_, this->raw_sector_,
+                           this->raw_start_sector_ + i, 1) == ESP_OK &&
+        pcm_utils::parse_raw_index(this->raw_sector_, &copy) &&
+        (!found || copy.generation > this->raw_index_.generation)) {
+      this->raw_index_ = copy;
+      found = true;
+    }
+  }
+  if (found && this->raw_index_.data_sectors != data_sectors) {
+    // Every position in the ring now maps to a different sector.
+    ESP_LOGW(TAG, "Raw region changed size; discarding its recordings");
+    found = false;
+  }
+  if (!found) {
+    this->raw_index_ = pcm_utils::RawIndex{};
+    this->raw_index_.data_sectors = data_sectors;
+    this->raw_index_.next_sequence = 1;
+    this->raw_write_position_ = 0;
+    ESP_LOGI(TAG, "Starting a new raw region");
+    return this->commit_raw_index_();
+  }
 
-  this->write_wav_header_(this->file_, 0);
-  std::fflush(this->file_);
+  // Whatever was written past the committed position before a power loss
+  // is overwritten from here on.
+  this->raw_write_position_ = this->raw_index_.write_position;
+  this->raw_reserved_end_ = this->raw_write_position_;
+  const uint32_t last = this->raw_index_.next_sequence - 1;
+  const pcm_utils::RawRecording &recording =
+      this->raw_index_.recordings[last % pcm_utils::RAW_INDEX_RECORDINGS];
+  if (last > 0 && recording.sequence == last &&
+      (recording.flags & pcm_utils::RAW_RECORDING_COMPLETE) == 0) {
+    ESP_LOGW(TAG, "Raw recording %u was cut short after %u KB", last,
+             static_cast<uint32_t>(recording.length >> 10));
+  }
+  ESP_LOGI(TAG, "Raw region holds recordings up to %u", last);
   return true;
 }
 
-void MicrophoneRecorder::close_file_() {
-  if (this->file_ != nullptr) {
-    std::fflush(this->file_);
-    std::fclose(this->file_);
-    this->file_ = nullptr;
+bool MicrophoneRecorder::check_raw_partitions_(uint64_t sectors) {
+  // Refuse to write over a file system: the region has to be carved out of
+  // unpartitioned space, or be on a card given over to it entirely.
+  if (sdmmc_read_sectors(this->card_, this->raw_sector_, 0, 1) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to read the partition table");
+    return false;
+  }
+  const uint8_t *mbr = this->raw_sector_;
+  if (mbr[510] != 0x55 || mbr[511] != 0xAA) {
+    return true;
   }
+  // A FAT or exFAT boot sector carries the same signature, with the file
+  // system covering the whole card.
+  if (((mbr[0] == 0xEB || mbr[0] == 0xE9) &&
+       (std::memcmp(mbr + 54, "FAT", 3) == 0 ||
+        std::memcmp(mbr + 82, "FAT", 3) == 0)) ||
+      std::memcmp(mbr + 3, "EXFAT   ", 8) == 0) {
+    ESP_LOGE(TAG, "The card holds an unpartitioned file system; not writing "
+                  "a raw region over it");
+    return false;
+  }
+  const uint64_t first = this->raw_start_sector_;
+  const uint64_t end = first + sectors;
+  for (int i = 0; i < 4; i++) {
+    const uint8_t *entry = mbr + 446 + 16 * i;
+    if ((entry[0] != 0x00 && entry[0] != 0x80) || entry[4] == 0) {
+      continue;
+    }
+    const uint64_t part_first = pcm_utils::get_le32(entry + 8);
+    const uint64_t part_end = part_first + pcm_utils::get_le32(entry + 12);
+    if (first == 0 || (first < part_end && part_first < end)) {
+      ESP_LOGE(TAG,
+               "Raw region overlaps partition %d (sectors %u to %u); not "
+               "writing over it",
+               i + 1, static_cast<uint32_t>(part_first),
+               static_cast<uint32_t>(part_end - 1));
+      return false;
+    }
+  }
+  return true;
 }
 
-void MicrophoneRecorder::write_wav_header_(std::FILE *file,
-                                           uint32_t data_length) {
+bool MicrophoneRecorder::begin_raw_recording_() {
   const auto info = this->mic_source_->get_audio_stream_info();
-  const uint16_t channels = info.get_channels();
-  const uint32_t sample_rate = info.get_sample_rate();
-  const uint16_t bits_per_sample = info.get_bits_per_sample();
-  const uint16_t block_align = channels * (bits_per_sample / 8);
-  const uint32_t byte_rate = sample_rate * block_align;
-  const uint32_t chunk_size = 36 + data_length;
-
-  std::fwrite("RIFF", 1, 4, file);
-  std::fwrite(&chunk_size, 4, 1, file);
-  std::fwrite("WAVE", 1, 4, file);
-  std::fwrite("fmt ", 1, 4, file);
-
-  uint32_t subchunk1_size = 16;
-  uint16_t audio_format = 1;
-  std::fwrite(&subchunk1_size, 4, 1, file);
-  std::fwrite(&audio_format, 2, 1, file);
-  std::fwrite(&channels, 2, 1, file);
-  std::fwrite(&sample_rate, 4, 1, file);
-  std::fwrite(&byte_rate, 4, 1, file);
-  std::fwrite(&block_align, 2, 1, file);
-  std::fwrite(&bits_per_sample, 2, 1, file);
-
-  std::fwrite("data", 1, 4, file);
-  std::fwrite(&data_length, 4, 1, file);
-}
-
-void MicrophoneRecorder::update_wav_sizes_() {
-  if (this->file_ == nullptr) {
-    return;
+  const uint32_t sequence = this->raw_index_.next_sequence++;
+  pcm_utils::RawRecording &recording =
+      this->raw_index_.recordings[sequence % pcm_utils::RAW_INDEX_RECORDINGS];
+  recording = pcm_utils::RawRecording{};
+  recording.sequence = sequence;
+  recording.sample_rate = info.get_sample_rate();
+  recording.start = this->raw_write_position_;
+  recording.channels = info.get_channels();
+  recording.bits_per_sample = this->output_bits_per_sample_;
+  this->raw_recording_ = &recording;
+
+  char name[32];
+  snprintf(name, sizeof(name), "raw recording %u",
+           static_cast<unsigned>(sequence));
+  this->active_path_ = name;
+  // Committed before any audio, so the recording is known even if power is
+  // lost before its first commit.
+  if (!this->commit_raw_index_()) {
+    ESP_LOGE(TAG, "Failed to write the raw index");
+    return false;
+  }
+  return true;
+}
+
+bool MicrophoneRecorder::write_raw_sectors_(uint64_t position,
+                                            const uint8_t *data,
+                                            size_t count) {
+  using pcm_utils::RAW_SECTOR_SIZE;
+  const uint32_t data_sectors = this->raw_index_.data_sectors;
+  const uint32_t data_start =
+      this->raw_start_sector_ + pcm_utils::RAW_INDEX_SECTORS;
+  uint32_t sector = position / RAW_SECTOR_SIZE % data_sectors;
+  while (count > 0) {
+    // A write that reaches the end of the region wraps to its start.
+    const size_t run = std::min<size_t>(count, data_sectors - sector);
+    const esp_err_t ret =
+        sdmmc_write_sectors(this->card_, data, data_start + sector, run);
+    if (ret != ESP_OK) {
+      // Sector writes can simply be repeated, at a clock the bus copes with.
+      if (is_bus_error(ret) && this->lower_bus_speed_()) {
+        continue;
+      }
+      ESP_LOGE(TAG, "Raw write of %zu sectors failed (%s)", run,
+               esp_err_to_name(ret));
+      return false;
+    }
+    data += run * RAW_SECTOR_SIZE;
+    count -= run;
+    sector = 0;
+  }
+  return true;
+}
+
+bool MicrophoneRecorder::write_raw_block_(size_t len) {
+  using pcm_utils::RAW_SECTOR_SIZE;
+  // Only the last block of a recording is short; pad it to whole sectors.
+  const size_t padded =
+      (len + RAW_SECTOR_SIZE - 1) / RAW_SECTOR_SIZE * RAW_SECTOR_SIZE;
+  std::memset(this->block_buffer_ + len, 0, padded - len);
+  if (this->raw_write_position_ + padded > this->raw_reserved_end_ &&
+      !this->commit_raw_index_()) {
+    return false;
+  }
+
+  if (!this->write_raw_sectors_(this->raw_write_position_, this->block_buffer_,
+                                padded / RAW_SECTOR_SIZE)) {
+    return false;
+  }
+
+  const uint64_t audio_end = this->raw_write_position_ + len;
+  this->raw_write_position_ += padded;
+  pcm_utils::RawRecording *recording = this->raw_recording_;
+  recording->length = (audio_end - recording->start) /
+                      this->output_frame_size_ * this->output_frame_size_;
+  return true;
+}
+
+bool MicrophoneRecorder::commit_raw_index_() {
+  using pcm_utils::RAW_SECTOR_SIZE;
+  pcm_utils::RawIndex &index = this->raw_index_;
+  // Declare the audio the writer may overwrite before the next commit gone
+  // now, so an index read after a power loss never points at it.
+  this->raw_reserved_end_ =
+      this->raw_write_position_ + this->raw_reserve_bytes_;
+  const uint64_t capacity =
+      static_cast<uint64_t>(index.data_sectors) * RAW_SECTOR_SIZE;
+  if (this->raw_reserved_end_ > capacity) {
+    index.oldest_position = std::max(index.oldest_position,
+                                     this->raw_reserved_end_ - capacity);
   }
+  index.write_position = this->raw_write_position_;
+  index.generation++;
+  pcm_utils::write_raw_index(this->raw_sector_, index);
+  const uint32_t sector = this->raw_start_sector_ +
+                          index.generation % pcm_utils::RAW_INDEX_SECTORS;
+  esp_err_t ret;
+  do {
+    ret = sdmmc_write_sectors(this->card_, this->raw_sector_, sector, 1);
+  } while (is_bus_error(ret) && this->lower_bus_speed_());
+  // Whichever task commits owns the index right now: the loop task while a
+  // recording starts, the writer task otherwise.
+  this->update_raw_free_space_();
+  return ret == ESP_OK;
+}
 
-  uint32_t data_length = this->data_bytes_written_;
-  uint32_t chunk_size = 36 + data_length;
+void MicrophoneRecorder::segment_path_(uint32_t sequence, char *out,
+                                       size_t len) const {
+  snprintf(out, len, "%s/%s-%06u%s", this->mount_point_.c_str(),
+           this->filename_prefix_.c_str(), static_cast<unsigned>(sequence),
+           this->file_extension_());
+}
 
-  std::fseek(this->file_, 4, SEEK_SET);
-  std::fwrite(&chunk_size, 4, 1, this->file_);
-  std::fseek(this->file_, 40, SEEK_SET);
-  std::fwrite(&data_length, 4, 1, this->file_);
-  std::fflush(this->file_);
+void MicrophoneRecorder::scan_segments_() {
+  // Segment numbers carry on from what is already on the card, so a reboot
+  // neither overwrites nor reorders earlier segments.
+  uint32_t lowest = UINT32_MAX;
+  uint32_t highest = 0;
+  DIR *dir = ::opendir(this->mount_point_.c_str());
+  if (dir != nullptr) {
+    while (struct dirent *entry = ::readdir(dir)) {
+      uint32_t sequence;
+      if (!this->parse_sequence_(entry->d_name, &sequence)) {
+        continue;
+      }
+      lowest = std::min(lowest, sequence);
+      highest = std::max(highest, sequence);
+    }
+    ::closedir(dir);
+  }
+  this->sequence_ = highest + 1;
+  this->oldest_sequence_ = lowest == UINT32_MAX ? this->sequence_ : lowest;
+  this->segments_scanned_ = true;
+  if (highest > 0) {
+    ESP_LOGD(TAG, "Found segments %u to %u", this->oldest_sequence_, highest);
+  }
+}
+
+void MicrophoneRecorder::evict_segments_(uint32_t keep_from) {
+  if (this->min_free_bytes_ == 0) {
+    return;
+  }
+  // Room for the segment about to be created comes on top of the reserve.
+  const uint64_t wanted = this->min_free_bytes_ + this->segment_file_size_;
+  uint64_t total = 0;
+  uint64_t free = 0;
+  while (esp_vfs_fat_info(this->mount_point_.c_str(), &total, &free) ==
+             ESP_OK &&
+         free < wanted) {
+    if (this->oldest_sequence_ >= keep_from) {
+      if (!this->warned_no_space_) {
+        ESP_LOGW(TAG, "Card below its free space reserve with no segments "
+                      "left to evict");
+        this->warned_no_space_ = true;
+      }
+      return;
+    }
+    char path[64];
+    this->segment_path_(this->oldest_sequence_++, path, sizeof(path));
+    // Gaps left by segments deleted by hand are simply skipped.
+    if (::unlink(path) == 0) {
+      ESP_LOGI(TAG, "Evicted %s (%u MB free)", path,
+               static_cast<uint32_t>(free >> 20));
+    }
+  }
+  this->warned_no_space_ = false;
 }
 
 void MicrophoneRecorder::handle_audio_data_(const std::vector<uint8_t> &data) {
-  if (!this->recording_) {
+  const uint8_t state = this->state_.load(std::memory_order_acquire);
+  if (state != STATE_RECORDING && this->pre_roll_bytes_ == 0) {
     return;
   }
-  std::lock_guard<std::mutex> lock(this->write_mutex_);
-  if (!this->recording_ || this->file_ == nullptr) {
+  pcm_utils::SpscRing *ring = this->ring_.get();
+
+  // Whole frames only, so a drop never misaligns the channels in the file.
+  const size_t written =
+      ring->write(data.data(), data.size(), this->source_frame_size_);
+  const size_t queued = ring->available();
+  if (state != STATE_IDLE && queued >= this->block_source_size_) {
+    xTaskNotifyGive(this->task_handle_);
+  }
+  if (queued > this->queue_high_water_.load(std::memory_order_relaxed)) {
+    this->queue_high_water_.store(queued, std::memory_order_relaxed);
+  }
+  if (queued > this->window_high_water_.load(std::memory_order_relaxed)) {
+    this->window_high_water_.store(queued, std::memory_order_relaxed);
+  }
+
+  if (written < data.size()) {
+    this->bytes_dropped_total_.fetch_add(data.size() - written,
+                                         std::memory_order_relaxed);
+    if (!this->warned_full_) {
+      ESP_LOGW(TAG, "Staging buffer full, dropping %zu bytes",
+               data.size() - written);
+      this->warned_full_ = true;
+    }
+  } else {
+    this->warned_full_ = false;
+  }
+}
+
+void MicrophoneRecorder::writer_task_(void *params) {
+  static_cast<MicrophoneRecorder *>(params)->run_writer_task_();
+}
+
+void MicrophoneRecorder::run_writer_task_() {
+  pcm_utils::SpscRing *ring = this->ring_.get();
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WRITER_IDLE_WAIT_MS));
+
+    // A raw region's free space follows the index commits instead.
+    if (!this->raw_ &&
+        millis() - this->last_free_space_ms_ >= STATS_WINDOW_MS) {
+      this->update_free_space_();
+    }
+
+    const uint8_t state = this->state_.load(std::memory_order_acquire);
+    if (state == STATE_IDLE) {
+      // Keep only the newest pre_roll_bytes_ ready for the next start.
+      // Without a pre-roll, anything here came from a callback that was
+      // already past its state check when the last recording stopped.
+      const size_t queued = ring->available();
+      if (queued > this->pre_roll_bytes_) {
+        ring->consume(queued - this->pre_roll_bytes_);
+      }
+      continue;
+    }
+
+    if (this->trim_pending_) {
+      // The idle trim runs periodically, so up to one wait interval more
+      // than the pre-roll may precede the start position.
+      const size_t lead = this->start_position_ - ring->read_position();
+      if (lead <= ring->available() && lead > this->pre_roll_bytes_) {
+        ring->consume(lead - this->pre_roll_bytes_);
+      }
+      this->trim_pending_ = false;
+    }
+
+    this->write_queued_(state);
+
+    if (state == STATE_STOPPING) {
+      this->finish_file_();
+    } else if (this->segment_source_bytes_ > 0 && this->next_fd_ < 0 &&
+               !this->next_attempted_) {
+      // Create the next segment well ahead of the cut, while the ring can
+      // absorb the time it takes.
+      this->prepare_next_segment_();
+    }
+  }
+}
+
+size_t MicrophoneRecorder::queued_for_file_(uint8_t state) const {
+  pcm_utils::SpscRing *ring = this->ring_.get();
+  const size_t queued = ring->available();
+  if (state != STATE_STOPPING) {
+    return queued;
+  }
+  // A pass that started before the stop may already have written a little
+  // past stop_position_; the distance then wraps to more than the ring holds.
+  const size_t remaining = this->stop_position_ - ring->read_position();
+  if (remaining > ring->capacity()) {
+    return 0;
+  }
+  return remaining < queued ? remaining : queued;
+}
+
+void MicrophoneRecorder::write_queued_(uint8_t state) {
+  const bool segmented = this->segment_source_bytes_ > 0;
+  while (!this->write_failed_.load(std::memory_order_relaxed)) {
+    const size_t queued = this->queued_for_file_(state);
+    if (segmented && this->segment_remaining_ == 0) {
+      // Cut only once there is audio for the next segment, so a stop that
+      // lands on a boundary doesn't leave an empty file behind.
+      if (queued == 0) {
+        break;
+      }
+      this->rotate_segment_();
+      continue;
+    }
+
+    size_t limit = queued;
+    if (segmented && limit > this->segment_remaining_) {
+      limit = this->segment_remaining_;
+    }
+    const size_t taken = this->fill_block_(limit);
+    if (segmented) {
+      this->segment_remaining_ -= taken;
+    }
+    if (this->block_fill_ == this->block_size_) {
+      this->flush_block_();
+    } else if (!segmented || this->segment_remaining_ > 0) {
+      break;
+    }
+  }
+}
+
+size_t MicrophoneRecorder::read_source_(uint8_t *out, size_t room,
+                                        size_t limit, size_t *produced) {
+  pcm_utils::SpscRing *ring = this->ring_.get();
+  const size_t in_sample = this->source_bits_per_sample_ / 8;
+  const size_t out_sample = this->output_bits_per_sample_ / 8;
+  const size_t wanted = room / out_sample * in_sample;
+
+  uint8_t *first;
+  uint8_t *second;
+  size_t first_len;
+  size_t second_len;
+  const size_t taken = ring->peek(wanted < limit ? wanted : limit, &first,
+                                  &first_len, &second, &second_len);
+  // Both the ring capacity and every write into it are whole samples, so
+  // neither region splits a sample.
+  for (int i = 0; i < 2; i++) {
+    const uint8_t *data = i == 0 ? first : second;
+    const size_t len = i == 0 ? first_len : second_len;
+    if (len == 0) {
+      continue;
+    }
+    const size_t samples = len / in_sample;
+    if (out_sample == in_sample) {
+      std::memcpy(out, data, len);
+    } else if (out_sample == 2) {
+      pcm_utils::convert_32_to_16(data, out, samples);
+    } else {
+      pcm_utils::convert_32_to_24(data, out, samples);
+    }
+    out += samples * out_sample;
+  }
+  *produced = taken / in_sample * out_sample;
+  ring->consume(taken);
+  return taken;
+}
+
+void MicrophoneRecorder::copy_sample_carry_() {
+  const size_t len =
+      std::min<size_t>(this->sample_carry_len_ - this->sample_carry_pos_,
+                       this->block_size_ - this->block_fill_);
+  std::memcpy(this->block_buffer_ + this->block_fill_,
+              this->sample_carry_ + this->sample_carry_pos_, len);
+  this->block_fill_ += len;
+  this->sample_carry_pos_ += len;
+}
+
+size_t MicrophoneRecorder::fill_block_(size_t limit) {
+  size_t produced;
+  if (this->codec_ == CODEC_PCM) {
+    this->copy_sample_carry_();
+    size_t taken =
+        this->read_source_(this->block_buffer_ + this->block_fill_,
+                           this->block_size_ - this->block_fill_, limit,
+                           &produced);
+    this->block_fill_ += produced;
+    // Blocks are sector multiples, which 24-bit samples don't divide: the
+    // sample crossing the end of the block goes through the carry.
+    const size_t out_sample = this->output_bits_per_sample_ / 8;
+    const size_t room = this->block_size_ - this->block_fill_;
+    if (room > 0 && room < out_sample && taken < limit) {
+      taken += this->read_source_(this->sample_carry_, out_sample,
+                                  limit - taken, &produced);
+      this->sample_carry_len_ = produced;
+      this->sample_carry_pos_ = 0;
+      this->copy_sample_carry_();
+    }
+    return taken;
+  }
+
+  // The encoder only runs once the previous codec frame is all in the block,
+  // so at most one is ever split across two blocks.
+  const size_t input_size = this->codec_frames_ * this->output_frame_size_;
+  size_t taken = 0;
+  while (this->block_fill_ < this->block_size_) {
+    if (this->codec_output_pos_ < this->codec_output_len_) {
+      this->copy_codec_output_();
+      continue;
+    }
+    taken += this->read_source_(this->codec_input_ + this->codec_input_fill_,
+                                input_size - this->codec_input_fill_,
+                                limit - taken, &produced);
+    this->codec_input_fill_ += produced;
+    if (this->codec_input_fill_ < input_size) {
+      break;
+    }
+    this->encode_codec_frame_();
+  }
+  return taken;
+}
+
+void MicrophoneRecorder::encode_codec_frame_() {
+  const size_t frames = this->codec_input_fill_ / this->output_frame_size_;
+  const uint8_t channels = this->output_frame_size_ / sizeof(int16_t);
+  size_t len;
+  if (this->codec_ == CODEC_IMA_ADPCM) {
+    // IMA-ADPCM blocks have a fixed length: a short last block repeats its
+    // final frame, and the fact chunk keeps the true frame count.
+    for (size_t frame = frames; frame < this->codec_frames_; frame++) {
+      std::memcpy(this->codec_input_ + frame * this->output_frame_size_,
+                  this->codec_input_ + (frames - 1) * this->output_frame_size_,
+                  this->output_frame_size_);
+    }
+    len = pcm_utils::ima_adpcm_encode_wav_block(
+        this->adpcm_states_, channels, this->codec_input_, this->codec_frames_,
+        this->codec_output_);
+  } else {
+    len = this->flac_encoder_->encode_frame(this->codec_input_, frames,
+                                            this->codec_output_);
+    this->min_frame_bytes_ =
+        std::min(this->min_frame_bytes_, static_cast<uint32_t>(len));
+    this->max_frame_bytes_ =
+        std::max(this->max_frame_bytes_, static_cast<uint32_t>(len));
+  }
+  this->codec_input_fill_ = 0;
+  this->codec_output_len_ = len;
+  this->codec_output_pos_ = 0;
+  this->previous_encoded_bytes_ = this->encoded_bytes_;
+  this->previous_encoded_frames_ = this->encoded_frames_;
+  this->encoded_bytes_ += len;
+  this->encoded_frames_ += frames;
+}
+
+void MicrophoneRecorder::copy_codec_output_() {
+  const size_t len =
+      std::min(this->codec_output_len_ - this->codec_output_pos_,
+               this->block_size_ - this->block_fill_);
+  std::memcpy(this->block_buffer_ + this->block_fill_,
+              this->codec_output_ + this->codec_output_pos_, len);
+  this->block_fill_ += len;
+  this->codec_output_pos_ += len;
+}
+
+bool MicrophoneRecorder::flush_block_() {
+  if (this->block_fill_ == 0) {
+    return true;
+  }
+
+  const int64_t start_us = esp_timer_get_time();
+  const size_t len = this->block_fill_;
+  ssize_t written;
+  if (this->raw_) {
+    written = this->write_raw_block_(len) ? static_cast<ssize_t>(len) : -1;
+  } else {
+    written = ::write(this->fd_, this->block_buffer_, len);
+  }
+  this->block_fill_ = 0;
+  const bool complete = written == static_cast<ssize_t>(len);
+  if (complete) {
+    this->file_bytes_written_ += len;
+    this->bytes_written_total_.fetch_add(len, std::memory_order_relaxed);
+    // Header commits ride on a block write rather than getting a write of
+    // their own, and are timed with it: the ring absorbs them the same way.
+    if (this->header_commit_interval_ms_ > 0 &&
+        millis() - this->last_header_commit_ms_ >=
+            this->header_commit_interval_ms_) {
+      this->commit_header_();
+    }
+  }
+  const uint32_t elapsed_us =
+      static_cast<uint32_t>(esp_timer_get_time() - start_us);
+  if (elapsed_us > this->max_write_us_.load(std::memory_order_relaxed)) {
+    this->max_write_us_.store(elapsed_us, std::memory_order_relaxed);
+  }
+  this->write_latency_.record(elapsed_us);
+  this->write_busy_us_total_.fetch_add(elapsed_us, std::memory_order_relaxed);
+
+  if (!complete) {
+    ESP_LOGE(TAG, "Short write to %s (%d/%zu)", this->active_path_.c_str(),
+             static_cast<int>(written), len);
+    // FAT gives up on a file after an I/O error, so this recording ends; the
+    // next one runs at a lower clock.
+    if (!this->raw_ && written < 0 && errno == EIO) {
+      this->lower_bus_speed_();
+    }
+    this->write_failed_.store(true, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void MicrophoneRecorder::flush_tail_() {
+  // The codec may still hold a partial frame and the encoding of the last
+  // one, and PCM the rest of a sample; they all belong to this file.
+  if (this->sample_carry_pos_ < this->sample_carry_len_) {
+    if (this->block_fill_ == this->block_size_) {
+      this->flush_block_();
+    }
+    this->copy_sample_carry_();
+  }
+  if (this->codec_input_fill_ > 0) {
+    this->encode_codec_frame_();
+  }
+  while (this->codec_output_pos_ < this->codec_output_len_ &&
+         !this->write_failed_.load(std::memory_order_relaxed)) {
+    this->copy_codec_output_();
+    if (this->block_fill_ == this->block_size_) {
+      this->flush_block_();
+    }
+  }
+  this->flush_block_();
+}
+
+void MicrophoneRecorder::prepare_next_segment_() {
+  this->next_attempted_ = true;
+  this->evict_segments_(this->active_sequence_);
+  char path[64];
+  this->segment_path_(this->sequence_, path, sizeof(path));
+  this->next_fd_ = this->open_file_(path, &this->next_preallocated_);
+  if (this->next_fd_ >= 0) {
+    this->next_path_ = path;
+    this->sequence_++;
+  }
+}
+
+void MicrophoneRecorder::rotate_segment_() {
+  this->flush_tail_();
+  this->close_file_();
+  ESP_LOGI(TAG, "Segment finished: %s (%u bytes)", this->active_path_.c_str(),
+           this->file_bytes_written_);
+
+  if (this->next_fd_ < 0) {
+    this->prepare_next_segment_();
+    if (this->next_fd_ < 0) {
+      this->write_failed_.store(true, std::memory_order_relaxed);
+      return;
+    }
+  }
+  this->fd_ = this->next_fd_;
+  this->preallocated_bytes_ = this->next_preallocated_;
+  this->active_path_ = this->next_path_;
+  this->active_sequence_ = this->sequence_ - 1;
+  this->next_fd_ = -1;
+  this->next_attempted_ = false;
+  this->begin_file_();
+}
+
+void MicrophoneRecorder::finish_file_() {
+  // Write out the tail up to stop_position_.
+  this->write_queued_(STATE_STOPPING);
+  if (!this->write_failed_.load(std::memory_order_relaxed)) {
+    this->flush_tail_();
+  } else {
+    // Drop the unwritten tail, but not the audio after the stop.
+    pcm_utils::SpscRing *ring = this->ring_.get();
+    ring->consume(this->queued_for_file_(STATE_STOPPING));
+  }
+  this->block_fill_ = 0;
+  this->close_file_();
+
+  if (this->next_fd_ >= 0) {
+    // The segment prepared for after this one is never used; give its number
+    // back so the sequence on the card stays gapless.
+    ::close(this->next_fd_);
+    ::unlink(this->next_path_.c_str());
+    this->next_fd_ = -1;
+    this->sequence_--;
+  }
+  this->next_attempted_ = false;
+
+  this->finished_.store(true, std::memory_order_release);
+  this->state_.store(STATE_IDLE, std::memory_order_release);
+}
+
+void MicrophoneRecorder::close_file_() {
+  if (this->raw_) {
+    this->raw_recording_->flags |= pcm_utils::RAW_RECORDING_COMPLETE;
+    this->commit_raw_index_();
+    return;
+  }
+  if (this->fd_ < 0) {
+    return;
+  }
+  if (this->file_bytes_written_ >= this->header_size_) {
+    uint32_t data_bytes;
+    uint64_t frames;
+    this->committed_point_(&data_bytes, &frames);
+    this->write_header_(this->fd_, data_bytes, frames, true);
+  }
+  if (this->preallocated_bytes_ > 0) {
+    // Hand back the part of the preallocation the recording didn't use.
+    ::ftruncate(this->fd_, this->file_bytes_written_);
+  }
+  ::fsync(this->fd_);
+  ::close(this->fd_);
+  this->fd_ = -1;
+}
+
+size_t MicrophoneRecorder::build_header_(uint8_t *out, uint32_t data_bytes,
+                                         uint64_t frames,
+                                         bool complete) const {
+  const auto info = this->mic_source_->get_audio_stream_info();
+  switch (this->codec_) {
+  case CODEC_IMA_ADPCM:
+    return pcm_utils::write_ima_adpcm_wav_header(
+        out, info.get_channels(), info.get_sample_rate(),
+        ADPCM_BLOCK_ALIGN_PER_CHANNEL * info.get_channels(),
+        static_cast<uint32_t>(std::min<uint64_t>(frames, UINT32_MAX)),
+        data_bytes);
+  case CODEC_FLAC: {
+    pcm_utils::FlacStreamInfo stream{};
+    stream.sample_rate = info.get_sample_rate();
+    stream.channels = info.get_channels();
+    stream.block_frames = FLAC_BLOCK_FRAMES;
+    stream.total_frames = frames;
+    stream.seek_frame = pcm_utils::FLAC_SEEK_PLACEHOLDER;
+    if (complete) {
+      if (this->max_frame_bytes_ > 0) {
+        stream.min_frame_bytes = this->min_frame_bytes_;
+        stream.max_frame_bytes = this->max_frame_bytes_;
+      }
+    } else {
+      // A used seek point marks the file unfinished, and says where the
+      // committed audio ends for recover_flac_file_().
+      stream.seek_frame = frames;
+      stream.seek_offset = data_bytes;
+    }
+    return pcm_utils::write_flac_stream_header(out, stream);
+  }
+  default:
+    return pcm_utils::write_wav_header(out, info.get_channels(),
+                                       info.get_sample_rate(),
+                                       this->output_bits_per_sample_,
+                                       data_bytes);
+  }
+}
+
+bool MicrophoneRecorder::write_header_(int fd, uint32_t data_bytes,
+                                       uint64_t frames, bool complete) {
+  uint8_t header[MAX_HEADER_SIZE];
+  const size_t len = this->build_header_(header, data_bytes, frames, complete);
+  // pwrite leaves the file position where the next block goes.
+  return ::pwrite(fd, header, len, 0) == static_cast<ssize_t>(len);
+}
+
+void MicrophoneRecorder::committed_point_(uint32_t *data_bytes,
+                                          uint64_t *frames) const {
+  const uint32_t written = this->file_bytes_written_ - this->header_size_;
+  if (this->codec_ == CODEC_PCM) {
+    // Blocks needn't end on a frame boundary when frames are 3 or 6 bytes.
+    *frames = written / this->output_frame_size_;
+    *data_bytes = *frames * this->output_frame_size_;
+  } else if (written >= this->encoded_bytes_) {
+    *data_bytes = this->encoded_bytes_;
+    *frames = this->encoded_frames_;
+  } else {
+    *data_bytes = this->previous_encoded_bytes_;
+    *frames = this->previous_encoded_frames_;
+  }
+}
+
+void MicrophoneRecorder::commit_header_() {
+  if (this->raw_) {
+    this->commit_raw_index_();
+    this->last_header_commit_ms_ = millis();
+    return;
+  }
+  // The fsync puts both the header and the file length in the directory
+  // entry on the card, so after a power loss the file plays up to here.
+  uint32_t data_bytes;
+  uint64_t frames;
+  this->committed_point_(&data_bytes, &frames);
+  this->write_header_(this->fd_, data_bytes, frames, false);
+  ::fsync(this->fd_);
+  this->last_header_commit_ms_ = millis();
+}
+
+void MicrophoneRecorder::update_free_space_() {
+  if (this->raw_) {
+    this->update_raw_free_space_();
+    return;
+  }
+  uint64_t total = 0;
+  uint64_t free = 0;
+  if (esp_vfs_fat_info(this->mount_point_.c_str(), &total, &free) != ESP_OK) {
+    return;
+  }
+  this->free_space_mb_.store(static_cast<uint32_t>(free >> 20),
+                             std::memory_order_relaxed);
+  this->last_free_space_ms_ = millis();
+}
+
+void MicrophoneRecorder::update_raw_free_space_() {
+  // The ring never fills up; what is free is the room left before the
+  // writer overwrites the oldest recording the index still lists. Space
+  // behind it holds only forgotten or already overwritten audio.
+  const uint64_t capacity =
+      static_cast<uint64_t>(this->raw_index_.data_sectors) *
+      pcm_utils::RAW_SECTOR_SIZE;
+  uint64_t oldest = this->raw_write_position_;
+  for (const auto &recording : this->raw_index_.recordings) {
+    if (recording.sequence != 0) {
+      oldest = std::min(oldest, recording.start);
+    }
+  }
+  oldest = std::max(oldest, this->raw_index_.oldest_position);
+  const uint64_t retained =
+      oldest < this->raw_write_position_
+          ? std::min(this->raw_write_position_ - oldest, capacity)
+          : 0;
+  this->free_space_mb_.store(static_cast<uint32_t>((capacity - retained) >> 20),
+                             std::memory_order_relaxed);
+}
+
+void MicrophoneRecorder::update_write_stats_() {
+  const uint32_t now = millis();
+  if (now - this->last_stats_ms_ < STATS_WINDOW_MS) {
     return;
   }
+  this->last_stats_ms_ = now;
+
+  pcm_utils::LatencyCounts latency;
+  this->write_latency_.snapshot(&latency);
+  const uint32_t bytes =
+      this->bytes_written_total_.load(std::memory_order_relaxed);
+  const uint32_t busy_us =
+      this->write_busy_us_total_.load(std::memory_order_relaxed);
+  // A window without writes keeps the figures of the last one that had some.
+  if (busy_us != this->window_busy_us_) {
+    // Bytes per microsecond of writing are megabytes per second: the rate
+    // the card sustains, not the rate audio arrives at.
+    this->write_mb_per_s_ =
+        static_cast<float>(bytes - this->window_bytes_written_) /
+        static_cast<float>(busy_us - this->window_busy_us_);
+    pcm_utils::LatencyCounts window = latency;
+    window.subtract(this->window_latency_);
+    // Bucket bounds can overshoot the slowest write actually seen.
+    const uint32_t max_us = this->max_write_us_.load(std::memory_order_relaxed);
+    this->write_p50_us_ = std::min(window.percentile(0.5f), max_us);
+    this->write_p99_us_ = std::min(window.percentile(0.99f), max_us);
+  }
+  this->window_latency_ = latency;
+  this->window_bytes_written_ = bytes;
+  this->window_busy_us_ = busy_us;
+
+  // The least audio the ring could still have taken before dropping any.
+  const size_t high_water =
+      std::min(this->window_high_water_.exchange(0, std::memory_order_relaxed),
+               this->ring_size_);
+  const size_t bytes_per_s =
+      std::max<size_t>(this->ms_to_source_bytes_(1000), 1);
+  this->headroom_ms_ = static_cast<uint32_t>(
+      static_cast<uint64_t>(this->ring_size_ - high_water) * 1000 /
+      bytes_per_s);
+}
 
-  size_t written = std::fwrite(data.data(), 1, data.size(), this->file_);
-  if (written != data.size()) {
-    ESP_LOGW(TAG, "Short write to recording file (%zu/%zu)", written,
-             data.size());
-    this->pending_stop_ = true;
+void MicrophoneRecorder::publish_sensors_() {
+#ifdef USE_SENSOR
+  uint32_t now = millis();
+  if (now - this->last_sensor_publish_ms_ < SENSOR_PUBLISH_INTERVAL_MS) {
     return;
   }
-  this->data_bytes_written_ += written;
+  this->last_sensor_publish_ms_ = now;
+
+  if (this->max_write_time_sensor_ != nullptr) {
+    float max_ms =
+        this->max_write_us_.load(std::memory_order_relaxed) / 1000.0f;
+    if (!this->max_write_time_sensor_->has_state() ||
+        this->max_write_time_sensor_->get_raw_state() != max_ms) {
+      this->max_write_time_sensor_->publish_state(max_ms);
+    }
+  }
+  if (this->queue_high_water_sensor_ != nullptr && this->ring_size_ > 0) {
+    float high_water =
+        100.0f * this->queue_high_water_.load(std::memory_order_relaxed) /
+        this->ring_size_;
+    if (!this->queue_high_water_sensor_->has_state() ||
+        this->queue_high_water_sensor_->get_raw_state() != high_water) {
+      this->queue_high_water_sensor_->publish_state(high_water);
+    }
+  }
+  publish_if_changed(
+      this->bytes_dropped_sensor_,
+      this->bytes_dropped_total_.load(std::memory_order_relaxed));
+  if (this->bus_frequency_sensor_ != nullptr) {
+    float mhz = this->bus_freq_khz_.load(std::memory_order_relaxed) / 1000.0f;
+    if (!this->bus_frequency_sensor_->has_state() ||
+        this->bus_frequency_sensor_->get_raw_state() != mhz) {
+      this->bus_frequency_sensor_->publish_state(mhz);
+    }
+  }
+  publish_if_changed(this->free_space_sensor_,
+                     this->free_space_mb_.load(std::memory_order_relaxed));
+  if (this->last_stats_ms_ != 0) {
+    publish_if_changed(this->buffer_headroom_sensor_, this->headroom_ms_);
+  }
+  // Nothing to report until a window has seen a write.
+  if (this->write_mb_per_s_ > 0.0f) {
+    publish_if_changed(this->write_time_p50_sensor_,
+                       this->write_p50_us_ / 1000.0f);
+    publish_if_changed(this->write_time_p99_sensor_,
+                       this->write_p99_us_ / 1000.0f);
+    publish_if_changed(this->write_speed_sensor_, this->write_mb_per_s_);
+  }
+  // The self-test runs once at boot, so these are published once.
+  if (this->self_test_write_speed_sensor_ != nullptr &&
+      !this->self_test_write_speed_sensor_->has_state() &&
+      this->self_test_mb_per_s_ > 0.0f) {
+    this->self_test_write_speed_sensor_->publish_state(
+        this->self_test_mb_per_s_);
+  }
+  if (this->self_test_max_write_time_sensor_ != nullptr &&
+      !this->self_test_max_write_time_sensor_->has_state() &&
+      this->self_test_mb_per_s_ > 0.0f) {
+    this->self_test_max_write_time_sensor_->publish_state(
+        this->self_test_max_us_ / 1000.0f);
+  }
+#endif
 }
 
 void StartRecordingAction::play(automation::ActionContext &ctx) {
@@ -5,11 +5,24 @@
 #ifdef USE_ESP32
 
 #include "esphome/components/microphone/microphone_source.h"
+#include "esphome/components/pcm_utils/flac_encoder.h"
+#include "esphome/components/pcm_utils/ima_adpcm.h"
+#include "esphome/components/pcm_utils/latency_histogram.h"
+#include "esphome/components/pcm_utils/raw_index.h"
+#include "esphome/components/pcm_utils/spsc_ring.h"
+#include "esphome/components/pcm_utils/wav_header.h"
 #include "esphome/core/automation.h"
 #include "esphome/core/component.h"
 
-#include <cstdio>
-#include <mutex>
+#ifdef USE_SENSOR
+#include "esphome/components/sensor/sensor.h"
+#endif
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <memory>
 #include <string>
 
 #include <driver/sdmmc_types.h>
@@ -19,6 +32,23 @@
 namespace esphome {
 namespace microphone_recorder {
 
+enum RecorderState : uint8_t {
+  STATE_IDLE,
+  // The writer task writes queued audio to the file.
+  STATE_RECORDING,
+  // The writer task drains what was queued up to the stop, patches the
+  // header and closes the file, then returns to STATE_IDLE.
+  STATE_STOPPING,
+};
+
+enum RecorderCodec : uint8_t {
+  CODEC_PCM,
+  // WAVE_FORMAT_IMA_ADPCM, a quarter of the PCM size for very little CPU.
+  CODEC_IMA_ADPCM,
+  // Lossless, in .flac files; room audio typically shrinks by about half.
+  CODEC_FLAC,
+};
+
 class MicrophoneRecorder : public Component {
 public:
   void set_microphone_source(microphone::MicrophoneSource *mic_source) {
@@ -44,13 +74,110 @@ public:
   void set_max_duration_ms(uint32_t duration_ms) {
     this->max_duration_ms_ = duration_ms;
   }
+  /// Fastest clock to run the card at. Mounting steps down from it while
+  /// the bus shows CRC errors or timeouts.
+  void set_bus_frequency_khz(uint32_t freq_khz) {
+    this->max_bus_freq_khz_ = freq_khz;
+  }
+  /// Bus setup used when the SPI bus is brought up by this component.
+  void set_spi_bus(uint32_t max_transfer_size, spi_dma_chan_t dma_channel) {
+    this->spi_max_transfer_size_ = max_transfer_size;
+    this->spi_dma_channel_ = dma_channel;
+  }
+  /// Writes this many bytes at boot, timing each block (0 to skip it).
+  void set_self_test_size(uint32_t size) { this->self_test_size_ = size; }
   void set_format_if_mount_failed(bool format_if_failed) {
     this->format_if_failed_ = format_if_failed;
   }
+  void set_allocation_unit_size(uint32_t size) {
+    this->allocation_unit_size_ = size;
+  }
+  void set_max_files(uint8_t max_files) { this->max_files_ = max_files; }
+  void set_preallocate(bool preallocate) { this->preallocate_ = preallocate; }
+  void set_codec(RecorderCodec codec) { this->codec_ = codec; }
+  /// Sample width of PCM recordings: 16, 24 or 32 bits. Wider samples than
+  /// the source delivers are rejected when a recording starts.
+  void set_bits_per_sample(uint8_t bits) {
+    this->output_bits_per_sample_ = bits;
+  }
+  /// Splits a recording into files of duration_ms or size_bytes each (one of
+  /// them non-zero), deleting the oldest segments whenever the card has less
+  /// than min_free_bytes free.
+  void set_segment(uint32_t duration_ms, uint32_t size_bytes,
+                   uint64_t min_free_bytes) {
+    this->segment_duration_ms_ = duration_ms;
+    this->segment_size_ = size_bytes;
+    this->min_free_bytes_ = min_free_bytes;
+  }
+  /// Rewrites the header of the open file and syncs it this often, so a
+  /// power loss costs at most this much of the recording. 0 disables it.
+  void set_header_commit_interval_ms(uint32_t interval_ms) {
+    this->header_commit_interval_ms_ = interval_ms;
+  }
+  /// Records into size_bytes of card sectors from start_sector on, written
+  /// directly instead of through FAT (0 for the rest of the card).
+  void set_raw_region(uint32_t start_sector, uint64_t size_bytes) {
+    this->raw_ = true;
+    this->raw_start_sector_ = start_sector;
+    this->raw_size_ = size_bytes;
+  }
+  void set_pre_roll_ms(uint32_t pre_roll_ms) {
+    this->pre_roll_ms_ = pre_roll_ms;
+  }
+  void set_buffer_duration_ms(uint32_t duration_ms) {
+    this->buffer_duration_ms_ = duration_ms;
+  }
+  void set_write_block_size(size_t block_size) {
+    this->block_size_ = block_size;
+  }
+  void set_writer_task(uint8_t priority, int8_t core, uint32_t stack_size) {
+    this->task_priority_ = priority;
+    this->task_core_ = core;
+    this->task_stack_size_ = stack_size;
+  }
+
+#ifdef USE_SENSOR
+  void set_max_write_time_sensor(sensor::Sensor *sensor) {
+    this->max_write_time_sensor_ = sensor;
+  }
+  void set_queue_high_water_sensor(sensor::Sensor *sensor) {
+    this->queue_high_water_sensor_ = sensor;
+  }
+  void set_bytes_dropped_sensor(sensor::Sensor *sensor) {
+    this->bytes_dropped_sensor_ = sensor;
+  }
+  void set_bus_frequency_sensor(sensor::Sensor *sensor) {
+    this->bus_frequency_sensor_ = sensor;
+  }
+  void set_self_test_write_speed_sensor(sensor::Sensor *sensor) {
+    this->self_test_write_speed_sensor_ = sensor;
+  }
+  void set_self_test_max_write_time_sensor(sensor::Sensor *sensor) {
+    this->self_test_max_write_time_sensor_ = sensor;
+  }
+  void set_write_time_p50_sensor(sensor::Sensor *sensor) {
+    this->write_time_p50_sensor_ = sensor;
+  }
+  void set_write_time_p99_sensor(sensor::Sensor *sensor) {
+    this->write_time_p99_sensor_ = sensor;
+  }
+  void set_write_speed_sensor(sensor::Sensor *sensor) {
+    this->write_speed_sensor_ = sensor;
+  }
+  void set_buffer_headroom_sensor(sensor::Sensor *sensor) {
+    this->buffer_headroom_sensor_ = sensor;
+  }
+  void set_free_space_sensor(sensor::Sensor *sensor) {
+    this->free_space_sensor_ = sensor;
+  }
+#endif
 
   bool start_recording();
+  /// Asks the writer task to finish the file; returns without waiting for it.
   void stop_recording();
-  bool is_recording() const { return this->recording_; }
+  bool is_recording() const {
+    return this->state_.load(std::memory_order_acquire) == STATE_RECORDING;
+  }
 
   void setup() override;
   void loop() override;
@@ -58,13 +185,71 @@ public:
 
 protected:
   bool mount_sdcard_();
+  bool init_spi_bus_();
+  esp_err_t mount_spi_(uint32_t freq_khz);
+  esp_err_t mount_sdmmc_(uint32_t freq_khz);
+  esp_err_t init_raw_card_(sdmmc_host_t *host);
+  bool lower_bus_speed_();
+  void run_self_test_();
+  bool self_test_pass_(size_t blocks, uint32_t *max_us, bool *io_error);
   void unmount_sdcard_();
+  size_t ms_to_source_bytes_(uint32_t ms) const;
+  bool allocate_buffers_();
+  bool start_writer_task_();
   bool open_new_file_();
-  void close_file_();
+  int open_file_(const char *path, uint32_t *preallocated);
+  uint64_t file_size_for_frames_(uint64_t frames) const;
+  uint64_t expected_file_size_() const;
+  uint32_t preallocate_file_(const char *path);
+  void begin_file_();
+
+  const char *file_extension_() const;
+  bool parse_sequence_(const char *name, uint32_t *sequence) const;
+  void recover_files_();
+  void recover_file_(const char *path);
+  void recover_flac_file_(int fd, const char *path, uint8_t *header,
+                          size_t len, uint64_t length);
+  bool open_raw_region_();
+  bool check_raw_partitions_(uint64_t sectors);
+  bool begin_raw_recording_();
+  bool write_raw_sectors_(uint64_t position, const uint8_t *data,
+                          size_t count);
+  bool write_raw_block_(size_t len);
+  bool commit_raw_index_();
+  void segment_path_(uint32_t sequence, char *out, size_t len) const;
+  void scan_segments_();
+  void evict_segments_(uint32_t keep_from);
 
   void handle_audio_data_(const std::vector<uint8_t> &data);
-  void write_wav_header_(std::FILE *file, uint32_t data_length);
-  void update_wav_sizes_();
+
+  // Writer task side.
+  static void writer_task_(void *params);
+  void run_writer_task_();
+  size_t queued_for_file_(uint8_t state) const;
+  void write_queued_(uint8_t state);
+  size_t read_source_(uint8_t *out, size_t room, size_t limit,
+                      size_t *produced);
+  void copy_sample_carry_();
+  size_t fill_block_(size_t limit);
+  void encode_codec_frame_();
+  void copy_codec_output_();
+  bool flush_block_();
+  void flush_tail_();
+  void prepare_next_segment_();
+  void rotate_segment_();
+  void finish_file_();
+  void close_file_();
+  size_t build_header_(uint8_t *out, uint32_t data_bytes, uint64_t frames,
+                       bool complete) const;
+  bool write_header_(int fd, uint32_t data_bytes, uint64_t frames,
+                     bool complete);
+  void committed_point_(uint32_t *data_bytes, uint64_t *frames) const;
+  void commit_header_();
+
+  void update_free_space_();
+  void update_raw_free_space_();
+  void update_write_stats_();
+  void publish_sensors_();
 
   microphone::MicrophoneSource *mic_source_{nullptr};
   std::string mount_point_{"/sdcard"};
@@ -77,20 +262,184 @@ protected:
   int d2_pin_{-1};
   int d3_pin_{-1};
 
+  uint32_t max_bus_freq_khz_{SDMMC_FREQ_DEFAULT};
+  // The clock the card runs at now. Mounting settles on it, and the writer
+  // task lowers it further if writes keep failing.
+  std::atomic<uint32_t> bus_freq_khz_{0};
+  uint32_t spi_max_transfer_size_{4096};
+  spi_dma_chan_t spi_dma_channel_{SPI_DMA_CH_AUTO};
+  // Boot-time write test; results stay 0 until it has passed.
+  uint32_t self_test_size_{0};
+  float self_test_mb_per_s_{0.0f};
+  uint32_t self_test_max_us_{0};
+
   bool format_if_failed_{false};
+  uint32_t allocation_unit_size_{0};
+  uint8_t max_files_{8};
+  bool preallocate_{false};
   bool mounted_{false};
 
-  std::FILE *file_{nullptr};
+  // The file and block buffer are set up by start_recording() and then owned
+  // by the writer task until it returns the state to STATE_IDLE.
+  int fd_{-1};
   std::string active_path_;
+  uint32_t file_bytes_written_{0};
+  // Size the file was created at, or 0 if it grows as it is written.
+  uint32_t preallocated_bytes_{0};
+  uint32_t header_commit_interval_ms_{10000};
+  uint32_t last_header_commit_ms_{0};
 
-  uint32_t data_bytes_written_{0};
+  // Raw sector recording: no file system, the card region is a ring of data
+  // sectors described by raw_index_, which is committed in place of a WAV
+  // header. raw_write_position_ runs ahead of the committed write position;
+  // no sector at or past raw_reserved_end_ is written before the index has
+  // declared the audio it overwrites gone.
+  bool raw_{false};
+  uint32_t raw_start_sector_{0};
+  uint64_t raw_size_{0};
+  uint64_t raw_write_position_{0};
+  uint64_t raw_reserved_end_{0};
+  uint64_t raw_reserve_bytes_{0};
+  pcm_utils::RawRecording *raw_recording_{nullptr};
+  pcm_utils::RawIndex raw_index_{};
+  alignas(4) uint8_t raw_sector_[pcm_utils::RAW_SECTOR_SIZE];
+
+  // Segmented recording. Sequence numbers are touched by start_recording()
+  // while idle and by the writer task while recording.
+  uint32_t segment_duration_ms_{0};
+  uint32_t segment_size_{0};
+  uint64_t min_free_bytes_{0};
+  // Source bytes per segment (0 when not segmenting) and the resulting file
+  // size.
+  size_t segment_source_bytes_{0};
+  uint64_t segment_file_size_{0};
+  size_t segment_remaining_{0};
+  bool segments_scanned_{false};
+  uint32_t sequence_{1};
+  uint32_t oldest_sequence_{1};
+  uint32_t active_sequence_{0};
+  bool warned_no_space_{false};
+  // The next segment, created ahead of the cut by the writer task.
+  int next_fd_{-1};
+  std::string next_path_;
+  uint32_t next_preallocated_{0};
+  bool next_attempted_{false};
   uint32_t recording_start_ms_{0};
   uint32_t max_duration_ms_{10000};
 
-  bool recording_{false};
-  bool pending_stop_{false};
+  uint8_t source_bits_per_sample_{16};
+  size_t source_frame_size_{2};
+  // Frames reach the codec as 16-bit samples, and the file for PCM as
+  // output_bits_per_sample_ ones.
+  uint8_t output_bits_per_sample_{16};
+  size_t output_frame_size_{2};
+  // A 24-bit sample that straddles two blocks: the block gets its head, and
+  // the rest waits here for the next one.
+  uint8_t sample_carry_[sizeof(int32_t)]{};
+  uint8_t sample_carry_len_{0};
+  uint8_t sample_carry_pos_{0};
+
+  RecorderCodec codec_{CODEC_PCM};
+  size_t header_size_{pcm_utils::WAV_HEADER_SIZE};
+  // Encoder stage between the ring and the block, unused for PCM. Frames
+  // collect in codec_input_ until there are codec_frames_ of them, and their
+  // encoding waits in codec_output_ until the block has room for it.
+  size_t codec_frames_{0};
+  uint8_t *codec_input_{nullptr};
+  size_t codec_input_fill_{0};
+  uint8_t *codec_output_{nullptr};
+  size_t codec_output_len_{0};
+  size_t codec_output_pos_{0};
+  pcm_utils::ImaAdpcmState adpcm_states_[2]{};
+  uint8_t *flac_work_{nullptr};
+  std::unique_ptr<pcm_utils::FlacEncoder> flac_encoder_;
+  // Encoded bytes and audio frames up to the end of the newest codec frame
+  // and of the one before it. A header commit describes whole codec frames
+  // only, and every frame but the newest is always on the card by then.
+  uint32_t encoded_bytes_{0};
+  uint64_t encoded_frames_{0};
+  uint32_t previous_encoded_bytes_{0};
+  uint64_t previous_encoded_frames_{0};
+  uint32_t min_frame_bytes_{0};
+  uint32_t max_frame_bytes_{0};
+
+  std::atomic<uint8_t> state_{STATE_IDLE};
+  std::atomic<bool> write_failed_{false};
+  // Set by the writer task when a file is closed, so loop() can report it.
+  std::atomic<bool> finished_{false};
+
+  // Staging ring between the microphone callback and the writer task. With
+  // a pre-roll, the callback queues even while idle and the writer task
+  // keeps the newest pre_roll_bytes_ of it.
+  uint32_t buffer_duration_ms_{2000};
+  size_t ring_size_{0};
+  uint8_t *ring_storage_{nullptr};
+  std::unique_ptr<pcm_utils::SpscRing> ring_;
+  bool warned_full_{false};
+  uint32_t pre_roll_ms_{0};
+  size_t pre_roll_bytes_{0};
+  // Free-running ring positions of the start and stop requests, handed to
+  // the writer task through state_.
+  size_t start_position_{0};
+  size_t stop_position_{0};
+  bool trim_pending_{false};
+
+  // Output block assembled by the writer task; written to the card in one
+  // call once full.
+  size_t block_size_{32768};
+  // Ring bytes that make up one block.
+  size_t block_source_size_{0};
+  uint8_t *block_buffer_{nullptr};
+  size_t block_fill_{0};
+
+  TaskHandle_t task_handle_{nullptr};
+  uint8_t task_priority_{10};
+  int8_t task_core_{1};
+  uint32_t task_stack_size_{4096};
+
+  std::atomic<uint32_t> max_write_us_{0};
+  std::atomic<size_t> queue_high_water_{0};
+  std::atomic<uint32_t> bytes_dropped_total_{0};
+  uint32_t dropped_at_start_{0};
+  uint32_t last_sensor_publish_ms_{0};
+
+  // Every block write, recorded by the writer task with the bytes it wrote
+  // and the time it spent writing them. Both totals wrap; only differences
+  // between two readings are used.
+  pcm_utils::LatencyHistogram write_latency_;
+  std::atomic<uint32_t> bytes_written_total_{0};
+  std::atomic<uint32_t> write_busy_us_total_{0};
+  // Fullest the ring got since loop() last reset it. A callback racing the
+  // reset can only store a level the ring really had in the new window.
+  std::atomic<size_t> window_high_water_{0};
+  // Refreshed by the writer task, so loop() never waits on the card. In raw
+  // mode, the region not yet written since it was created.
+  std::atomic<uint32_t> free_space_mb_{0};
+  uint32_t last_free_space_ms_{0};
+  // Figures over the last full stats window, derived by loop() from the
+  // counters above as they stood at its start.
+  uint32_t last_stats_ms_{0};
+  pcm_utils::LatencyCounts window_latency_{};
+  uint32_t window_bytes_written_{0};
+  uint32_t window_busy_us_{0};
+  uint32_t write_p50_us_{0};
+  uint32_t write_p99_us_{0};
+  float write_mb_per_s_{0.0f};
+  uint32_t headroom_ms_{0};
 
-  std::mutex write_mutex_;
+#ifdef USE_SENSOR
+  sensor::Sensor *max_write_time_sensor_{nullptr};
+  sensor::Sensor *queue_high_water_sensor_{nullptr};
+  sensor::Sensor *bytes_dropped_sensor_{nullptr};
+  sensor::Sensor *bus_frequency_sensor_{nullptr};
+  sensor::Sensor *self_test_write_speed_sensor_{nullptr};
+  sensor::Sensor *self_test_max_write_time_sensor_{nullptr};
+  sensor::Sensor *write_time_p50_sensor_{nullptr};
+  sensor::Sensor *write_time_p99_sensor_{nullptr};
+  sensor::Sensor *write_speed_sensor_{nullptr};
+  sensor::Sensor *buffer_headroom_sensor_{nullptr};
+  sensor::Sensor *free_space_sensor_{nullptr};
+#endif
 
   sdmmc_card_t *card_{nullptr};
   bool using_spi_host_{false};
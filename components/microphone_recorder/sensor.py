@@ -0,0 +1,146 @@
+import esphome.codegen as cg
+from esphome.components import sensor
+import esphome.config_validation as cv
+from esphome.const import (
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_BYTES,
+    UNIT_MILLISECOND,
+    UNIT_PERCENT,
+)
+
+from . import CONF_MICROPHONE_RECORDER_ID, MicrophoneRecorder
+
+DEPENDENCIES = ["microphone_recorder"]
+
+CONF_MAX_WRITE_TIME = "max_write_time"
+CONF_QUEUE_HIGH_WATER = "queue_high_water"
+CONF_BYTES_DROPPED = "bytes_dropped"
+CONF_BUS_FREQUENCY = "bus_frequency"
+CONF_SELF_TEST_WRITE_SPEED = "self_test_write_speed"
+CONF_SELF_TEST_MAX_WRITE_TIME = "self_test_max_write_time"
+CONF_WRITE_TIME_P50 = "write_time_p50"
+CONF_WRITE_TIME_P99 = "write_time_p99"
+CONF_WRITE_SPEED = "write_speed"
+CONF_BUFFER_HEADROOM = "buffer_headroom"
+CONF_FREE_SPACE = "free_space"
+UNIT_MEGAHERTZ = "MHz"
+UNIT_MEGABYTES_PER_SECOND = "MB/s"
+UNIT_MEGABYTES = "MB"
+ICON_TIMER = "mdi:timer-sand"
+ICON_BUFFER = "mdi:tray-full"
+ICON_DROPPED = "mdi:delete-sweep"
+ICON_CLOCK = "mdi:sine-wave"
+ICON_SPEED = "mdi:speedometer"
+ICON_HEADROOM = "mdi:tray-arrow-down"
+ICON_CARD = "mdi:micro-sd"
+
+TYPES = [
+    CONF_MAX_WRITE_TIME,
+    CONF_QUEUE_HIGH_WATER,
+    CONF_BYTES_DROPPED,
+    CONF_BUS_FREQUENCY,
+    CONF_SELF_TEST_WRITE_SPEED,
+    CONF_SELF_TEST_MAX_WRITE_TIME,
+    CONF_WRITE_TIME_P50,
+    CONF_WRITE_TIME_P99,
+    CONF_WRITE_SPEED,
+    CONF_BUFFER_HEADROOM,
+    CONF_FREE_SPACE,
+]
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_MICROPHONE_RECORDER_ID): cv.use_id(MicrophoneRecorder),
+        cv.Optional(CONF_MAX_WRITE_TIME): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon=ICON_TIMER,
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_QUEUE_HIGH_WATER): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            icon=ICON_BUFFER,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_BYTES_DROPPED): sensor.sensor_schema(
+            unit_of_measurement=UNIT_BYTES,
+            icon=ICON_DROPPED,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_BUS_FREQUENCY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MEGAHERTZ,
+            icon=ICON_CLOCK,
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_SELF_TEST_WRITE_SPEED): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MEGABYTES_PER_SECOND,
+            icon=ICON_SPEED,
+            accuracy_decimals=2,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_SELF_TEST_MAX_WRITE_TIME): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon=ICON_TIMER,
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_WRITE_TIME_P50): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon=ICON_TIMER,
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_WRITE_TIME_P99): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon=ICON_TIMER,
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_WRITE_SPEED): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MEGABYTES_PER_SECOND,
+            icon=ICON_SPEED,
+            accuracy_decimals=2,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_BUFFER_HEADROOM): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            icon=ICON_HEADROOM,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_FREE_SPACE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MEGABYTES,
+            icon=ICON_CARD,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+    }
+)
+
+
+async def setup_conf(config, key, hub):
+    if conf := config.get(key):
+        sens = await sensor.new_sensor(conf)
+        cg.add(getattr(hub, f"set_{key}_sensor")(sens))
+
+
+async def to_code(config):
+    hub = await cg.get_variable(config[CONF_MICROPHONE_RECORDER_ID])
+    for key in TYPES:
+        await setup_conf(config, key, hub)
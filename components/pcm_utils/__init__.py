@@ -0,0 +1,5 @@
+"""Shared PCM sample kernels, codecs and the SPSC audio ring used by the
+audio components in this repository.
+
+Loaded automatically by components that need it; it has no configuration.
+"""
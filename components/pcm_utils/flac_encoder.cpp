@@ -0,0 +1,592 @@
+#include "flac_encoder.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace pcm_utils {
+
+static constexpr int BITS_PER_SAMPLE = 16;
+static constexpr int MAX_FIXED_ORDER = 4;
+static constexpr int MAX_PARTITION_ORDER = 8;
+static_assert(FLAC_MAX_PARTITIONS == 1 << MAX_PARTITION_ORDER,
+              "partition buffers must match the highest partition order");
+// 4-bit Rice parameters stop at 14, since 15 is the escape code; the 5-bit
+// variant goes up to 30.
+static constexpr uint32_t RICE_MAX_PARAMETER = 14;
+static constexpr uint32_t RICE2_MAX_PARAMETER = 30;
+
+static constexpr uint8_t SUBFRAME_CONSTANT = 0;
+static constexpr uint8_t SUBFRAME_VERBATIM = 1;
+static constexpr uint8_t SUBFRAME_FIXED = 8;
+
+static constexpr uint8_t CHANNELS_LEFT_SIDE = 8;
+static constexpr uint8_t CHANNELS_RIGHT_SIDE = 9;
+static constexpr uint8_t CHANNELS_MID_SIDE = 10;
+
+// Signals a subframe can carry besides the input channels themselves.
+static constexpr int SIGNAL_MID = -1;
+static constexpr int SIGNAL_SIDE = -2;
+
+struct Crc8Table {
+  uint8_t value[256];
+  constexpr Crc8Table() : value() {
+    for (int i = 0; i < 256; i++) {
+      uint8_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x80) ? static_cast<uint8_t>(crc << 1) ^ 0x07
+                           : static_cast<uint8_t>(crc << 1);
+      }
+      this->value[i] = crc;
+    }
+  }
+};
+
+struct Crc16Table {
+  uint16_t value[256];
+  constexpr Crc16Table() : value() {
+    for (int i = 0; i < 256; i++) {
+      uint16_t crc = static_cast<uint16_t>(i << 8);
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? static_cast<uint16_t>(crc << 1) ^ 0x8005
+                             : static_cast<uint16_t>(crc << 1);
+      }
+      this->value[i] = crc;
+    }
+  }
+};
+
+static constexpr Crc8Table CRC8;
+static constexpr Crc16Table CRC16;
+
+// Most significant bit first, as FLAC stores everything.
+class BitWriter {
+public:
+  explicit BitWriter(uint8_t *out) : start_(out), pos_(out) {}
+
+  void put(uint32_t value, int bits) {
+    if (bits == 0) {
+      return;
+    }
+    const uint64_t mask = (uint64_t{1} << bits) - 1;
+    this->acc_ = (this->acc_ << bits) | (value & mask);
+    this->count_ += bits;
+    while (this->count_ >= 8) {
+      this->count_ -= 8;
+      *this->pos_++ = static_cast<uint8_t>(this->acc_ >> this->count_);
+    }
+  }
+
+  void put_signed(int32_t value, int bits) {
+    this->put(static_cast<uint32_t>(value), bits);
+  }
+
+  void put_zeros(uint32_t count) {
+    while (count >= 32) {
+      this->put(0, 32);
+      count -= 32;
+    }
+    this->put(0, count);
+  }
+
+  void align() {
+    if (this->count_ > 0) {
+      this->put(0, 8 - this->count_);
+    }
+  }
+
+  uint8_t *position() const { return this->pos_; }
+  size_t bytes() const { return this->pos_ - this->start_; }
+
+protected:
+  uint8_t *start_;
+  uint8_t *pos_;
+  uint64_t acc_{0};
+  int count_{0};
+};
+
+static inline int16_t sample_at(const uint8_t *in, size_t index) {
+  int16_t sample;
+  std::memcpy(&sample, in + index * sizeof(int16_t), sizeof(sample));
+  return sample;
+}
+
+static inline uint32_t zigzag(int32_t residual) {
+  return (static_cast<uint32_t>(residual) << 1) ^
+         static_cast<uint32_t>(residual >> 31);
+}
+
+// Sums of absolute residuals for each fixed predictor order, fed one sample
+// at a time. All orders are summed over the same samples (from the fifth on)
+// so they compare fairly.
+struct FixedOrderCost {
+  uint64_t sum[MAX_FIXED_ORDER + 1]{};
+  int32_t history[MAX_FIXED_ORDER]{};
+  size_t seen{0};
+
+  void add(int32_t x) {
+    if (this->seen >= MAX_FIXED_ORDER) {
+      const int32_t *h = this->history;
+      const int32_t e1 = x - h[0];
+      const int32_t e2 = e1 - (h[0] - h[1]);
+      const int32_t e3 = e2 - (h[0] - 2 * h[1] + h[2]);
+      const int32_t e4 = e3 - (h[0] - 3 * h[1] + 3 * h[2] - h[3]);
+      this->sum[0] += x < 0 ? -static_cast<int64_t>(x) : x;
+      this->sum[1] += e1 < 0 ? -static_cast<int64_t>(e1) : e1;
+      this->sum[2] += e2 < 0 ? -static_cast<int64_t>(e2) : e2;
+      this->sum[3] += e3 < 0 ? -static_cast<int64_t>(e3) : e3;
+      this->sum[4] += e4 < 0 ? -static_cast<int64_t>(e4) : e4;
+    }
+    this->history[3] = this->history[2];
+    this->history[2] = this->history[1];
+    this->history[1] = this->history[0];
+    this->history[0] = x;
+    this->seen++;
+  }
+
+  int best_order() const {
+    int best = 0;
+    for (int order = 1; order <= MAX_FIXED_ORDER; order++) {
+      if (this->sum[order] < this->sum[best]) {
+        best = order;
+      }
+    }
+    return best;
+  }
+
+  uint64_t best_sum() const { return this->sum[this->best_order()]; }
+};
+
+static inline int32_t signal_sample(const uint8_t *in, size_t frame,
+                                    uint8_t channels, int signal) {
+  if (signal >= 0) {
+    return sample_at(in, frame * channels + signal);
+  }
+  const int32_t left = sample_at(in, frame * 2);
+  const int32_t right = sample_at(in, frame * 2 + 1);
+  return signal == SIGNAL_MID ? (left + right) >> 1 : left - right;
+}
+
+static uint8_t block_size_code(size_t frames, int *extra_bits) {
+  *extra_bits = 0;
+  for (uint8_t code = 8; code <= 15; code++) {
+    if (frames == (size_t{256} << (code - 8))) {
+      return code;
+    }
+  }
+  if (frames <= 256) {
+    *extra_bits = 8;
+    return 6;
+  }
+  *extra_bits = 16;
+  return 7;
+}
+
+static uint8_t sample_rate_code(uint32_t sample_rate) {
+  switch (sample_rate) {
+  case 8000:
+    return 4;
+  case 16000:
+    return 5;
+  case 22050:
+    return 6;
+  case 24000:
+    return 7;
+  case 32000:
+    return 8;
+  case 44100:
+    return 9;
+  case 48000:
+    return 10;
+  case 96000:
+    return 11;
+  default:
+    // Taken from STREAMINFO.
+    return 0;
+  }
+}
+
+static void put_frame_number(BitWriter &writer, uint32_t number) {
+  // UTF-8 style coding, up to six bytes for 31 bits.
+  if (number < 0x80) {
+    writer.put(number, 8);
+    return;
+  }
+  int extra = 1;
+  while (extra < 5 && number >= (1u << (6 * extra + 6 - extra))) {
+    extra++;
+  }
+  const uint32_t lead_mask = 0xFF00 >> (extra + 1);
+  writer.put((lead_mask & 0xFF) | (number >> (6 * extra)), 8);
+  for (int i = extra - 1; i >= 0; i--) {
+    writer.put(0x80 | ((number >> (6 * i)) & 0x3F), 8);
+  }
+}
+
+static uint32_t best_rice_parameter(uint64_t sum, size_t count,
+                                    uint64_t *bits) {
+  // Estimates count * (k + 1) + sum >> k bits, close to the exact
+  // count * (k + 1) + sum of (u >> k), around k = log2(sum / count).
+  uint32_t k = 0;
+  while (k < RICE2_MAX_PARAMETER && (uint64_t{count} << (k + 1)) < sum) {
+    k++;
+  }
+  uint32_t best = k;
+  uint64_t best_bits = count * (k + 1) + (sum >> k);
+  for (uint32_t candidate = k > 0 ? k - 1 : 0;
+       candidate <= k + 1 && candidate <= RICE2_MAX_PARAMETER; candidate++) {
+    const uint64_t candidate_bits =
+        count * (candidate + 1) + (sum >> candidate);
+    if (candidate_bits < best_bits) {
+      best = candidate;
+      best_bits = candidate_bits;
+    }
+  }
+  *bits = best_bits;
+  return best;
+}
+
+// The partitioning and Rice parameters chosen for one residual.
+struct RicePlan {
+  int partition_order;
+  bool rice2;
+  // Exact size of the residual section, coding method field included.
+  uint64_t bits;
+};
+
+static inline uint32_t saturating_add(uint32_t a, uint32_t b) {
+  return a > UINT32_MAX - b ? UINT32_MAX : a + b;
+}
+
+static RicePlan plan_rice(const int32_t *residual, size_t frames, int order,
+                          uint32_t *sums, uint8_t *params,
+                          uint8_t *candidate_params) {
+  int max_order = MAX_PARTITION_ORDER;
+  while (max_order > 0 &&
+         ((frames & ((size_t{1} << max_order) - 1)) != 0 ||
+          (frames >> max_order) <= static_cast<size_t>(order))) {
+    max_order--;
+  }
+
+  const size_t finest = size_t{1} << max_order;
+  const size_t finest_len = frames >> max_order;
+  for (size_t part = 0; part < finest; part++) {
+    const size_t start = part == 0 ? order : part * finest_len;
+    const size_t end = (part + 1) * finest_len;
+    uint64_t sum = 0;
+    for (size_t i = start; i < end; i++) {
+      sum += zigzag(residual[i]);
+    }
+    // Only full-scale noise gets near this, and it ends up verbatim anyway;
+    // the exact count below keeps the choice honest.
+    sums[part] = sum > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(sum);
+  }
+
+  // Coarser partitionings merge neighbouring sums, so every order is
+  // estimated without another pass over the residual.
+  RicePlan plan{0, false, UINT64_MAX};
+  for (int partition_order = max_order;; partition_order--) {
+    const size_t parts = size_t{1} << partition_order;
+    const size_t len = frames >> partition_order;
+    uint64_t bits = 0;
+    uint32_t max_param = 0;
+    for (size_t part = 0; part < parts; part++) {
+      const size_t count = part == 0 ? len - order : len;
+      uint64_t part_bits;
+      const uint32_t param = best_rice_parameter(sums[part], count, &part_bits);
+      candidate_params[part] = param;
+      bits += part_bits;
+      if (param > max_param) {
+        max_param = param;
+      }
+    }
+    const bool rice2 = max_param > RICE_MAX_PARAMETER;
+    bits += parts * (rice2 ? 5 : 4);
+    if (bits < plan.bits) {
+      plan = {partition_order, rice2, bits};
+      std::memcpy(params, candidate_params, parts);
+    }
+    if (partition_order == 0) {
+      break;
+    }
+    for (size_t part = 0; part < parts / 2; part++) {
+      sums[part] = saturating_add(sums[2 * part], sums[2 * part + 1]);
+    }
+  }
+
+  // The estimate can be a little under; count exactly for the verbatim
+  // comparison, which also bounds the frame size.
+  const size_t parts = size_t{1} << plan.partition_order;
+  const size_t len = frames >> plan.partition_order;
+  uint64_t bits = 2 + 4 + parts * (plan.rice2 ? 5 : 4);
+  for (size_t part = 0; part < parts; part++) {
+    const size_t start = part == 0 ? order : part * len;
+    const size_t end = (part + 1) * len;
+    const uint32_t param = params[part];
+    bits += (end - start) * (param + 1);
+    for (size_t i = start; i < end; i++) {
+      bits += zigzag(residual[i]) >> param;
+    }
+  }
+  plan.bits = bits;
+  return plan;
+}
+
+static void put_residual(BitWriter &writer, const int32_t *residual,
+                         size_t frames, int order, const RicePlan &plan,
+                         const uint8_t *params) {
+  writer.put(plan.rice2 ? 1 : 0, 2);
+  writer.put(plan.partition_order, 4);
+  const size_t parts = size_t{1} << plan.partition_order;
+  const size_t len = frames >> plan.partition_order;
+  for (size_t part = 0; part < parts; part++) {
+    const uint32_t param = params[part];
+    writer.put(param, plan.rice2 ? 5 : 4);
+    const size_t start = part == 0 ? order : part * len;
+    const size_t end = (part + 1) * len;
+    const uint32_t low_mask = (uint32_t{1} << param) - 1;
+    for (size_t i = start; i < end; i++) {
+      const uint32_t value = zigzag(residual[i]);
+      const uint32_t quotient = value >> param;
+      // Unary quotient, stop bit and the low bits in one go when they fit.
+      const uint32_t tail = (uint32_t{1} << param) | (value & low_mask);
+      if (quotient + param + 1 <= 32) {
+        writer.put(tail, quotient + param + 1);
+      } else {
+        writer.put_zeros(quotient);
+        writer.put(tail, param + 1);
+      }
+    }
+  }
+}
+
+static void encode_subframe(BitWriter &writer, const int32_t *signal,
+                            size_t frames, int bits_per_sample,
+                            int32_t *residual, uint32_t *sums, uint8_t *params,
+                            uint8_t *candidate_params) {
+  bool constant = true;
+  FixedOrderCost cost;
+  for (size_t i = 0; i < frames; i++) {
+    constant = constant && signal[i] == signal[0];
+    cost.add(signal[i]);
+  }
+  if (constant) {
+    writer.put(SUBFRAME_CONSTANT << 1, 8);
+    writer.put_signed(signal[0], bits_per_sample);
+    return;
+  }
+
+  const uint64_t verbatim_bits =
+      static_cast<uint64_t>(frames) * bits_per_sample;
+  int order = cost.best_order();
+  if (static_cast<size_t>(order) >= frames) {
+    order = static_cast<int>(frames) - 1;
+  }
+  if (frames > MAX_FIXED_ORDER) {
+    for (size_t i = order; i < frames; i++) {
+      const int32_t *x = signal + i;
+      switch (order) {
+      case 0:
+        residual[i] = x[0];
+        break;
+      case 1:
+        residual[i] = x[0] - x[-1];
+        break;
+      case 2:
+        residual[i] = x[0] - 2 * x[-1] + x[-2];
+        break;
+      case 3:
+        residual[i] = x[0] - 3 * x[-1] + 3 * x[-2] - x[-3];
+        break;
+      default:
+        residual[i] = x[0] - 4 * x[-1] + 6 * x[-2] - 4 * x[-3] + x[-4];
+        break;
+      }
+    }
+    const RicePlan plan = plan_rice(residual, frames, order, sums, params,
+                                    candidate_params);
+    if (static_cast<uint64_t>(order) * bits_per_sample + plan.bits <
+        verbatim_bits) {
+      writer.put((SUBFRAME_FIXED | order) << 1, 8);
+      for (int i = 0; i < order; i++) {
+        writer.put_signed(signal[i], bits_per_sample);
+      }
+      put_residual(writer, residual, frames, order, plan, params);
+      return;
+    }
+  }
+
+  writer.put(SUBFRAME_VERBATIM << 1, 8);
+  for (size_t i = 0; i < frames; i++) {
+    writer.put_signed(signal[i], bits_per_sample);
+  }
+}
+
+size_t write_flac_stream_header(uint8_t *out, const FlacStreamInfo &info) {
+  BitWriter writer(out);
+  writer.put(0x664C6143, 32); // "fLaC"
+
+  // STREAMINFO, not the last metadata block.
+  writer.put(0, 8);
+  writer.put(34, 24);
+  writer.put(info.block_frames, 16);
+  writer.put(info.block_frames, 16);
+  writer.put(info.min_frame_bytes, 24);
+  writer.put(info.max_frame_bytes, 24);
+  writer.put(info.sample_rate, 20);
+  writer.put(info.channels - 1, 3);
+  writer.put(BITS_PER_SAMPLE - 1, 5);
+  writer.put(static_cast<uint32_t>(info.total_frames >> 32), 4);
+  writer.put(static_cast<uint32_t>(info.total_frames), 32);
+  for (int i = 0; i < 4; i++) {
+    writer.put(0, 32); // MD5 not computed
+  }
+
+  // SEEKTABLE with one point, the last metadata block.
+  writer.put(0x80 | 3, 8);
+  writer.put(18, 24);
+  writer.put(static_cast<uint32_t>(info.seek_frame >> 32), 32);
+  writer.put(static_cast<uint32_t>(info.seek_frame), 32);
+  writer.put(static_cast<uint32_t>(info.seek_offset >> 32), 32);
+  writer.put(static_cast<uint32_t>(info.seek_offset), 32);
+  writer.put(info.seek_frame == FLAC_SEEK_PLACEHOLDER ? 0 : info.block_frames,
+             16);
+  return writer.bytes();
+}
+
+static uint64_t get_be(const uint8_t *in, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value = value << 8 | in[i];
+  }
+  return value;
+}
+
+bool parse_flac_stream_header(const uint8_t *in, size_t len,
+                              FlacStreamInfo *info) {
+  if (len < FLAC_STREAM_HEADER_SIZE || std::memcmp(in, "fLaC", 4) != 0 ||
+      (in[4] & 0x7F) != 0 || get_be(in + 5, 3) != 34 ||
+      in[42] != (0x80 | 3) || get_be(in + 43, 3) != 18) {
+    return false;
+  }
+  const uint8_t *streaminfo = in + 8;
+  info->block_frames = get_be(streaminfo, 2);
+  info->min_frame_bytes = get_be(streaminfo + 4, 3);
+  info->max_frame_bytes = get_be(streaminfo + 7, 3);
+  const uint64_t packed = get_be(streaminfo + 10, 8);
+  info->sample_rate = packed >> 44;
+  info->channels = ((packed >> 41) & 0x7) + 1;
+  info->total_frames = packed & ((uint64_t{1} << 36) - 1);
+  const uint8_t *seek_point = in + 46;
+  info->seek_frame = get_be(seek_point, 8);
+  info->seek_offset = get_be(seek_point + 8, 8);
+  return true;
+}
+
+size_t flac_max_frame_size(uint16_t block_frames, uint8_t channels) {
+  // Frame header of at most 16 bytes, then per channel a subframe header and
+  // verbatim samples one bit wider for a side channel, then the CRC-16.
+  const size_t subframe = 1 + (static_cast<size_t>(block_frames) *
+                                   (BITS_PER_SAMPLE + 1) +
+                               7) /
+                                  8;
+  return 16 + channels * subframe + 2;
+}
+
+FlacEncoder::FlacEncoder(uint8_t channels, uint32_t sample_rate,
+                         uint16_t block_frames, uint8_t *work)
+    : channels_(channels), sample_rate_code_(sample_rate_code(sample_rate)),
+      block_frames_(block_frames),
+      signal_(reinterpret_cast<int32_t *>(work)),
+      residual_(this->signal_ + block_frames),
+      partition_sums_(reinterpret_cast<uint32_t *>(this->residual_ +
+                                                   block_frames)),
+      rice_params_(reinterpret_cast<uint8_t *>(this->partition_sums_ +
+                                               FLAC_MAX_PARTITIONS)),
+      candidate_params_(this->rice_params_ + FLAC_MAX_PARTITIONS) {}
+
+size_t FlacEncoder::encode_frame(const uint8_t *in, size_t frames,
+                                 uint8_t *out) {
+  // Stereo picks the pair of signals with the cheapest best predictors.
+  uint8_t assignment = this->channels_ - 1;
+  int signals[8];
+  for (int ch = 0; ch < this->channels_; ch++) {
+    signals[ch] = ch;
+  }
+  if (this->channels_ == 2) {
+    FixedOrderCost left;
+    FixedOrderCost right;
+    FixedOrderCost mid;
+    FixedOrderCost side;
+    for (size_t i = 0; i < frames; i++) {
+      const int32_t l = sample_at(in, i * 2);
+      const int32_t r = sample_at(in, i * 2 + 1);
+      left.add(l);
+      right.add(r);
+      mid.add((l + r) >> 1);
+      side.add(l - r);
+    }
+    const uint64_t l = left.best_sum();
+    const uint64_t r = right.best_sum();
+    const uint64_t m = mid.best_sum();
+    const uint64_t s = side.best_sum();
+    uint64_t best = l + r;
+    if (l + s < best) {
+      best = l + s;
+      assignment = CHANNELS_LEFT_SIDE;
+      signals[1] = SIGNAL_SIDE;
+    }
+    if (s + r < best) {
+      best = s + r;
+      assignment = CHANNELS_RIGHT_SIDE;
+      signals[0] = SIGNAL_SIDE;
+      signals[1] = 1;
+    }
+    if (m + s < best) {
+      assignment = CHANNELS_MID_SIDE;
+      signals[0] = SIGNAL_MID;
+      signals[1] = SIGNAL_SIDE;
+    }
+  }
+
+  BitWriter writer(out);
+  int size_bits;
+  const uint8_t size_code = block_size_code(frames, &size_bits);
+  writer.put(0x3FFE, 14); // sync code
+  writer.put(0, 1);
+  writer.put(0, 1); // fixed block size
+  writer.put(size_code, 4);
+  writer.put(this->sample_rate_code_, 4);
+  writer.put(assignment, 4);
+  writer.put(4, 3); // 16 bits per sample
+  writer.put(0, 1);
+  put_frame_number(writer, this->frame_number_++);
+  writer.put(static_cast<uint32_t>(frames - 1), size_bits);
+  uint8_t crc8 = 0;
+  for (const uint8_t *p = out; p < writer.position(); p++) {
+    crc8 = CRC8.value[crc8 ^ *p];
+  }
+  writer.put(crc8, 8);
+
+  for (int ch = 0; ch < this->channels_; ch++) {
+    const int signal = signals[ch];
+    for (size_t i = 0; i < frames; i++) {
+      this->signal_[i] = signal_sample(in, i, this->channels_, signal);
+    }
+    encode_subframe(writer, this->signal_, frames,
+                    signal == SIGNAL_SIDE ? BITS_PER_SAMPLE + 1
+                                          : BITS_PER_SAMPLE,
+                    this->residual_, this->partition_sums_, this->rice_params_,
+                    this->candidate_params_);
+  }
+
+  writer.align();
+  uint16_t crc16 = 0;
+  for (const uint8_t *p = out; p < writer.position(); p++) {
+    crc16 = static_cast<uint16_t>(crc16 << 8) ^ CRC16.value[(crc16 >> 8) ^ *p];
+  }
+  writer.put(crc16, 16);
+  return writer.bytes();
+}
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace pcm_utils {
+
+// "fLaC", a STREAMINFO block and a SEEKTABLE block holding one seek point.
+static constexpr size_t FLAC_STREAM_HEADER_SIZE = 64;
+// Seek point sample number that marks the point as unused.
+static constexpr uint64_t FLAC_SEEK_PLACEHOLDER = UINT64_MAX;
+
+/// The fields of a stream header written by write_flac_stream_header().
+struct FlacStreamInfo {
+  uint32_t sample_rate;
+  uint8_t channels;
+  uint16_t block_frames;
+  // Smallest and largest encoded frame in bytes, or 0 if not known.
+  uint32_t min_frame_bytes;
+  uint32_t max_frame_bytes;
+  // Frames in the stream, or 0 if not known.
+  uint64_t total_frames;
+  // The seek point: a frame number and the byte offset of the FLAC frame
+  // starting there, counted from the end of the header. seek_frame is
+  // FLAC_SEEK_PLACEHOLDER when the point is unused.
+  uint64_t seek_frame;
+  uint64_t seek_offset;
+};
+
+/// Writes a FLAC_STREAM_HEADER_SIZE-byte header for a 16-bit stream with a
+/// fixed block size. The MD5 signature is left zero, meaning not computed.
+/// Returns the number of bytes written.
+size_t write_flac_stream_header(uint8_t *out, const FlacStreamInfo &info);
+
+/// Reads back a header written by write_flac_stream_header(). Returns false
+/// if the first len bytes don't hold one.
+bool parse_flac_stream_header(const uint8_t *in, size_t len,
+                              FlacStreamInfo *info);
+
+// Residual partitions per subframe at the highest partition order tried.
+static constexpr size_t FLAC_MAX_PARTITIONS = 256;
+
+/// Bytes of work buffer a FlacEncoder with the given block size needs.
+inline size_t flac_encoder_work_size(uint16_t block_frames) {
+  return 2 * static_cast<size_t>(block_frames) * sizeof(int32_t) +
+         FLAC_MAX_PARTITIONS * (sizeof(uint32_t) + 2);
+}
+
+/// Largest frame FlacEncoder::encode_frame() can produce: every subframe
+/// stored verbatim, plus frame header and footer.
+size_t flac_max_frame_size(uint16_t block_frames, uint8_t channels);
+
+/// Streaming encoder for 16-bit FLAC with a fixed block size.
+///
+/// Each channel is coded with the best of the fixed polynomial predictors
+/// (orders 0 to 4) and partitioned Rice residuals, falling back to verbatim
+/// if that is smaller; stereo also tries left/side, right/side and mid/side.
+/// The cost per frame is a fixed number of passes over its samples, and the
+/// encoder never allocates: it works in a buffer the caller provides.
+class FlacEncoder {
+public:
+  /// work must hold flac_encoder_work_size(block_frames) bytes, be 4-byte
+  /// aligned and outlive the encoder. block_frames must be at least 16.
+  FlacEncoder(uint8_t channels, uint32_t sample_rate, uint16_t block_frames,
+              uint8_t *work);
+
+  /// Encodes interleaved little-endian 16-bit frames as the next FLAC frame.
+  /// frames may be below block_frames only for the last frame of a stream.
+  /// out must hold flac_max_frame_size() bytes. Returns the bytes written.
+  size_t encode_frame(const uint8_t *in, size_t frames, uint8_t *out);
+
+  /// Starts a new stream, numbering frames from zero again.
+  void reset() { this->frame_number_ = 0; }
+
+  uint8_t get_channels() const { return this->channels_; }
+  uint16_t get_block_frames() const { return this->block_frames_; }
+
+protected:
+  uint8_t channels_;
+  uint8_t sample_rate_code_;
+  uint16_t block_frames_;
+  uint32_t frame_number_{0};
+  // One channel's signal and its prediction residual.
+  int32_t *signal_;
+  int32_t *residual_;
+  // Per-partition residual sums and Rice parameters: the best found so far
+  // and the ones being tried.
+  uint32_t *partition_sums_;
+  uint8_t *rice_params_;
+  uint8_t *candidate_params_;
+};
+
+} // namespace pcm_utils
+} // namespace esphome
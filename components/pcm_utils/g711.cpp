@@ -0,0 +1,18 @@
+#include "g711.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace pcm_utils {
+
+size_t encode_ulaw(const uint8_t *in, uint8_t *out, size_t samples) {
+  for (size_t i = 0; i < samples; ++i) {
+    int16_t sample;
+    std::memcpy(&sample, in + i * sizeof(int16_t), sizeof(sample));
+    out[i] = linear_to_ulaw(sample);
+  }
+  return samples;
+}
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace pcm_utils {
+
+/// Encodes one 16-bit linear sample as G.711 mu-law.
+inline uint8_t linear_to_ulaw(int16_t sample) {
+  static constexpr int32_t BIAS = 0x84;
+  static constexpr int32_t CLIP = 32635;
+
+  int32_t magnitude = sample;
+  uint8_t sign = 0;
+  if (magnitude < 0) {
+    magnitude = -magnitude;
+    sign = 0x80;
+  }
+  if (magnitude > CLIP) {
+    magnitude = CLIP;
+  }
+  magnitude += BIAS;
+
+  // The biased magnitude has its top bit somewhere in bits 7..14, which maps
+  // directly onto the 3-bit segment number.
+  int32_t exponent = (31 - __builtin_clz(static_cast<uint32_t>(magnitude))) - 7;
+  int32_t mantissa = (magnitude >> (exponent + 3)) & 0x0F;
+  return static_cast<uint8_t>(~(sign | (exponent << 4) | mantissa));
+}
+
+/// Encodes little-endian 16-bit samples to one mu-law byte each. Returns the
+/// number of bytes written.
+size_t encode_ulaw(const uint8_t *in, uint8_t *out, size_t samples);
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,136 @@
+#include "ima_adpcm.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace pcm_utils {
+
+static const int8_t IMA_INDEX_TABLE[16] = {-1, -1, -1, -1, 2, 4, 6, 8,
+                                           -1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int16_t IMA_STEP_TABLE[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+uint8_t ima_adpcm_encode_sample(ImaAdpcmState &state, int16_t sample) {
+  int32_t step = IMA_STEP_TABLE[state.step_index];
+  int32_t diff = static_cast<int32_t>(sample) - state.predictor;
+  uint8_t code = 0;
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+
+  // Quantise exactly as the decoder reconstructs so the two never drift.
+  int32_t delta = step >> 3;
+  if (diff >= step) {
+    code |= 4;
+    diff -= step;
+    delta += step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 2;
+    diff -= step;
+    delta += step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 1;
+    delta += step;
+  }
+
+  int32_t predictor = state.predictor + ((code & 8) ? -delta : delta);
+  if (predictor > INT16_MAX) {
+    predictor = INT16_MAX;
+  } else if (predictor < INT16_MIN) {
+    predictor = INT16_MIN;
+  }
+  state.predictor = static_cast<int16_t>(predictor);
+
+  int32_t index = state.step_index + IMA_INDEX_TABLE[code];
+  if (index < 0) {
+    index = 0;
+  } else if (index > 88) {
+    index = 88;
+  }
+  state.step_index = static_cast<uint8_t>(index);
+  return code;
+}
+
+size_t ima_adpcm_encode_block(ImaAdpcmState *states, uint8_t channels,
+                              const uint8_t *in, size_t frames, uint8_t *out) {
+  uint8_t *pos = out;
+  for (uint8_t ch = 0; ch < channels; ++ch) {
+    uint16_t predictor = static_cast<uint16_t>(states[ch].predictor);
+    pos[0] = static_cast<uint8_t>(predictor);
+    pos[1] = static_cast<uint8_t>(predictor >> 8);
+    pos[2] = states[ch].step_index;
+    pos[3] = 0;
+    pos += IMA_ADPCM_CHANNEL_HEADER_SIZE;
+  }
+
+  const size_t samples = frames * channels;
+  uint8_t ch = 0;
+  for (size_t i = 0; i < samples; ++i) {
+    int16_t sample;
+    std::memcpy(&sample, in + i * sizeof(int16_t), sizeof(sample));
+    uint8_t code = ima_adpcm_encode_sample(states[ch], sample);
+    if ((i & 1) == 0) {
+      *pos = code;
+    } else {
+      *pos++ |= static_cast<uint8_t>(code << 4);
+    }
+    if (++ch == channels) {
+      ch = 0;
+    }
+  }
+  if (samples & 1) {
+    pos++;
+  }
+  return pos - out;
+}
+
+size_t ima_adpcm_encode_wav_block(ImaAdpcmState *states, uint8_t channels,
+                                  const uint8_t *in, size_t frames_per_block,
+                                  uint8_t *out) {
+  uint8_t *pos = out;
+  for (uint8_t ch = 0; ch < channels; ++ch) {
+    int16_t first;
+    std::memcpy(&first, in + ch * sizeof(int16_t), sizeof(first));
+    states[ch].predictor = first;
+    pos[0] = static_cast<uint8_t>(first);
+    pos[1] = static_cast<uint8_t>(static_cast<uint16_t>(first) >> 8);
+    pos[2] = states[ch].step_index;
+    pos[3] = 0;
+    pos += IMA_ADPCM_CHANNEL_HEADER_SIZE;
+  }
+
+  const size_t stride = channels * sizeof(int16_t);
+  for (size_t frame = 1; frame < frames_per_block; frame += 8) {
+    for (uint8_t ch = 0; ch < channels; ++ch) {
+      const uint8_t *sample_in = in + frame * stride + ch * sizeof(int16_t);
+      for (int i = 0; i < 8; i += 2) {
+        int16_t low;
+        int16_t high;
+        std::memcpy(&low, sample_in, sizeof(low));
+        std::memcpy(&high, sample_in + stride, sizeof(high));
+        sample_in += 2 * stride;
+        const uint8_t low_code = ima_adpcm_encode_sample(states[ch], low);
+        const uint8_t high_code = ima_adpcm_encode_sample(states[ch], high);
+        *pos++ = static_cast<uint8_t>(low_code | high_code << 4);
+      }
+    }
+  }
+  return pos - out;
+}
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace pcm_utils {
+
+/// Per-channel IMA-ADPCM encoder state.
+struct ImaAdpcmState {
+  int16_t predictor{0};
+  uint8_t step_index{0};
+};
+
+/// Bytes of block header emitted per channel by ima_adpcm_encode_block().
+static constexpr size_t IMA_ADPCM_CHANNEL_HEADER_SIZE = 4;
+
+/// Encodes one sample, advancing state, and returns its 4-bit code.
+uint8_t ima_adpcm_encode_sample(ImaAdpcmState &state, int16_t sample);
+
+/// Size of a block produced by ima_adpcm_encode_block().
+inline size_t ima_adpcm_block_size(size_t frames, uint8_t channels) {
+  return IMA_ADPCM_CHANNEL_HEADER_SIZE * channels + (frames * channels + 1) / 2;
+}
+
+/// Encodes interleaved little-endian 16-bit frames as a self-contained block:
+/// for each channel a header of the state before the block (predictor as
+/// little-endian int16, step index, zero pad), followed by one nibble per
+/// sample in interleaved order, low nibble first. states holds one entry per
+/// channel and carries over between blocks, so consecutive blocks form a
+/// continuous stream while each one can still be decoded on its own. Returns
+/// the number of bytes written.
+size_t ima_adpcm_encode_block(ImaAdpcmState *states, uint8_t channels,
+                              const uint8_t *in, size_t frames, uint8_t *out);
+
+/// Frames in each block of an IMA-ADPCM WAV file (WAVE_FORMAT_IMA_ADPCM)
+/// with the given block_align: the header sample plus eight per 4-byte group.
+inline size_t ima_adpcm_wav_frames_per_block(size_t block_align,
+                                             uint8_t channels) {
+  return (block_align - IMA_ADPCM_CHANNEL_HEADER_SIZE * channels) * 2 /
+             channels +
+         1;
+}
+
+/// Encodes frames_per_block interleaved little-endian 16-bit frames as one
+/// WAV IMA-ADPCM block, which differs from ima_adpcm_encode_block(): each
+/// channel header carries the block's first sample rather than the state
+/// before it, and the remaining samples follow in 4-byte groups of eight per
+/// channel. frames_per_block must be one more than a multiple of eight.
+/// Returns the number of bytes written, which is the block_align.
+size_t ima_adpcm_encode_wav_block(ImaAdpcmState *states, uint8_t channels,
+                                  const uint8_t *in, size_t frames_per_block,
+                                  uint8_t *out);
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,84 @@
+#include "latency_histogram.h"
+
+#include <cmath>
+
+namespace esphome {
+namespace pcm_utils {
+
+// Values below LATENCY_SUB_BUCKETS get a bucket each. Above that, a value
+// with its top bit at position e lands in octave e - 2, split by the three
+// bits below the top one.
+static constexpr uint32_t SUB_BITS = 3;
+static_assert(1u << SUB_BITS == LATENCY_SUB_BUCKETS, "");
+static_assert((32 - SUB_BITS + 1) * LATENCY_SUB_BUCKETS == LATENCY_BUCKETS,
+              "every uint32_t must have a bucket");
+
+size_t LatencyHistogram::bucket_for(uint32_t us) {
+  if (us < LATENCY_SUB_BUCKETS) {
+    return us;
+  }
+  const uint32_t top = 31 - __builtin_clz(us);
+  const uint32_t sub = (us >> (top - SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+  return (top - SUB_BITS + 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+uint32_t LatencyHistogram::bucket_upper(size_t index) {
+  if (index < LATENCY_SUB_BUCKETS) {
+    return index;
+  }
+  const uint32_t shift = index / LATENCY_SUB_BUCKETS - 1;
+  const uint64_t lower = static_cast<uint64_t>(
+                             LATENCY_SUB_BUCKETS +
+                             index % LATENCY_SUB_BUCKETS)
+                         << shift;
+  return static_cast<uint32_t>(lower + (uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::record(uint32_t us) {
+  // Only this thread writes, so a plain load and store can't lose a count.
+  std::atomic<uint32_t> &count = this->counts_[bucket_for(us)];
+  count.store(count.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
+void LatencyHistogram::snapshot(LatencyCounts *out) const {
+  for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+    out->counts[i] = this->counts_[i].load(std::memory_order_relaxed);
+  }
+}
+
+uint32_t LatencyCounts::total() const {
+  uint32_t total = 0;
+  for (uint32_t count : this->counts) {
+    total += count;
+  }
+  return total;
+}
+
+uint32_t LatencyCounts::percentile(float fraction) const {
+  const uint32_t total = this->total();
+  if (total == 0) {
+    return 0;
+  }
+  // Rank of the sample sought, counting from 1.
+  uint32_t rank =
+      static_cast<uint32_t>(std::ceil(static_cast<double>(fraction) * total));
+  rank = rank < 1 ? 1 : rank > total ? total : rank;
+  uint32_t seen = 0;
+  for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += this->counts[i];
+    if (seen >= rank) {
+      return LatencyHistogram::bucket_upper(i);
+    }
+  }
+  return LatencyHistogram::bucket_upper(LATENCY_BUCKETS - 1);
+}
+
+void LatencyCounts::subtract(const LatencyCounts &earlier) {
+  for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+    this->counts[i] -= earlier.counts[i];
+  }
+}
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace pcm_utils {
+
+// Eight buckets per power of two up to 2^32 us: a percentile read from them
+// is at most 12.5% above the true value.
+static constexpr size_t LATENCY_SUB_BUCKETS = 8;
+static constexpr size_t LATENCY_BUCKETS = 240;
+
+/// Plain copy of a LatencyHistogram's counts.
+struct LatencyCounts {
+  uint32_t counts[LATENCY_BUCKETS];
+
+  uint32_t total() const;
+  /// Upper bound of the bucket holding the sample that the given fraction
+  /// (0..1) of all samples are at or below, in microseconds; 0 without
+  /// samples.
+  uint32_t percentile(float fraction) const;
+  /// Leaves only the samples recorded after the earlier copy was taken.
+  void subtract(const LatencyCounts &earlier);
+};
+
+/// Log-linear histogram of durations in microseconds.
+///
+/// One thread records while any other takes snapshots; counts are relaxed
+/// atomics and never reset, so a snapshot minus an earlier one covers the
+/// samples in between. A snapshot taken mid-record() may miss that one
+/// sample.
+class LatencyHistogram {
+public:
+  static size_t bucket_for(uint32_t us);
+  /// Largest value that falls into the bucket.
+  static uint32_t bucket_upper(size_t index);
+
+  /// Recording side; a single thread only.
+  void record(uint32_t us);
+  void snapshot(LatencyCounts *out) const;
+
+protected:
+  std::atomic<uint32_t> counts_[LATENCY_BUCKETS]{};
+};
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,199 @@
+#include "pcm_convert.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace pcm_utils {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "PCM kernels assume a little-endian target");
+
+static inline bool is_word_aligned(const void *ptr) {
+  return (reinterpret_cast<uintptr_t>(ptr) & 3) == 0;
+}
+
+// Word accessors for pointers already known to be 4-byte aligned, so the
+// compiler emits single 32-bit loads/stores even on targets without unaligned
+// access.
+static inline uint32_t load_word(const uint8_t *ptr) {
+  uint32_t word;
+  std::memcpy(&word, __builtin_assume_aligned(ptr, 4), sizeof(word));
+  return word;
+}
+
+static inline void store_word(uint8_t *ptr, uint32_t word) {
+  std::memcpy(__builtin_assume_aligned(ptr, 4), &word, sizeof(word));
+}
+
+static inline int32_t load_s32(const uint8_t *ptr) {
+  int32_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+static inline int16_t load_s16(const uint8_t *ptr) {
+  int16_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+void swap_bytes_16(uint8_t *data, size_t samples) {
+  // An odd start address never reaches word alignment; the prologue then
+  // handles the whole buffer.
+  for (; samples > 0 && !is_word_aligned(data); --samples, data += 2) {
+    uint8_t tmp = data[0];
+    data[0] = data[1];
+    data[1] = tmp;
+  }
+  for (; samples >= 2; samples -= 2, data += 4) {
+    uint32_t word = load_word(data);
+    store_word(data, ((word & 0x00FF00FFU) << 8) | ((word >> 8) & 0x00FF00FFU));
+  }
+  if (samples > 0) {
+    uint8_t tmp = data[0];
+    data[0] = data[1];
+    data[1] = tmp;
+  }
+}
+
+void swap_bytes_24(uint8_t *data, size_t samples) {
+  // Three-byte samples reach word alignment within three steps.
+  for (; samples > 0 && !is_word_aligned(data); --samples, data += 3) {
+    uint8_t tmp = data[0];
+    data[0] = data[2];
+    data[2] = tmp;
+  }
+  // Four samples span exactly three words:
+  //   in:  a0 a1 a2 b0 | b1 b2 c0 c1 | c2 d0 d1 d2
+  //   out: a2 a1 a0 b2 | b1 b0 c2 c1 | c0 d2 d1 d0
+  for (; samples >= 4; samples -= 4, data += 12) {
+    uint32_t w0 = load_word(data);
+    uint32_t w1 = load_word(data + 4);
+    uint32_t w2 = load_word(data + 8);
+    store_word(data, ((w0 >> 16) & 0xFFU) | (w0 & 0xFF00U) |
+                         ((w0 & 0xFFU) << 16) | (((w1 >> 8) & 0xFFU) << 24));
+    store_word(data + 4, (w1 & 0xFFU) | ((w0 >> 24) << 8) |
+                             ((w2 & 0xFFU) << 16) | (w1 & 0xFF000000U));
+    store_word(data + 8, ((w1 >> 16) & 0xFFU) | ((w2 >> 24) << 8) |
+                             (w2 & 0x00FF0000U) | (((w2 >> 8) & 0xFFU) << 24));
+  }
+  for (; samples > 0; --samples, data += 3) {
+    uint8_t tmp = data[0];
+    data[0] = data[2];
+    data[2] = tmp;
+  }
+}
+
+void swap_bytes_32(uint8_t *data, size_t samples) {
+  if (is_word_aligned(data)) {
+    for (; samples > 0; --samples, data += 4) {
+      store_word(data, __builtin_bswap32(load_word(data)));
+    }
+    return;
+  }
+  for (; samples > 0; --samples, data += 4) {
+    uint8_t b0 = data[0];
+    uint8_t b1 = data[1];
+    data[0] = data[3];
+    data[1] = data[2];
+    data[2] = b1;
+    data[3] = b0;
+  }
+}
+
+void swap_bytes(uint8_t *data, size_t samples, uint8_t bits_per_sample) {
+  switch (bits_per_sample) {
+  case 16:
+    swap_bytes_16(data, samples);
+    break;
+  case 24:
+    swap_bytes_24(data, samples);
+    break;
+  case 32:
+    swap_bytes_32(data, samples);
+    break;
+  default:
+    break;
+  }
+}
+
+void convert_32_to_16(const uint8_t *in, uint8_t *out, size_t samples) {
+  for (; samples > 0 && !(is_word_aligned(in) && is_word_aligned(out));
+       --samples, in += 4, out += 2) {
+    out[0] = in[2];
+    out[1] = in[3];
+  }
+  for (; samples >= 2; samples -= 2, in += 8, out += 4) {
+    uint32_t s0 = load_word(in);
+    uint32_t s1 = load_word(in + 4);
+    store_word(out, (s0 >> 16) | (s1 & 0xFFFF0000U));
+  }
+  if (samples > 0) {
+    out[0] = in[2];
+    out[1] = in[3];
+  }
+}
+
+void convert_32_to_24(const uint8_t *in, uint8_t *out, size_t samples) {
+  for (; samples > 0 && !(is_word_aligned(in) && is_word_aligned(out));
+       --samples, in += 4, out += 3) {
+    out[0] = in[1];
+    out[1] = in[2];
+    out[2] = in[3];
+  }
+  // Four samples pack into three words; all loads happen before the stores so
+  // the in-place case is safe.
+  for (; samples >= 4; samples -= 4, in += 16, out += 12) {
+    uint32_t s0 = load_word(in);
+    uint32_t s1 = load_word(in + 4);
+    uint32_t s2 = load_word(in + 8);
+    uint32_t s3 = load_word(in + 12);
+    store_word(out, (s0 >> 8) | ((s1 & 0xFF00U) << 16));
+    store_word(out + 4, (s1 >> 16) | ((s2 >> 8) << 16));
+    store_word(out + 8, (s2 >> 24) | (s3 & 0xFFFFFF00U));
+  }
+  for (; samples > 0; --samples, in += 4, out += 3) {
+    out[0] = in[1];
+    out[1] = in[2];
+    out[2] = in[3];
+  }
+}
+
+void downmix_stereo_to_mono_16(const uint8_t *in, uint8_t *out,
+                               size_t frames) {
+  for (; frames > 0 && !(is_word_aligned(in) && is_word_aligned(out));
+       --frames, in += 4, out += 2) {
+    int16_t mono = static_cast<int16_t>(
+        (static_cast<int32_t>(load_s16(in)) + load_s16(in + 2)) >> 1);
+    std::memcpy(out, &mono, sizeof(mono));
+  }
+  for (; frames >= 2; frames -= 2, in += 8, out += 4) {
+    uint32_t f0 = load_word(in);
+    uint32_t f1 = load_word(in + 4);
+    int32_t m0 = (static_cast<int32_t>(static_cast<int16_t>(f0)) +
+                  static_cast<int16_t>(f0 >> 16)) >>
+                 1;
+    int32_t m1 = (static_cast<int32_t>(static_cast<int16_t>(f1)) +
+                  static_cast<int16_t>(f1 >> 16)) >>
+                 1;
+    store_word(out, (static_cast<uint32_t>(m0) & 0xFFFFU) |
+                        (static_cast<uint32_t>(m1) << 16));
+  }
+  if (frames > 0) {
+    int16_t mono = static_cast<int16_t>(
+        (static_cast<int32_t>(load_s16(in)) + load_s16(in + 2)) >> 1);
+    std::memcpy(out, &mono, sizeof(mono));
+  }
+}
+
+void downmix_stereo_to_mono_32(const uint8_t *in, uint8_t *out,
+                               size_t frames) {
+  for (; frames > 0; --frames, in += 8, out += 4) {
+    int32_t mono = static_cast<int32_t>(
+        (static_cast<int64_t>(load_s32(in)) + load_s32(in + 4)) >> 1);
+    std::memcpy(out, &mono, sizeof(mono));
+  }
+}
+
+} // namespace pcm_utils
+} // namespace esphome
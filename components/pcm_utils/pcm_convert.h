@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace pcm_utils {
+
+// Sample format kernels for interleaved PCM. Buffers are byte pointers with no
+// alignment requirement; the kernels run a short scalar prologue until the
+// pointer is word aligned and then work four bytes at a time. Multi-byte
+// samples are in host (little-endian) order unless stated otherwise. Every
+// kernel may be run in place (out == in).
+
+/// Reverses the byte order of each 16-bit sample.
+void swap_bytes_16(uint8_t *data, size_t samples);
+/// Reverses the byte order of each packed 3-byte sample.
+void swap_bytes_24(uint8_t *data, size_t samples);
+/// Reverses the byte order of each 32-bit sample.
+void swap_bytes_32(uint8_t *data, size_t samples);
+/// Reverses the byte order of each sample of the given width in bits.
+void swap_bytes(uint8_t *data, size_t samples, uint8_t bits_per_sample);
+
+/// Truncates 32-bit samples to their upper 16 bits.
+void convert_32_to_16(const uint8_t *in, uint8_t *out, size_t samples);
+/// Truncates 32-bit samples to their upper 24 bits, packed three bytes each.
+void convert_32_to_24(const uint8_t *in, uint8_t *out, size_t samples);
+
+/// Averages interleaved stereo frames down to mono.
+void downmix_stereo_to_mono_16(const uint8_t *in, uint8_t *out, size_t frames);
+void downmix_stereo_to_mono_32(const uint8_t *in, uint8_t *out, size_t frames);
+
+} // namespace pcm_utils
+} // namespace esphome
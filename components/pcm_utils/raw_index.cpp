@@ -0,0 +1,93 @@
+#include "raw_index.h"
+
+#include "wav_header.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace pcm_utils {
+
+static constexpr uint8_t RAW_INDEX_MAGIC[8] = {'M', 'I', 'C', 'R',
+                                               'E', 'C', 'R', 'W'};
+static constexpr uint16_t RAW_INDEX_VERSION = 1;
+static constexpr size_t RECORDINGS_OFFSET = 40;
+static constexpr size_t RECORDING_SIZE = 32;
+static constexpr size_t CRC_OFFSET = RAW_SECTOR_SIZE - 4;
+static_assert(RECORDINGS_OFFSET + RAW_INDEX_RECORDINGS * RECORDING_SIZE <=
+                  CRC_OFFSET,
+              "the index must fit in one sector");
+
+static uint64_t get_le64(const uint8_t *in) {
+  return get_le32(in) | static_cast<uint64_t>(get_le32(in + 4)) << 32;
+}
+
+static void put_le64(uint8_t *out, uint64_t value) {
+  put_le32(out, static_cast<uint32_t>(value));
+  put_le32(out + 4, static_cast<uint32_t>(value >> 32));
+}
+
+// CRC-32 as in zlib, so host tools can check it with the standard library.
+// The index is written a few times a minute at most: bitwise is plenty.
+static uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+void write_raw_index(uint8_t *out, const RawIndex &index) {
+  std::memset(out, 0, RAW_SECTOR_SIZE);
+  std::memcpy(out, RAW_INDEX_MAGIC, sizeof(RAW_INDEX_MAGIC));
+  put_le16(out + 8, RAW_INDEX_VERSION);
+  put_le16(out + 10, RAW_INDEX_RECORDINGS);
+  put_le32(out + 12, index.data_sectors);
+  put_le32(out + 16, index.generation);
+  put_le32(out + 20, index.next_sequence);
+  put_le64(out + 24, index.write_position);
+  put_le64(out + 32, index.oldest_position);
+  for (size_t i = 0; i < RAW_INDEX_RECORDINGS; i++) {
+    const RawRecording &recording = index.recordings[i];
+    uint8_t *entry = out + RECORDINGS_OFFSET + i * RECORDING_SIZE;
+    put_le32(entry, recording.sequence);
+    put_le32(entry + 4, recording.sample_rate);
+    put_le64(entry + 8, recording.start);
+    put_le64(entry + 16, recording.length);
+    entry[24] = recording.channels;
+    entry[25] = recording.bits_per_sample;
+    entry[26] = recording.flags;
+  }
+  put_le32(out + CRC_OFFSET, crc32(out, CRC_OFFSET));
+}
+
+bool parse_raw_index(const uint8_t *in, RawIndex *index) {
+  if (std::memcmp(in, RAW_INDEX_MAGIC, sizeof(RAW_INDEX_MAGIC)) != 0 ||
+      get_le16(in + 8) != RAW_INDEX_VERSION ||
+      get_le16(in + 10) != RAW_INDEX_RECORDINGS ||
+      get_le32(in + CRC_OFFSET) != crc32(in, CRC_OFFSET)) {
+    return false;
+  }
+  index->data_sectors = get_le32(in + 12);
+  index->generation = get_le32(in + 16);
+  index->next_sequence = get_le32(in + 20);
+  index->write_position = get_le64(in + 24);
+  index->oldest_position = get_le64(in + 32);
+  for (size_t i = 0; i < RAW_INDEX_RECORDINGS; i++) {
+    RawRecording &recording = index->recordings[i];
+    const uint8_t *entry = in + RECORDINGS_OFFSET + i * RECORDING_SIZE;
+    recording.sequence = get_le32(entry);
+    recording.sample_rate = get_le32(entry + 4);
+    recording.start = get_le64(entry + 8);
+    recording.length = get_le64(entry + 16);
+    recording.channels = entry[24];
+    recording.bits_per_sample = entry[25];
+    recording.flags = entry[26];
+  }
+  return true;
+}
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace pcm_utils {
+
+// A raw recording region is a run of card sectors written without a file
+// system: two index sectors, then data sectors used as a ring. Audio is
+// addressed by its position in the stream of bytes ever written to the ring,
+// so position p lives in data sector (p / RAW_SECTOR_SIZE) % data_sectors.
+static constexpr size_t RAW_SECTOR_SIZE = 512;
+// The index is written to the two sectors in turn, so a write torn by a
+// power loss leaves the previous copy intact.
+static constexpr size_t RAW_INDEX_SECTORS = 2;
+// Recordings the index keeps track of; older ones are forgotten.
+static constexpr size_t RAW_INDEX_RECORDINGS = 14;
+
+// RawRecording::flags: set once the recording was stopped cleanly.
+static constexpr uint8_t RAW_RECORDING_COMPLETE = 1;
+
+/// One PCM recording in the ring. sequence 0 marks an unused slot.
+struct RawRecording {
+  uint32_t sequence;
+  uint32_t sample_rate;
+  // Stream position of the first byte, always on a sector boundary, and the
+  // length of the audio in bytes: whole frames of interleaved little-endian
+  // samples.
+  uint64_t start;
+  uint64_t length;
+  uint8_t channels;
+  uint8_t bits_per_sample;
+  uint8_t flags;
+};
+
+struct RawIndex {
+  // Incremented by every write; the copy with the higher count is current.
+  uint32_t generation;
+  uint32_t data_sectors;
+  uint32_t next_sequence;
+  // Stream position the next write goes to, on a sector boundary.
+  uint64_t write_position;
+  // Audio before this stream position may have been overwritten.
+  uint64_t oldest_position;
+  // Recording n is kept in slot n % RAW_INDEX_RECORDINGS.
+  RawRecording recordings[RAW_INDEX_RECORDINGS];
+};
+
+/// Serialises index into one RAW_SECTOR_SIZE sector, with a CRC-32 over it.
+void write_raw_index(uint8_t *out, const RawIndex &index);
+
+/// Reads back a sector written by write_raw_index(). Returns false if it
+/// doesn't hold an index or its CRC doesn't match.
+bool parse_raw_index(const uint8_t *in, RawIndex *index);
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,114 @@
+#include "spsc_ring.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace pcm_utils {
+
+size_t SpscRing::round_capacity(size_t size) {
+  size_t capacity = 1;
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+SpscRing::SpscRing(uint8_t *storage, size_t capacity)
+    : storage_(storage), capacity_(capacity), mask_(capacity - 1) {}
+
+size_t SpscRing::write(const uint8_t *data, size_t len, size_t align) {
+  size_t room = this->free();
+  size_t to_write = len <= room ? len : room;
+  if (align > 1) {
+    to_write -= to_write % align;
+  }
+
+  if (to_write < len) {
+    this->overrun_bytes_.fetch_add(len - to_write, std::memory_order_relaxed);
+    this->overrun_events_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (to_write == 0) {
+    return 0;
+  }
+
+  const size_t head = this->head_.load(std::memory_order_relaxed);
+  const size_t offset = head & this->mask_;
+  const size_t first = this->capacity_ - offset;
+  if (to_write <= first) {
+    std::memcpy(this->storage_ + offset, data, to_write);
+  } else {
+    std::memcpy(this->storage_ + offset, data, first);
+    std::memcpy(this->storage_, data + first, to_write - first);
+  }
+  this->head_.store(head + to_write, std::memory_order_release);
+  return to_write;
+}
+
+size_t SpscRing::write_regions(uint8_t **first, size_t *first_len,
+                               uint8_t **second, size_t *second_len) {
+  const size_t room = this->free();
+  const size_t offset =
+      this->head_.load(std::memory_order_relaxed) & this->mask_;
+  const size_t to_end = this->capacity_ - offset;
+
+  *first = this->storage_ + offset;
+  *first_len = room <= to_end ? room : to_end;
+  *second = this->storage_;
+  *second_len = room - *first_len;
+  return room;
+}
+
+void SpscRing::commit_write(size_t len) {
+  const size_t head = this->head_.load(std::memory_order_relaxed);
+  this->head_.store(head + len, std::memory_order_release);
+}
+
+size_t SpscRing::free() const {
+  const size_t head = this->head_.load(std::memory_order_relaxed);
+  const size_t tail = this->tail_.load(std::memory_order_acquire);
+  return this->capacity_ - (head - tail);
+}
+
+size_t SpscRing::read(uint8_t *data, size_t len) {
+  uint8_t *first = nullptr;
+  uint8_t *second = nullptr;
+  size_t first_len = 0;
+  size_t second_len = 0;
+  size_t total = this->peek(len, &first, &first_len, &second, &second_len);
+  std::memcpy(data, first, first_len);
+  if (second_len > 0) {
+    std::memcpy(data + first_len, second, second_len);
+  }
+  this->consume(total);
+  return total;
+}
+
+size_t SpscRing::peek(size_t max_len, uint8_t **first, size_t *first_len,
+                      uint8_t **second, size_t *second_len) {
+  const size_t tail = this->tail_.load(std::memory_order_relaxed);
+  const size_t queued = this->head_.load(std::memory_order_acquire) - tail;
+  const size_t total = queued <= max_len ? queued : max_len;
+  const size_t offset = tail & this->mask_;
+  const size_t to_end = this->capacity_ - offset;
+
+  *first = this->storage_ + offset;
+  *first_len = total <= to_end ? total : to_end;
+  *second = this->storage_;
+  *second_len = total - *first_len;
+  return total;
+}
+
+void SpscRing::consume(size_t len) {
+  const size_t tail = this->tail_.load(std::memory_order_relaxed);
+  const size_t queued = this->head_.load(std::memory_order_acquire) - tail;
+  this->tail_.store(tail + (len <= queued ? len : queued),
+                    std::memory_order_release);
+}
+
+size_t SpscRing::available() const {
+  const size_t tail = this->tail_.load(std::memory_order_relaxed);
+  return this->head_.load(std::memory_order_acquire) - tail;
+}
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace pcm_utils {
+
+/// Lock-free single-producer/single-consumer byte ring.
+///
+/// Built for the microphone callback handing audio to a sender or writer
+/// task: exactly one context may call the producer methods (write,
+/// write_regions, commit_write, free) and exactly one the consumer methods
+/// (read, peek, consume, available). Both sides only ever advance their own
+/// index, so neither blocks the other and no critical section is needed.
+///
+/// The capacity is a power of two and the head/tail indices run freely,
+/// wrapping at 2^N; the fill level is simply head - tail. The ring does not
+/// own its storage.
+///
+/// A full ring drops the newest bytes and counts them as an overrun. It never
+/// overwrites queued bytes, because a consumer may be sending them in place
+/// from a region returned by peek().
+class SpscRing {
+public:
+  /// Smallest power of two >= size (and >= 1).
+  static size_t round_capacity(size_t size);
+
+  /// capacity must be a power of two; storage must hold capacity bytes.
+  SpscRing(uint8_t *storage, size_t capacity);
+
+  // Producer side.
+
+  /// Appends the largest multiple of align bytes from data that fits, and
+  /// counts the rest as an overrun. Returns the number of bytes written.
+  size_t write(const uint8_t *data, size_t len, size_t align = 1);
+  /// Exposes free space as up to two contiguous regions for the producer to
+  /// fill in place; publish them with commit_write(). Returns the total.
+  size_t write_regions(uint8_t **first, size_t *first_len, uint8_t **second,
+                       size_t *second_len);
+  void commit_write(size_t len);
+  /// Bytes that can be written now. Exact for the producer; the consumer can
+  /// only make it larger.
+  size_t free() const;
+
+  // Consumer side.
+
+  /// Copies up to len bytes out and consumes them.
+  size_t read(uint8_t *data, size_t len);
+  /// Exposes up to max_len queued bytes as up to two contiguous regions
+  /// (the second is non-empty only when the data wraps). The bytes stay
+  /// queued, and untouched by the producer, until consume(). Returns the
+  /// total.
+  size_t peek(size_t max_len, uint8_t **first, size_t *first_len,
+              uint8_t **second, size_t *second_len);
+  /// Releases len bytes from the head, whether or not they were read.
+  void consume(size_t len);
+  /// Bytes queued now. Exact for the consumer; the producer can only make it
+  /// larger.
+  size_t available() const;
+
+  // Either side.
+
+  size_t capacity() const { return this->capacity_; }
+  /// Free-running byte positions, e.g. to mark where an event occurred.
+  size_t write_position() const {
+    return this->head_.load(std::memory_order_acquire);
+  }
+  size_t read_position() const {
+    return this->tail_.load(std::memory_order_acquire);
+  }
+  /// Bytes and write calls dropped because the ring was full.
+  uint32_t overrun_bytes() const {
+    return this->overrun_bytes_.load(std::memory_order_relaxed);
+  }
+  uint32_t overrun_events() const {
+    return this->overrun_events_.load(std::memory_order_relaxed);
+  }
+
+protected:
+  uint8_t *const storage_;
+  const size_t capacity_;
+  const size_t mask_;
+
+  // head_ is only stored by the producer and tail_ only by the consumer;
+  // release/acquire pairs order the payload bytes around them.
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+
+  std::atomic<uint32_t> overrun_bytes_{0};
+  std::atomic<uint32_t> overrun_events_{0};
+};
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,126 @@
+#include "wav_header.h"
+
+#include "ima_adpcm.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace pcm_utils {
+
+static constexpr uint16_t WAVE_FORMAT_PCM = 1;
+static constexpr uint16_t WAVE_FORMAT_IMA_ADPCM = 0x11;
+static constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+// KSDATAFORMAT_SUBTYPE_PCM, 00000001-0000-0010-8000-00aa00389b71.
+static constexpr uint8_t SUBTYPE_PCM[16] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                            0x10, 0x00, 0x80, 0x00, 0x00, 0xAA,
+                                            0x00, 0x38, 0x9B, 0x71};
+// SPEAKER_FRONT_CENTER and SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT. Wider
+// captures come from microphone arrays, which have no speaker positions.
+static constexpr uint32_t CHANNEL_MASK_MONO = 0x4;
+static constexpr uint32_t CHANNEL_MASK_STEREO = 0x3;
+
+size_t write_wav_header(uint8_t *out, uint16_t channels, uint32_t sample_rate,
+                        uint16_t bits_per_sample, uint32_t data_bytes) {
+  const uint16_t block_align = channels * (bits_per_sample / 8);
+  const size_t header_size = wav_header_size(channels, bits_per_sample);
+  const bool extensible = header_size == WAV_EXTENSIBLE_HEADER_SIZE;
+
+  std::memcpy(out, "RIFF", 4);
+  put_le32(out + WAV_RIFF_SIZE_OFFSET, wav_riff_size(header_size, data_bytes));
+  std::memcpy(out + 8, "WAVE", 4);
+
+  std::memcpy(out + 12, "fmt ", 4);
+  put_le32(out + 16, extensible ? 40 : 16);
+  put_le16(out + 20, extensible ? WAVE_FORMAT_EXTENSIBLE : WAVE_FORMAT_PCM);
+  put_le16(out + 22, channels);
+  put_le32(out + 24, sample_rate);
+  put_le32(out + 28, sample_rate * block_align);
+  put_le16(out + 32, block_align);
+  put_le16(out + 34, bits_per_sample);
+
+  uint8_t *pos = out + 36;
+  if (extensible) {
+    put_le16(pos, 22);
+    // Every bit of the container carries audio.
+    put_le16(pos + 2, bits_per_sample);
+    put_le32(pos + 4, channels == 1   ? CHANNEL_MASK_MONO
+                      : channels == 2 ? CHANNEL_MASK_STEREO
+                                      : 0);
+    std::memcpy(pos + 8, SUBTYPE_PCM, sizeof(SUBTYPE_PCM));
+    pos += 24;
+  }
+
+  std::memcpy(pos, "data", 4);
+  put_le32(pos + 4, data_bytes);
+  return header_size;
+}
+
+size_t write_ima_adpcm_wav_header(uint8_t *out, uint16_t channels,
+                                  uint32_t sample_rate, uint16_t block_align,
+                                  uint32_t frames, uint32_t data_bytes) {
+  const size_t frames_per_block =
+      ima_adpcm_wav_frames_per_block(block_align, channels);
+
+  std::memcpy(out, "RIFF", 4);
+  put_le32(out + WAV_RIFF_SIZE_OFFSET,
+           wav_riff_size(IMA_ADPCM_WAV_HEADER_SIZE, data_bytes));
+  std::memcpy(out + 8, "WAVE", 4);
+
+  std::memcpy(out + 12, "fmt ", 4);
+  put_le32(out + 16, 20);
+  put_le16(out + 20, WAVE_FORMAT_IMA_ADPCM);
+  put_le16(out + 22, channels);
+  put_le32(out + 24, sample_rate);
+  put_le32(out + 28, static_cast<uint32_t>(static_cast<uint64_t>(sample_rate) *
+                                           block_align / frames_per_block));
+  put_le16(out + 32, block_align);
+  put_le16(out + 34, 4);
+  put_le16(out + 36, 2);
+  put_le16(out + 38, static_cast<uint16_t>(frames_per_block));
+
+  std::memcpy(out + 40, "fact", 4);
+  put_le32(out + 44, 4);
+  put_le32(out + 48, frames);
+
+  std::memcpy(out + 52, "data", 4);
+  put_le32(out + 56, data_bytes);
+  return IMA_ADPCM_WAV_HEADER_SIZE;
+}
+
+bool parse_wav_header(const uint8_t *in, size_t len, WavLayout *layout) {
+  if (len < 12 || std::memcmp(in, "RIFF", 4) != 0 ||
+      std::memcmp(in + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+  bool have_format = false;
+  layout->fact_offset = 0;
+  size_t pos = 12;
+  while (pos + 8 <= len) {
+    const uint32_t size = get_le32(in + pos + 4);
+    if (std::memcmp(in + pos, "fmt ", 4) == 0) {
+      if (size < 16 || pos + 8 + 16 > len) {
+        return false;
+      }
+      const uint8_t *format = in + pos + 8;
+      layout->block_align = get_le16(format + 12);
+      layout->frames_per_block = 1;
+      if (get_le16(format) == WAVE_FORMAT_IMA_ADPCM && size >= 20 &&
+          pos + 8 + 20 <= len) {
+        layout->frames_per_block = get_le16(format + 18);
+      }
+      have_format = layout->block_align > 0 && layout->frames_per_block > 0;
+    } else if (std::memcmp(in + pos, "fact", 4) == 0 && size >= 4) {
+      layout->fact_offset = pos + 8;
+    } else if (std::memcmp(in + pos, "data", 4) == 0) {
+      layout->data_offset = pos + 8;
+      layout->data_bytes = size;
+      return have_format;
+    }
+    // Chunks are padded to an even size.
+    pos += 8 + static_cast<size_t>(size) + (size & 1);
+  }
+  return false;
+}
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace pcm_utils {
+
+// Canonical RIFF/WAVE header for uncompressed PCM: RIFF, fmt and data chunk
+// headers back to back, with the audio starting right after.
+static constexpr size_t WAV_HEADER_SIZE = 44;
+// Offsets of the two size fields that change as a recording grows.
+static constexpr size_t WAV_RIFF_SIZE_OFFSET = 4;
+static constexpr size_t WAV_DATA_SIZE_OFFSET = 40;
+
+// WAVE_FORMAT_EXTENSIBLE PCM header, which replaces the canonical one for
+// samples wider than 16 bits or more than two channels.
+static constexpr size_t WAV_EXTENSIBLE_HEADER_SIZE = 68;
+
+// IMA-ADPCM files add the samples-per-block field to fmt and a fact chunk
+// holding the frame count, since the last block may be padded.
+static constexpr size_t IMA_ADPCM_WAV_HEADER_SIZE = 60;
+
+/// Size of the PCM header write_wav_header() writes for this format.
+inline size_t wav_header_size(uint16_t channels, uint16_t bits_per_sample) {
+  return channels > 2 || bits_per_sample > 16 ? WAV_EXTENSIBLE_HEADER_SIZE
+                                              : WAV_HEADER_SIZE;
+}
+
+/// Writes a PCM header describing data_bytes of audio: the canonical one for
+/// up to two channels of 16-bit samples, otherwise WAVE_FORMAT_EXTENSIBLE.
+/// Returns the number of bytes written, which is wav_header_size().
+size_t write_wav_header(uint8_t *out, uint16_t channels, uint32_t sample_rate,
+                        uint16_t bits_per_sample, uint32_t data_bytes);
+
+/// Writes an IMA_ADPCM_WAV_HEADER_SIZE-byte WAVE_FORMAT_IMA_ADPCM header for
+/// blocks of block_align bytes, describing frames of audio in data_bytes.
+/// Returns the number of bytes written.
+size_t write_ima_adpcm_wav_header(uint8_t *out, uint16_t channels,
+                                  uint32_t sample_rate, uint16_t block_align,
+                                  uint32_t frames, uint32_t data_bytes);
+
+/// Where the audio sits in a WAV file, as read back from its header.
+struct WavLayout {
+  size_t data_offset;
+  uint32_t data_bytes;
+  uint16_t block_align;
+  // Frames each block_align bytes decode to: 1 for PCM.
+  uint32_t frames_per_block;
+  // Offset of the fact chunk's frame count, or 0 if there is none.
+  size_t fact_offset;
+};
+
+/// Walks the RIFF chunks in the first len bytes of a file up to the data
+/// chunk header. Returns false if they don't hold a PCM WAV header that ends
+/// within len bytes.
+bool parse_wav_header(const uint8_t *in, size_t len, WavLayout *layout);
+
+/// RIFF chunk size for a file holding data_bytes of audio after a header of
+/// header_size bytes.
+inline uint32_t wav_riff_size(size_t header_size, uint32_t data_bytes) {
+  return static_cast<uint32_t>(header_size - 8) + data_bytes;
+}
+
+/// Loads and stores little-endian values regardless of the host byte order.
+inline uint16_t get_le16(const uint8_t *in) {
+  return static_cast<uint16_t>(in[0] | in[1] << 8);
+}
+inline uint32_t get_le32(const uint8_t *in) {
+  return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 |
+         static_cast<uint32_t>(in[2]) << 16 |
+         static_cast<uint32_t>(in[3]) << 24;
+}
+inline void put_le16(uint8_t *out, uint16_t value) {
+  out[0] = static_cast<uint8_t>(value);
+  out[1] = static_cast<uint8_t>(value >> 8);
+}
+inline void put_le32(uint8_t *out, uint32_t value) {
+  out[0] = static_cast<uint8_t>(value);
+  out[1] = static_cast<uint8_t>(value >> 8);
+  out[2] = static_cast<uint8_t>(value >> 16);
+  out[3] = static_cast<uint8_t>(value >> 24);
+}
+
+} // namespace pcm_utils
+} // namespace esphome
@@ -1,18 +1,169 @@
+import ipaddress
+
 import esphome.codegen as cg
 from esphome.components import microphone
 import esphome.config_validation as cv
-from esphome.const import CONF_ID, CONF_MICROPHONE, CONF_PORT
+from esphome.const import (
+    CONF_BITS_PER_SAMPLE,
+    CONF_CHANNELS,
+    CONF_ID,
+    CONF_MICROPHONE,
+    CONF_PORT,
+    CONF_SAMPLE_RATE,
+)
+import esphome.final_validate as fv
 
-AUTO_LOAD = ["socket"]
+AUTO_LOAD = ["pcm_utils", "socket"]
 DEPENDENCIES = ["microphone"]
 
 udp_audio_streamer_ns = cg.esphome_ns.namespace("udp_audio_streamer")
 UDPAudioStreamer = udp_audio_streamer_ns.class_("UDPAudioStreamer", cg.Component)
 
+PacketCodec = udp_audio_streamer_ns.enum("PacketCodec")
+CODEC_OPTIONS = {
+    "pcm": PacketCodec.PACKET_CODEC_PCM,
+    "mulaw": PacketCodec.PACKET_CODEC_ULAW,
+    "ima_adpcm": PacketCodec.PACKET_CODEC_IMA_ADPCM,
+}
+
+OverflowPolicy = udp_audio_streamer_ns.enum("OverflowPolicy")
+OVERFLOW_POLICY_OPTIONS = {
+    "drop_newest": OverflowPolicy.OVERFLOW_POLICY_DROP_NEWEST,
+    "drop_oldest": OverflowPolicy.OVERFLOW_POLICY_DROP_OLDEST,
+    "block": OverflowPolicy.OVERFLOW_POLICY_BLOCK,
+}
+
+WireByteOrder = udp_audio_streamer_ns.enum("WireByteOrder")
+BYTE_ORDER_OPTIONS = {
+    "big_endian": WireByteOrder.WIRE_BYTE_ORDER_BIG_ENDIAN,
+    "little_endian": WireByteOrder.WIRE_BYTE_ORDER_LITTLE_ENDIAN,
+}
+
+Transport = udp_audio_streamer_ns.enum("Transport")
+TRANSPORT_OPTIONS = {
+    "udp": Transport.TRANSPORT_UDP,
+    "tcp": Transport.TRANSPORT_TCP,
+}
+
+CONF_UDP_AUDIO_STREAMER_ID = "udp_audio_streamer_id"
 CONF_HOST = "host"
+CONF_DESTINATIONS = "destinations"
+CONF_TTL = "ttl"
+CONF_TRANSPORT = "transport"
 CONF_CHUNK_DURATION = "chunk_duration"
 CONF_BUFFER_DURATION = "buffer_duration"
 CONF_PASSIVE = "passive"
+CONF_OVERFLOW_POLICY = "overflow_policy"
+CONF_MAX_LATENCY = "max_latency"
+CONF_BLOCK_TIMEOUT = "block_timeout"
+CONF_BYTE_ORDER = "byte_order"
+CONF_CODEC = "codec"
+CONF_PACKET_HEADER = "packet_header"
+CONF_SENDER_TASK = "sender_task"
+CONF_PRIORITY = "priority"
+CONF_CORE = "core"
+CONF_STACK_SIZE = "stack_size"
+CONF_ADAPTIVE_CHUNK = "adaptive_chunk"
+CONF_MAX_CHUNK_DURATION = "max_chunk_duration"
+CONF_MAX_PACKET_SIZE = "max_packet_size"
+CONF_FEC = "fec"
+CONF_GROUP_SIZE = "group_size"
+CONF_CLOCK_ANCHOR_INTERVAL = "clock_anchor_interval"
+CONF_VAD = "vad"
+CONF_ENERGY_THRESHOLD = "energy_threshold"
+CONF_ZERO_CROSSING_THRESHOLD = "zero_crossing_threshold"
+CONF_HANGOVER = "hangover"
+CONF_PRE_ROLL = "pre_roll"
+CONF_KEEPALIVE_INTERVAL = "keepalive_interval"
+
+SENDER_TASK_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_PRIORITY, default=19): cv.int_range(min=1, max=24),
+        cv.Optional(CONF_CORE, default=1): cv.int_range(min=-1, max=1),
+        cv.Optional(CONF_STACK_SIZE, default=4096): cv.int_range(
+            min=2048, max=32768
+        ),
+    }
+)
+
+VAD_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_ENERGY_THRESHOLD, default=-50.0): cv.float_range(
+            min=-96.0, max=0.0
+        ),
+        cv.Optional(CONF_ZERO_CROSSING_THRESHOLD, default=0.25): cv.percentage,
+        cv.Optional(
+            CONF_HANGOVER, default="500ms"
+        ): cv.positive_time_period_milliseconds,
+        cv.Optional(
+            CONF_PRE_ROLL, default="250ms"
+        ): cv.positive_time_period_milliseconds,
+        cv.Optional(
+            CONF_KEEPALIVE_INTERVAL, default="1s"
+        ): cv.positive_time_period_milliseconds,
+    }
+)
+
+DESTINATION_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_HOST): cv.string_strict,
+        cv.Required(CONF_PORT): cv.port,
+        cv.Optional(CONF_TTL, default=1): cv.int_range(min=1, max=255),
+    }
+)
+
+# Sizes from packet_header.h and ima_adpcm.h.
+PACKET_HEADER_SIZE = 24
+PACKET_ANCHOR_SIZE = 12
+FEC_DESCRIPTOR_SIZE = 4
+IMA_ADPCM_CHANNEL_HEADER_SIZE = 4
+DEFAULT_MAX_PACKET_SIZE = 1472
+
+# Each destination holds its own lwIP socket, which counts against
+# CONFIG_LWIP_MAX_SOCKETS alongside the API and OTA sockets.
+MAX_DESTINATIONS = 4
+
+
+def _validate_destinations(config):
+    if CONF_HOST in config:
+        if CONF_DESTINATIONS in config:
+            raise cv.Invalid(
+                f"Use either {CONF_HOST}/{CONF_PORT} or {CONF_DESTINATIONS}, not both"
+            )
+        if CONF_PORT not in config:
+            raise cv.Invalid(f"{CONF_PORT} is required with {CONF_HOST}")
+        config = config.copy()
+        config[CONF_DESTINATIONS] = [
+            DESTINATION_SCHEMA(
+                {
+                    CONF_HOST: config.pop(CONF_HOST),
+                    CONF_PORT: config.pop(CONF_PORT),
+                    CONF_TTL: config.pop(CONF_TTL, 1),
+                }
+            )
+        ]
+    elif CONF_DESTINATIONS not in config:
+        raise cv.Invalid(f"Either {CONF_HOST} or {CONF_DESTINATIONS} is required")
+    return config
+
+ADAPTIVE_CHUNK_SCHEMA = cv.Schema(
+    {
+        cv.Optional(
+            CONF_MAX_CHUNK_DURATION, default="128ms"
+        ): cv.positive_time_period_milliseconds,
+        # 1472 bytes is the largest UDP payload in one 1500-byte Ethernet/WiFi
+        # frame; larger values allow IP fragmentation.
+        cv.Optional(CONF_MAX_PACKET_SIZE, default=1472): cv.int_range(
+            min=256, max=65507
+        ),
+    }
+)
+
+FEC_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_GROUP_SIZE, default=4): cv.int_range(min=2, max=16),
+    }
+)
 
 
 def _validate_buffer(config):
@@ -22,6 +173,142 @@ def _validate_buffer(config):
         raise cv.Invalid(
             f"{CONF_BUFFER_DURATION} must be greater than or equal to {CONF_CHUNK_DURATION}"
         )
+    if CONF_MAX_LATENCY in config:
+        if config[CONF_OVERFLOW_POLICY] != "drop_oldest":
+            raise cv.Invalid(
+                f"{CONF_MAX_LATENCY} only applies to {CONF_OVERFLOW_POLICY}: drop_oldest"
+            )
+        if config[CONF_MAX_LATENCY].total_milliseconds < chunk_ms:
+            raise cv.Invalid(
+                f"{CONF_MAX_LATENCY} must be greater than or equal to {CONF_CHUNK_DURATION}"
+            )
+    if CONF_BLOCK_TIMEOUT in config and config[CONF_OVERFLOW_POLICY] != "block":
+        raise cv.Invalid(
+            f"{CONF_BLOCK_TIMEOUT} only applies to {CONF_OVERFLOW_POLICY}: block"
+        )
+    if CONF_ADAPTIVE_CHUNK in config:
+        max_chunk_ms = config[CONF_ADAPTIVE_CHUNK][
+            CONF_MAX_CHUNK_DURATION
+        ].total_milliseconds
+        if max_chunk_ms < chunk_ms:
+            raise cv.Invalid(
+                f"{CONF_MAX_CHUNK_DURATION} must be greater than or equal to {CONF_CHUNK_DURATION}"
+            )
+        if buffer_ms < max_chunk_ms * 2:
+            raise cv.Invalid(
+                f"{CONF_BUFFER_DURATION} must hold at least two chunks of {CONF_MAX_CHUNK_DURATION}"
+            )
+    if CONF_VAD in config:
+        pre_roll_ms = config[CONF_VAD][CONF_PRE_ROLL].total_milliseconds
+        if pre_roll_ms + chunk_ms > buffer_ms:
+            raise cv.Invalid(
+                f"{CONF_BUFFER_DURATION} must cover {CONF_VAD} {CONF_PRE_ROLL} plus one {CONF_CHUNK_DURATION}"
+            )
+    return config
+
+
+def _energy_threshold(dbfs):
+    # The detector compares the mean square of 16-bit samples, so convert the
+    # dBFS level into that domain here rather than doing log math on-device.
+    return int(round(32767.0**2 * 10.0 ** (dbfs / 10.0)))
+
+
+def _validate_fec(config):
+    if CONF_FEC in config and not config[CONF_PACKET_HEADER]:
+        raise cv.Invalid(
+            f"{CONF_FEC} requires {CONF_PACKET_HEADER}: true so receivers can find lost packets"
+        )
+    return config
+
+
+def _validate_clock_anchors(config):
+    if CONF_CLOCK_ANCHOR_INTERVAL in config and not config[CONF_PACKET_HEADER]:
+        raise cv.Invalid(
+            f"{CONF_CLOCK_ANCHOR_INTERVAL} requires {CONF_PACKET_HEADER}: true; anchors are carried in the header"
+        )
+    return config
+
+
+def _packet_size(config, sample_rate):
+    """Bytes in a datagram of one chunk_duration chunk, header included."""
+    source = config[CONF_MICROPHONE]
+    channels = len(source[CONF_CHANNELS])
+    frames = config[CONF_CHUNK_DURATION].total_milliseconds * sample_rate // 1000
+    if config[CONF_CODEC] == "mulaw":
+        payload = frames * channels
+    elif config[CONF_CODEC] == "ima_adpcm":
+        payload = (
+            IMA_ADPCM_CHANNEL_HEADER_SIZE * channels + (frames * channels + 1) // 2
+        )
+    else:
+        payload = frames * channels * (source[CONF_BITS_PER_SAMPLE] + 7) // 8
+    header = PACKET_HEADER_SIZE
+    if CONF_CLOCK_ANCHOR_INTERVAL in config:
+        header += PACKET_ANCHOR_SIZE
+    return header + payload
+
+
+def _final_validate_fec(config):
+    # A parity packet carries the group's longest datagram behind a header and
+    # descriptor of its own. Adaptive chunking keeps the chunks it grows small
+    # enough for that, but chunk_duration is sent as configured.
+    if CONF_FEC not in config:
+        return config
+    full_config = fv.full_config.get()
+    microphone_path = full_config.get_path_for_id(
+        config[CONF_MICROPHONE][CONF_MICROPHONE]
+    )[:-1]
+    sample_rate = full_config.get_config_for_path(microphone_path).get(
+        CONF_SAMPLE_RATE
+    )
+    if sample_rate is None:
+        return config
+    max_packet_size = DEFAULT_MAX_PACKET_SIZE
+    if CONF_ADAPTIVE_CHUNK in config:
+        max_packet_size = config[CONF_ADAPTIVE_CHUNK][CONF_MAX_PACKET_SIZE]
+    parity_size = (
+        _packet_size(config, sample_rate) + PACKET_HEADER_SIZE + FEC_DESCRIPTOR_SIZE
+    )
+    if parity_size > max_packet_size:
+        raise cv.Invalid(
+            f"{CONF_FEC} parity packets for a {CONF_CHUNK_DURATION} chunk take {parity_size} bytes, over the {max_packet_size}-byte {CONF_MAX_PACKET_SIZE}; shorten {CONF_CHUNK_DURATION}"
+        )
+    return config
+
+
+def _is_multicast(host):
+    try:
+        return ipaddress.ip_address(host).is_multicast
+    except ValueError:
+        return False
+
+
+def _validate_transport(config):
+    if config[CONF_TRANSPORT] != "tcp":
+        return config
+    if CONF_FEC in config:
+        raise cv.Invalid(
+            f"{CONF_FEC} has nothing to recover over {CONF_TRANSPORT}: tcp"
+        )
+    for destination in config[CONF_DESTINATIONS]:
+        if _is_multicast(destination[CONF_HOST]):
+            raise cv.Invalid(
+                f"{CONF_TRANSPORT}: tcp cannot send to multicast group {destination[CONF_HOST]}"
+            )
+    return config
+
+
+def _validate_codec(config):
+    if config[CONF_CODEC] == "pcm":
+        return config
+    if not config[CONF_PACKET_HEADER]:
+        raise cv.Invalid(
+            f"{CONF_CODEC}: {config[CONF_CODEC]} requires {CONF_PACKET_HEADER}: true so receivers can identify the codec"
+        )
+    if config[CONF_MICROPHONE][CONF_BITS_PER_SAMPLE] != 16:
+        raise cv.Invalid(
+            f"{CONF_CODEC}: {config[CONF_CODEC]} requires a 16-bit microphone source"
+        )
     return config
 
 
@@ -29,8 +316,16 @@ CONFIG_SCHEMA = cv.All(
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(UDPAudioStreamer),
-            cv.Required(CONF_HOST): cv.string_strict,
-            cv.Required(CONF_PORT): cv.port,
+            cv.Optional(CONF_HOST): cv.string_strict,
+            cv.Optional(CONF_PORT): cv.port,
+            cv.Optional(CONF_TTL): cv.int_range(min=1, max=255),
+            cv.Optional(CONF_DESTINATIONS): cv.All(
+                cv.ensure_list(DESTINATION_SCHEMA),
+                cv.Length(min=1, max=MAX_DESTINATIONS),
+            ),
+            cv.Optional(CONF_TRANSPORT, default="udp"): cv.enum(
+                TRANSPORT_OPTIONS, lower=True
+            ),
             cv.Optional(CONF_PASSIVE, default=False): cv.boolean,
             cv.Optional(
                 CONF_CHUNK_DURATION, default="32ms"
@@ -38,6 +333,26 @@ CONFIG_SCHEMA = cv.All(
             cv.Optional(
                 CONF_BUFFER_DURATION, default="512ms"
             ): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_OVERFLOW_POLICY, default="drop_oldest"): cv.enum(
+                OVERFLOW_POLICY_OPTIONS, lower=True
+            ),
+            cv.Optional(CONF_MAX_LATENCY): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_BLOCK_TIMEOUT): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(max=cv.TimePeriod(milliseconds=100)),
+            ),
+            cv.Optional(CONF_PACKET_HEADER, default=False): cv.boolean,
+            cv.Optional(CONF_CODEC, default="pcm"): cv.enum(CODEC_OPTIONS, lower=True),
+            cv.Optional(CONF_BYTE_ORDER, default="big_endian"): cv.enum(
+                BYTE_ORDER_OPTIONS, lower=True
+            ),
+            cv.Optional(CONF_SENDER_TASK): SENDER_TASK_SCHEMA,
+            cv.Optional(CONF_ADAPTIVE_CHUNK): ADAPTIVE_CHUNK_SCHEMA,
+            cv.Optional(CONF_FEC): FEC_SCHEMA,
+            cv.Optional(
+                CONF_CLOCK_ANCHOR_INTERVAL
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_VAD): VAD_SCHEMA,
             cv.Required(CONF_MICROPHONE): microphone.microphone_source_schema(
                 min_bits_per_sample=16,
                 max_bits_per_sample=32,
@@ -46,10 +361,18 @@ CONFIG_SCHEMA = cv.All(
             ),
         }
     ).extend(cv.COMPONENT_SCHEMA),
+    _validate_destinations,
     _validate_buffer,
+    _validate_codec,
+    _validate_fec,
+    _validate_clock_anchors,
+    _validate_transport,
 )
 
 
+FINAL_VALIDATE_SCHEMA = _final_validate_fec
+
+
 async def to_code(config):
     chunk_ms = config[CONF_CHUNK_DURATION].total_milliseconds
     buffer_ms = config[CONF_BUFFER_DURATION].total_milliseconds
@@ -64,7 +387,62 @@ async def to_code(config):
         config[CONF_MICROPHONE], passive=config[CONF_PASSIVE]
     )
     cg.add(var.set_microphone_source(mic_source))
-    cg.add(var.set_endpoint(config[CONF_HOST], config[CONF_PORT]))
+    for destination in config[CONF_DESTINATIONS]:
+        cg.add(
+            var.add_destination(
+                destination[CONF_HOST], destination[CONF_PORT], destination[CONF_TTL]
+            )
+        )
+    cg.add(var.set_transport(config[CONF_TRANSPORT]))
     cg.add(var.set_chunk_duration(chunk_ms))
     cg.add(var.set_buffer_duration(buffer_ms))
     cg.add(var.set_passive(config[CONF_PASSIVE]))
+    cg.add(var.set_overflow_policy(config[CONF_OVERFLOW_POLICY]))
+    if CONF_MAX_LATENCY in config:
+        cg.add(var.set_max_latency(config[CONF_MAX_LATENCY].total_milliseconds))
+    if CONF_BLOCK_TIMEOUT in config:
+        cg.add(var.set_block_timeout(config[CONF_BLOCK_TIMEOUT].total_milliseconds))
+    cg.add(var.set_packet_header(config[CONF_PACKET_HEADER]))
+    cg.add(var.set_codec(config[CONF_CODEC]))
+    cg.add(var.set_byte_order(config[CONF_BYTE_ORDER]))
+
+    if CONF_SENDER_TASK in config:
+        task_config = config[CONF_SENDER_TASK]
+        cg.add(
+            var.set_sender_task(
+                task_config[CONF_PRIORITY],
+                task_config[CONF_CORE],
+                task_config[CONF_STACK_SIZE],
+            )
+        )
+
+    if CONF_ADAPTIVE_CHUNK in config:
+        adaptive_config = config[CONF_ADAPTIVE_CHUNK]
+        cg.add(
+            var.set_adaptive_chunk(
+                adaptive_config[CONF_MAX_CHUNK_DURATION].total_milliseconds,
+                adaptive_config[CONF_MAX_PACKET_SIZE],
+            )
+        )
+
+    if CONF_FEC in config:
+        cg.add(var.set_fec_group_size(config[CONF_FEC][CONF_GROUP_SIZE]))
+
+    if CONF_CLOCK_ANCHOR_INTERVAL in config:
+        cg.add(
+            var.set_anchor_interval(
+                config[CONF_CLOCK_ANCHOR_INTERVAL].total_milliseconds
+            )
+        )
+
+    if CONF_VAD in config:
+        vad_config = config[CONF_VAD]
+        cg.add(
+            var.set_vad(
+                _energy_threshold(vad_config[CONF_ENERGY_THRESHOLD]),
+                int(round(vad_config[CONF_ZERO_CROSSING_THRESHOLD] * 65536)),
+                vad_config[CONF_HANGOVER].total_milliseconds,
+                vad_config[CONF_PRE_ROLL].total_milliseconds,
+                vad_config[CONF_KEEPALIVE_INTERVAL].total_milliseconds,
+            )
+        )
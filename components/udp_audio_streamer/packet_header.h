@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace udp_audio_streamer {
+
+// Optional header written in front of every datagram when `packet_header` is
+// enabled. Multi-byte fields are big-endian. Receivers must skip
+// header_length bytes to reach the payload so later revisions can append
+// fields without breaking older parsers.
+//
+//  0  'U' 'A'          magic
+//  2  version          PACKET_HEADER_VERSION
+//  3  flags            PACKET_FLAG_* bits
+//  4  header_length    bytes preceding the payload
+//  5  codec            PacketCodec
+//  6  channels
+//  7  bits_per_sample
+//  8  sequence         u32, increments once per packet
+// 12  frame_counter    u32, stream index of the payload's first sample frame
+// 16  capture_time_us  u32, device monotonic clock when that frame was captured
+// 20  sample_rate      u32, Hz
+//
+// With PACKET_FLAG_ANCHOR set, a clock anchor follows (header_length 36):
+//
+// 24  frame_counter_high  u32, upper half of the 64-bit stream frame index
+// 28  wall_time_us        u64, Unix time in microseconds when frame_counter
+//                         was captured, from the device's synced clock
+//
+// Anchors tie the I2S sample clock to real time, so receivers can measure
+// its rate without network jitter getting in the way.
+static constexpr uint8_t PACKET_MAGIC_0 = 'U';
+static constexpr uint8_t PACKET_MAGIC_1 = 'A';
+static constexpr uint8_t PACKET_HEADER_VERSION = 1;
+static constexpr size_t PACKET_HEADER_SIZE = 24;
+static constexpr size_t PACKET_ANCHOR_SIZE = 12;
+
+enum PacketFlag : uint8_t {
+  PACKET_FLAG_LITTLE_ENDIAN = 1 << 0, // PCM payload is little-endian
+  PACKET_FLAG_KEEPALIVE = 1 << 1,     // no payload; sent while VAD-gated
+  PACKET_FLAG_PARITY = 1 << 2,        // FEC parity, see below
+  PACKET_FLAG_ANCHOR = 1 << 3,        // clock anchor follows the header
+};
+
+// A parity packet (PACKET_FLAG_PARITY) follows each group of data packets
+// when FEC is enabled. Its header carries the group's first sequence number
+// and does not consume one itself. The payload is a 4-byte descriptor
+//
+//  0  count            data packets in the group (consecutive sequences)
+//  1  reserved
+//  2  length_xor       u16, XOR of the group's packet lengths
+//
+// followed by the XOR of the group's complete datagrams (header included),
+// each zero-padded to the longest. Any single lost packet in the group is
+// the XOR of the parity body with the packets that did arrive.
+static constexpr size_t FEC_DESCRIPTOR_SIZE = 4;
+
+// Over the TCP transport each packet, exactly as it would have been sent as
+// a datagram, is prefixed with its length as a big-endian u16. A keepalive
+// without a header is a zero-length frame.
+static constexpr size_t STREAM_FRAME_PREFIX_SIZE = 2;
+static constexpr size_t STREAM_FRAME_MAX_SIZE = 0xFFFF;
+
+enum PacketCodec : uint8_t {
+  PACKET_CODEC_PCM = 0,
+  PACKET_CODEC_ULAW = 1,      // G.711 mu-law, one byte per sample
+  PACKET_CODEC_IMA_ADPCM = 2, // see pcm_utils::ima_adpcm_encode_block()
+};
+
+inline const char *codec_to_string(PacketCodec codec) {
+  switch (codec) {
+  case PACKET_CODEC_PCM:
+    return "PCM";
+  case PACKET_CODEC_ULAW:
+    return "mu-law";
+  case PACKET_CODEC_IMA_ADPCM:
+    return "IMA-ADPCM";
+  default:
+    return "unknown";
+  }
+}
+
+struct PacketHeader {
+  uint8_t flags{0};
+  uint8_t codec{PACKET_CODEC_PCM};
+  uint8_t channels{0};
+  uint8_t bits_per_sample{0};
+  uint32_t sequence{0};
+  uint32_t frame_counter{0};
+  uint32_t capture_time_us{0};
+  uint32_t sample_rate{0};
+  // Only sent with PACKET_FLAG_ANCHOR.
+  uint32_t frame_counter_high{0};
+  uint64_t wall_time_us{0};
+};
+
+inline void put_be32(uint8_t *out, uint32_t value) {
+  out[0] = static_cast<uint8_t>(value >> 24);
+  out[1] = static_cast<uint8_t>(value >> 16);
+  out[2] = static_cast<uint8_t>(value >> 8);
+  out[3] = static_cast<uint8_t>(value);
+}
+
+/// Serialises header into out, which must hold PACKET_HEADER_SIZE bytes, plus
+/// PACKET_ANCHOR_SIZE with PACKET_FLAG_ANCHOR. Returns the number of bytes
+/// written.
+inline size_t encode_packet_header(const PacketHeader &header, uint8_t *out) {
+  const bool anchor = (header.flags & PACKET_FLAG_ANCHOR) != 0;
+  const size_t length = PACKET_HEADER_SIZE + (anchor ? PACKET_ANCHOR_SIZE : 0);
+  out[0] = PACKET_MAGIC_0;
+  out[1] = PACKET_MAGIC_1;
+  out[2] = PACKET_HEADER_VERSION;
+  out[3] = header.flags;
+  out[4] = static_cast<uint8_t>(length);
+  out[5] = header.codec;
+  out[6] = header.channels;
+  out[7] = header.bits_per_sample;
+  put_be32(out + 8, header.sequence);
+  put_be32(out + 12, header.frame_counter);
+  put_be32(out + 16, header.capture_time_us);
+  put_be32(out + 20, header.sample_rate);
+  if (anchor) {
+    put_be32(out + 24, header.frame_counter_high);
+    put_be32(out + 28, static_cast<uint32_t>(header.wall_time_us >> 32));
+    put_be32(out + 32, static_cast<uint32_t>(header.wall_time_us));
+  }
+  return length;
+}
+
+/// Serialises a parity descriptor into out (FEC_DESCRIPTOR_SIZE bytes).
+inline size_t encode_fec_descriptor(uint8_t count, uint16_t length_xor,
+                                    uint8_t *out) {
+  out[0] = count;
+  out[1] = 0;
+  out[2] = static_cast<uint8_t>(length_xor >> 8);
+  out[3] = static_cast<uint8_t>(length_xor);
+  return FEC_DESCRIPTOR_SIZE;
+}
+
+} // namespace udp_audio_streamer
+} // namespace esphome
@@ -0,0 +1,108 @@
+import esphome.codegen as cg
+from esphome.components import sensor
+import esphome.config_validation as cv
+from esphome.const import (
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_BYTES,
+    UNIT_PERCENT,
+)
+
+from . import CONF_UDP_AUDIO_STREAMER_ID, UDPAudioStreamer
+
+DEPENDENCIES = ["udp_audio_streamer"]
+
+CONF_CHUNK_SIZE = "chunk_size"
+CONF_RING_OCCUPANCY = "ring_occupancy"
+CONF_RING_HIGH_WATER = "ring_high_water"
+CONF_BYTES_DROPPED = "bytes_dropped"
+CONF_PACKETS_SENT = "packets_sent"
+CONF_SEND_ERRORS = "send_errors"
+CONF_RECONNECTS = "reconnects"
+ICON_PACKET = "mdi:package-variant"
+ICON_BUFFER = "mdi:tray-full"
+ICON_DROPPED = "mdi:delete-sweep"
+ICON_SENT = "mdi:upload-network"
+ICON_ERROR = "mdi:alert-circle-outline"
+ICON_RECONNECT = "mdi:lan-connect"
+UNIT_PACKETS = "packets"
+UNIT_ERRORS = "errors"
+UNIT_RECONNECTS = "reconnects"
+
+TYPES = [
+    CONF_CHUNK_SIZE,
+    CONF_RING_OCCUPANCY,
+    CONF_RING_HIGH_WATER,
+    CONF_BYTES_DROPPED,
+    CONF_PACKETS_SENT,
+    CONF_SEND_ERRORS,
+    CONF_RECONNECTS,
+]
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(CONF_UDP_AUDIO_STREAMER_ID): cv.use_id(UDPAudioStreamer),
+        cv.Optional(CONF_CHUNK_SIZE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_BYTES,
+            icon=ICON_PACKET,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_RING_OCCUPANCY): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            icon=ICON_BUFFER,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_RING_HIGH_WATER): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PERCENT,
+            icon=ICON_BUFFER,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_BYTES_DROPPED): sensor.sensor_schema(
+            unit_of_measurement=UNIT_BYTES,
+            icon=ICON_DROPPED,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_PACKETS_SENT): sensor.sensor_schema(
+            unit_of_measurement=UNIT_PACKETS,
+            icon=ICON_SENT,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_SEND_ERRORS): sensor.sensor_schema(
+            unit_of_measurement=UNIT_ERRORS,
+            icon=ICON_ERROR,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_RECONNECTS): sensor.sensor_schema(
+            unit_of_measurement=UNIT_RECONNECTS,
+            icon=ICON_RECONNECT,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+    }
+)
+
+
+async def setup_conf(config, key, hub):
+    if conf := config.get(key):
+        sens = await sensor.new_sensor(conf)
+        cg.add(getattr(hub, f"set_{key}_sensor")(sens))
+
+
+async def to_code(config):
+    hub = await cg.get_variable(config[CONF_UDP_AUDIO_STREAMER_ID])
+    for key in TYPES:
+        await setup_conf(config, key, hub)
@@ -2,11 +2,20 @@
 
 #ifdef USE_ESP32
 
+#include "esphome/components/pcm_utils/g711.h"
+#include "esphome/components/pcm_utils/ima_adpcm.h"
+#include "esphome/components/pcm_utils/pcm_convert.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 
+#include <esp_timer.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+#include <algorithm>
 #include <cerrno>
+#include <cstdint>
 #include <cstring>
 #include <utility>
 #include <vector>
@@ -16,11 +25,103 @@ namespace udp_audio_streamer {
 
 static const char *const TAG = "udp_audio_streamer";
 
-UDPAudioStreamer::~UDPAudioStreamer() { this->deallocate_buffers_(); }
+static constexpr int SEND_ERROR_PARTIAL = -1;
+// Ring occupancy, as a fraction of its size, that forces the chunk to grow,
+// and the level it must stay below before the chunk may shrink again.
+static constexpr size_t ADAPT_GROW_DIVISOR = 2;
+static constexpr size_t ADAPT_CLEAR_DIVISOR = 4;
+static constexpr int64_t ADAPT_SHRINK_INTERVAL_US = 1000000;
+static constexpr uint32_t SENSOR_PUBLISH_INTERVAL_MS = 1000;
+// Clock anchors are only sent once something has set the system clock;
+// before that it counts up from the 1970 epoch.
+static constexpr time_t MIN_VALID_EPOCH = 1577836800; // 2020-01-01
+static constexpr uint32_t TCP_CONNECT_TIMEOUT_MS = 5000;
+static constexpr uint32_t TCP_BACKOFF_MIN_MS = 250;
+static constexpr uint32_t TCP_BACKOFF_MAX_MS = 30000;
+
+static const char *overflow_policy_to_string(OverflowPolicy policy) {
+  switch (policy) {
+  case OVERFLOW_POLICY_DROP_NEWEST:
+    return "drop newest";
+  case OVERFLOW_POLICY_DROP_OLDEST:
+    return "drop oldest";
+  case OVERFLOW_POLICY_BLOCK:
+    return "block";
+  default:
+    return "unknown";
+  }
+}
+
+// XORs src into dst, four bytes at a time where possible.
+static void xor_into(uint8_t *dst, const uint8_t *src, size_t len) {
+  size_t i = 0;
+  for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+    uint32_t a;
+    uint32_t b;
+    std::memcpy(&a, dst + i, sizeof(a));
+    std::memcpy(&b, src + i, sizeof(b));
+    a ^= b;
+    std::memcpy(dst + i, &a, sizeof(a));
+  }
+  for (; i < len; i++) {
+    dst[i] ^= src[i];
+  }
+}
+
+#ifdef USE_SENSOR
+static void publish_counter(sensor::Sensor *sensor, uint32_t value) {
+  if (sensor == nullptr) {
+    return;
+  }
+  float state = value;
+  if (!sensor->has_state() || sensor->get_raw_state() != state) {
+    sensor->publish_state(state);
+  }
+}
+#endif
+
+UDPAudioStreamer::~UDPAudioStreamer() {
+  if (this->task_handle_ != nullptr) {
+    vTaskDelete(this->task_handle_);
+    this->task_handle_ = nullptr;
+  }
+  this->deallocate_buffers_();
+}
+
+void UDPAudioStreamer::add_destination(const std::string &host, uint16_t port,
+                                       uint8_t ttl) {
+  Destination destination;
+  destination.host = host;
+  destination.port = port;
+  destination.ttl = ttl;
+  this->destinations_.push_back(std::move(destination));
+}
+
+static bool is_ipv4_multicast(const struct sockaddr_storage &addr) {
+  if (addr.ss_family != AF_INET) {
+    return false;
+  }
+  const auto *in = reinterpret_cast<const struct sockaddr_in *>(&addr);
+  return (ntohl(in->sin_addr.s_addr) & 0xF0000000UL) == 0xE0000000UL;
+}
 
-void UDPAudioStreamer::set_endpoint(const std::string &host, uint16_t port) {
-  this->host_ = host;
-  this->port_ = port;
+static bool is_would_block(int error) {
+  return error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS ||
+         error == ENOMEM;
+}
+
+// True once the socket can take more data without blocking. A non-blocking
+// connect reports this once it has finished, one way or the other.
+static bool poll_writable(socket::Socket *sock) {
+  const int fd = sock->get_fd();
+  if (fd < 0) {
+    return true; // can't tell; the first write will
+  }
+  fd_set writable;
+  FD_ZERO(&writable);
+  FD_SET(fd, &writable);
+  struct timeval timeout{};
+  return ::select(fd + 1, nullptr, &writable, nullptr, &timeout) > 0;
 }
 
 void UDPAudioStreamer::setup() {
@@ -30,31 +131,38 @@ void UDPAudioStreamer::setup() {
     return;
   }
 
-  if (this->host_.empty() || this->port_ == 0) {
-    ESP_LOGE(TAG, "Destination host and port must be provided");
+  if (this->destinations_.empty()) {
+    ESP_LOGE(TAG, "At least one destination must be provided");
     this->mark_failed();
     return;
   }
 
-  socklen_t sl = socket::set_sockaddr(
-      reinterpret_cast<struct sockaddr *>(&this->dest_addr_),
-      sizeof(this->dest_addr_), this->host_, this->port_);
-  if (sl == 0) {
-    ESP_LOGE(TAG, "Invalid destination address '%s:%u'", this->host_.c_str(),
-             this->port_);
-    this->mark_failed();
-    return;
+  for (auto &destination : this->destinations_) {
+    if (destination.host.empty() || destination.port == 0) {
+      ESP_LOGE(TAG, "Destination host and port must be provided");
+      this->mark_failed();
+      return;
+    }
+    destination.addr_len = socket::set_sockaddr(
+        reinterpret_cast<struct sockaddr *>(&destination.addr),
+        sizeof(destination.addr), destination.host, destination.port);
+    if (destination.addr_len == 0) {
+      ESP_LOGE(TAG, "Invalid destination address '%s:%u'",
+               destination.host.c_str(), destination.port);
+      this->mark_failed();
+      return;
+    }
   }
-  this->endpoint_valid_ = true;
+  this->destinations_valid_ = true;
 
   this->audio_stream_info_ = this->mic_source_->get_audio_stream_info();
-  ESP_LOGI(
-      TAG,
-      "Configuring UDP stream to %s:%u (%u Hz, %u channel(s), %u-bit samples)",
-      this->host_.c_str(), this->port_,
-      this->audio_stream_info_.get_sample_rate(),
-      this->audio_stream_info_.get_channels(),
-      this->audio_stream_info_.get_bits_per_sample());
+  ESP_LOGI(TAG,
+           "Configuring UDP stream to %zu destination(s) (%u Hz, %u "
+           "channel(s), %u-bit samples)",
+           this->destinations_.size(),
+           this->audio_stream_info_.get_sample_rate(),
+           this->audio_stream_info_.get_channels(),
+           this->audio_stream_info_.get_bits_per_sample());
 
   this->send_buffer_size_ =
       this->audio_stream_info_.ms_to_bytes(this->chunk_duration_ms_);
@@ -67,11 +175,103 @@ void UDPAudioStreamer::setup() {
     return;
   }
 
+  this->header_size_ = 0;
+  if (this->packet_header_) {
+    this->header_size_ = PACKET_HEADER_SIZE;
+    if (this->anchor_interval_ms_ > 0) {
+      this->header_size_ += PACKET_ANCHOR_SIZE;
+    }
+  }
+  this->swap_payload_ = this->byte_order_ == WIRE_BYTE_ORDER_BIG_ENDIAN;
+
+  this->min_chunk_size_ = this->send_buffer_size_;
+  if (this->adaptive_) {
+    size_t max_chunk =
+        this->audio_stream_info_.ms_to_bytes(this->max_chunk_duration_ms_);
+    size_t packet_limit = this->max_chunk_for_packet_size_();
+    if (max_chunk > packet_limit) {
+      max_chunk = packet_limit;
+    }
+    if (max_chunk <= this->min_chunk_size_) {
+      ESP_LOGW(TAG, "Chunk already fills a %u byte packet; adaptive chunking "
+                    "has no room to grow",
+               this->max_packet_size_);
+      max_chunk = this->min_chunk_size_;
+    }
+    this->send_buffer_size_ = max_chunk;
+  }
+  this->chunk_size_.store(this->min_chunk_size_, std::memory_order_relaxed);
+
+  if (this->vad_enabled_) {
+    this->vad_.set_hangover_frames(static_cast<uint32_t>(
+        (static_cast<uint64_t>(this->vad_hangover_ms_) *
+         this->audio_stream_info_.get_sample_rate()) /
+        1000));
+    this->pre_roll_bytes_ =
+        this->audio_stream_info_.ms_to_bytes(this->pre_roll_ms_);
+    this->gate_open_.store(false, std::memory_order_relaxed);
+    this->gate_logged_open_ = false;
+  }
+
+  if (this->codec_ != PACKET_CODEC_PCM) {
+    if (this->audio_stream_info_.get_bits_per_sample() != 16) {
+      ESP_LOGE(TAG, "Compressed codecs require 16-bit samples");
+      this->mark_failed();
+      return;
+    }
+    this->codec_buffer_size_ =
+        (this->codec_ == PACKET_CODEC_ULAW)
+            ? this->send_buffer_size_ / sizeof(int16_t)
+            : pcm_utils::ima_adpcm_block_size(
+                  this->audio_stream_info_.bytes_to_frames(
+                      this->send_buffer_size_),
+                  this->audio_stream_info_.get_channels());
+  }
+
+  if (this->transport_ == TRANSPORT_TCP) {
+    size_t payload_max = this->send_buffer_size_;
+    if (this->codec_buffer_size_ > payload_max) {
+      payload_max = this->codec_buffer_size_;
+    }
+    const size_t frame_max = this->header_size_ + payload_max;
+    if (frame_max > STREAM_FRAME_MAX_SIZE) {
+      ESP_LOGE(TAG, "%zu byte packets don't fit a TCP frame; shorten the chunk",
+               frame_max);
+      this->mark_failed();
+      return;
+    }
+    for (auto &destination : this->destinations_) {
+      destination.pending.reserve(STREAM_FRAME_PREFIX_SIZE + frame_max);
+    }
+  }
+
   this->ring_buffer_size_ =
       this->audio_stream_info_.ms_to_bytes(this->buffer_duration_ms_);
   if (this->ring_buffer_size_ < this->send_buffer_size_ * 2) {
     this->ring_buffer_size_ = this->send_buffer_size_ * 4;
   }
+  if (this->ring_buffer_size_ <
+      this->pre_roll_bytes_ + this->send_buffer_size_ * 2) {
+    this->ring_buffer_size_ =
+        this->pre_roll_bytes_ + this->send_buffer_size_ * 2;
+  }
+  this->ring_buffer_size_ =
+      pcm_utils::SpscRing::round_capacity(this->ring_buffer_size_);
+
+  // Keep room for two full chunks above the latency bound so the producer
+  // never hits the end of the ring before the sender trims it.
+  const size_t latency_ceiling =
+      this->ring_buffer_size_ - this->send_buffer_size_ * 2;
+  this->max_latency_bytes_ =
+      this->max_latency_ms_ > 0
+          ? this->audio_stream_info_.ms_to_bytes(this->max_latency_ms_)
+          : latency_ceiling;
+  if (this->max_latency_bytes_ > latency_ceiling) {
+    this->max_latency_bytes_ = latency_ceiling;
+  }
+  if (this->max_latency_bytes_ < this->send_buffer_size_) {
+    this->max_latency_bytes_ = this->send_buffer_size_;
+  }
 
   if (!this->allocate_buffers_()) {
     ESP_LOGE(TAG, "Failed to allocate audio buffers");
@@ -81,22 +281,15 @@ void UDPAudioStreamer::setup() {
 
   this->mic_source_->add_data_callback(
       [this](const std::vector<uint8_t> &data) {
-        std::shared_ptr<RingBuffer> ring = this->ring_buffer_;
-        if (!ring) {
-          return;
-        }
-        size_t written = ring->write(data.data(), data.size());
-        if (written < data.size()) {
-          if (!this->warned_full_) {
-            ESP_LOGW(TAG, "Ring buffer full, dropping %zu bytes",
-                     data.size() - written);
-            this->warned_full_ = true;
-          }
-        } else {
-          this->warned_full_ = false;
-        }
+        this->handle_audio_data_(data);
       });
 
+  if (this->use_task_ && !this->start_sender_task_()) {
+    ESP_LOGE(TAG, "Failed to start sender task");
+    this->mark_failed();
+    return;
+  }
+
   if (!this->passive_ && !this->mic_source_->is_running()) {
     ESP_LOGD(TAG, "Starting microphone source");
     this->mic_source_->start();
@@ -104,96 +297,1047 @@ void UDPAudioStreamer::setup() {
 }
 
 void UDPAudioStreamer::loop() {
-  if (this->is_failed() || !this->endpoint_valid_) {
+  if (this->is_failed() || !this->destinations_valid_) {
     return;
   }
 
+  if (!this->prepare_transport_()) {
+    return;
+  }
+
+  if (!this->passive_ && !this->mic_source_->is_running()) {
+    ESP_LOGD(TAG, "Starting microphone source");
+    this->mic_source_->start();
+  }
+
+  if (this->task_handle_ == nullptr) {
+    pcm_utils::SpscRing *ring = this->ring_.get();
+    while (ring != nullptr && this->send_buffer_size_ > 0 &&
+           ring->available() >=
+               this->chunk_size_.load(std::memory_order_relaxed)) {
+      if (!this->send_chunk_(0)) {
+        break;
+      }
+    }
+  }
+
+  this->update_status_();
+}
+
+bool UDPAudioStreamer::prepare_transport_() {
+  if (this->transport_ready_.load(std::memory_order_acquire)) {
+    return true;
+  }
+
   if (!this->allocate_buffers_()) {
     this->status_momentary_error("buffer_alloc", 1000);
-    return;
+    return false;
   }
 
-  if (!this->ensure_socket_()) {
+  if (!this->ensure_sockets_()) {
     this->status_set_warning();
+    return false;
+  }
+
+  this->transport_ready_.store(true, std::memory_order_release);
+  return true;
+}
+
+void UDPAudioStreamer::handle_audio_data_(const std::vector<uint8_t> &data) {
+  // The ring lives from setup() until destruction, so a plain pointer is
+  // enough here.
+  pcm_utils::SpscRing *ring = this->ring_.get();
+  if (ring == nullptr) {
     return;
   }
 
-  if (!this->passive_ && !this->mic_source_->is_running()) {
-    ESP_LOGD(TAG, "Starting microphone source");
-    this->mic_source_->start();
+  if (this->vad_enabled_) {
+    bool open = this->vad_.process(
+        data.data(), this->audio_stream_info_.bytes_to_frames(data.size()),
+        this->audio_stream_info_.get_bytes_per_sample(),
+        this->audio_stream_info_.get_channels());
+    this->gate_open_.store(open, std::memory_order_release);
   }
 
-  std::shared_ptr<RingBuffer> ring = this->ring_buffer_;
-  if (!ring || this->send_buffer_size_ == 0) {
+  if (this->overflow_policy_ == OVERFLOW_POLICY_BLOCK &&
+      ring->free() < data.size()) {
+    this->wait_for_room_(ring, data.size());
+  }
+
+  // Write whole frames only, so a partial write never misaligns the stream.
+  const size_t position = ring->write_position();
+  size_t dropped =
+      data.size() - ring->write(data.data(), data.size(),
+                                this->audio_stream_info_.frames_to_bytes(1));
+  const size_t queued = ring->available();
+  if (this->task_handle_ != nullptr &&
+      queued >= this->chunk_size_.load(std::memory_order_relaxed)) {
+    xTaskNotifyGive(this->task_handle_);
+  }
+  if (queued > this->ring_high_water_.load(std::memory_order_relaxed)) {
+    this->ring_high_water_.store(queued, std::memory_order_relaxed);
+  }
+
+  uint32_t frames = this->audio_stream_info_.bytes_to_frames(data.size());
+  this->frames_captured_.fetch_add(frames, std::memory_order_relaxed);
+  this->last_capture_us_.store(static_cast<uint32_t>(esp_timer_get_time()),
+                               std::memory_order_relaxed);
+
+  if (dropped > 0) {
+    // The ring drops the newest audio, so the gap sits after everything
+    // queued so far. Queue where, so the sender skips the stream position
+    // only once it reaches that point.
+    if (this->pending_drop_.frames == 0) {
+      this->pending_drop_.position = position + data.size() - dropped;
+    }
+    this->pending_drop_.frames +=
+        this->audio_stream_info_.bytes_to_frames(dropped);
+    this->bytes_dropped_total_.fetch_add(dropped, std::memory_order_relaxed);
+    if (!this->warned_full_) {
+      ESP_LOGW(TAG, "Ring buffer full, dropping %zu bytes", dropped);
+      this->warned_full_ = true;
+    }
+  } else {
+    this->warned_full_ = false;
+  }
+  if (this->pending_drop_.frames > 0) {
+    this->queue_drop_();
+  }
+}
+
+void UDPAudioStreamer::queue_drop_() {
+  const uint32_t head = this->drop_head_.load(std::memory_order_relaxed);
+  if (head - this->drop_tail_.load(std::memory_order_acquire) >=
+      DROP_RECORD_SLOTS) {
+    return; // the sender is behind every queued gap; retry next callback
+  }
+  this->drop_records_[head % DROP_RECORD_SLOTS] = this->pending_drop_;
+  this->drop_head_.store(head + 1, std::memory_order_release);
+  this->pending_drop_ = DropRecord{};
+}
+
+bool UDPAudioStreamer::send_chunk_(TickType_t ticks_to_wait) {
+  pcm_utils::SpscRing *ring = this->ring_.get();
+  if (ring == nullptr || this->send_buffer_size_ == 0) {
+    return false;
+  }
+
+  const bool writable = this->transport_ != TRANSPORT_TCP ||
+                        this->service_connections_();
+
+  if (this->vad_enabled_ && !this->apply_vad_gate_(ring)) {
+    // Gated: sleep until more audio arrives so the sender task doesn't spin.
+    if (ticks_to_wait > 0) {
+      ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+    }
+    return false;
+  }
+
+  if (this->overflow_policy_ == OVERFLOW_POLICY_DROP_OLDEST) {
+    this->trim_backlog_(ring);
+  }
+
+  if (!writable) {
+    // Every connection is down or still full: keep the audio queued in the
+    // ring, where the overflow policy bounds the backlog, and send it once
+    // a connection can take it again.
+    this->backpressure_ = true;
+    if (ticks_to_wait > 0) {
+      vTaskDelay(ticks_to_wait);
+    }
+    return false;
+  }
+
+  const size_t chunk_size = this->chunk_size_.load(std::memory_order_relaxed);
+  if (ring->available() < chunk_size) {
+    if (ticks_to_wait == 0) {
+      return false;
+    }
+    // The microphone callback notifies the sender task once a full chunk is
+    // queued; the timeout bounds the wait if it never does.
+    ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+    if (ring->available() < chunk_size) {
+      return false;
+    }
+  }
+
+  // Borrow the chunk straight out of ring storage; the producer never touches
+  // queued bytes, so they can be byte-swapped and sent in place. A chunk that
+  // wraps comes back as two regions, which PCM gathers as-is. Encoders need
+  // contiguous input, and a wrap can split a 24-bit frame, so those cases
+  // copy into send_buffer_ instead.
+  const size_t chunk_position = ring->read_position();
+  uint8_t *first = nullptr;
+  uint8_t *second = nullptr;
+  size_t first_len = 0;
+  size_t second_len = 0;
+  ring->peek(chunk_size, &first, &first_len, &second, &second_len);
+  bool consumed = false;
+  if (second_len > 0 &&
+      (this->codec_ != PACKET_CODEC_PCM ||
+       first_len % this->audio_stream_info_.frames_to_bytes(1) != 0)) {
+    uint8_t *copy = this->send_buffer_ + this->header_size_;
+    std::memcpy(copy, first, first_len);
+    std::memcpy(copy + first_len, second, second_len);
+    ring->consume(chunk_size);
+    consumed = true;
+    first = copy;
+    first_len = chunk_size;
+    second_len = 0;
+  }
+
+  const uint8_t *wire_payload = first;
+  size_t wire_size = first_len;
+  if (this->codec_ != PACKET_CODEC_PCM) {
+    wire_size = this->encode_payload_(first, chunk_size);
+    wire_payload = this->codec_buffer_;
+    if (!consumed) {
+      ring->consume(chunk_size);
+      consumed = true;
+    }
+  } else if (this->swap_payload_) {
+    const size_t bytes_per_sample =
+        this->audio_stream_info_.get_bytes_per_sample();
+    const uint8_t bits = this->audio_stream_info_.get_bits_per_sample();
+    pcm_utils::swap_bytes(first, first_len / bytes_per_sample, bits);
+    pcm_utils::swap_bytes(second, second_len / bytes_per_sample, bits);
+  }
+
+  size_t header_length = 0;
+  if (this->header_size_ > 0) {
+    header_length = this->write_packet_header_(
+        this->audio_stream_info_.bytes_to_frames(chunk_size), chunk_position);
+  }
+
+  struct iovec iov[3];
+  int iovcnt = 0;
+  if (header_length > 0) {
+    iov[iovcnt].iov_base = this->send_buffer_;
+    iov[iovcnt].iov_len = header_length;
+    iovcnt++;
+  }
+  iov[iovcnt].iov_base = const_cast<uint8_t *>(wire_payload);
+  iov[iovcnt].iov_len = wire_size;
+  iovcnt++;
+  if (second_len > 0 && !consumed) {
+    iov[iovcnt].iov_base = second;
+    iov[iovcnt].iov_len = second_len;
+    iovcnt++;
+    wire_size += second_len;
+  }
+
+  const size_t packet_size = header_length + wire_size;
+  this->backpressure_ = false;
+  this->frame_skipped_ = false;
+  size_t delivered = this->send_to_all_(iov, iovcnt, packet_size);
+  if (this->frame_skipped_) {
+    // A connected destination missed this chunk; its receiver sees a gap in
+    // the frame counter, so count the audio as dropped.
+    this->bytes_dropped_total_.fetch_add(chunk_size,
+                                         std::memory_order_relaxed);
+  }
+  if (this->parity_buffer_ != nullptr) {
+    // Include the packet even if no destination took it: the receiver may
+    // then rebuild it from the parity.
+    this->add_to_parity_(iov, iovcnt, packet_size);
+  }
+  if (!consumed) {
+    ring->consume(chunk_size);
+  }
+  if (this->adaptive_) {
+    this->adapt_chunk_size_(ring->available());
+  }
+  if (delivered == 0) {
+    return false;
+  }
+
+  this->last_send_us_ = esp_timer_get_time();
+  this->last_packet_size_.store(packet_size, std::memory_order_relaxed);
+  this->bytes_since_log_.fetch_add(packet_size * delivered,
+                                   std::memory_order_relaxed);
+  this->packets_since_log_.fetch_add(1, std::memory_order_relaxed);
+  this->packets_sent_total_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void UDPAudioStreamer::add_to_parity_(const struct iovec *iov, int iovcnt,
+                                      size_t packet_size) {
+  uint8_t *body =
+      this->parity_buffer_ + PACKET_HEADER_SIZE + FEC_DESCRIPTOR_SIZE;
+  if (this->parity_count_ == 0) {
+    std::memset(body, 0, this->parity_buffer_size_ - PACKET_HEADER_SIZE -
+                             FEC_DESCRIPTOR_SIZE);
+    this->parity_length_xor_ = 0;
+    this->parity_length_ = 0;
+    this->parity_first_sequence_ = this->sequence_ - 1;
+    this->parity_first_frame_ = static_cast<uint32_t>(
+        this->stream_frame_ -
+        this->audio_stream_info_.bytes_to_frames(
+            this->chunk_size_.load(std::memory_order_relaxed)));
+  }
+
+  size_t offset = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    xor_into(body + offset, static_cast<const uint8_t *>(iov[i].iov_base),
+             iov[i].iov_len);
+    offset += iov[i].iov_len;
+  }
+  this->parity_length_xor_ ^= static_cast<uint16_t>(packet_size);
+  if (packet_size > this->parity_length_) {
+    this->parity_length_ = packet_size;
+  }
+
+  if (++this->parity_count_ >= this->fec_group_size_) {
+    this->send_parity_();
+  }
+}
+
+void UDPAudioStreamer::send_parity_() {
+  if (this->parity_count_ == 0) {
     return;
   }
 
-  size_t available = ring->available();
-  while (available >= this->send_buffer_size_) {
-    size_t read_bytes =
-        ring->read(this->send_buffer_, this->send_buffer_size_, 0);
-    if (read_bytes == 0) {
-      break;
+  PacketHeader header;
+  header.flags = PACKET_FLAG_PARITY;
+  header.codec = this->codec_;
+  header.channels = this->audio_stream_info_.get_channels();
+  header.bits_per_sample = this->audio_stream_info_.get_bits_per_sample();
+  header.sequence = this->parity_first_sequence_;
+  header.frame_counter = this->parity_first_frame_;
+  header.capture_time_us =
+      this->estimate_capture_time_us_(this->parity_first_frame_);
+  header.sample_rate = this->audio_stream_info_.get_sample_rate();
+  encode_packet_header(header, this->parity_buffer_);
+  encode_fec_descriptor(this->parity_count_, this->parity_length_xor_,
+                        this->parity_buffer_ + PACKET_HEADER_SIZE);
+
+  struct iovec iov;
+  iov.iov_base = this->parity_buffer_;
+  iov.iov_len = PACKET_HEADER_SIZE + FEC_DESCRIPTOR_SIZE + this->parity_length_;
+  if (this->send_to_all_(&iov, 1, iov.iov_len) > 0) {
+    this->bytes_since_log_.fetch_add(iov.iov_len, std::memory_order_relaxed);
+    this->parity_packets_since_log_.fetch_add(1, std::memory_order_relaxed);
+  }
+  this->parity_count_ = 0;
+}
+
+void UDPAudioStreamer::trim_backlog_(pcm_utils::SpscRing *ring) {
+  size_t queued = ring->available();
+  if (queued <= this->max_latency_bytes_) {
+    return;
+  }
+  // Skip whole frames from the head; the header frame counter jumps over
+  // them, so receivers see a gap rather than growing latency.
+  size_t excess = queued - this->max_latency_bytes_;
+  excess -= excess % this->audio_stream_info_.frames_to_bytes(1);
+  ring->consume(excess);
+  this->stream_frame_ += this->audio_stream_info_.bytes_to_frames(excess);
+  this->bytes_dropped_total_.fetch_add(excess, std::memory_order_relaxed);
+}
+
+void UDPAudioStreamer::wait_for_room_(pcm_utils::SpscRing *ring, size_t len) {
+  // Runs in the microphone's context, so this stalls capture: keep it short
+  // and poke the sender so it drains meanwhile.
+  const uint32_t start = millis();
+  while (ring->free() < len && millis() - start < this->block_timeout_ms_) {
+    if (this->task_handle_ != nullptr) {
+      xTaskNotifyGive(this->task_handle_);
     }
+    vTaskDelay(1);
+  }
+}
 
-    if (this->audio_stream_info_.get_bits_per_sample() == 16) {
-      for (size_t i = 0; i + 1 < read_bytes; i += 2) {
-        std::swap(this->send_buffer_[i], this->send_buffer_[i + 1]);
+size_t UDPAudioStreamer::send_to_all_(const struct iovec *iov, int iovcnt,
+                                      size_t packet_size) {
+  // The packet is encoded once; only the send is repeated per destination.
+  // A failing destination is reported but does not hold back the others.
+  size_t delivered = 0;
+  for (auto &destination : this->destinations_) {
+    if (this->transport_ == TRANSPORT_TCP) {
+      if (this->send_frame_(destination, iov, iovcnt, packet_size)) {
+        delivered++;
       }
+      continue;
     }
-
-    ssize_t sent = this->socket_->sendto(
-        this->send_buffer_, read_bytes, 0,
-        reinterpret_cast<struct sockaddr *>(&this->dest_addr_),
-        sizeof(this->dest_addr_));
+    ssize_t sent = destination.socket->writev(iov, iovcnt);
     if (sent < 0) {
-      if (!this->status_has_warning()) {
-        ESP_LOGW(TAG, "sendto failed: errno=%d", errno);
+      int error = errno;
+      if (is_would_block(error)) {
+        this->backpressure_ = true;
       }
-      this->status_set_warning();
-      break;
+      this->send_error_.store(error != 0 ? error : EIO,
+                              std::memory_order_relaxed);
+      this->send_errors_total_.fetch_add(1, std::memory_order_relaxed);
+    } else if (static_cast<size_t>(sent) != packet_size) {
+      this->send_error_.store(SEND_ERROR_PARTIAL, std::memory_order_relaxed);
+      this->send_errors_total_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      delivered++;
+    }
+  }
+  return delivered;
+}
+
+bool UDPAudioStreamer::service_connections_() {
+  const uint32_t now = millis();
+  bool writable = false;
+  for (auto &destination : this->destinations_) {
+    if (destination.socket == nullptr) {
+      if (static_cast<int32_t>(now - destination.retry_at_ms) < 0) {
+        continue;
+      }
+      this->open_connection_(destination);
+      if (destination.socket == nullptr) {
+        continue;
+      }
+    }
+
+    if (!destination.connected) {
+      if (!poll_writable(destination.socket.get())) {
+        if (now - destination.connect_started_ms >= TCP_CONNECT_TIMEOUT_MS) {
+          this->close_connection_(destination, ETIMEDOUT);
+        }
+        continue;
+      }
+      int error = 0;
+      socklen_t len = sizeof(error);
+      if (destination.socket->getsockopt(SOL_SOCKET, SO_ERROR, &error, &len) !=
+          0) {
+        error = errno;
+      }
+      if (error != 0) {
+        this->close_connection_(destination, error);
+        continue;
+      }
+      destination.connected = true;
+      destination.backoff_ms = 0;
+      ESP_LOGI(TAG, "Connected to %s:%u over TCP", destination.host.c_str(),
+               destination.port);
+    }
+
+    // Only promise the next frame to a connection with room for it: one
+    // that would block has to skip the frame once the chunk is consumed.
+    destination.writable = this->flush_pending_(destination) &&
+                           poll_writable(destination.socket.get());
+    if (destination.writable) {
+      writable = true;
+    }
+  }
+  return writable;
+}
+
+void UDPAudioStreamer::open_connection_(Destination &destination) {
+  destination.connect_started_ms = millis();
+  auto sock = socket::socket_ip(SOCK_STREAM, IPPROTO_TCP);
+  if (sock == nullptr) {
+    this->close_connection_(destination, errno);
+    return;
+  }
+  destination.socket = std::move(sock);
+  if (destination.socket->setblocking(false) != 0) {
+    this->close_connection_(destination, errno);
+    return;
+  }
+
+  // Frames are written whole and should leave at once; Nagle would hold
+  // each one back waiting for the previous ACK.
+  int one = 1;
+  if (destination.socket->setsockopt(IPPROTO_TCP, TCP_NODELAY, &one,
+                                     sizeof(one)) != 0) {
+    ESP_LOGW(TAG, "Failed to disable Nagle for %s: errno=%d",
+             destination.host.c_str(), errno);
+  }
+
+  if (destination.socket->connect(
+          reinterpret_cast<struct sockaddr *>(&destination.addr),
+          destination.addr_len) != 0 &&
+      errno != EINPROGRESS) {
+    this->close_connection_(destination, errno);
+  }
+}
+
+void UDPAudioStreamer::close_connection_(Destination &destination,
+                                         int error) {
+  const bool was_connected = destination.connected;
+  destination.socket.reset();
+  destination.connected = false;
+  destination.writable = false;
+  // A partly sent frame can't be finished on a new connection, which must
+  // start on a frame boundary; its unsent tail counts as dropped.
+  this->bytes_dropped_total_.fetch_add(
+      destination.pending.size() - destination.pending_offset,
+      std::memory_order_relaxed);
+  destination.pending.clear();
+  destination.pending_offset = 0;
+
+  destination.backoff_ms =
+      destination.backoff_ms == 0
+          ? TCP_BACKOFF_MIN_MS
+          : std::min(destination.backoff_ms * 2, TCP_BACKOFF_MAX_MS);
+  destination.retry_at_ms = millis() + destination.backoff_ms;
+
+  if (was_connected) {
+    this->reconnects_total_.fetch_add(1, std::memory_order_relaxed);
+    ESP_LOGW(TAG, "Connection to %s:%u lost: errno=%d",
+             destination.host.c_str(), destination.port, error);
+  } else {
+    ESP_LOGD(TAG, "Connecting to %s:%u failed: errno=%d; retrying in %u ms",
+             destination.host.c_str(), destination.port, error,
+             destination.backoff_ms);
+  }
+  this->send_error_.store(error != 0 ? error : EIO, std::memory_order_relaxed);
+}
+
+bool UDPAudioStreamer::send_frame_(Destination &destination,
+                                   const struct iovec *iov, int iovcnt,
+                                   size_t packet_size) {
+  if (!destination.connected) {
+    return false;
+  }
+  if (!destination.writable || !destination.pending.empty()) {
+    this->frame_skipped_ = true;
+    return false;
+  }
+
+  uint8_t prefix[STREAM_FRAME_PREFIX_SIZE] = {
+      static_cast<uint8_t>(packet_size >> 8),
+      static_cast<uint8_t>(packet_size)};
+  struct iovec frame[4];
+  frame[0].iov_base = prefix;
+  frame[0].iov_len = sizeof(prefix);
+  for (int i = 0; i < iovcnt; i++) {
+    frame[i + 1] = iov[i];
+  }
+  const size_t frame_size = sizeof(prefix) + packet_size;
+
+  ssize_t sent = destination.socket->writev(frame, iovcnt + 1);
+  if (sent < 0) {
+    int error = errno;
+    if (is_would_block(error)) {
+      // Nothing was written, so the stream is still on a frame boundary;
+      // this frame is skipped for this destination only.
+      destination.writable = false;
+      this->backpressure_ = true;
+      this->frame_skipped_ = true;
+      return false;
     }
-    if (static_cast<size_t>(sent) != read_bytes) {
-      if (!this->status_has_warning()) {
-        ESP_LOGW(TAG, "Partial UDP write: %d/%zu bytes", static_cast<int>(sent),
-                 read_bytes);
+    this->send_errors_total_.fetch_add(1, std::memory_order_relaxed);
+    this->close_connection_(destination, error);
+    return false;
+  }
+
+  if (static_cast<size_t>(sent) < frame_size) {
+    // Keep the unsent tail; the gathered regions go back to the ring as
+    // soon as this returns. Capacity was reserved, so this doesn't allocate.
+    size_t skip = sent;
+    for (int i = 0; i <= iovcnt; i++) {
+      const auto *base = static_cast<const uint8_t *>(frame[i].iov_base);
+      if (skip >= frame[i].iov_len) {
+        skip -= frame[i].iov_len;
+        continue;
       }
-      this->status_set_warning();
+      destination.pending.insert(destination.pending.end(), base + skip,
+                                 base + frame[i].iov_len);
+      skip = 0;
+    }
+    destination.pending_offset = 0;
+    this->backpressure_ = true;
+  }
+  return true;
+}
+
+bool UDPAudioStreamer::flush_pending_(Destination &destination) {
+  if (destination.pending.empty()) {
+    return true;
+  }
+  ssize_t sent = destination.socket->write(
+      destination.pending.data() + destination.pending_offset,
+      destination.pending.size() - destination.pending_offset);
+  if (sent < 0) {
+    int error = errno;
+    if (!is_would_block(error)) {
+      this->send_errors_total_.fetch_add(1, std::memory_order_relaxed);
+      this->close_connection_(destination, error);
+    }
+    return false;
+  }
+  destination.pending_offset += sent;
+  if (destination.pending_offset < destination.pending.size()) {
+    return false;
+  }
+  destination.pending.clear();
+  destination.pending_offset = 0;
+  return true;
+}
+
+bool UDPAudioStreamer::apply_vad_gate_(pcm_utils::SpscRing *ring) {
+  if (this->gate_open_.load(std::memory_order_acquire)) {
+    return true;
+  }
+
+  // Close out a partial FEC group so its last packets stay recoverable.
+  if (this->parity_buffer_ != nullptr) {
+    this->send_parity_();
+  }
+
+  // Keep the most recent pre_roll_bytes_ queued so the onset of speech is
+  // sent once the gate opens; everything older is discarded unsent.
+  const size_t frame_size = this->audio_stream_info_.frames_to_bytes(1);
+  size_t available = ring->available();
+  if (available > this->pre_roll_bytes_ +
+                      this->chunk_size_.load(std::memory_order_relaxed)) {
+    size_t excess = available - this->pre_roll_bytes_;
+    excess -= excess % frame_size;
+    ring->consume(excess);
+    this->stream_frame_ += this->audio_stream_info_.bytes_to_frames(excess);
+  }
+
+  int64_t now = esp_timer_get_time();
+  if (this->keepalive_interval_ms_ > 0 &&
+      now - this->last_send_us_ >=
+          static_cast<int64_t>(this->keepalive_interval_ms_) * 1000) {
+    this->send_keepalive_();
+    this->last_send_us_ = now;
+  }
+  return false;
+}
+
+void UDPAudioStreamer::send_keepalive_() {
+  struct iovec iov;
+  iov.iov_base = this->send_buffer_;
+  iov.iov_len = 0;
+  if (this->header_size_ == 0) {
+    // Without a header a keepalive is simply an empty datagram.
+    this->send_to_all_(&iov, 1, 0);
+    return;
+  }
+
+  PacketHeader header;
+  header.flags = PACKET_FLAG_KEEPALIVE;
+  header.codec = this->codec_;
+  header.channels = this->audio_stream_info_.get_channels();
+  header.bits_per_sample = this->audio_stream_info_.get_bits_per_sample();
+  // Keepalives carry the next audio sequence number without consuming it.
+  header.sequence = this->sequence_;
+  header.frame_counter = static_cast<uint32_t>(this->stream_frame_);
+  header.capture_time_us =
+      this->estimate_capture_time_us_(header.frame_counter);
+  header.sample_rate = this->audio_stream_info_.get_sample_rate();
+  // Keep anchoring while gated, so the clock estimate stays warm.
+  this->add_clock_anchor_(header);
+  iov.iov_len = encode_packet_header(header, this->send_buffer_);
+  this->send_to_all_(&iov, 1, iov.iov_len);
+}
+
+size_t UDPAudioStreamer::encode_payload_(const uint8_t *pcm, size_t size) {
+  const uint32_t start_us = static_cast<uint32_t>(esp_timer_get_time());
+  const size_t samples = size / sizeof(int16_t);
+  size_t encoded = 0;
+  switch (this->codec_) {
+  case PACKET_CODEC_ULAW:
+    encoded = pcm_utils::encode_ulaw(pcm, this->codec_buffer_, samples);
+    break;
+  case PACKET_CODEC_IMA_ADPCM:
+    encoded = pcm_utils::ima_adpcm_encode_block(
+        this->adpcm_states_, this->audio_stream_info_.get_channels(), pcm,
+        this->audio_stream_info_.bytes_to_frames(size), this->codec_buffer_);
+    break;
+  default:
+    break;
+  }
+  this->encode_us_since_log_.fetch_add(
+      static_cast<uint32_t>(esp_timer_get_time()) - start_us,
+      std::memory_order_relaxed);
+  return encoded;
+}
+
+size_t UDPAudioStreamer::write_packet_header_(uint32_t frames,
+                                              size_t ring_position) {
+  // Frames the ring dropped on overflow were never sent; once this chunk
+  // starts at or past a gap, skip the stream position over it so receivers
+  // see the gap where it happened.
+  const uint32_t head = this->drop_head_.load(std::memory_order_acquire);
+  uint32_t tail = this->drop_tail_.load(std::memory_order_relaxed);
+  while (tail != head) {
+    const DropRecord &drop = this->drop_records_[tail % DROP_RECORD_SLOTS];
+    if (ring_position - drop.position > SIZE_MAX / 2) {
       break;
     }
-    this->status_clear_warning();
+    this->stream_frame_ += drop.frames;
+    tail++;
+  }
+  this->drop_tail_.store(tail, std::memory_order_release);
+
+  PacketHeader header;
+  header.flags = this->swap_payload_ ? 0 : PACKET_FLAG_LITTLE_ENDIAN;
+  header.codec = this->codec_;
+  header.channels = this->audio_stream_info_.get_channels();
+  header.bits_per_sample = this->audio_stream_info_.get_bits_per_sample();
+  header.sequence = this->sequence_++;
+  header.frame_counter = static_cast<uint32_t>(this->stream_frame_);
+  header.capture_time_us =
+      this->estimate_capture_time_us_(header.frame_counter);
+  header.sample_rate = this->audio_stream_info_.get_sample_rate();
+  this->add_clock_anchor_(header);
+  size_t length = encode_packet_header(header, this->send_buffer_);
+
+  this->stream_frame_ += frames;
+  return length;
+}
+
+void UDPAudioStreamer::add_clock_anchor_(PacketHeader &header) {
+  if (this->anchor_interval_ms_ == 0) {
+    return;
+  }
+  const int64_t now = esp_timer_get_time();
+  if (this->last_anchor_us_ != 0 &&
+      now - this->last_anchor_us_ <
+          static_cast<int64_t>(this->anchor_interval_ms_) * 1000) {
+    return;
+  }
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < MIN_VALID_EPOCH) {
+    return; // no time source has set the clock yet
+  }
+
+  // Walk the wall clock back to the capture time of the header's first
+  // frame; over so short a lag the two clocks agree.
+  const uint32_t lag_us = static_cast<uint32_t>(now) - header.capture_time_us;
+  header.flags |= PACKET_FLAG_ANCHOR;
+  header.frame_counter_high = static_cast<uint32_t>(this->stream_frame_ >> 32);
+  header.wall_time_us = static_cast<uint64_t>(tv.tv_sec) * 1000000ULL +
+                        static_cast<uint64_t>(tv.tv_usec) - lag_us;
+  this->last_anchor_us_ = now;
+}
+
+size_t UDPAudioStreamer::max_chunk_for_packet_size_() const {
+  const size_t channels = this->audio_stream_info_.get_channels();
+  // A parity packet wraps the longest datagram of its group in a header and
+  // descriptor of its own, so with FEC it is the one that must fit.
+  size_t overhead = this->header_size_;
+  if (this->fec_group_size_ > 0) {
+    overhead += PACKET_HEADER_SIZE + FEC_DESCRIPTOR_SIZE;
+  }
+  if (this->max_packet_size_ <= overhead || channels == 0) {
+    return 0;
+  }
+  const size_t payload_limit = this->max_packet_size_ - overhead;
+  size_t frames = 0;
+  switch (this->codec_) {
+  case PACKET_CODEC_ULAW:
+    frames = payload_limit / channels;
+    break;
+  case PACKET_CODEC_IMA_ADPCM: {
+    const size_t headers = channels * pcm_utils::IMA_ADPCM_CHANNEL_HEADER_SIZE;
+    frames = payload_limit > headers
+                 ? ((payload_limit - headers) * 2) / channels
+                 : 0;
+    break;
+  }
+  default:
+    frames = this->audio_stream_info_.bytes_to_frames(payload_limit);
+    break;
+  }
+  return this->audio_stream_info_.frames_to_bytes(frames);
+}
+
+void UDPAudioStreamer::adapt_chunk_size_(size_t queued) {
+  const size_t current = this->chunk_size_.load(std::memory_order_relaxed);
+  const size_t frame_size = this->audio_stream_info_.frames_to_bytes(1);
+  const int64_t now = esp_timer_get_time();
+
+  if (this->backpressure_ ||
+      queued >= this->ring_buffer_size_ / ADAPT_GROW_DIVISOR) {
+    // Fewer, larger datagrams cost less per byte in lwIP and the driver.
+    size_t grown = current + current / 2;
+    grown -= grown % frame_size;
+    if (grown > this->send_buffer_size_) {
+      grown = this->send_buffer_size_;
+    }
+    this->chunk_size_.store(grown, std::memory_order_relaxed);
+    this->adapt_clear_since_us_ = now;
+    return;
+  }
+
+  if (queued > this->ring_buffer_size_ / ADAPT_CLEAR_DIVISOR) {
+    this->adapt_clear_since_us_ = now;
+    return;
+  }
+
+  if (current > this->min_chunk_size_ &&
+      now - this->adapt_clear_since_us_ >= ADAPT_SHRINK_INTERVAL_US) {
+    size_t step = this->min_chunk_size_ / 2;
+    step -= step % frame_size;
+    if (step == 0) {
+      step = frame_size;
+    }
+    size_t shrunk = current > this->min_chunk_size_ + step
+                        ? current - step
+                        : this->min_chunk_size_;
+    this->chunk_size_.store(shrunk, std::memory_order_relaxed);
+    this->adapt_clear_since_us_ = now;
+  }
+}
+
+TickType_t UDPAudioStreamer::chunk_period_() const {
+  TickType_t period = pdMS_TO_TICKS(this->audio_stream_info_.bytes_to_ms(
+      this->chunk_size_.load(std::memory_order_relaxed)));
+  return period == 0 ? 1 : period;
+}
+
+void UDPAudioStreamer::publish_sensors_() {
+#ifdef USE_SENSOR
+  uint32_t now = millis();
+  if (now - this->last_sensor_publish_ms_ < SENSOR_PUBLISH_INTERVAL_MS) {
+    return;
+  }
+  this->last_sensor_publish_ms_ = now;
+
+  if (this->chunk_size_sensor_ != nullptr) {
+    float chunk = this->chunk_size_.load(std::memory_order_relaxed);
+    if (!this->chunk_size_sensor_->has_state() ||
+        this->chunk_size_sensor_->get_raw_state() != chunk) {
+      this->chunk_size_sensor_->publish_state(chunk);
+    }
+  }
+
+  pcm_utils::SpscRing *ring = this->ring_.get();
+  if (this->ring_occupancy_sensor_ != nullptr && ring != nullptr &&
+      this->ring_buffer_size_ > 0) {
+    this->ring_occupancy_sensor_->publish_state(
+        100.0f * ring->available() / this->ring_buffer_size_);
+  }
+  if (this->ring_high_water_sensor_ != nullptr && this->ring_buffer_size_ > 0) {
+    float high_water =
+        100.0f * this->ring_high_water_.load(std::memory_order_relaxed) /
+        this->ring_buffer_size_;
+    if (!this->ring_high_water_sensor_->has_state() ||
+        this->ring_high_water_sensor_->get_raw_state() != high_water) {
+      this->ring_high_water_sensor_->publish_state(high_water);
+    }
+  }
+
+  publish_counter(this->bytes_dropped_sensor_,
+                  this->bytes_dropped_total_.load(std::memory_order_relaxed));
+  publish_counter(this->packets_sent_sensor_,
+                  this->packets_sent_total_.load(std::memory_order_relaxed));
+  publish_counter(this->send_errors_sensor_,
+                  this->send_errors_total_.load(std::memory_order_relaxed));
+  publish_counter(this->reconnects_sensor_,
+                  this->reconnects_total_.load(std::memory_order_relaxed));
+#endif
+}
+
+uint32_t UDPAudioStreamer::estimate_capture_time_us_(uint32_t frame) const {
+  // The newest captured frame arrived at last_capture_us_; walk back by the
+  // number of frames still queued behind the requested one.
+  uint32_t captured = this->frames_captured_.load(std::memory_order_relaxed);
+  uint32_t newest_us = this->last_capture_us_.load(std::memory_order_relaxed);
+  uint32_t sample_rate = this->audio_stream_info_.get_sample_rate();
+  if (sample_rate == 0) {
+    return newest_us;
+  }
+  uint32_t lag_frames = captured - frame;
+  uint64_t lag_us = (static_cast<uint64_t>(lag_frames) * 1000000ULL) /
+                    static_cast<uint64_t>(sample_rate);
+  return newest_us - static_cast<uint32_t>(lag_us);
+}
+
+void UDPAudioStreamer::update_status_() {
+  if (this->vad_enabled_) {
+    bool open = this->gate_open_.load(std::memory_order_relaxed);
+    if (open != this->gate_logged_open_) {
+      ESP_LOGD(TAG, "Voice activity %s (energy %u)", open ? "started" : "ended",
+               this->vad_.get_last_energy());
+      this->gate_logged_open_ = open;
+    }
+  }
+
+  int error = this->send_error_.exchange(0, std::memory_order_relaxed);
+  if (error != 0) {
+    if (!this->status_has_warning()) {
+      if (error == SEND_ERROR_PARTIAL) {
+        ESP_LOGW(TAG, "Partial UDP write of %zu byte packet",
+                 this->last_packet_size_.load(std::memory_order_relaxed));
+      } else {
+        ESP_LOGW(TAG, "%s send failed: errno=%d",
+                 this->transport_ == TRANSPORT_TCP ? "TCP" : "UDP", error);
+      }
+    }
+    this->status_set_warning();
+  }
+
+  uint32_t now = millis();
+  if (this->last_rate_log_ms_ == 0) {
+    this->last_rate_log_ms_ = now;
+  }
+  uint32_t elapsed = now - this->last_rate_log_ms_;
+  uint32_t packets = this->packets_since_log_.load(std::memory_order_relaxed);
+
+  if (packets > 0) {
+    if (error == 0) {
+      this->status_clear_warning();
+    }
     if (!this->streaming_logged_) {
-      ESP_LOGI(TAG, "Streaming audio packets (%zu bytes) to %s:%u", read_bytes,
-               this->host_.c_str(), this->port_);
+      ESP_LOGI(TAG, "Streaming audio packets (%zu bytes) to %zu destination(s)",
+               this->last_packet_size_.load(std::memory_order_relaxed),
+               this->destinations_.size());
       this->streaming_logged_ = true;
     }
-    this->bytes_since_log_ += read_bytes;
-    this->packets_since_log_ += 1;
-    uint32_t now = millis();
-    if (this->last_rate_log_ms_ == 0) {
-      this->last_rate_log_ms_ = now;
+  }
+
+  if ((elapsed >= 1000) && (packets > 0)) {
+    uint32_t bytes =
+        this->bytes_since_log_.exchange(0, std::memory_order_relaxed);
+    packets = this->packets_since_log_.exchange(0, std::memory_order_relaxed);
+    uint32_t bytes_per_sec = (bytes * 1000U) / elapsed;
+    ESP_LOGD(TAG, "Throughput: %u B/s across %u packets", bytes_per_sec,
+             packets);
+    uint32_t encode_us =
+        this->encode_us_since_log_.exchange(0, std::memory_order_relaxed);
+    if (this->codec_ != PACKET_CODEC_PCM) {
+      ESP_LOGD(TAG, "Encoder: %u us per packet", encode_us / packets);
+    }
+    uint32_t parity_packets =
+        this->parity_packets_since_log_.exchange(0, std::memory_order_relaxed);
+    if (this->fec_group_size_ > 0) {
+      ESP_LOGD(TAG, "FEC: %u parity packets", parity_packets);
+    }
+    uint32_t dropped =
+        this->bytes_dropped_total_.load(std::memory_order_relaxed);
+    if (dropped != this->dropped_logged_) {
+      ESP_LOGW(TAG, "Dropped %u bytes of audio (%s)",
+               dropped - this->dropped_logged_,
+               overflow_policy_to_string(this->overflow_policy_));
+      this->dropped_logged_ = dropped;
+    }
+    this->last_rate_log_ms_ = now;
+  }
+
+  this->publish_sensors_();
+}
+
+bool UDPAudioStreamer::start_sender_task_() {
+  if (this->task_handle_ != nullptr) {
+    return true;
+  }
+
+  BaseType_t core = this->task_core_;
+  if (core < 0 || core >= portNUM_PROCESSORS) {
+    core = tskNO_AFFINITY;
+  }
+  BaseType_t result = xTaskCreatePinnedToCore(
+      UDPAudioStreamer::sender_task_, "udp_audio_tx", this->task_stack_size_,
+      this, this->task_priority_, &this->task_handle_, core);
+  if (result != pdPASS) {
+    this->task_handle_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void UDPAudioStreamer::sender_task_(void *params) {
+  static_cast<UDPAudioStreamer *>(params)->run_sender_task_();
+}
+
+void UDPAudioStreamer::run_sender_task_() {
+  TickType_t next_wake = xTaskGetTickCount();
+
+  while (true) {
+    // Re-read each pass: adaptive chunking changes the cadence.
+    const TickType_t period = this->chunk_period_();
+
+    if (!this->transport_ready_.load(std::memory_order_acquire)) {
+      vTaskDelay(period);
+      next_wake = xTaskGetTickCount();
+      continue;
+    }
+
+    // Wait for up to one chunk period for a full chunk; a partial one stays
+    // queued in the ring until the next pass.
+    if (!this->send_chunk_(period)) {
+      next_wake = xTaskGetTickCount();
+      continue;
     }
-    uint32_t elapsed = now - this->last_rate_log_ms_;
-    if ((elapsed >= 1000) && (this->bytes_since_log_ > 0)) {
-      uint32_t bytes_per_sec = (this->bytes_since_log_ * 1000U) / elapsed;
-      ESP_LOGD(TAG, "Throughput: %u B/s across %u packets", bytes_per_sec,
-               this->packets_since_log_);
-      this->bytes_since_log_ = 0;
-      this->packets_since_log_ = 0;
-      this->last_rate_log_ms_ = now;
+
+    // With a backlog (e.g. after the microphone delivered a burst) send
+    // immediately to catch up; otherwise hold to the chunk cadence.
+    pcm_utils::SpscRing *ring = this->ring_.get();
+    if (ring != nullptr &&
+        ring->available() >=
+            this->chunk_size_.load(std::memory_order_relaxed) * 2) {
+      next_wake = xTaskGetTickCount();
+      continue;
     }
-    available = ring->available();
+    vTaskDelayUntil(&next_wake, period);
   }
 }
 
 void UDPAudioStreamer::dump_config() {
   ESP_LOGCONFIG(TAG, "UDP Audio Streamer:");
-  ESP_LOGCONFIG(TAG, "  Destination: %s:%u", this->host_.c_str(), this->port_);
+  for (const auto &destination : this->destinations_) {
+    if (is_ipv4_multicast(destination.addr)) {
+      ESP_LOGCONFIG(TAG, "  Destination: %s:%u (multicast, TTL %u)",
+                    destination.host.c_str(), destination.port,
+                    destination.ttl);
+    } else {
+      ESP_LOGCONFIG(TAG, "  Destination: %s:%u", destination.host.c_str(),
+                    destination.port);
+    }
+  }
+  ESP_LOGCONFIG(TAG, "  Transport: %s",
+                this->transport_ == TRANSPORT_TCP
+                    ? "TCP (length-prefixed frames)"
+                    : "UDP");
   ESP_LOGCONFIG(TAG, "  Passive: %s", YESNO(this->passive_));
+  ESP_LOGCONFIG(TAG, "  Packet header: %s", YESNO(this->packet_header_));
+  ESP_LOGCONFIG(TAG, "  Codec: %s", codec_to_string(this->codec_));
+  if (this->vad_enabled_) {
+    ESP_LOGCONFIG(TAG, "  VAD: hangover %u ms, pre-roll %u ms, keepalive %u ms",
+                  this->vad_hangover_ms_, this->pre_roll_ms_,
+                  this->keepalive_interval_ms_);
+  }
+  ESP_LOGCONFIG(TAG, "  Wire byte order: %s",
+                this->byte_order_ == WIRE_BYTE_ORDER_LITTLE_ENDIAN
+                    ? "little-endian"
+                    : "big-endian");
   ESP_LOGCONFIG(TAG, "  Chunk duration: %u ms (%zu bytes)",
-                this->chunk_duration_ms_, this->send_buffer_size_);
+                this->chunk_duration_ms_, this->min_chunk_size_);
+  if (this->overflow_policy_ == OVERFLOW_POLICY_DROP_OLDEST) {
+    ESP_LOGCONFIG(TAG, "  Overflow policy: %s (max latency %u ms)",
+                  overflow_policy_to_string(this->overflow_policy_),
+                  this->audio_stream_info_.bytes_to_ms(
+                      this->max_latency_bytes_));
+  } else if (this->overflow_policy_ == OVERFLOW_POLICY_BLOCK) {
+    ESP_LOGCONFIG(TAG, "  Overflow policy: %s (up to %u ms)",
+                  overflow_policy_to_string(this->overflow_policy_),
+                  this->block_timeout_ms_);
+  } else {
+    ESP_LOGCONFIG(TAG, "  Overflow policy: %s",
+                  overflow_policy_to_string(this->overflow_policy_));
+  }
+  if (this->fec_group_size_ > 0) {
+    ESP_LOGCONFIG(TAG, "  FEC: XOR parity every %u packets",
+                  this->fec_group_size_);
+  }
+  if (this->anchor_interval_ms_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Clock anchors: every %u ms",
+                  this->anchor_interval_ms_);
+  }
+  if (this->adaptive_) {
+    ESP_LOGCONFIG(TAG, "  Adaptive chunk: up to %zu bytes (packet limit %u)",
+                  this->send_buffer_size_, this->max_packet_size_);
+  }
   ESP_LOGCONFIG(TAG, "  Buffer duration: %u ms (%zu bytes)",
                 this->buffer_duration_ms_, this->ring_buffer_size_);
+  if (this->use_task_) {
+    ESP_LOGCONFIG(TAG, "  Sender task: priority %u, core %d, stack %u bytes",
+                  this->task_priority_, this->task_core_,
+                  this->task_stack_size_);
+  } else {
+    ESP_LOGCONFIG(TAG, "  Sender task: disabled (sending from loop)");
+  }
   if (this->mic_source_ != nullptr) {
     const auto info = this->mic_source_->get_audio_stream_info();
     ESP_LOGCONFIG(TAG, "  Audio stream:");
@@ -210,22 +1354,52 @@ bool UDPAudioStreamer::allocate_buffers_() {
 
   if (!this->send_buffer_) {
     RAMAllocator<uint8_t> allocator;
-    this->send_buffer_ = allocator.allocate(this->send_buffer_size_);
+    this->send_buffer_ =
+        allocator.allocate(this->header_size_ + this->send_buffer_size_);
     if (this->send_buffer_ == nullptr) {
       ESP_LOGW(TAG, "Failed to allocate send buffer (%zu bytes)",
-               this->send_buffer_size_);
+               this->header_size_ + this->send_buffer_size_);
       return false;
     }
   }
 
-  if (this->ring_buffer_.use_count() == 0) {
-    auto buffer = RingBuffer::create(this->ring_buffer_size_);
-    if (!buffer) {
-      ESP_LOGW(TAG, "Failed to create ring buffer (%zu bytes)",
+  if (this->codec_buffer_size_ > 0 && !this->codec_buffer_) {
+    RAMAllocator<uint8_t> allocator;
+    this->codec_buffer_ = allocator.allocate(this->codec_buffer_size_);
+    if (this->codec_buffer_ == nullptr) {
+      ESP_LOGW(TAG, "Failed to allocate codec buffer (%zu bytes)",
+               this->codec_buffer_size_);
+      return false;
+    }
+  }
+
+  if (this->fec_group_size_ > 0 && !this->parity_buffer_) {
+    // Room for the parity header and descriptor plus one whole data packet.
+    size_t payload_max = this->send_buffer_size_;
+    if (this->codec_buffer_size_ > payload_max) {
+      payload_max = this->codec_buffer_size_;
+    }
+    this->parity_buffer_size_ = PACKET_HEADER_SIZE + FEC_DESCRIPTOR_SIZE +
+                                this->header_size_ + payload_max;
+    RAMAllocator<uint8_t> allocator;
+    this->parity_buffer_ = allocator.allocate(this->parity_buffer_size_);
+    if (this->parity_buffer_ == nullptr) {
+      ESP_LOGW(TAG, "Failed to allocate parity buffer (%zu bytes)",
+               this->parity_buffer_size_);
+      return false;
+    }
+  }
+
+  if (this->ring_ == nullptr) {
+    RAMAllocator<uint8_t> allocator;
+    this->ring_storage_ = allocator.allocate(this->ring_buffer_size_);
+    if (this->ring_storage_ == nullptr) {
+      ESP_LOGW(TAG, "Failed to allocate ring buffer (%zu bytes)",
                this->ring_buffer_size_);
       return false;
     }
-    this->ring_buffer_ = std::shared_ptr<RingBuffer>(std::move(buffer));
+    this->ring_ = std::make_unique<pcm_utils::SpscRing>(
+        this->ring_storage_, this->ring_buffer_size_);
     this->warned_full_ = false;
   }
 
@@ -235,36 +1409,79 @@ bool UDPAudioStreamer::allocate_buffers_() {
 void UDPAudioStreamer::deallocate_buffers_() {
   if (this->send_buffer_) {
     RAMAllocator<uint8_t> allocator;
-    allocator.deallocate(this->send_buffer_, this->send_buffer_size_);
+    allocator.deallocate(this->send_buffer_,
+                         this->header_size_ + this->send_buffer_size_);
     this->send_buffer_ = nullptr;
   }
 
-  if (this->ring_buffer_.use_count() > 0) {
-    this->ring_buffer_.reset();
+  if (this->codec_buffer_) {
+    RAMAllocator<uint8_t> allocator;
+    allocator.deallocate(this->codec_buffer_, this->codec_buffer_size_);
+    this->codec_buffer_ = nullptr;
+  }
+
+  if (this->parity_buffer_) {
+    RAMAllocator<uint8_t> allocator;
+    allocator.deallocate(this->parity_buffer_, this->parity_buffer_size_);
+    this->parity_buffer_ = nullptr;
+  }
+
+  this->ring_.reset();
+  if (this->ring_storage_) {
+    RAMAllocator<uint8_t> allocator;
+    allocator.deallocate(this->ring_storage_, this->ring_buffer_size_);
+    this->ring_storage_ = nullptr;
   }
 }
 
-bool UDPAudioStreamer::ensure_socket_() {
-  if (this->socket_ != nullptr) {
+bool UDPAudioStreamer::ensure_sockets_() {
+  if (this->transport_ == TRANSPORT_TCP) {
+    // Connections are opened, and reopened, by the sending context in
+    // service_connections_(), so they never race the sender task.
     return true;
   }
 
-  auto sock = socket::socket_ip(SOCK_DGRAM, IPPROTO_IP);
-  if (sock == nullptr) {
-    ESP_LOGW(TAG, "Failed to create UDP socket");
-    return false;
-  }
+  for (auto &destination : this->destinations_) {
+    if (destination.socket != nullptr) {
+      continue;
+    }
 
-  if (sock->setblocking(false) != 0) {
-    ESP_LOGW(TAG, "Failed to set socket non-blocking mode");
-    return false;
+    auto sock = socket::socket_ip(SOCK_DGRAM, IPPROTO_IP);
+    if (sock == nullptr) {
+      ESP_LOGW(TAG, "Failed to create UDP socket");
+      return false;
+    }
+
+    if (sock->setblocking(false) != 0) {
+      ESP_LOGW(TAG, "Failed to set socket non-blocking mode");
+      return false;
+    }
+
+    if (is_ipv4_multicast(destination.addr)) {
+      uint8_t ttl = destination.ttl;
+      if (sock->setsockopt(IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) !=
+          0) {
+        ESP_LOGW(TAG, "Failed to set multicast TTL for %s: errno=%d",
+                 destination.host.c_str(), errno);
+      }
+    }
+
+    // Connecting a datagram socket fixes the destination so packets can be
+    // gathered from the header and ring storage with writev().
+    if (sock->connect(reinterpret_cast<struct sockaddr *>(&destination.addr),
+                      destination.addr_len) != 0) {
+      ESP_LOGW(TAG, "Failed to connect UDP socket to %s:%u: errno=%d",
+               destination.host.c_str(), destination.port, errno);
+      return false;
+    }
+
+    destination.socket = std::move(sock);
   }
 
-  this->socket_ = std::move(sock);
-  if (!this->socket_logged_) {
-    ESP_LOGD(TAG, "UDP socket created for %s:%u", this->host_.c_str(),
-             this->port_);
-    this->socket_logged_ = true;
+  if (!this->sockets_logged_) {
+    ESP_LOGD(TAG, "UDP sockets created for %zu destination(s)",
+             this->destinations_.size());
+    this->sockets_logged_ = true;
   }
   return true;
 }
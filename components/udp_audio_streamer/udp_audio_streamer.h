@@ -4,19 +4,90 @@
 
 #ifdef USE_ESP32
 
+#include "packet_header.h"
+#include "voice_activity.h"
+
 #include "esphome/components/audio/audio.h"
+#include "esphome/components/pcm_utils/ima_adpcm.h"
+#include "esphome/components/pcm_utils/spsc_ring.h"
 #include "esphome/components/microphone/microphone_source.h"
 #include "esphome/components/socket/socket.h"
 #include "esphome/core/component.h"
-#include "esphome/core/ring_buffer.h"
 
+#ifdef USE_SENSOR
+#include "esphome/components/sensor/sensor.h"
+#endif
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace esphome {
 namespace udp_audio_streamer {
 
+enum WireByteOrder : uint8_t {
+  WIRE_BYTE_ORDER_BIG_ENDIAN,
+  WIRE_BYTE_ORDER_LITTLE_ENDIAN,
+};
+
+enum Transport : uint8_t {
+  TRANSPORT_UDP,
+  /// Length-prefixed frames over one TCP connection per destination.
+  TRANSPORT_TCP,
+};
+
+/// One receiver of the stream. Each destination gets its own connected
+/// socket so the same header and payload can be gathered to it with writev().
+struct Destination {
+  std::string host;
+  uint16_t port{0};
+  uint8_t ttl{1};
+  struct sockaddr_storage addr{};
+  // Length of the address in addr, as set_sockaddr() filled it in; lwIP
+  // rejects any other length.
+  socklen_t addr_len{0};
+  std::unique_ptr<socket::Socket> socket;
+
+  // TCP only, owned by the sending context.
+  bool connected{false};
+  // Set by service_connections_() when the connection can take the next
+  // frame without blocking.
+  bool writable{false};
+  uint32_t connect_started_ms{0};
+  uint32_t retry_at_ms{0};
+  uint32_t backoff_ms{0};
+  // Unsent tail of a frame the socket only partly accepted. It goes out
+  // before anything else so the byte stream stays framed; capacity is
+  // reserved once in setup().
+  std::vector<uint8_t> pending;
+  size_t pending_offset{0};
+};
+
+/// A gap the ring left on overflow: frames dropped right before the ring
+/// position.
+struct DropRecord {
+  size_t position{0};
+  uint32_t frames{0};
+};
+
+/// Gaps the microphone callback can queue before the sender reaches them.
+static constexpr size_t DROP_RECORD_SLOTS = 8;
+
+/// What happens to audio when the sender falls behind the microphone.
+enum OverflowPolicy : uint8_t {
+  /// Lose the audio that doesn't fit; queued audio is always sent.
+  OVERFLOW_POLICY_DROP_NEWEST,
+  /// Skip the oldest queued audio so latency stays within max_latency.
+  OVERFLOW_POLICY_DROP_OLDEST,
+  /// Stall the microphone callback up to block_timeout waiting for room.
+  OVERFLOW_POLICY_BLOCK,
+};
+
 class UDPAudioStreamer : public Component {
 public:
   ~UDPAudioStreamer();
@@ -24,7 +95,7 @@ public:
   void set_microphone_source(microphone::MicrophoneSource *mic_source) {
     this->mic_source_ = mic_source;
   }
-  void set_endpoint(const std::string &host, uint16_t port);
+  void add_destination(const std::string &host, uint16_t port, uint8_t ttl);
   void set_chunk_duration(uint32_t chunk_duration_ms) {
     this->chunk_duration_ms_ = chunk_duration_ms;
   }
@@ -32,6 +103,75 @@ public:
     this->buffer_duration_ms_ = buffer_duration_ms;
   }
   void set_passive(bool passive) { this->passive_ = passive; }
+  void set_packet_header(bool packet_header) {
+    this->packet_header_ = packet_header;
+  }
+  void set_codec(PacketCodec codec) { this->codec_ = codec; }
+  void set_byte_order(WireByteOrder byte_order) {
+    this->byte_order_ = byte_order;
+  }
+  void set_overflow_policy(OverflowPolicy policy) {
+    this->overflow_policy_ = policy;
+  }
+  void set_max_latency(uint32_t max_latency_ms) {
+    this->max_latency_ms_ = max_latency_ms;
+  }
+  void set_block_timeout(uint32_t block_timeout_ms) {
+    this->block_timeout_ms_ = block_timeout_ms;
+  }
+  void set_fec_group_size(uint8_t group_size) {
+    this->fec_group_size_ = group_size;
+  }
+  void set_transport(Transport transport) { this->transport_ = transport; }
+  void set_anchor_interval(uint32_t anchor_interval_ms) {
+    this->anchor_interval_ms_ = anchor_interval_ms;
+  }
+  void set_vad(uint32_t energy_threshold, uint32_t zero_crossing_threshold,
+               uint32_t hangover_ms, uint32_t pre_roll_ms,
+               uint32_t keepalive_interval_ms) {
+    this->vad_enabled_ = true;
+    this->vad_.set_energy_threshold(energy_threshold);
+    this->vad_.set_zero_crossing_threshold(zero_crossing_threshold);
+    this->vad_hangover_ms_ = hangover_ms;
+    this->pre_roll_ms_ = pre_roll_ms;
+    this->keepalive_interval_ms_ = keepalive_interval_ms;
+  }
+  void set_adaptive_chunk(uint32_t max_chunk_duration_ms,
+                          uint16_t max_packet_size) {
+    this->adaptive_ = true;
+    this->max_chunk_duration_ms_ = max_chunk_duration_ms;
+    this->max_packet_size_ = max_packet_size;
+  }
+  void set_sender_task(uint8_t priority, int8_t core, uint32_t stack_size) {
+    this->use_task_ = true;
+    this->task_priority_ = priority;
+    this->task_core_ = core;
+    this->task_stack_size_ = stack_size;
+  }
+
+#ifdef USE_SENSOR
+  void set_chunk_size_sensor(sensor::Sensor *sensor) {
+    this->chunk_size_sensor_ = sensor;
+  }
+  void set_ring_occupancy_sensor(sensor::Sensor *sensor) {
+    this->ring_occupancy_sensor_ = sensor;
+  }
+  void set_ring_high_water_sensor(sensor::Sensor *sensor) {
+    this->ring_high_water_sensor_ = sensor;
+  }
+  void set_bytes_dropped_sensor(sensor::Sensor *sensor) {
+    this->bytes_dropped_sensor_ = sensor;
+  }
+  void set_packets_sent_sensor(sensor::Sensor *sensor) {
+    this->packets_sent_sensor_ = sensor;
+  }
+  void set_send_errors_sensor(sensor::Sensor *sensor) {
+    this->send_errors_sensor_ = sensor;
+  }
+  void set_reconnects_sensor(sensor::Sensor *sensor) {
+    this->reconnects_sensor_ = sensor;
+  }
+#endif
 
   void setup() override;
   void loop() override;
@@ -40,31 +180,199 @@ public:
 protected:
   bool allocate_buffers_();
   void deallocate_buffers_();
-  bool ensure_socket_();
+  bool ensure_sockets_();
+  /// Sends the same gathered packet to every destination and returns how
+  /// many accepted it in full.
+  size_t send_to_all_(const struct iovec *iov, int iovcnt, size_t packet_size);
+  bool prepare_transport_();
+
+  /// TCP: (re)connects destinations whose backoff has expired, finishes
+  /// pending connects and flushes partly written frames. Returns true if at
+  /// least one destination can take a new frame right away; otherwise the
+  /// caller leaves the chunk queued.
+  bool service_connections_();
+  void open_connection_(Destination &destination);
+  void close_connection_(Destination &destination, int error);
+  /// Writes one length-prefixed frame; a partial write leaves the rest in
+  /// destination.pending. Returns true once the frame is committed.
+  bool send_frame_(Destination &destination, const struct iovec *iov,
+                   int iovcnt, size_t packet_size);
+  /// Returns true once nothing is left pending.
+  bool flush_pending_(Destination &destination);
+
+  /// Transmits one chunk once the ring holds a full one, waiting at most
+  /// ticks_to_wait for it. Safe to call from either loop() or the sender
+  /// task, but never both.
+  bool send_chunk_(TickType_t ticks_to_wait);
+  void update_status_();
+  void handle_audio_data_(const std::vector<uint8_t> &data);
+  /// Microphone callback: moves pending_drop_ into the drop queue if a slot
+  /// is free.
+  void queue_drop_();
+  /// Compresses one chunk of 16-bit PCM into codec_buffer_ and returns the
+  /// encoded size.
+  size_t encode_payload_(const uint8_t *pcm, size_t size);
+  /// Writes the header for a chunk of frames into send_buffer_ and returns
+  /// its length.
+  size_t write_packet_header_(uint32_t frames, size_t ring_position);
+  /// Adds a clock anchor to header once per anchor_interval_ms_, provided a
+  /// time source has set the system clock.
+  void add_clock_anchor_(PacketHeader &header);
+  /// Largest chunk, in PCM bytes, whose encoded packet fits max_packet_size_,
+  /// as does its group's parity packet with FEC.
+  size_t max_chunk_for_packet_size_() const;
+  /// Grows the chunk under send backpressure or ring pressure and shrinks it
+  /// back toward the configured chunk_duration once the link has been clear.
+  void adapt_chunk_size_(size_t queued);
+  TickType_t chunk_period_() const;
+  void publish_sensors_();
+  /// While the VAD gate is closed, trims the ring down to the pre-roll and
+  /// sends keepalives. Returns true if audio should be sent.
+  bool apply_vad_gate_(pcm_utils::SpscRing *ring);
+  /// drop_oldest: skips queued audio beyond max_latency_bytes_.
+  void trim_backlog_(pcm_utils::SpscRing *ring);
+  /// block: waits up to block_timeout_ms_ for len bytes of room.
+  void wait_for_room_(pcm_utils::SpscRing *ring, size_t len);
+  void send_keepalive_();
+  /// Folds a sent data packet into the running parity and emits the parity
+  /// packet once the group is complete.
+  void add_to_parity_(const struct iovec *iov, int iovcnt, size_t packet_size);
+  void send_parity_();
+  uint32_t estimate_capture_time_us_(uint32_t frame) const;
+
+  bool start_sender_task_();
+  static void sender_task_(void *params);
+  void run_sender_task_();
 
   microphone::MicrophoneSource *mic_source_{nullptr};
   audio::AudioStreamInfo audio_stream_info_;
 
-  std::shared_ptr<RingBuffer> ring_buffer_;
+  // Written only by the microphone callback and read only by the sending
+  // context (loop() or the sender task).
+  std::unique_ptr<pcm_utils::SpscRing> ring_;
+  uint8_t *ring_storage_{nullptr};
+  // send_buffer_ holds header_size_ bytes of packet header (the largest one,
+  // with room for a clock anchor when enabled) followed by room
+  // for one chunk, used only when a wrapped chunk can't be sent in place.
+  // send_buffer_size_ is the largest chunk; chunk_size_ is the one in use,
+  // which only differs with adaptive chunking.
   uint8_t *send_buffer_{nullptr};
   size_t send_buffer_size_{0};
+  size_t min_chunk_size_{0};
+  std::atomic<size_t> chunk_size_{0};
+  size_t header_size_{0};
+  uint8_t *codec_buffer_{nullptr};
+  size_t codec_buffer_size_{0};
   size_t ring_buffer_size_{0};
+  // Parity header, descriptor and XOR body; only allocated with FEC.
+  uint8_t *parity_buffer_{nullptr};
+  size_t parity_buffer_size_{0};
+
+  std::vector<Destination> destinations_;
+  Transport transport_{TRANSPORT_UDP};
 
-  std::unique_ptr<socket::Socket> socket_;
-  struct sockaddr_storage dest_addr_{};
+  TaskHandle_t task_handle_{nullptr};
+  bool use_task_{false};
+  uint8_t task_priority_{19};
+  int8_t task_core_{1};
+  uint32_t task_stack_size_{4096};
+  // Set by loop() once buffers and socket exist; the sender task idles until
+  // then so it never races socket creation.
+  std::atomic<bool> transport_ready_{false};
 
-  std::string host_;
-  uint16_t port_{0};
   uint32_t chunk_duration_ms_{32};
   uint32_t buffer_duration_ms_{512};
   bool passive_{false};
-  bool endpoint_valid_{false};
+  bool packet_header_{false};
+  PacketCodec codec_{PACKET_CODEC_PCM};
+  pcm_utils::ImaAdpcmState adpcm_states_[2];
+  WireByteOrder byte_order_{WIRE_BYTE_ORDER_BIG_ENDIAN};
+  bool swap_payload_{false};
+  bool destinations_valid_{false};
   bool warned_full_{false};
-  bool socket_logged_{false};
+  bool sockets_logged_{false};
   bool streaming_logged_{false};
-  uint32_t bytes_since_log_{0};
-  uint32_t packets_since_log_{0};
+
+  // Written by the sending context, consumed by loop() for logging/status.
+  std::atomic<uint32_t> bytes_since_log_{0};
+  std::atomic<uint32_t> packets_since_log_{0};
+  std::atomic<int> send_error_{0};
+  std::atomic<size_t> last_packet_size_{0};
+  std::atomic<uint32_t> encode_us_since_log_{0};
   uint32_t last_rate_log_ms_{0};
+  uint32_t dropped_logged_{0};
+
+  OverflowPolicy overflow_policy_{OVERFLOW_POLICY_DROP_OLDEST};
+  uint32_t max_latency_ms_{0};
+  size_t max_latency_bytes_{0};
+  uint32_t block_timeout_ms_{10};
+
+  bool adaptive_{false};
+  uint32_t max_chunk_duration_ms_{0};
+  uint16_t max_packet_size_{1472};
+  // Set by send_to_all_() when a socket reports it is out of buffers; only
+  // touched by the sending context.
+  bool backpressure_{false};
+  // Set by send_frame_() when a connected destination misses a frame.
+  bool frame_skipped_{false};
+  int64_t adapt_clear_since_us_{0};
+
+#ifdef USE_SENSOR
+  sensor::Sensor *chunk_size_sensor_{nullptr};
+  sensor::Sensor *ring_occupancy_sensor_{nullptr};
+  sensor::Sensor *ring_high_water_sensor_{nullptr};
+  sensor::Sensor *bytes_dropped_sensor_{nullptr};
+  sensor::Sensor *packets_sent_sensor_{nullptr};
+  sensor::Sensor *send_errors_sensor_{nullptr};
+  sensor::Sensor *reconnects_sensor_{nullptr};
+  uint32_t last_sensor_publish_ms_{0};
+#endif
+
+  uint8_t fec_group_size_{0};
+  uint8_t parity_count_{0};
+  uint16_t parity_length_xor_{0};
+  size_t parity_length_{0};
+  uint32_t parity_first_sequence_{0};
+  uint32_t parity_first_frame_{0};
+  std::atomic<uint32_t> parity_packets_since_log_{0};
+
+  uint32_t anchor_interval_ms_{0};
+  int64_t last_anchor_us_{0};
+
+  VoiceActivityDetector vad_;
+  bool vad_enabled_{false};
+  uint32_t vad_hangover_ms_{0};
+  uint32_t pre_roll_ms_{0};
+  size_t pre_roll_bytes_{0};
+  uint32_t keepalive_interval_ms_{1000};
+  std::atomic<bool> gate_open_{true};
+  bool gate_logged_open_{true};
+  int64_t last_send_us_{0};
+
+  // Stream position bookkeeping for the packet header. The microphone
+  // callback counts captured frames and queues each overflow gap; the sender
+  // owns the rest.
+  std::atomic<uint32_t> frames_captured_{0};
+  // Single-producer queue of gaps in ring order. The callback fills
+  // drop_records_[drop_head_] before publishing it by advancing drop_head_;
+  // the sender retires a record by advancing drop_tail_ once it reaches the
+  // gap. While every slot is taken, new drops gather in pending_drop_ (owned
+  // by the callback) and queue as one gap when a slot frees.
+  DropRecord drop_records_[DROP_RECORD_SLOTS];
+  std::atomic<uint32_t> drop_head_{0};
+  std::atomic<uint32_t> drop_tail_{0};
+  DropRecord pending_drop_;
+  // Lifetime totals for the diagnostic sensors.
+  std::atomic<uint32_t> bytes_dropped_total_{0};
+  std::atomic<uint32_t> packets_sent_total_{0};
+  std::atomic<uint32_t> send_errors_total_{0};
+  std::atomic<uint32_t> reconnects_total_{0};
+  std::atomic<size_t> ring_high_water_{0};
+  std::atomic<uint32_t> last_capture_us_{0};
+  uint32_t sequence_{0};
+  // 64-bit so anchors can carry an index that never wraps; headers send the
+  // low half.
+  uint64_t stream_frame_{0};
 };
 
 } // namespace udp_audio_streamer
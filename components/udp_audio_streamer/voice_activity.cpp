@@ -0,0 +1,59 @@
+#include "voice_activity.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace udp_audio_streamer {
+
+bool VoiceActivityDetector::process(const uint8_t *data, size_t frames,
+                                    uint8_t bytes_per_sample,
+                                    uint8_t channels) {
+  if (frames == 0 || bytes_per_sample < 2 || channels == 0) {
+    return this->open_;
+  }
+
+  const size_t stride = static_cast<size_t>(bytes_per_sample) * channels;
+  const uint8_t *sample_ptr = data + (bytes_per_sample - 2);
+  uint64_t energy_sum = 0;
+  uint32_t crossings = 0;
+  int16_t previous = this->previous_sample_;
+  for (size_t i = 0; i < frames; ++i, sample_ptr += stride) {
+    int16_t sample;
+    std::memcpy(&sample, sample_ptr, sizeof(sample));
+    energy_sum += static_cast<uint32_t>(static_cast<int32_t>(sample) * sample);
+    if ((sample ^ previous) < 0) {
+      crossings++;
+    }
+    previous = sample;
+  }
+  this->previous_sample_ = previous;
+  this->last_energy_ = static_cast<uint32_t>(energy_sum / frames);
+
+  bool speech = this->last_energy_ >= this->energy_threshold_;
+  if (!speech && this->zero_crossing_threshold_ > 0 &&
+      this->last_energy_ >= this->energy_threshold_ / 4) {
+    speech = (static_cast<uint64_t>(crossings) << 16) >=
+             static_cast<uint64_t>(this->zero_crossing_threshold_) * frames;
+  }
+
+  if (speech) {
+    this->open_ = true;
+    this->hangover_remaining_ = this->hangover_frames_;
+  } else if (this->hangover_remaining_ > frames) {
+    this->hangover_remaining_ -= frames;
+  } else {
+    this->hangover_remaining_ = 0;
+    this->open_ = false;
+  }
+  return this->open_;
+}
+
+void VoiceActivityDetector::reset() {
+  this->hangover_remaining_ = 0;
+  this->last_energy_ = 0;
+  this->previous_sample_ = 0;
+  this->open_ = false;
+}
+
+} // namespace udp_audio_streamer
+} // namespace esphome
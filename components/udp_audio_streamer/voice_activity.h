@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace udp_audio_streamer {
+
+/// Energy/zero-crossing voice activity detector in integer arithmetic.
+///
+/// A block counts as speech when its mean-square level reaches the energy
+/// threshold, or when it reaches a quarter of it while crossing zero at least
+/// as often as the zero-crossing threshold (this catches quiet, noisy
+/// fricatives). The gate stays open for a hangover period after the last
+/// speech block. Only the first channel is analysed, using the top 16 bits of
+/// each sample.
+class VoiceActivityDetector {
+public:
+  /// Mean-square level on a 16-bit scale (32767^2 is full scale).
+  void set_energy_threshold(uint32_t mean_square) {
+    this->energy_threshold_ = mean_square;
+  }
+  /// Fraction of sample pairs that change sign, in Q16 (0 disables).
+  void set_zero_crossing_threshold(uint32_t rate_q16) {
+    this->zero_crossing_threshold_ = rate_q16;
+  }
+  void set_hangover_frames(uint32_t frames) { this->hangover_frames_ = frames; }
+
+  /// Analyses one block of interleaved little-endian samples and returns
+  /// whether the gate is open afterwards.
+  bool process(const uint8_t *data, size_t frames, uint8_t bytes_per_sample,
+               uint8_t channels);
+
+  bool is_open() const { return this->open_; }
+  uint32_t get_last_energy() const { return this->last_energy_; }
+  void reset();
+
+protected:
+  uint32_t energy_threshold_{0};
+  uint32_t zero_crossing_threshold_{0};
+  uint32_t hangover_frames_{0};
+
+  uint32_t hangover_remaining_{0};
+  uint32_t last_energy_{0};
+  int16_t previous_sample_{0};
+  bool open_{false};
+};
+
+} // namespace udp_audio_streamer
+} // namespace esphome
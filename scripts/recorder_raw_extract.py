@@ -0,0 +1,209 @@
+#!/usr/bin/env -S uv run
+# /// script
+# requires-python = ">=3.10"
+# dependencies = []
+# ///
+"""Extract the recordings microphone_recorder wrote to a raw card region.
+
+With raw_region set, the recorder writes audio straight to a range of card
+sectors instead of files. The range starts with two copies of an index sector,
+followed by data sectors used as a ring. This reads the newer intact index
+from a card (for example /dev/sdX, which needs read access) or from an image
+of one made with dd. Each recording still in the ring is written out as a WAV
+file.
+
+--start-sector must match the recorder's raw_region start_sector. Use 0 if the
+image holds only the region. A recording whose head the ring has since
+overwritten is written from its oldest surviving frame. Output is split into
+files of at most --max-wav-size bytes, because WAV sizes are 32-bit and many
+tools stop at 2 GB.
+"""
+from __future__ import annotations
+
+import argparse
+import struct
+import sys
+import zlib
+from dataclasses import dataclass
+from pathlib import Path
+from typing import BinaryIO, List, Optional
+
+SECTOR_SIZE = 512
+INDEX_SECTORS = 2
+INDEX_MAGIC = b"MICRECRW"
+INDEX_VERSION = 1
+RECORDINGS = 14
+RECORDINGS_OFFSET = 40
+RECORDING_SIZE = 32
+RECORDING_COMPLETE = 1
+# KSDATAFORMAT_SUBTYPE_PCM.
+SUBTYPE_PCM = bytes.fromhex("0100000000001000800000aa00389b71")
+
+
+@dataclass
+class Recording:
+    sequence: int
+    sample_rate: int
+    start: int
+    length: int
+    channels: int
+    bits_per_sample: int
+    flags: int
+
+    @property
+    def frame_size(self) -> int:
+        return self.channels * self.bits_per_sample // 8
+
+
+@dataclass
+class Index:
+    generation: int
+    data_sectors: int
+    next_sequence: int
+    write_position: int
+    oldest_position: int
+    recordings: List[Recording]
+
+
+def parse_index(sector: bytes) -> Optional[Index]:
+    """Mirrors pcm_utils::parse_raw_index(); None if the sector isn't an intact index."""
+    if sector[:8] != INDEX_MAGIC or struct.unpack_from("<HH", sector, 8) != (INDEX_VERSION, RECORDINGS):
+        return None
+    if struct.unpack_from("<I", sector, SECTOR_SIZE - 4)[0] != zlib.crc32(sector[:SECTOR_SIZE - 4]):
+        return None
+    data_sectors, generation, next_sequence, write_position, oldest_position = struct.unpack_from(
+        "<IIIQQ", sector, 12
+    )
+    recordings = []
+    for i in range(RECORDINGS):
+        sequence, rate, start, length, channels, bits, flags = struct.unpack_from(
+            "<IIQQBBB", sector, RECORDINGS_OFFSET + i * RECORDING_SIZE
+        )
+        if sequence:
+            recordings.append(Recording(sequence, rate, start, length, channels, bits, flags))
+    recordings.sort(key=lambda r: r.sequence)
+    return Index(generation, data_sectors, next_sequence, write_position, oldest_position, recordings)
+
+
+def read_index(card: BinaryIO, start_sector: int) -> Optional[Index]:
+    best = None
+    for i in range(INDEX_SECTORS):
+        card.seek((start_sector + i) * SECTOR_SIZE)
+        index = parse_index(card.read(SECTOR_SIZE).ljust(SECTOR_SIZE, b"\0"))
+        if index and (best is None or index.generation > best.generation):
+            best = index
+    return best
+
+
+def wav_header(recording: Recording, data_bytes: int) -> bytes:
+    """Mirrors pcm_utils::write_wav_header(), including WAVE_FORMAT_EXTENSIBLE."""
+    channels, bits, rate = recording.channels, recording.bits_per_sample, recording.sample_rate
+    block_align = recording.frame_size
+    extensible = channels > 2 or bits > 16
+    fmt = struct.pack("<HHIIHH", 0xFFFE if extensible else 1, channels, rate, rate * block_align, block_align, bits)
+    if extensible:
+        mask = {1: 0x4, 2: 0x3}.get(channels, 0)
+        fmt += struct.pack("<HHI", 22, bits, mask) + SUBTYPE_PCM
+    chunks = b"WAVE" + b"fmt " + struct.pack("<I", len(fmt)) + fmt + b"data" + struct.pack("<I", data_bytes)
+    return b"RIFF" + struct.pack("<I", len(chunks) + data_bytes) + chunks
+
+
+def read_ring(card: BinaryIO, start_sector: int, index: Index, position: int, length: int) -> bytes:
+    """Reads length bytes from stream position on, following the ring around its end."""
+    out = bytearray()
+    capacity = index.data_sectors * SECTOR_SIZE
+    while length > 0:
+        offset = position % capacity
+        run = min(length, capacity - offset)
+        card.seek((start_sector + INDEX_SECTORS) * SECTOR_SIZE + offset)
+        data = card.read(run)
+        if len(data) != run:
+            raise EOFError("the image ends inside the region")
+        out += data
+        position += run
+        length -= run
+    return bytes(out)
+
+
+def surviving_start(recording: Recording, index: Index) -> int:
+    """Stream position of the recording's oldest frame the ring still holds."""
+    if recording.start >= index.oldest_position:
+        return recording.start
+    lost = index.oldest_position - recording.start
+    return recording.start + -(-lost // recording.frame_size) * recording.frame_size
+
+
+def extract(card: BinaryIO, start_sector: int, index: Index, recording: Recording, output: Path, prefix: str,
+            max_wav_size: int) -> List[Path]:
+    first = surviving_start(recording, index)
+    end = recording.start + recording.length
+    frame_size = recording.frame_size
+    per_file = (max_wav_size - len(wav_header(recording, 0))) // frame_size * frame_size
+    parts = max(1, -(-(end - first) // per_file))
+    paths = []
+    position = first
+    for part in range(parts):
+        name = f"{prefix}-{recording.sequence:06d}.wav" if parts == 1 else \
+            f"{prefix}-{recording.sequence:06d}-{part + 1:03d}.wav"
+        path = output / name
+        data_bytes = min(per_file, end - position)
+        with path.open("wb") as wav:
+            wav.write(wav_header(recording, data_bytes))
+            remaining = data_bytes
+            while remaining > 0:
+                chunk = min(remaining, 1 << 20)
+                wav.write(read_ring(card, start_sector, index, position, chunk))
+                position += chunk
+                remaining -= chunk
+        paths.append(path)
+    return paths
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("card", type=Path, help="Card device or image")
+    parser.add_argument("--start-sector", type=int, default=0, help="The recorder's raw_region start_sector")
+    parser.add_argument("--output", "-o", type=Path, default=Path("."), help="Directory to write WAV files to")
+    parser.add_argument("--prefix", default="rec", help="Prefix of the WAV file names")
+    parser.add_argument("--sequence", type=int, action="append", help="Only extract this recording (repeatable)")
+    parser.add_argument("--list", action="store_true", help="Only list the recordings")
+    parser.add_argument("--max-wav-size", type=int, default=2**31 - 1, help="Split WAV files at this size")
+    args = parser.parse_args()
+
+    with args.card.open("rb") as card:
+        index = read_index(card, args.start_sector)
+        if index is None:
+            print(f"No raw recorder index at sector {args.start_sector} of {args.card}")
+            sys.exit(1)
+        capacity = index.data_sectors * SECTOR_SIZE
+        print(f"Region of {capacity / 2**20:.1f} MB, {index.write_position / 2**20:.1f} MB written, "
+              f"index generation {index.generation}")
+        if not args.list:
+            args.output.mkdir(parents=True, exist_ok=True)
+        for recording in index.recordings:
+            if args.sequence and recording.sequence not in args.sequence:
+                continue
+            frame_size = recording.frame_size
+            first = surviving_start(recording, index)
+            end = recording.start + recording.length
+            seconds = recording.length / frame_size / recording.sample_rate
+            notes = []
+            if not recording.flags & RECORDING_COMPLETE:
+                # Still recording when the card was read, or cut off by a power loss.
+                notes.append("not stopped cleanly")
+            if first >= end:
+                notes.append("overwritten")
+            elif first > recording.start:
+                notes.append(f"first {(first - recording.start) / frame_size / recording.sample_rate:.1f} s "
+                             "overwritten")
+            print(f"  {recording.sequence}: {recording.channels} ch, {recording.sample_rate} Hz, "
+                  f"{recording.bits_per_sample}-bit, {seconds:.1f} s" + (f" ({', '.join(notes)})" if notes else ""))
+            if args.list or first >= end:
+                continue
+            for path in extract(card, args.start_sector, index, recording, args.output, args.prefix,
+                                args.max_wav_size):
+                print(f"    wrote {path}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,179 @@
+#!/usr/bin/env -S uv run
+# /// script
+# requires-python = ">=3.10"
+# dependencies = []
+# ///
+"""Check the segments microphone_recorder wrote to a card.
+
+Reads every <prefix>-<sequence>.wav in a directory (a mounted card or a copy
+of one) and checks that each header agrees with its file's length, that all
+segments share one format, that the numbering has no gaps, and that every
+segment of a recording is full length except its last. Segments are grouped
+into recordings by that last, shorter segment, so a recording that stopped
+exactly on a boundary runs into the next one in the report.
+
+With --reference, the audio of the selected segments, joined end to end, must
+match the reference WAV sample for sample, starting --offset frames into it.
+"""
+from __future__ import annotations
+
+import argparse
+import re
+import struct
+import sys
+from collections import Counter
+from dataclasses import dataclass
+from pathlib import Path
+from typing import List, Optional, Tuple
+
+
+@dataclass
+class Segment:
+    path: Path
+    sequence: int
+    # (format tag, channels, sample rate, bits per sample)
+    fmt: Tuple[int, int, int, int]
+    frame_size: int
+    data_offset: int
+    data_bytes: int
+    problems: List[str]
+
+    @property
+    def frames(self) -> int:
+        return self.data_bytes // self.frame_size if self.frame_size else 0
+
+
+def read_segment(path: Path, sequence: int) -> Segment:
+    """Walks the RIFF chunks of one file and checks its sizes against its length."""
+    raw = path.read_bytes()
+    problems = []
+    fmt = (0, 0, 0, 0)
+    frame_size = 0
+    data_offset = 0
+    data_bytes = 0
+    if len(raw) < 12 or raw[:4] != b"RIFF" or raw[8:12] != b"WAVE":
+        return Segment(path, sequence, fmt, 0, 0, 0, ["not a RIFF/WAVE file"])
+    riff_size = struct.unpack_from("<I", raw, 4)[0]
+    if riff_size != len(raw) - 8:
+        problems.append(f"RIFF size {riff_size}, file holds {len(raw) - 8}")
+    pos = 12
+    while pos + 8 <= len(raw):
+        chunk_id, size = struct.unpack_from("<4sI", raw, pos)
+        if chunk_id == b"fmt ":
+            tag, channels, rate, _, block_align, bits = struct.unpack_from("<HHIIHH", raw, pos + 8)
+            fmt = (tag, channels, rate, bits)
+            frame_size = block_align
+        elif chunk_id == b"data":
+            data_offset = pos + 8
+            data_bytes = size
+            if data_offset + size != len(raw):
+                problems.append(f"data size {size}, file holds {len(raw) - data_offset}")
+            break
+        pos += 8 + size + (size & 1)
+    if data_offset == 0:
+        problems.append("no data chunk")
+    elif frame_size and data_bytes % frame_size:
+        problems.append(f"data size {data_bytes} is not a whole number of {frame_size}-byte frames")
+    return Segment(path, sequence, fmt, frame_size, data_offset, data_bytes, problems)
+
+
+def find_segments(directory: Path, prefix: str) -> List[Segment]:
+    # FAT may report short names in upper case.
+    pattern = re.compile(rf"{re.escape(prefix)}-(\d+)\.wav", re.IGNORECASE)
+    found = []
+    for path in directory.iterdir():
+        match = pattern.fullmatch(path.name)
+        if match and path.is_file():
+            found.append(read_segment(path, int(match.group(1))))
+    return sorted(found, key=lambda s: s.sequence)
+
+
+def group_recordings(segments: List[Segment], full_frames: int) -> List[List[Segment]]:
+    """Splits the sequence after each segment shorter than full_frames."""
+    recordings: List[List[Segment]] = []
+    current: List[Segment] = []
+    for segment in segments:
+        current.append(segment)
+        if segment.frames < full_frames:
+            recordings.append(current)
+            current = []
+    if current:
+        recordings.append(current)
+    return recordings
+
+
+def compare_reference(segments: List[Segment], reference: Path, offset: int) -> Optional[str]:
+    """Returns a description of the first difference, or None if the audio matches."""
+    # Read like a segment rather than with the wave module, which only learned
+    # WAVE_FORMAT_EXTENSIBLE (24/32-bit and multichannel files) in Python 3.12.
+    ref = read_segment(reference, 0)
+    if ref.data_offset == 0:
+        return f"reference: {', '.join(ref.problems)}"
+    if ref.frame_size != segments[0].frame_size:
+        return f"reference has {ref.frame_size}-byte frames, segments have {segments[0].frame_size}"
+    frame_size = ref.frame_size
+    ref_data = reference.read_bytes()[ref.data_offset:ref.data_offset + ref.data_bytes]
+    frame = offset
+    for segment in segments:
+        data = segment.path.read_bytes()[segment.data_offset:segment.data_offset + segment.data_bytes]
+        expected = ref_data[frame * frame_size:(frame + segment.frames) * frame_size]
+        if data != expected:
+            if len(expected) < len(data):
+                return f"reference ends inside {segment.path.name}"
+            first = next(i for i in range(len(data)) if data[i] != expected[i]) // frame_size
+            return f"{segment.path.name} differs from reference frame {frame + first} on"
+        frame += segment.frames
+    return None
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("directory", type=Path, help="Directory holding the segments")
+    parser.add_argument("--prefix", default="rec", help="The recorder's filename_prefix")
+    parser.add_argument("--first", type=int, default=None, help="First sequence number to check")
+    parser.add_argument("--last", type=int, default=None, help="Last sequence number to check")
+    parser.add_argument("--reference", type=Path, default=None, help="WAV the joined segments must match")
+    parser.add_argument("--offset", type=int, default=0, help="Frame of the reference the first segment starts at")
+    args = parser.parse_args()
+
+    segments = [
+        s for s in find_segments(args.directory, args.prefix)
+        if (args.first is None or s.sequence >= args.first) and (args.last is None or s.sequence <= args.last)
+    ]
+    if not segments:
+        print(f"No {args.prefix}-<sequence>.wav files in {args.directory}")
+        sys.exit(1)
+
+    problems = [f"{s.path.name}: {p}" for s in segments for p in s.problems]
+    formats = Counter(s.fmt for s in segments)
+    if len(formats) > 1:
+        problems.append(f"segments use {len(formats)} different formats: {sorted(formats)}")
+    for previous, segment in zip(segments, segments[1:]):
+        if segment.sequence != previous.sequence + 1:
+            problems.append(f"sequence jumps from {previous.sequence} to {segment.sequence}")
+
+    full_frames = max(s.frames for s in segments)
+    recordings = group_recordings(segments, full_frames)
+    tag, channels, rate, bits = formats.most_common(1)[0][0]
+    print(f"{len(segments)} segments, format {tag}, {channels} ch, {rate} Hz, {bits}-bit, "
+          f"{full_frames} frames ({full_frames / rate:.3f} s) per full segment")
+    for recording in recordings:
+        frames = sum(s.frames for s in recording)
+        print(f"  {recording[0].path.name} .. {recording[-1].path.name}: "
+              f"{len(recording)} segments, {frames / rate:.3f} s")
+
+    if args.reference is not None:
+        mismatch = compare_reference(segments, args.reference, args.offset)
+        if mismatch:
+            problems.append(mismatch)
+        else:
+            print(f"Audio matches {args.reference.name} from frame {args.offset}")
+
+    for problem in problems:
+        print(f"PROBLEM: {problem}")
+    if problems:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env -S uv run
+# /// script
+# requires-python = ">=3.10"
+# dependencies = [
+#     "numpy>=1.26",
+# ]
+# ///
+"""Measure udp_audio_receiver.py ingest throughput and CPU cost per stream.
+
+For each stream count, runs the load generator in a child process against an
+in-process ingest server with no outputs, then reports packets/s, delivery,
+and the server's CPU time per stream and per packet.
+"""
+from __future__ import annotations
+
+import argparse
+import contextlib
+import io
+import socket
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+from udp_audio_receiver import IngestServer, parse_args as receiver_args
+
+SCRIPTS = Path(__file__).resolve().parent
+
+
+def measure(streams: int, args: argparse.Namespace) -> str:
+    options = receiver_args([
+        "--host", "127.0.0.1", "--port", "0", "--stats-interval", "0", "--batch", str(args.batch),
+    ])
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, options.rcvbuf)
+    sock.bind(("127.0.0.1", 0))
+    port = sock.getsockname()[1]
+    server = IngestServer(sock, options, None)
+
+    generator = subprocess.Popen([
+        sys.executable, str(SCRIPTS / "udp_audio_loadgen.py"),
+        "--port", str(port), "--streams", str(streams), "--codec", args.codec,
+        "--chunk-ms", str(args.chunk_ms), "--skew-spread-ppm", "100", "--jitter-ms", "5",
+        "--duration", str(args.duration + 1.0), "--seed", "1",
+    ], stdout=subprocess.DEVNULL)
+    try:
+        # The server's per-stream log lines would drown out the table.
+        with contextlib.redirect_stderr(io.StringIO()):
+            server.run(duration=0.5)  # warm up; streams get created here
+            packets = server.total_packets
+            cpu = time.process_time()
+            start = time.monotonic()
+            server.run(duration=args.duration)
+            elapsed = time.monotonic() - start
+            cpu = time.process_time() - cpu
+            packets = server.total_packets - packets
+    finally:
+        generator.wait()
+        server.close()
+        sock.close()
+
+    expected = streams * elapsed * 1000.0 / args.chunk_ms
+    per_stream = 100.0 * cpu / elapsed / streams
+    per_packet = 1e6 * cpu / max(1, packets)
+    return (
+        f"{streams:>7} {packets / elapsed:>9.0f} {100.0 * packets / expected:>9.1f}% "
+        f"{100.0 * cpu / elapsed:>7.1f}% {per_stream:>10.3f}% {per_packet:>9.1f}"
+    )
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--streams", default="1,10,40,80", help="Comma-separated stream counts to measure")
+    parser.add_argument("--duration", type=float, default=10.0, help="Seconds to measure each count")
+    parser.add_argument("--codec", default="pcm", choices=("pcm", "ulaw"), help="Payload codec")
+    parser.add_argument("--chunk-ms", type=int, default=32, help="Audio per packet")
+    parser.add_argument("--batch", type=int, default=32, help="Datagrams per receive call")
+    args = parser.parse_args()
+
+    print(f"{'streams':>7} {'pkt/s':>9} {'delivered':>10} {'CPU':>8} {'CPU/stream':>11} {'us/pkt':>9}")
+    for count in (int(c) for c in args.streams.split(",")):
+        print(measure(count, args), flush=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+#!/usr/bin/env -S uv run
+# /// script
+# requires-python = ">=3.10"
+# dependencies = [
+#     "numpy>=1.26",
+# ]
+# ///
+"""Check that the receiver holds its buffer depth against a skewed sender clock.
+
+Runs one simulated node with a fixed sample clock error through the
+receiver's per-stream pipeline on a synthetic clock (no sockets, no waiting),
+so hours or days of streaming take seconds to minutes. Prints the clock
+estimate and the buffer depth for each period, and exits non-zero if the
+depth wanders from its target or the buffer underruns once settled.
+"""
+from __future__ import annotations
+
+import argparse
+import heapq
+import random
+import sys
+
+import numpy as np
+
+import udp_audio_loadgen as loadgen
+import udp_audio_receiver as receiver
+
+SETTLE_S = 600.0  # ignore the first ten minutes while the estimate converges
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--hours", type=float, default=6.0, help="Simulated duration")
+    parser.add_argument("--skew-ppm", type=float, default=200.0, help="Sender clock error (positive runs fast)")
+    parser.add_argument("--jitter-ms", type=float, default=5.0, help="Random network delay, up to this")
+    parser.add_argument(
+        "--anchor-interval", type=float, default=5.0, help="Seconds between clock anchors (0: arrivals only)"
+    )
+    parser.add_argument("--sync-interval", type=float, default=900.0, help="Seconds between the node's time syncs")
+    parser.add_argument("--tick-ms", type=int, default=20, help="Playout interval")
+    parser.add_argument("--report-minutes", type=float, default=30.0, help="Length of each reported period")
+    parser.add_argument("--tolerance-ms", type=float, default=20.0, help="Allowed depth error once settled")
+    parser.add_argument("--seed", type=int, default=1, help="Random seed")
+    args = parser.parse_args()
+
+    random.seed(args.seed)
+    node_args = loadgen.parse_args([
+        "--streams", "1", "--skew-ppm", str(args.skew_ppm), "--anchor-interval", str(args.anchor_interval),
+        "--sync-interval", str(args.sync_interval),
+    ])
+    node = loadgen.SimulatedStreamer(0, node_args, start=0.0, epoch=1.7e9)
+    options = receiver.parse_args(["--tick-ms", str(args.tick_ms)])
+    fmt = receiver.StreamFormat(node.rate, 1, 16, node.codec, True)
+    stream = receiver.Stream("sim", "sim", fmt, options, [])
+
+    chunk_s = node.frames / node.rate
+    tick = args.tick_ms / 1000.0
+    end = args.hours * 3600.0
+    period = args.report_minutes * 60.0
+    in_flight: list = []
+    order = 0
+    depths = []
+    targets = []
+    worst = 0.0
+    settled_underruns = None
+    now = 0.0
+    next_report = period
+
+    print(f"Sender clock {args.skew_ppm:+.1f} ppm, {args.hours:g} h simulated")
+    print(f"{'time':>8} {'clock est':>12} {'source':>9} {'ratio':>10} {'depth':>9} {'target':>9} {'underruns':>10}")
+    while now < end:
+        now += tick
+        while node.due() + chunk_s <= now:
+            # Sent once the chunk has been captured, then delayed by the network.
+            sent = node.due() + chunk_s
+            for packet in node.next_packets(0):
+                order += 1
+                heapq.heappush(in_flight, (sent + random.uniform(0.0, args.jitter_ms / 1000.0), order, packet))
+        while in_flight and in_flight[0][0] <= now:
+            arrival, _, packet = heapq.heappop(in_flight)
+            stream.receive(packet, receiver.parse_header(packet), arrival)
+        stream.play_out(now)
+
+        rate = float(node.rate)
+        depths.append(stream.jitter.depth() / rate)
+        targets.append(stream.jitter.target / rate)
+        if now >= SETTLE_S and settled_underruns is None:
+            settled_underruns = stream.jitter.underruns
+        if now >= next_report:
+            depth = 1000.0 * float(np.mean(depths))
+            target = 1000.0 * float(np.mean(targets))
+            if now > SETTLE_S:
+                worst = max(worst, abs(depth - target))
+            estimate = stream.clock.ratio
+            print(
+                f"{now / 3600.0:>7.2f}h "
+                f"{'n/a' if estimate is None else f'{(estimate - 1.0) * 1e6:+.2f} ppm':>12} "
+                f"{stream.clock.source:>9} {(stream.drift.ratio - 1.0) * 1e6:>+7.1f} ppm "
+                f"{depth:>6.1f} ms {target:>6.1f} ms {stream.jitter.underruns:>10}",
+                flush=True,
+            )
+            depths.clear()
+            targets.clear()
+            next_report += period
+
+    underruns = stream.jitter.underruns - (settled_underruns or 0)
+    print(f"Worst settled depth error: {worst:.1f} ms, underruns after settling: {underruns}")
+    if worst > args.tolerance_ms or underruns > 0:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
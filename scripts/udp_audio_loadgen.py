@@ -0,0 +1,282 @@
+#!/usr/bin/env -S uv run
+# /// script
+# requires-python = ">=3.10"
+# dependencies = [
+#     "numpy>=1.26",
+# ]
+# ///
+"""Simulate many udp_audio_streamer nodes sending headered audio to one receiver.
+
+Each simulated node sends from its own UDP port, or over its own TCP
+connection, with its own tone, sample clock skew, loss, jitter, optional XOR
+parity and clock anchors, exactly as the firmware frames it, so
+udp_audio_receiver.py can be exercised without hardware.
+"""
+from __future__ import annotations
+
+import argparse
+import heapq
+import random
+import socket
+import time
+from collections import deque
+from typing import Deque, List, Optional, Tuple
+
+import numpy as np
+
+from udp_audio_receiver import (
+    ANCHOR,
+    CODEC_PCM,
+    CODEC_ULAW,
+    FEC_DESCRIPTOR,
+    FLAG_ANCHOR,
+    FLAG_LITTLE_ENDIAN,
+    FLAG_PARITY,
+    FRAME_PREFIX,
+    HEADER,
+    HEADER_MAGIC,
+)
+
+
+def _build_ulaw_encoder() -> np.ndarray:
+    """Lookup table from every int16 value (offset by 32768) to its u-law code."""
+    samples = np.arange(-32768, 32768, dtype=np.int32)
+    sign = np.where(samples < 0, 0x80, 0)
+    magnitude = np.minimum(np.abs(samples), 32635) + 0x84
+    exponent = np.floor(np.log2(magnitude)).astype(np.int32) - 7
+    mantissa = (magnitude >> (exponent + 3)) & 0x0F
+    return (~(sign | (exponent << 4) | mantissa) & 0xFF).astype(np.uint8)
+
+
+ULAW_ENCODER = _build_ulaw_encoder()
+
+
+class SimulatedStreamer:
+    """Produces one node's datagrams; the caller decides when and how to deliver them.
+
+    Times are on the caller's clock, taken as true time. The node's crystal
+    is off by its skew, which drives both its sample clock and, between time
+    syncs, its wall clock.
+    """
+
+    def __init__(self, index: int, args: argparse.Namespace, start: float, epoch: float) -> None:
+        self.rate = args.sample_rate
+        self.codec = CODEC_ULAW if args.codec == "ulaw" else CODEC_PCM
+        self.little_endian = args.byte_order == "little"
+        self.frames = args.sample_rate * args.chunk_ms // 1000
+        self.skew = (args.skew_ppm + random.uniform(-args.skew_spread_ppm, args.skew_spread_ppm)) * 1e-6
+        # Stagger senders across one chunk so they don't all fire at once.
+        self.start = start + random.uniform(0.0, args.chunk_ms / 1000.0)
+        self.epoch = epoch
+        self.anchor_interval = args.anchor_interval
+        self.sync_interval = args.sync_interval
+        self.next_anchor = self.start
+        self.frequency = 220.0 * 2 ** (index % 24 / 12)
+        self.boot_us = random.randrange(1 << 32)
+        self.sequence = random.randrange(1 << 32)
+        self.frame = 0
+        self.count = 0
+        self.group: List[bytes] = []
+        self.group_first: Tuple[int, int] = (0, 0)
+
+    def due(self) -> float:
+        # A fast sample clock produces each chunk a little early.
+        return self.start + self.count * self.frames / (self.rate * (1.0 + self.skew))
+
+    def wall_time_us(self, when: float) -> int:
+        """The node's wall clock at true time when: exact at each time sync, drifting in between."""
+        since_sync = (when - self.start) % self.sync_interval if self.sync_interval > 0 else when - self.start
+        return int((self.epoch + when - since_sync + since_sync * (1.0 + self.skew)) * 1e6)
+
+    def next_packets(self, fec_group: int) -> List[bytes]:
+        t = (self.frame + np.arange(self.frames)) / self.rate
+        samples = (np.sin(2 * np.pi * self.frequency * t) * 8000).astype(np.int16)
+        if self.codec == CODEC_ULAW:
+            payload = ULAW_ENCODER[samples.astype(np.int32) + 32768].tobytes()
+        else:
+            payload = samples.astype("<i2" if self.little_endian else ">i2").tobytes()
+        flags = FLAG_LITTLE_ENDIAN if self.little_endian and self.codec == CODEC_PCM else 0
+        capture_us = (self.boot_us + self.frame * 1_000_000 // self.rate) & 0xFFFFFFFF
+        anchor = b""
+        due = self.due()
+        if self.anchor_interval > 0 and due >= self.next_anchor:
+            flags |= FLAG_ANCHOR
+            anchor = ANCHOR.pack(self.frame >> 32, self.wall_time_us(due))
+            self.next_anchor = due + self.anchor_interval
+        header = HEADER.pack(
+            HEADER_MAGIC, 1, flags, HEADER.size + len(anchor), self.codec, 1, 16,
+            self.sequence, self.frame & 0xFFFFFFFF, capture_us, self.rate,
+        )
+        packet = header + anchor + payload
+        packets = [packet]
+        if fec_group:
+            if not self.group:
+                self.group_first = (self.sequence, self.frame & 0xFFFFFFFF)
+            self.group.append(packet)
+            if len(self.group) == fec_group:
+                packets.append(self._parity(capture_us))
+                self.group = []
+        self.sequence = (self.sequence + 1) & 0xFFFFFFFF
+        self.frame += self.frames
+        self.count += 1
+        return packets
+
+    def _parity(self, capture_us: int) -> bytes:
+        longest = max(len(p) for p in self.group)
+        body = np.zeros(longest, dtype=np.uint8)
+        length_xor = 0
+        for packet in self.group:
+            body[:len(packet)] ^= np.frombuffer(packet, dtype=np.uint8)
+            length_xor ^= len(packet)
+        sequence, frame = self.group_first
+        header = HEADER.pack(
+            HEADER_MAGIC, 1, FLAG_PARITY, HEADER.size, self.codec, 1, 16,
+            sequence, frame, capture_us, self.rate,
+        )
+        return header + FEC_DESCRIPTOR.pack(len(self.group), 0, length_xor) + body.tobytes()
+
+
+class TcpLink:
+    """One node's TCP connection, dropped and re-established like the firmware's.
+
+    While disconnected, packets queue up to max_backlog, as audio would in
+    the node's ring buffer, and are sent in a burst on reconnect. A forced
+    disconnect cuts the connection partway through a frame, which costs the
+    receiver exactly that frame.
+    """
+
+    RECONNECT_DELAY = 0.25
+
+    def __init__(self, address: Tuple[str, int], disconnect_interval: float, max_backlog: int) -> None:
+        self.address = address
+        self.disconnect_interval = disconnect_interval
+        self.backlog: Deque[bytes] = deque(maxlen=max_backlog)
+        self.sock: Optional[socket.socket] = None
+        self.reconnect_at = 0.0
+        self.disconnect_at = float("inf")
+
+    def send(self, packet: bytes, now: float) -> int:
+        """Queues packet and sends whatever the connection allows. Returns frames sent."""
+        self.backlog.append(FRAME_PREFIX.pack(len(packet)) + packet)
+        if self.sock is None:
+            if now < self.reconnect_at:
+                return 0
+            self.sock = socket.create_connection(self.address)
+            self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            if self.disconnect_interval > 0:
+                self.disconnect_at = now + random.uniform(0.5, 1.5) * self.disconnect_interval
+        if now >= self.disconnect_at:
+            frame = self.backlog.popleft()
+            self.sock.sendall(frame[:random.randrange(1, len(frame))])
+            self.close()
+            self.reconnect_at = now + self.RECONNECT_DELAY
+            return 0
+        sent = len(self.backlog)
+        self.sock.sendall(b"".join(self.backlog))
+        self.backlog.clear()
+        return sent
+
+    def close(self) -> None:
+        if self.sock is not None:
+            self.sock.close()
+            self.sock = None
+
+
+def parse_args(argv: Optional[List[str]] = None) -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1", help="Receiver address")
+    parser.add_argument("--port", type=int, default=7000, help="Receiver UDP port")
+    parser.add_argument("--transport", default="udp", choices=("udp", "tcp"), help="How the nodes send")
+    parser.add_argument(
+        "--disconnect-interval", type=float, default=0.0,
+        help="TCP: drop each connection mid-frame about this often, in seconds (0: never)"
+    )
+    parser.add_argument("--streams", type=int, default=40, help="Number of simulated nodes")
+    parser.add_argument("--sample-rate", type=int, default=16000, help="Sample rate in Hz")
+    parser.add_argument("--chunk-ms", type=int, default=32, help="Audio per packet")
+    parser.add_argument("--codec", default="pcm", choices=("pcm", "ulaw"), help="Payload codec")
+    parser.add_argument("--byte-order", default="big", choices=("big", "little"), help="PCM wire byte order")
+    parser.add_argument("--skew-ppm", type=float, default=0.0, help="Clock error of every node (positive runs fast)")
+    parser.add_argument(
+        "--skew-spread-ppm", type=float, default=0.0, help="Add a random error of up to this much per node"
+    )
+    parser.add_argument(
+        "--anchor-interval", type=float, default=5.0, help="Seconds between clock anchors (0: no anchors)"
+    )
+    parser.add_argument(
+        "--sync-interval", type=float, default=900.0,
+        help="Seconds between the nodes' simulated time syncs, which reset their wall-clock drift"
+    )
+    parser.add_argument("--loss", type=float, default=0.0, help="Fraction of packets to drop (0.0-1.0)")
+    parser.add_argument("--jitter-ms", type=float, default=0.0, help="Random extra delay per packet, up to this")
+    parser.add_argument("--fec-group", type=int, default=0, help="Send XOR parity after this many packets (0: off)")
+    parser.add_argument("--duration", type=float, default=0.0, help="Seconds to run (0: until interrupted)")
+    parser.add_argument("--seed", type=int, default=None, help="Random seed")
+    return parser.parse_args(argv)
+
+
+def run(args: argparse.Namespace) -> int:
+    """Sends until the duration elapses and returns the number of datagrams sent."""
+    random.seed(args.seed)
+    start = time.monotonic() + 0.1
+    epoch = time.time() - time.monotonic()
+    streamers = [SimulatedStreamer(i, args, start, epoch) for i in range(args.streams)]
+    sockets = []
+    links = []
+    if args.transport == "tcp":
+        # Half a second of packets, like the firmware's default ring.
+        backlog = max(1, 512 // args.chunk_ms)
+        links = [TcpLink((args.host, args.port), args.disconnect_interval, backlog) for _ in streamers]
+    else:
+        for _ in streamers:
+            sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            sock.connect((args.host, args.port))
+            sockets.append(sock)
+    schedule = [(s.due(), i) for i, s in enumerate(streamers)]
+    heapq.heapify(schedule)
+    # Packets held back by simulated jitter, ordered by send time.
+    delayed: List[Tuple[float, int, int, bytes]] = []
+    sent = 0
+    order = 0
+    end = start + args.duration if args.duration > 0 else float("inf")
+    while True:
+        now = time.monotonic()
+        while delayed and delayed[0][0] <= now:
+            _, _, index, packet = heapq.heappop(delayed)
+            if links:
+                sent += links[index].send(packet, now)
+            else:
+                sockets[index].send(packet)
+                sent += 1
+        while schedule[0][0] <= now:
+            due, index = heapq.heappop(schedule)
+            streamer = streamers[index]
+            for packet in streamer.next_packets(args.fec_group):
+                if random.random() < args.loss:
+                    continue
+                order += 1
+                heapq.heappush(delayed, (due + random.uniform(0.0, args.jitter_ms / 1000.0), order, index, packet))
+            heapq.heappush(schedule, (streamer.due(), index))
+        if now >= end:
+            break
+        wake = min(schedule[0][0], delayed[0][0] if delayed else float("inf"), end)
+        time.sleep(max(0.0, wake - time.monotonic()))
+    for sock in sockets:
+        sock.close()
+    for link in links:
+        link.close()
+    return sent
+
+
+def main() -> None:
+    args = parse_args()
+    print(f"Sending {args.streams} streams to {args.host}:{args.port}")
+    try:
+        sent = run(args)
+    except KeyboardInterrupt:
+        return
+    print(f"Sent {sent} packets")
+
+
+if __name__ == "__main__":
+    main()
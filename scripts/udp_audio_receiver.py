@@ -6,156 +6,1377 @@
 #     "sounddevice>=0.4",
 # ]
 # ///
-"""Listen for PCM audio frames from ESPHome's udp_audio_streamer component with jitter buffering."""
+"""Ingest audio from any number of ESPHome udp_audio_streamer nodes on one port.
+
+Each sender gets its own FEC reassembler, loss tracker, adaptive jitter buffer
+and drift-compensating resampler, and is written to a WAV file, a pipe, stdout
+or the sound card.
+"""
 from __future__ import annotations
 
 import argparse
-import queue
+import contextlib
+import ctypes
+import errno
+import heapq
+import os
+import select
 import socket
+import struct
+import subprocess
+import sys
 import threading
 import time
-from contextlib import closing
-from typing import Dict, Tuple
+import wave
+from collections import deque
+from dataclasses import dataclass
+from typing import Callable, Deque, Dict, Hashable, List, Optional, Tuple
 
 import numpy as np
-import sounddevice as sd
 
 
-DTYPE_MAP: Dict[int, Tuple[str, np.dtype]] = {
-    16: ("<i2", np.int16),
-    24: ("<i4", np.int32),  # 24-bit samples are packed into 32-bit integers
-    32: ("<i4", np.int32),
+DTYPE_MAP: Dict[int, type] = {
+    16: np.int16,
+    24: np.int32,  # 24-bit samples are left-justified into 32-bit integers
+    32: np.int32,
 }
 
+# Mirrors components/udp_audio_streamer/packet_header.h
+HEADER = struct.Struct(">2sBBBBBBIIII")
+HEADER_MAGIC = b"UA"
+FLAG_LITTLE_ENDIAN = 0x01
+FLAG_KEEPALIVE = 0x02
+FLAG_PARITY = 0x04
+FLAG_ANCHOR = 0x08
+ANCHOR = struct.Struct(">IQ")
+FEC_DESCRIPTOR = struct.Struct(">BBH")
+FRAME_PREFIX = struct.Struct(">H")  # TCP transport: length of the packet that follows
+CODEC_PCM = 0
+CODEC_ULAW = 1
+CODEC_IMA_ADPCM = 2
+
+IMA_INDEX_TABLE = (-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8)
+IMA_STEP_TABLE = (
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+)
+
+
+def _build_ulaw_table() -> np.ndarray:
+    codes = ~np.arange(256, dtype=np.uint8)
+    exponent = (codes >> 4) & 0x07
+    mantissa = (codes & 0x0F).astype(np.int32)
+    magnitude = (((mantissa << 3) + 0x84) << exponent) - 0x84
+    return np.where(codes & 0x80, -magnitude, magnitude).astype(np.int16)
+
+
+ULAW_TABLE = _build_ulaw_table()
+
+
+@dataclass
+class PacketHeader:
+    version: int
+    flags: int
+    header_length: int
+    codec: int
+    channels: int
+    bits: int
+    sequence: int
+    frame_counter: int
+    capture_time_us: int
+    sample_rate: int
+    # Clock anchor, present with FLAG_ANCHOR.
+    frame_counter_high: int = 0
+    wall_time_us: int = 0
+
+    @property
+    def anchored(self) -> bool:
+        return bool(self.flags & FLAG_ANCHOR) and self.header_length >= HEADER.size + ANCHOR.size
+
+
+def parse_header(payload: bytes) -> Optional[PacketHeader]:
+    if len(payload) < HEADER.size:
+        return None
+    fields = HEADER.unpack_from(payload)
+    if fields[0] != HEADER_MAGIC:
+        return None
+    header = PacketHeader(*fields[1:])
+    if header.header_length < HEADER.size or header.header_length > len(payload):
+        return None
+    if header.anchored:
+        header.frame_counter_high, header.wall_time_us = ANCHOR.unpack_from(payload, HEADER.size)
+    return header
+
+
+def decode_pcm(payload: bytes, bits: int, little_endian: bool) -> np.ndarray:
+    """Decode a PCM payload into int16 (16-bit) or left-justified int32 samples."""
+    order = "<" if little_endian else ">"
+    if bits == 16:
+        return np.frombuffer(payload, dtype=f"{order}i2").astype(np.int16)
+    if bits == 32:
+        return np.frombuffer(payload, dtype=f"{order}i4").astype(np.int32)
+    raw = np.frombuffer(payload, dtype=np.uint8)
+    raw = raw[: len(raw) - len(raw) % 3].reshape(-1, 3).astype(np.uint32)
+    msb, mid, lsb = (raw[:, 2], raw[:, 1], raw[:, 0]) if little_endian else (raw[:, 0], raw[:, 1], raw[:, 2])
+    return ((msb << 24) | (mid << 16) | (lsb << 8)).view(np.int32)
+
+
+def decode_ulaw(payload: bytes) -> np.ndarray:
+    return ULAW_TABLE[np.frombuffer(payload, dtype=np.uint8)]
+
+
+def _build_ima_tables() -> Tuple[List[int], List[int]]:
+    """Flattened (step index * 16 + code) tables of signed deltas and next rows."""
+    deltas = []
+    rows = []
+    for index, step in enumerate(IMA_STEP_TABLE):
+        for code in range(16):
+            diff = step >> 3
+            if code & 4:
+                diff += step
+            if code & 2:
+                diff += step >> 1
+            if code & 1:
+                diff += step >> 2
+            deltas.append(-diff if code & 8 else diff)
+            rows.append(max(0, min(88, index + IMA_INDEX_TABLE[code])) * 16)
+    return deltas, rows
+
+
+IMA_DELTAS, IMA_ROWS = _build_ima_tables()
+
+
+def decode_ima_adpcm(payload: bytes, channels: int) -> np.ndarray:
+    """Decode one self-contained block from pcm_utils::ima_adpcm_encode_block()."""
+    header_size = 4 * channels
+    predictors = [int.from_bytes(payload[4 * ch:4 * ch + 2], "little", signed=True) for ch in range(channels)]
+    rows = [min(payload[4 * ch + 2], 88) * 16 for ch in range(channels)]
+    codes = payload[header_size:]
+    count = (len(codes) * 2) // channels * channels
+    out = [0] * count
+    deltas = IMA_DELTAS
+    next_rows = IMA_ROWS
+    if channels == 1:
+        # The decoder is inherently serial, so keep the per-sample work to two
+        # table lookups and a clamp.
+        predictor = predictors[0]
+        row = rows[0]
+        i = 0
+        for byte in codes:
+            code = row + (byte & 0x0F)
+            predictor += deltas[code]
+            predictor = 32767 if predictor > 32767 else (-32768 if predictor < -32768 else predictor)
+            row = next_rows[code]
+            out[i] = predictor
+            code = row + (byte >> 4)
+            predictor += deltas[code]
+            predictor = 32767 if predictor > 32767 else (-32768 if predictor < -32768 else predictor)
+            row = next_rows[code]
+            out[i + 1] = predictor
+            i += 2
+        return np.array(out, dtype=np.int16)
+
+    ch = 0
+    for i in range(count):
+        byte = codes[i >> 1]
+        code = rows[ch] + ((byte >> 4) if i & 1 else (byte & 0x0F))
+        predictor = predictors[ch] + deltas[code]
+        predictors[ch] = max(-32768, min(32767, predictor))
+        rows[ch] = next_rows[code]
+        out[i] = predictors[ch]
+        ch = ch + 1 if ch + 1 < channels else 0
+    return np.array(out, dtype=np.int16)
+
+
+def decode_payload(header: PacketHeader, payload: bytes) -> Optional[np.ndarray]:
+    if header.codec == CODEC_PCM:
+        return decode_pcm(payload, header.bits, bool(header.flags & FLAG_LITTLE_ENDIAN))
+    if header.codec == CODEC_ULAW:
+        return decode_ulaw(payload)
+    if header.codec == CODEC_IMA_ADPCM:
+        return decode_ima_adpcm(payload, header.channels)
+    return None
+
+
+def seq_delta(new: int, old: int) -> int:
+    """Signed distance between two u32 sequence numbers."""
+    return ((new - old + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+
+
+class FecReassembler:
+    """Rebuilds a single lost packet per group from the streamer's XOR parity packets.
+
+    Packets are passed on as soon as they arrive (the jitter buffer puts them
+    back in order) and kept for a few groups. Whenever a group's parity and all
+    but one of its members are in hand, the missing member is rebuilt and
+    passed on too, usually well before the jitter buffer needs it.
+    """
+
+    HORIZON = 64  # packets kept for recovery
+
+    def __init__(self) -> None:
+        self.active = False
+        self.packets: Dict[int, bytes] = {}
+        self.parity: Dict[int, Tuple[int, int, bytes]] = {}
+        self.rebuilt: set = set()
+        self.highest: Optional[int] = None
+        self.recovered = 0
+        self.parity_packets = 0
+
+    def add_packet(self, sequence: int, packet: bytes) -> List[bytes]:
+        if not self.active:
+            return [packet]
+        if sequence in self.packets:
+            if sequence in self.rebuilt:
+                # Only delayed, not lost; don't count it as a recovery.
+                self.rebuilt.discard(sequence)
+                self.recovered -= 1
+            return []
+        self.packets[sequence] = packet
+        self._advance(sequence)
+        for first, (count, _, _) in list(self.parity.items()):
+            if 0 <= seq_delta(sequence, first) < count:
+                return [packet] + self._recover(first)
+        return [packet]
+
+    def add_parity(self, header: PacketHeader, payload: bytes) -> List[bytes]:
+        if len(payload) < FEC_DESCRIPTOR.size:
+            return []
+        count, _, length_xor = FEC_DESCRIPTOR.unpack_from(payload)
+        self.parity_packets += 1
+        self.active = True
+        self.parity[header.sequence] = (count, length_xor, payload[FEC_DESCRIPTOR.size:])
+        self._advance(header.sequence)
+        return self._recover(header.sequence)
+
+    def _recover(self, first: int) -> List[bytes]:
+        count, length_xor, body = self.parity[first]
+        members = [(first + i) & 0xFFFFFFFF for i in range(count)]
+        missing = [s for s in members if s not in self.packets]
+        if len(missing) != 1:
+            return []
+        rebuilt = np.frombuffer(body, dtype=np.uint8).copy()
+        length = length_xor
+        for sequence in members:
+            other = self.packets.get(sequence)
+            if other is None:
+                continue
+            if len(other) > len(rebuilt):
+                return []
+            rebuilt[:len(other)] ^= np.frombuffer(other, dtype=np.uint8)
+            length ^= len(other)
+        del self.parity[first]
+        if length > len(rebuilt):
+            return []
+        packet = rebuilt[:length].tobytes()
+        self.packets[missing[0]] = packet
+        self.rebuilt.add(missing[0])
+        self.recovered += 1
+        return [packet]
+
+    def _advance(self, sequence: int) -> None:
+        if self.highest is None or seq_delta(sequence, self.highest) > 0:
+            self.highest = sequence
+        if len(self.packets) + len(self.parity) < 2 * self.HORIZON:
+            return
+        for table in (self.packets, self.parity):
+            for old in [s for s in table if seq_delta(self.highest, s) > self.HORIZON]:
+                del table[old]
+        self.rebuilt.intersection_update(self.packets)
+
+
+class StreamTracker:
+    """Tracks loss, reordering and relative latency from packet headers."""
+
+    def __init__(self) -> None:
+        self.expected_seq: Optional[int] = None
+        self.lost = 0
+        self.reordered = 0
+        self.received = 0
+        self.keepalives = 0
+        # Capture timestamps are u32 microseconds; unwrap them locally.
+        self.capture_base = 0
+        self.last_capture: Optional[int] = None
+        # The transit floor is the minimum over the current and previous
+        # window, so the sender's clock drift can't walk it away.
+        self.floor_window = 30.0
+        self.window_start = 0.0
+        self.window_min: Optional[float] = None
+        self.previous_min: Optional[float] = None
+        self.last_offset = 0.0
+
+    def update(self, header: PacketHeader, arrival: float) -> int:
+        """Return the number of packets missing before this one, or -1 if it is late."""
+        missing = 0
+        if self.expected_seq is not None:
+            delta = seq_delta(header.sequence, self.expected_seq)
+            if delta < 0:
+                # Counted as lost when the gap opened; the jitter buffer may
+                # still have room for it.
+                self.reordered += 1
+                self.lost = max(0, self.lost - 1)
+                return -1
+            missing = delta
+            self.lost += delta
+        self.expected_seq = (header.sequence + 1) & 0xFFFFFFFF
+        self.received += 1
+
+        if self.last_capture is not None and header.capture_time_us < self.last_capture:
+            if self.last_capture - header.capture_time_us > 0x80000000:
+                self.capture_base += 1 << 32
+        self.last_capture = header.capture_time_us
+        capture = (self.capture_base + header.capture_time_us) / 1e6
+        offset = arrival - capture
+        if arrival - self.window_start >= self.floor_window:
+            self.previous_min = self.window_min
+            self.window_min = None
+            self.window_start = arrival
+        if self.window_min is None or offset < self.window_min:
+            self.window_min = offset
+        self.last_offset = offset
+        return missing
+
+    def summary(self) -> str:
+        floors = [m for m in (self.window_min, self.previous_min) if m is not None]
+        latency_ms = (self.last_offset - min(floors)) * 1e3 if floors else 0.0
+        return (
+            f"lost: {self.lost}, reordered: {self.reordered}, "
+            f"keepalives: {self.keepalives}, "
+            f"latency above floor: {latency_ms:.1f} ms"
+        )
+
+
+def log(message: str) -> None:
+    # stdout may be carrying audio, so all status goes to stderr.
+    print(message, file=sys.stderr, flush=True)
+
+
+@dataclass(frozen=True)
+class StreamFormat:
+    sample_rate: int
+    channels: int
+    bits: int
+    codec: int
+    headered: bool
+
+    @property
+    def dtype(self) -> type:
+        # Compressed codecs always decode to 16-bit samples.
+        return DTYPE_MAP[self.bits] if self.codec == CODEC_PCM else np.int16
+
+    def describe(self) -> str:
+        codec = {CODEC_PCM: "PCM", CODEC_ULAW: "u-law", CODEC_IMA_ADPCM: "IMA-ADPCM"}.get(self.codec, "?")
+        header = "headered" if self.headered else "headerless"
+        return f"{self.sample_rate} Hz, {self.channels} ch, {self.bits}-bit {codec}, {header}"
+
+
+class JitterBuffer:
+    """Reorders packets on the stream's frame timeline and plays them out at an adaptive depth.
+
+    The target depth follows the spread of recent packet transit times (a high
+    percentile over a sliding window), so a clean network keeps latency low and
+    a jittery one trades latency for fewer gaps. Gaps inside the buffered range
+    are concealed once they are due; when the buffer runs dry, playout pauses
+    and re-buffers to the target depth.
+    """
+
+    TRANSIT_WINDOW = 5.0
+    TRANSIT_PERCENTILE = 98
+
+    def __init__(self, fmt: StreamFormat, min_ms: int, max_ms: int, max_conceal_ms: int) -> None:
+        self.rate = fmt.sample_rate
+        self.channels = fmt.channels
+        self.dtype = fmt.dtype
+        self.min_depth = self.rate * min_ms // 1000
+        self.max_depth = max(self.min_depth, self.rate * max_ms // 1000)
+        self.max_conceal = self.rate * max_conceal_ms // 1000
+        self.target = self.min_depth
+        self.packets: Dict[int, np.ndarray] = {}
+        self.starts: List[int] = []
+        self.end_frame = 0
+        self.next_frame = 0
+        self.playing = False
+        self.packet_frames = 0
+        self.history = np.zeros((0, self.channels), dtype=self.dtype)
+        self.conceal_run = 0
+        self.transits: Deque[Tuple[float, float]] = deque()
+        self.last_target_update = 0.0
+        self.late = 0
+        self.skipped_frames = 0
+        self.concealed_frames = 0
+        self.underruns = 0
+
+    def push(self, frame: int, samples: np.ndarray, arrival: float) -> None:
+        frames = samples.shape[0]
+        if frames == 0:
+            return
+        self.packet_frames = frames
+        self.transits.append((arrival, arrival - frame / self.rate))
+        if self.playing and frame + frames <= self.next_frame:
+            self.late += 1
+            return
+        if frame in self.packets:
+            return
+        self.packets[frame] = samples
+        heapq.heappush(self.starts, frame)
+        if len(self.packets) == 1 or frame + frames > self.end_frame:
+            self.end_frame = frame + frames
+
+    def depth(self) -> int:
+        """Frames buffered ahead of the playout point."""
+        if not self.starts:
+            return 0
+        return self.end_frame - (self.next_frame if self.playing else self.starts[0])
+
+    def update_target(self, now: float) -> None:
+        while self.transits and now - self.transits[0][0] > self.TRANSIT_WINDOW:
+            self.transits.popleft()
+        if now - self.last_target_update < 1.0 or len(self.transits) < 2:
+            return
+        self.last_target_update = now
+        transits = np.fromiter((t for _, t in self.transits), dtype=np.float64, count=len(self.transits))
+        spread = np.percentile(transits, self.TRANSIT_PERCENTILE) - transits.min()
+        target = int(spread * self.rate) + self.packet_frames
+        self.target = max(self.min_depth, min(self.max_depth, target))
+
+    def pull(self, count: int) -> np.ndarray:
+        out = np.zeros((count, self.channels), dtype=self.dtype)
+        if not self.playing:
+            if not self.starts or self.depth() < self.target:
+                return out
+            self.playing = True
+            self.next_frame = self.starts[0]
+        elif self.depth() > 2 * self.max_depth:
+            # A burst after a stall; jump to the target rather than resampling
+            # through seconds of backlog.
+            skip = self.depth() - self.target
+            self.next_frame += skip
+            self.skipped_frames += skip
+
+        filled = 0
+        while filled < count:
+            if not self.starts:
+                self.playing = False
+                self.underruns += 1
+                break
+            start = self.starts[0]
+            data = self.packets[start]
+            end = start + data.shape[0]
+            if end <= self.next_frame:
+                heapq.heappop(self.starts)
+                del self.packets[start]
+                continue
+            if start > self.next_frame:
+                gap = min(start - self.next_frame, count - filled)
+                self._conceal(out[filled:filled + gap])
+                filled += gap
+                self.next_frame += gap
+                continue
+            offset = self.next_frame - start
+            take = min(end - self.next_frame, count - filled)
+            out[filled:filled + take] = data[offset:offset + take]
+            filled += take
+            self.next_frame += take
+            self.conceal_run = 0
+            if self.next_frame >= end:
+                heapq.heappop(self.starts)
+                del self.packets[start]
+
+        if filled:
+            keep = max(1, self.packet_frames)
+            self.history = out[max(0, filled - keep):filled].copy()
+        return out
+
+    def _conceal(self, gap: np.ndarray) -> None:
+        frames = gap.shape[0]
+        self.concealed_frames += frames
+        if self.history.shape[0] == 0 or self.conceal_run + frames > self.max_conceal:
+            return  # silence
+        # Repeat the most recent audio at half level to mask a short gap.
+        source = self.history // 2
+        reps = -(-frames // source.shape[0])
+        gap[:] = np.tile(source, (reps, 1))[:frames]
+        self.history = source
+        self.conceal_run += frames
+
+
+class LinearResampler:
+    """Fractional-ratio linear interpolator that carries its phase across calls.
+
+    A ratio above 1 consumes input faster than the nominal rate.
+    """
+
+    def __init__(self, channels: int, dtype: type) -> None:
+        self.dtype = dtype
+        self.tail = np.zeros((0, channels), dtype=np.float64)
+        self.phase = 0.0
+        info = np.iinfo(dtype)
+        self.limits = (info.min, info.max)
+
+    def process(self, source: Callable[[int], np.ndarray], count: int, ratio: float) -> np.ndarray:
+        positions = self.phase + np.arange(count) * ratio
+        needed = int(positions[-1]) + 2
+        if needed > self.tail.shape[0]:
+            fresh = source(needed - self.tail.shape[0]).astype(np.float64)
+            buffer = np.concatenate((self.tail, fresh)) if self.tail.shape[0] else fresh
+        else:
+            buffer = self.tail
+        index = positions.astype(np.int64)
+        weight = (positions - index)[:, None]
+        out = buffer[index] * (1.0 - weight) + buffer[index + 1] * weight
+
+        next_position = self.phase + count * ratio
+        consumed = int(next_position)
+        self.tail = buffer[consumed:]
+        self.phase = next_position - consumed
+        return np.clip(np.rint(out), *self.limits).astype(self.dtype)
+
+
+class ClockEstimator:
+    """Estimates a sender's sample clock rate relative to ours.
+
+    Fits stream frame index against time by least squares over a long sliding
+    window. Two sources feed it:
+
+    - clock anchors from the device, which pair a frame index with its
+      NTP-disciplined wall-clock capture time. They are immune to network
+      jitter, but the device clock only gets corrected at each time sync, so
+      they need a span covering several syncs;
+    - packet arrivals on our clock, reduced to the earliest arrival in each
+      second so queueing delay mostly drops out. Usable within a minute.
+
+    Anchors take over once they span long enough.
+    """
+
+    WINDOW = 6 * 3600.0
+    ARRIVAL_MIN_SPAN = 60.0
+    ANCHOR_MIN_SPAN = 1800.0
+    REFIT_INTERVAL = 10.0
+    MAX_OFFSET = 0.01  # reject fits implying a clock off by more than 1%
+
+    def __init__(self, nominal_rate: int) -> None:
+        self.nominal = float(nominal_rate)
+        self.arrivals: Deque[Tuple[float, int]] = deque()
+        self.anchors: Deque[Tuple[float, int]] = deque()
+        self.bucket = -1
+        self.bucket_best: Optional[Tuple[float, float, int]] = None
+        self.last_fit = 0.0
+        self.ratio: Optional[float] = None
+        self.source = "none"
+
+    def add_arrival(self, frame: int, arrival: float) -> None:
+        offset = arrival - frame / self.nominal
+        bucket = int(arrival)
+        if bucket != self.bucket:
+            if self.bucket_best is not None:
+                _, best_arrival, best_frame = self.bucket_best
+                self._append(self.arrivals, best_arrival, best_frame)
+            self.bucket = bucket
+            self.bucket_best = (offset, arrival, frame)
+        elif offset < self.bucket_best[0]:
+            self.bucket_best = (offset, arrival, frame)
+
+    def add_anchor(self, frame: int, wall_time_us: int) -> None:
+        if self.anchors and frame <= self.anchors[-1][1]:
+            if frame == self.anchors[-1][1]:
+                return  # duplicate datagram
+            self.anchors.clear()  # the sender restarted its stream
+        self._append(self.anchors, wall_time_us / 1e6, frame)
+
+    def update(self, now: float) -> Optional[float]:
+        """Refits at most every REFIT_INTERVAL seconds; returns the ratio (None until known)."""
+        if now - self.last_fit < self.REFIT_INTERVAL:
+            return self.ratio
+        self.last_fit = now
+        for source, points, min_span in (
+            ("anchors", self.anchors, self.ANCHOR_MIN_SPAN),
+            ("arrivals", self.arrivals, self.ARRIVAL_MIN_SPAN),
+        ):
+            if len(points) < 3 or points[-1][0] - points[0][0] < min_span:
+                continue
+            times = np.fromiter((p[0] for p in points), dtype=np.float64, count=len(points))
+            frames = np.fromiter((p[1] for p in points), dtype=np.float64, count=len(points))
+            slope = np.polyfit(times - times[0], frames - frames[0], 1)[0]
+            ratio = slope / self.nominal
+            if abs(ratio - 1.0) <= self.MAX_OFFSET:
+                self.ratio = ratio
+                self.source = source
+                break
+        return self.ratio
+
+    def _append(self, points: Deque[Tuple[float, int]], when: float, frame: int) -> None:
+        points.append((when, frame))
+        while points[-1][0] - points[0][0] > self.WINDOW:
+            points.popleft()
+
+
+class DriftController:
+    """Turns the clock estimate and jitter-buffer depth into a resampling ratio.
+
+    The measured clock ratio, when there is one, is applied directly; on top of
+    it, proportional-integral control on the smoothed depth trims whatever
+    error is left (or all of it, before the estimate settles), so the depth
+    holds at the target instead of creeping toward an underrun or overflow.
+    """
+
+    KP = 0.02  # ratio per second of depth error
+    KI = 0.0005  # ratio per second of error per second
+    LIMIT = 0.005
+    SMOOTHING = 2.0  # seconds; hides the per-packet sawtooth in the depth
+
+    def __init__(self) -> None:
+        self.error = 0.0
+        self.integral = 0.0
+        self.ratio = 1.0
+
+    def update(self, depth_s: float, target_s: float, dt: float, clock_ratio: Optional[float]) -> float:
+        self.error += (depth_s - target_s - self.error) * min(1.0, dt / self.SMOOTHING)
+        self.integral = max(-self.LIMIT, min(self.LIMIT, self.integral + self.KI * self.error * dt))
+        trim = max(-self.LIMIT, min(self.LIMIT, self.KP * self.error + self.integral))
+        self.ratio = (clock_ratio or 1.0) + trim
+        return self.ratio
+
+
+class WavSink:
+    def __init__(self, path: str, fmt: StreamFormat) -> None:
+        self.path = path
+        self.dtype = np.dtype(fmt.dtype).newbyteorder("<")
+        self.file = wave.open(path, "wb")
+        self.file.setnchannels(fmt.channels)
+        self.file.setsampwidth(self.dtype.itemsize)
+        self.file.setframerate(fmt.sample_rate)
+
+    def write(self, block: np.ndarray) -> None:
+        self.file.writeframes(block.astype(self.dtype, copy=False).tobytes())
+
+    def close(self) -> None:
+        self.file.close()
+
+
+class FdSink:
+    """Writes raw little-endian frames to a file descriptor without ever blocking ingest.
 
-def parse_args() -> argparse.Namespace:
-    parser = argparse.ArgumentParser(description=__doc__)
+    Anything the reader can't take immediately is queued up to a limit; past
+    that, whole blocks are dropped and counted.
+    """
+
+    def __init__(self, fd: int, fmt: StreamFormat, name: str) -> None:
+        self.fd = fd
+        self.name = name
+        self.dtype = np.dtype(fmt.dtype).newbyteorder("<")
+        self.limit = fmt.sample_rate * fmt.channels * self.dtype.itemsize  # one second
+        self.pending = bytearray()
+        self.dropped = 0
+        self.closed = False
+        os.set_blocking(fd, False)
+
+    def write(self, block: np.ndarray) -> None:
+        if self.closed:
+            return
+        data = block.astype(self.dtype, copy=False).tobytes()
+        if len(self.pending) + len(data) > self.limit:
+            self.dropped += 1
+        else:
+            self.pending += data
+        try:
+            written = os.write(self.fd, self.pending)
+        except BlockingIOError:
+            return
+        except (BrokenPipeError, OSError) as err:
+            log(f"{self.name}: output closed ({err})")
+            self.closed = True
+            return
+        del self.pending[:written]
+
+    def close(self) -> None:
+        self.closed = True
+
+
+class PipeSink(FdSink):
+    def __init__(self, command: str, fmt: StreamFormat, name: str) -> None:
+        self.process = subprocess.Popen(command, shell=True, stdin=subprocess.PIPE)
+        super().__init__(self.process.stdin.fileno(), fmt, name)
+
+    def close(self) -> None:
+        super().close()
+        self.process.stdin.close()
+        try:
+            self.process.wait(timeout=2.0)
+        except subprocess.TimeoutExpired:
+            self.process.terminate()
+
+
+class PlaySink:
+    """Plays one stream on the default output device.
+
+    The device clock is independent of ours, so its FIFO is capped at half a
+    second and padded with silence on underrun.
+    """
+
+    def __init__(self, fmt: StreamFormat) -> None:
+        import sounddevice as sd  # only needed for playback
+
+        self.channels = fmt.channels
+        self.dtype = fmt.dtype
+        self.limit = fmt.sample_rate // 2
+        self.blocks: Deque[np.ndarray] = deque()
+        self.queued = 0
+        self.pending = np.zeros((0, self.channels), dtype=self.dtype)
+        self.underruns = 0
+        self.lock = threading.Lock()
+        self.stream = sd.OutputStream(
+            samplerate=fmt.sample_rate, channels=fmt.channels, dtype=self.dtype, callback=self._callback
+        )
+        self.stream.start()
+
+    def write(self, block: np.ndarray) -> None:
+        with self.lock:
+            self.blocks.append(block)
+            self.queued += block.shape[0]
+            while self.queued > self.limit:
+                self.queued -= self.blocks.popleft().shape[0]
+
+    def _callback(self, outdata: np.ndarray, frames: int, time_info, status) -> None:
+        parts = [self.pending]
+        available = self.pending.shape[0]
+        with self.lock:
+            while available < frames and self.blocks:
+                block = self.blocks.popleft()
+                self.queued -= block.shape[0]
+                parts.append(block)
+                available += block.shape[0]
+        data = np.concatenate(parts) if len(parts) > 1 else self.pending
+        if available < frames:
+            self.underruns += 1
+            outdata[:available] = data
+            outdata[available:] = 0
+            self.pending = data[:0]
+            return
+        outdata[:] = data[:frames]
+        self.pending = data[frames:]
+
+    def close(self) -> None:
+        self.stream.stop()
+        self.stream.close()
+
+
+class SinkFactory:
+    """Opens the configured outputs for each new stream.
+
+    WAV files and pipes are per stream; stdout and the sound card go to the
+    first stream that claims them and are released when it goes idle.
+    """
+
+    def __init__(self, args: argparse.Namespace) -> None:
+        self.wav_dir = args.wav_dir
+        self.pipe = args.pipe
+        self.stdout = args.stdout
+        self.play = args.play or not (args.wav_dir or args.pipe or args.stdout)
+        self.owners: Dict[str, Hashable] = {}
+        if self.wav_dir:
+            os.makedirs(self.wav_dir, exist_ok=True)
+
+    def open(self, stream: "Stream") -> List:
+        fmt = stream.format
+        sinks: List = []
+        if self.wav_dir:
+            path = os.path.join(self.wav_dir, f"{stream.name}_{time.strftime('%Y%m%d-%H%M%S')}.wav")
+            sinks.append(WavSink(path, fmt))
+            log(f"{stream.name}: recording to {path}")
+        if self.pipe:
+            command = self.pipe.format(
+                name=stream.name, rate=fmt.sample_rate, channels=fmt.channels,
+                bits=np.dtype(fmt.dtype).itemsize * 8,
+            )
+            sinks.append(PipeSink(command, fmt, stream.name))
+        if self.stdout and self._claim("stdout", stream):
+            sinks.append(FdSink(sys.stdout.fileno(), fmt, "stdout"))
+            log(f"{stream.name}: writing raw audio to stdout")
+        if self.play and self._claim("play", stream):
+            sinks.append(PlaySink(fmt))
+            log(f"{stream.name}: playing")
+        return sinks
+
+    def release(self, stream: "Stream") -> None:
+        for output in [o for o, key in self.owners.items() if key == stream.key]:
+            del self.owners[output]
+
+    def _claim(self, output: str, stream: "Stream") -> bool:
+        if output in self.owners:
+            return False
+        self.owners[output] = stream.key
+        return True
+
+
+class Stream:
+    """Everything the server keeps for one sender."""
+
+    def __init__(self, key: Hashable, name: str, fmt: StreamFormat, args: argparse.Namespace, sinks: List) -> None:
+        self.key = key
+        self.name = name
+        self.format = fmt
+        self.sinks = sinks
+        self.byte_order_little = args.byte_order == "little"
+        self.tracker = StreamTracker()
+        self.fec = FecReassembler()
+        self.jitter = JitterBuffer(fmt, args.min_delay_ms, args.max_delay_ms, args.max_conceal_ms)
+        self.resampler = LinearResampler(fmt.channels, fmt.dtype)
+        self.drift = DriftController()
+        self.clock = ClockEstimator(fmt.sample_rate)
+        self.frame_base: Optional[int] = None
+        self.frame_raw = 0
+        self.last_arrival = 0.0
+        self.last_playout: Optional[float] = None
+        self.due = 0.0
+        self.packets = 0
+        self.bytes = 0
+        self.warned_codec = False
+
+    def receive(self, payload: bytes, header: Optional[PacketHeader], arrival: float) -> None:
+        self.last_arrival = arrival
+        self.bytes += len(payload)
+        if header is None:
+            self._receive_headerless(payload, arrival)
+            return
+        if header.anchored:
+            self.clock.add_anchor((header.frame_counter_high << 32) | header.frame_counter, header.wall_time_us)
+        if header.flags & FLAG_KEEPALIVE:
+            # The sender is gated by voice activity; nothing to play.
+            self.tracker.keepalives += 1
+            return
+        if header.flags & FLAG_PARITY:
+            ready = self.fec.add_parity(header, payload[header.header_length:])
+        else:
+            ready = self.fec.add_packet(header.sequence, payload)
+        for packet in ready:
+            self._receive_packet(packet, arrival)
+
+    def _receive_packet(self, packet: bytes, arrival: float) -> None:
+        header = parse_header(packet)
+        if header is None:
+            return
+        data = decode_payload(header, packet[header.header_length:])
+        if data is None:
+            if not self.warned_codec:
+                log(f"{self.name}: unsupported codec {header.codec}; skipping")
+                self.warned_codec = True
+            return
+        channels = self.format.channels
+        frames = data.shape[0] // channels
+        self.tracker.update(header, arrival)
+        self.packets += 1
+        frame = self._unwrap_frame(header.frame_counter)
+        self.clock.add_arrival(frame, arrival)
+        self.jitter.push(frame, data[:frames * channels].reshape(frames, channels), arrival)
+
+    def _receive_headerless(self, payload: bytes, arrival: float) -> None:
+        fmt = self.format
+        frame_bytes = fmt.bits // 8 * fmt.channels
+        frames = len(payload) // frame_bytes
+        data = decode_pcm(payload[:frames * frame_bytes], fmt.bits, self.byte_order_little)
+        self.packets += 1
+        # No frame counter on the wire; assume packets arrive in order.
+        self.clock.add_arrival(self.frame_raw, arrival)
+        self.jitter.push(self.frame_raw, data.reshape(frames, fmt.channels), arrival)
+        self.frame_raw += frames
+
+    def _unwrap_frame(self, counter: int) -> int:
+        if self.frame_base is None:
+            self.frame_base = counter
+            self.frame_raw = counter
+        self.frame_base += seq_delta(counter, self.frame_raw)
+        self.frame_raw = counter
+        return self.frame_base
+
+    def play_out(self, now: float) -> None:
+        if self.last_playout is None:
+            self.last_playout = now
+            return
+        dt = now - self.last_playout
+        self.last_playout = now
+        rate = self.format.sample_rate
+        self.due += dt * rate
+        count = int(self.due)
+        if count == 0:
+            return
+        self.due -= count
+        self.jitter.update_target(now)
+        clock_ratio = self.clock.update(now)
+        block = self.resampler.process(self.jitter.pull, count, self.drift.ratio)
+        # Measured after the pull, so the block just played doesn't count as reserve.
+        if self.jitter.playing:
+            self.drift.update(self.jitter.depth() / rate, self.jitter.target / rate, dt, clock_ratio)
+        for sink in self.sinks:
+            sink.write(block)
+
+    def _clock_summary(self) -> str:
+        if self.clock.ratio is None:
+            return "measuring"
+        return f"{(self.clock.ratio - 1.0) * 1e6:+.1f} ppm ({self.clock.source})"
+
+    def close(self) -> None:
+        for sink in self.sinks:
+            sink.close()
+        self.sinks = []
+
+    def summary(self, elapsed: float) -> str:
+        rate = self.format.sample_rate
+        line = (
+            f"{self.name}: {self.packets / elapsed:.0f} pkt/s, {self.bytes / elapsed / 1000:.1f} kB/s, "
+            f"depth {1000 * self.jitter.depth() / rate:.0f}/{1000 * self.jitter.target / rate:.0f} ms, "
+            f"ratio {(self.drift.ratio - 1.0) * 1e6:+.0f} ppm, clock: {self._clock_summary()}, late: {self.jitter.late}, "
+            f"concealed: {1000 * self.jitter.concealed_frames / rate:.0f} ms, underruns: {self.jitter.underruns}"
+        )
+        if self.format.headered:
+            line += f", {self.tracker.summary()}"
+        if self.fec.active:
+            expected = max(1, self.tracker.received + self.tracker.lost)
+            line += (
+                f", FEC recovered: {self.fec.recovered} ({100.0 * self.fec.recovered / expected:.2f}%), "
+                f"unrecoverable: {self.tracker.lost} ({100.0 * self.tracker.lost / expected:.2f}%)"
+            )
+        self.packets = 0
+        self.bytes = 0
+        return line
+
+
+class _IoVec(ctypes.Structure):
+    _fields_ = [("iov_base", ctypes.c_void_p), ("iov_len", ctypes.c_size_t)]
+
+
+class _MsgHdr(ctypes.Structure):
+    _fields_ = [
+        ("msg_name", ctypes.c_void_p),
+        ("msg_namelen", ctypes.c_uint32),
+        ("msg_iov", ctypes.POINTER(_IoVec)),
+        ("msg_iovlen", ctypes.c_size_t),
+        ("msg_control", ctypes.c_void_p),
+        ("msg_controllen", ctypes.c_size_t),
+        ("msg_flags", ctypes.c_int),
+    ]
+
+
+class _MMsgHdr(ctypes.Structure):
+    _fields_ = [("msg_hdr", _MsgHdr), ("msg_len", ctypes.c_uint)]
+
+
+def _load_recvmmsg():
+    if not sys.platform.startswith("linux"):
+        return None
+    try:
+        function = ctypes.CDLL(None, use_errno=True).recvmmsg
+    except (OSError, AttributeError):
+        return None
+    function.argtypes = [ctypes.c_int, ctypes.POINTER(_MMsgHdr), ctypes.c_uint, ctypes.c_int, ctypes.c_void_p]
+    function.restype = ctypes.c_int
+    return function
+
+
+class BatchReceiver:
+    """Drains a non-blocking UDP socket a batch at a time.
+
+    On Linux each batch is one recvmmsg() call through ctypes; elsewhere it
+    falls back to a recvfrom_into() loop over the same preallocated slots.
+    Source addresses are decoded once and cached.
+    """
+
+    SLOT_SIZE = 65536
+    NAME_SIZE = 128  # sizeof(struct sockaddr_storage)
+
+    def __init__(self, sock: socket.socket, batch: int) -> None:
+        self.sock = sock
+        self.batch = max(1, batch)
+        self.buffer = bytearray(self.SLOT_SIZE * self.batch)
+        self.view = memoryview(self.buffer)
+        self.addresses: Dict[bytes, Tuple[str, int]] = {}
+        self.syscalls = 0
+        sock.setblocking(False)
+
+        self._recvmmsg = _load_recvmmsg()
+        if self._recvmmsg is None:
+            return
+        self.names = bytearray(self.NAME_SIZE * self.batch)
+        data = (ctypes.c_char * len(self.buffer)).from_buffer(self.buffer)
+        names = (ctypes.c_char * len(self.names)).from_buffer(self.names)
+        base = ctypes.addressof(data)
+        name_base = ctypes.addressof(names)
+        self._keep = (data, names)
+        self.iovecs = (_IoVec * self.batch)()
+        self.headers = (_MMsgHdr * self.batch)()
+        for i in range(self.batch):
+            self.iovecs[i].iov_base = base + i * self.SLOT_SIZE
+            self.iovecs[i].iov_len = self.SLOT_SIZE
+            header = self.headers[i].msg_hdr
+            header.msg_name = name_base + i * self.NAME_SIZE
+            header.msg_namelen = self.NAME_SIZE
+            header.msg_iov = ctypes.pointer(self.iovecs[i])
+            header.msg_iovlen = 1
+        self.used = 0
+
+    @property
+    def batched(self) -> bool:
+        return self._recvmmsg is not None
+
+    def wait(self, timeout: float) -> bool:
+        readable, _, _ = select.select([self.sock], [], [], max(0.0, timeout))
+        return bool(readable)
+
+    def receive(self) -> List[Tuple[bytes, Tuple[str, int]]]:
+        """Returns up to one batch of (payload, address) without blocking."""
+        self.syscalls += 1
+        if self._recvmmsg is None:
+            return self._receive_loop()
+        headers = self.headers
+        for i in range(self.used):
+            headers[i].msg_hdr.msg_namelen = self.NAME_SIZE
+        count = self._recvmmsg(self.sock.fileno(), headers, self.batch, socket.MSG_DONTWAIT, None)
+        if count < 0:
+            err = ctypes.get_errno()
+            self.used = 0
+            if err in (errno.EAGAIN, errno.EWOULDBLOCK, errno.EINTR):
+                return []
+            raise OSError(err, os.strerror(err))
+        self.used = count
+        packets = []
+        for i in range(count):
+            entry = headers[i]
+            start = i * self.NAME_SIZE
+            name = bytes(self.names[start:start + entry.msg_hdr.msg_namelen])
+            address = self.addresses.get(name) or self._decode_address(name)
+            start = i * self.SLOT_SIZE
+            packets.append((self.view[start:start + entry.msg_len].tobytes(), address))
+        return packets
+
+    def _receive_loop(self) -> List[Tuple[bytes, Tuple[str, int]]]:
+        packets = []
+        for i in range(self.batch):
+            slot = self.view[i * self.SLOT_SIZE:(i + 1) * self.SLOT_SIZE]
+            try:
+                length, address = self.sock.recvfrom_into(slot)
+            except (BlockingIOError, InterruptedError):
+                break
+            packets.append((slot[:length].tobytes(), address[:2]))
+        return packets
+
+    def _decode_address(self, name: bytes) -> Tuple[str, int]:
+        family = int.from_bytes(name[:2], sys.byteorder)
+        port = int.from_bytes(name[2:4], "big")
+        if family == socket.AF_INET6:
+            address = (socket.inet_ntop(socket.AF_INET6, name[8:24]), port)
+        else:
+            address = (socket.inet_ntop(socket.AF_INET, name[4:8]), port)
+        if len(self.addresses) > 4096:
+            self.addresses.clear()
+        self.addresses[name] = address
+        return address
+
+
+class TcpReceiver:
+    """Accepts streamers using the TCP transport and splits their byte streams back into packets.
+
+    Each packet arrives exactly as it would have as a datagram, behind a
+    big-endian u16 length. A connection that drops mid-frame loses only that
+    frame; the sender starts its next connection on a frame boundary.
+    """
+
+    READ_SIZE = 65536
+
+    def __init__(self, sock: socket.socket) -> None:
+        self.sock = sock
+        sock.setblocking(False)
+        self.connections: Dict[socket.socket, Tuple[Tuple[str, int], bytearray]] = {}
+        self.accepted = 0
+        self.frames_cut = 0
+
+    def sockets(self) -> List[socket.socket]:
+        return [self.sock, *self.connections]
+
+    def receive(self, ready: List[socket.socket]) -> List[Tuple[bytes, Tuple[str, int]]]:
+        """Reads whatever the ready sockets hold and returns the complete packets."""
+        packets: List[Tuple[bytes, Tuple[str, int]]] = []
+        for sock in ready:
+            if sock is self.sock:
+                self._accept()
+                continue
+            address, pending = self.connections[sock]
+            try:
+                data = sock.recv(self.READ_SIZE)
+            except (BlockingIOError, InterruptedError):
+                continue
+            except OSError as err:
+                log(f"{address[0]}:{address[1]}: connection failed ({err.strerror})")
+                data = b""
+            if not data:
+                if pending:
+                    log(f"{address[0]}:{address[1]}: disconnected mid-frame, {len(pending)} bytes discarded")
+                    self.frames_cut += 1
+                self._close(sock)
+                continue
+            pending += data
+            offset = 0
+            while len(pending) - offset >= FRAME_PREFIX.size:
+                (length,) = FRAME_PREFIX.unpack_from(pending, offset)
+                end = offset + FRAME_PREFIX.size + length
+                if end > len(pending):
+                    break
+                packets.append((bytes(pending[offset + FRAME_PREFIX.size:end]), address))
+                offset = end
+            del pending[:offset]
+        return packets
+
+    def _accept(self) -> None:
+        while True:
+            try:
+                conn, address = self.sock.accept()
+            except (BlockingIOError, InterruptedError):
+                return
+            conn.setblocking(False)
+            self.connections[conn] = (address[:2], bytearray())
+            self.accepted += 1
+
+    def _close(self, sock: socket.socket) -> None:
+        del self.connections[sock]
+        sock.close()
+
+    def close(self) -> None:
+        for sock in list(self.connections):
+            self._close(sock)
+
+
+class IngestServer:
+    """Single-threaded event loop: drain the sockets in batches, then play every stream out on a fixed tick."""
+
+    def __init__(
+        self, sock: socket.socket, args: argparse.Namespace, sinks: Optional[SinkFactory],
+        tcp: Optional[socket.socket] = None,
+    ) -> None:
+        self.args = args
+        self.receiver = BatchReceiver(sock, args.batch)
+        self.tcp = TcpReceiver(tcp) if tcp is not None else None
+        self.sink_factory = sinks
+        self.streams: Dict[Hashable, Stream] = {}
+        self.tick = args.tick_ms / 1000.0
+        self.total_packets = 0
+        self.total_bytes = 0
+        self.ignored = 0
+        self.stop_requested = False
+
+    def ingest(self, payload: bytes, address: Tuple[str, int], arrival: float) -> None:
+        self.total_packets += 1
+        self.total_bytes += len(payload)
+        args = self.args
+        key = address[0] if args.key == "host" else address
+        stream = self.streams.get(key)
+        if not payload:
+            # Headerless keepalive.
+            if stream is not None:
+                stream.last_arrival = arrival
+            return
+        header = parse_header(payload)
+        if header is not None:
+            fmt = StreamFormat(header.sample_rate, header.channels, header.bits, header.codec, True)
+        else:
+            fmt = StreamFormat(args.sample_rate, args.channels, args.bits, CODEC_PCM, False)
+        if stream is not None and stream.format != fmt:
+            # Parity and keepalive packets carry the stream's format too, so a
+            # mismatch means the sender was reconfigured.
+            log(f"{stream.name}: format changed to {fmt.describe()}")
+            self._close_stream(stream)
+            stream = None
+        if stream is None:
+            if len(self.streams) >= args.max_streams:
+                self.ignored += 1
+                return
+            host = address[0].replace(":", "-")
+            name = host if args.key == "host" else f"{host}_{address[1]}"
+            stream = Stream(key, name, fmt, args, [])
+            if self.sink_factory is not None:
+                stream.sinks = self.sink_factory.open(stream)
+            self.streams[key] = stream
+            log(f"New stream {name}: {fmt.describe()}")
+        stream.receive(payload, header, arrival)
+
+    def poll(self, timeout: float) -> int:
+        """Waits up to timeout for traffic and ingests everything queued. Returns packets read."""
+        if self.tcp is not None:
+            return self._poll_with_tcp(timeout)
+        if not self.receiver.wait(timeout):
+            return 0
+        return self._drain_udp()
+
+    def _poll_with_tcp(self, timeout: float) -> int:
+        udp = self.receiver.sock
+        readable, _, _ = select.select([udp, *self.tcp.sockets()], [], [], max(0.0, timeout))
+        total = 0
+        if udp in readable:
+            readable.remove(udp)
+            total = self._drain_udp()
+        packets = self.tcp.receive(readable)
+        arrival = time.monotonic()
+        for payload, address in packets:
+            self.ingest(payload, address, arrival)
+        return total + len(packets)
+
+    def _drain_udp(self) -> int:
+        total = 0
+        while True:
+            packets = self.receiver.receive()
+            arrival = time.monotonic()
+            for payload, address in packets:
+                self.ingest(payload, address, arrival)
+            total += len(packets)
+            if len(packets) < self.receiver.batch:
+                return total
+
+    def play_out(self, now: float) -> None:
+        for stream in list(self.streams.values()):
+            if now - stream.last_arrival > self.args.idle_timeout:
+                log(f"{stream.name}: idle, closing")
+                self._close_stream(stream)
+                continue
+            stream.play_out(now)
+
+    def run(self, duration: Optional[float] = None) -> None:
+        start = time.monotonic()
+        next_tick = start + self.tick
+        stats_interval = self.args.stats_interval
+        next_stats = start + stats_interval
+        last_stats = start
+        last_cpu = time.process_time()
+        last_packets = 0
+        while not self.stop_requested:
+            now = time.monotonic()
+            if duration is not None and now - start >= duration:
+                break
+            self.poll(next_tick - now)
+            now = time.monotonic()
+            if now >= next_tick:
+                self.play_out(now)
+                next_tick += self.tick
+                if next_tick < now:
+                    next_tick = now + self.tick
+            if stats_interval > 0 and now >= next_stats:
+                elapsed = now - last_stats
+                cpu = time.process_time()
+                streams = max(1, len(self.streams))
+                cpu_percent = 100.0 * (cpu - last_cpu) / elapsed
+                for stream in self.streams.values():
+                    log(stream.summary(elapsed))
+                log(
+                    f"Total: {len(self.streams)} streams, {(self.total_packets - last_packets) / elapsed:.0f} pkt/s, "
+                    f"CPU {cpu_percent:.1f}% ({cpu_percent / streams:.2f}% per stream), ignored: {self.ignored}"
+                )
+                last_stats, last_cpu, last_packets = now, cpu, self.total_packets
+                next_stats = now + stats_interval
+
+    def close(self) -> None:
+        for stream in list(self.streams.values()):
+            self._close_stream(stream)
+        if self.tcp is not None:
+            self.tcp.close()
+
+    def _close_stream(self, stream: Stream) -> None:
+        stream.close()
+        if self.sink_factory is not None:
+            self.sink_factory.release(stream)
+        del self.streams[stream.key]
+
+
+def open_socket(args: argparse.Namespace) -> socket.socket:
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    # Absorb bursts from many senders while the loop is busy playing out.
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, args.rcvbuf)
+    sock.bind((args.host, args.port))
+    if args.multicast_group:
+        # Join on the default interface.
+        membership = socket.inet_aton(args.multicast_group) + socket.inet_aton("0.0.0.0")
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+        log(f"Joined multicast group {args.multicast_group}")
+    return sock
+
+
+def open_tcp_socket(args: argparse.Namespace) -> socket.socket:
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind((args.host, args.port))
+    sock.listen(args.max_streams)
+    return sock
+
+
+def parse_args(argv: Optional[List[str]] = None) -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
     parser.add_argument("--host", default="0.0.0.0", help="IP to bind the UDP listener")
     parser.add_argument("--port", type=int, default=7000, help="UDP port to bind")
-    parser.add_argument("--sample-rate", type=int, default=16000, help="Sample rate in Hz")
-    parser.add_argument("--channels", type=int, default=1, choices=(1, 2), help="Channel count")
-    parser.add_argument("--bits", type=int, default=16, choices=(16, 24, 32), help="Bits per sample")
     parser.add_argument(
-        "--queue-len", type=int, default=64, help="Number of packets to buffer before playback"
+        "--tcp", action="store_true",
+        help="Also accept streamers using transport: tcp on the same port number"
     )
     parser.add_argument(
-        "--prefill", type=float, default=0.5,
-        help="Fraction of the queue to fill before starting playback (0.0-1.0)"
+        "--multicast-group", default=None,
+        help="IPv4 multicast group to join (for streamers sending to a multicast destination)"
     )
     parser.add_argument(
-        "--record", type=str, default=None,
-        help="Optional path to save audio as a WAV file"
+        "--key", default="address", choices=("address", "host"),
+        help="Identify streams by source address and port, or by host alone (survives sender restarts)"
     )
-    return parser.parse_args()
+    parser.add_argument("--max-streams", type=int, default=64, help="Ignore senders beyond this many")
+    parser.add_argument("--idle-timeout", type=float, default=30.0, help="Close a stream after this many idle seconds")
+    parser.add_argument("--batch", type=int, default=32, help="Datagrams read per receive call")
+    parser.add_argument("--rcvbuf", type=int, default=4 << 20, help="Socket receive buffer size in bytes")
+
+    headerless = parser.add_argument_group("streams without a packet header")
+    headerless.add_argument("--sample-rate", type=int, default=16000, help="Sample rate in Hz")
+    headerless.add_argument("--channels", type=int, default=1, choices=(1, 2), help="Channel count")
+    headerless.add_argument("--bits", type=int, default=16, choices=(16, 24, 32), help="Bits per sample")
+    headerless.add_argument(
+        "--byte-order", default="big", choices=("big", "little"),
+        help="Payload byte order (matches the streamer's byte_order)"
+    )
+
+    playout = parser.add_argument_group("jitter buffer")
+    playout.add_argument("--min-delay-ms", type=int, default=40, help="Lowest jitter buffer target")
+    playout.add_argument("--max-delay-ms", type=int, default=500, help="Highest jitter buffer target")
+    playout.add_argument(
+        "--max-conceal-ms", type=int, default=100,
+        help="Longest gap to mask by repeating recent audio; longer gaps play silence"
+    )
+    playout.add_argument("--tick-ms", type=int, default=20, help="Playout interval")
+    playout.add_argument("--stats-interval", type=float, default=5.0, help="Seconds between stats lines (0 disables)")
+
+    outputs = parser.add_argument_group("outputs (default: --play)")
+    outputs.add_argument("--wav-dir", default=None, help="Write each stream to <dir>/<sender>_<start time>.wav")
+    outputs.add_argument(
+        "--pipe", default=None,
+        help="Shell command to start per stream, fed raw little-endian frames on stdin; "
+             "{name}, {rate}, {channels} and {bits} are substituted"
+    )
+    outputs.add_argument("--stdout", action="store_true", help="Write the first stream's raw frames to stdout")
+    outputs.add_argument("--play", action="store_true", help="Play the first stream on the default output device")
+    return parser.parse_args(argv)
 
 
 def main() -> None:
     args = parse_args()
-    dtype_info = DTYPE_MAP.get(args.bits)
-    if dtype_info is None:
-        raise SystemExit(f"Unsupported bit depth: {args.bits}")
-    buffer_dtype, stream_dtype = dtype_info
-    bytes_per_sample = 4 if args.bits == 24 else args.bits // 8
-
-    queue_capacity = max(4, args.queue_len)
-    pkt_queue: queue.Queue[np.ndarray] = queue.Queue(maxsize=queue_capacity)
-    packet_stats = {"bytes": 0, "packets": 0, "last_log": time.monotonic(), "underruns": 0}
-    block_frames = None
-    stop_event = threading.Event()
-
-    def udp_reader(sock: socket.socket) -> None:
-        nonlocal block_frames
-        try:
-            while not stop_event.is_set():
-                payload, addr = sock.recvfrom(65535)
-                if not payload:
-                    continue
-
-                if block_frames is None:
-                    samples = len(payload) // (bytes_per_sample * args.channels)
-                    if samples == 0:
-                        print("Received undersized packet; skipping")
-                        continue
-                    block_frames = samples
-                    print(
-                        f"Detected frame: {len(payload)} bytes ({samples} samples) from {addr[0]}:{addr[1]}"
-                    )
-
-                if args.bits == 24:
-                    data = np.frombuffer(payload, dtype=buffer_dtype, count=block_frames * args.channels)
-                    data = (data >> 8).astype(np.int32)
-                else:
-                    data = np.frombuffer(payload, dtype=buffer_dtype, count=block_frames * args.channels)
-
-                try:
-                    pkt_queue.put_nowait(data)
-                except queue.Full:
-                    try:
-                        pkt_queue.get_nowait()
-                    except queue.Empty:
-                        pass
-                    pkt_queue.put_nowait(data)
-
-                packet_stats["bytes"] += len(payload)
-                packet_stats["packets"] += 1
-        except OSError:
-            pass
-
-    with closing(socket.socket(socket.AF_INET, socket.SOCK_DGRAM)) as sock:
-        sock.bind((args.host, args.port))
-        sock.settimeout(None)
-        print(f"Listening on {args.host}:{args.port} ({args.sample_rate} Hz, {args.channels} ch, {args.bits}-bit)")
-
-        reader = threading.Thread(target=udp_reader, args=(sock,), name="udp-reader", daemon=True)
-        reader.start()
-
+    sinks = SinkFactory(args)
+    with open_socket(args) as sock, contextlib.ExitStack() as stack:
+        tcp = stack.enter_context(open_tcp_socket(args)) if args.tcp else None
+        server = IngestServer(sock, args, sinks, tcp)
+        log(
+            f"Listening on {args.host}:{args.port}{' (UDP and TCP)' if tcp else ''} "
+            f"({'recvmmsg' if server.receiver.batched else 'recvfrom'} batches of {args.batch})"
+        )
         try:
-            target_prefill = max(1, int(queue_capacity * max(0.0, min(args.prefill, 1.0))))
-            while block_frames is None or pkt_queue.qsize() < target_prefill:
-                time.sleep(0.01)
-
-            def callback(outdata: np.ndarray, frames: int, time_info, status) -> None:
-                nonlocal packet_stats
-                try:
-                    data = pkt_queue.get_nowait()
-                except queue.Empty:
-                    data = np.zeros(frames * args.channels, dtype=stream_dtype)
-                    packet_stats["underruns"] += 1
-
-                if data.shape[0] != frames * args.channels:
-                    padded = np.zeros(frames * args.channels, dtype=stream_dtype)
-                    count = min(data.shape[0], padded.shape[0])
-                    padded[:count] = data[:count]
-                    data = padded
-
-                outdata[:] = data.reshape(-1, args.channels)
-
-                now = time.monotonic()
-                elapsed = now - packet_stats["last_log"]
-                if elapsed >= 1.0:
-                    rate = packet_stats["bytes"] / elapsed if packet_stats["bytes"] else 0.0
-                    print(
-                        f"Rate: {rate:.0f} B/s, packets: {packet_stats['packets']}, underruns: {packet_stats['underruns']}"
-                    )
-                    packet_stats["bytes"] = 0
-                    packet_stats["packets"] = 0
-                    packet_stats["underruns"] = 0
-                    packet_stats["last_log"] = now
-
-            with sd.OutputStream(
-                samplerate=args.sample_rate,
-                channels=args.channels,
-                dtype=stream_dtype,
-                blocksize=block_frames,
-                callback=callback,
-            ):
-                print("Streaming audio... Press Ctrl+C to stop")
-                while True:
-                    time.sleep(1)
+            server.run()
         except KeyboardInterrupt:
-            print("\nStopping receiver")
+            log("Stopping receiver")
         finally:
-            stop_event.set()
+            server.close()
 
 
 if __name__ == "__main__":
@@ -0,0 +1,223 @@
+// Times the G.711 and IMA-ADPCM encoders per sample. On x86 the figure is
+// also given in TSC ticks, which track cycles at the nominal clock; the
+// ESP32 figure is what matters, so compare runs of the same machine only.
+// Then each of the recorder's codecs, FLAC included, per second of audio
+// and with the compression it reaches.
+
+#include "host_bench.h"
+
+#include "esphome/components/pcm_utils/flac_encoder.h"
+#include "esphome/components/pcm_utils/g711.h"
+#include "esphome/components/pcm_utils/ima_adpcm.h"
+#include "test_signal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace esphome;
+using host_bench::keep;
+
+namespace {
+
+// One second of 16 kHz audio per call, enough to amortise the call itself.
+constexpr size_t FRAMES = 16000;
+
+/// TSC ticks per nanosecond, or zero where there is no TSC to read.
+double ticks_per_ns() {
+#if defined(__x86_64__) || defined(__i386__)
+  static const double rate = [] {
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    const uint64_t ticks = __rdtsc();
+    while (clock::now() - start < std::chrono::milliseconds(20)) {
+    }
+    const uint64_t elapsed_ticks = __rdtsc() - ticks;
+    const auto elapsed = clock::now() - start;
+    return static_cast<double>(elapsed_ticks) /
+           std::chrono::duration<double, std::nano>(elapsed).count();
+  }();
+  return rate;
+#else
+  return 0.0;
+#endif
+}
+
+void report_per_sample(const char *name, double ns_per_call, size_t samples) {
+  const double ns = ns_per_call / static_cast<double>(samples);
+  host_bench::report(name, "ns/sample", ns, "ns");
+  if (ticks_per_ns() > 0) {
+    host_bench::report(name, "TSC ticks/sample", ns * ticks_per_ns(),
+                       "ticks");
+  }
+  CHECK(ns > 0);
+}
+
+} // namespace
+
+TEST(bench_ulaw) {
+  const auto samples = test_signal::tone(FRAMES, 1);
+  const auto bytes = test_signal::to_bytes(samples);
+  std::vector<uint8_t> out(samples.size());
+  report_per_sample("linear_to_ulaw", host_bench::ns_per_call([&] {
+                      for (size_t i = 0; i < samples.size(); i++) {
+                        out[i] = pcm_utils::linear_to_ulaw(samples[i]);
+                      }
+                      keep(out[0]);
+                    }),
+                    samples.size());
+  report_per_sample("encode_ulaw", host_bench::ns_per_call([&] {
+                      pcm_utils::encode_ulaw(bytes.data(), out.data(),
+                                             samples.size());
+                      keep(out[0]);
+                    }),
+                    samples.size());
+}
+
+TEST(bench_ima_adpcm) {
+  for (uint8_t channels : {1, 2}) {
+    // The streamer's 32 ms block.
+    const size_t frames = 512;
+    const auto bytes =
+        test_signal::to_bytes(test_signal::tone(FRAMES, channels));
+    std::vector<uint8_t> block(
+        pcm_utils::ima_adpcm_block_size(frames, channels));
+    pcm_utils::ImaAdpcmState states[2];
+    const double ns = host_bench::ns_per_call([&] {
+      for (size_t f = 0; f + frames <= FRAMES; f += frames) {
+        pcm_utils::ima_adpcm_encode_block(states, channels,
+                                          bytes.data() + f * channels * 2,
+                                          frames, block.data());
+      }
+      keep(block[0]);
+    });
+    report_per_sample(channels == 1 ? "adpcm_encode_block mono"
+                                    : "adpcm_encode_block stereo",
+                      ns, FRAMES / frames * frames * channels);
+  }
+}
+
+TEST(bench_ima_adpcm_wav) {
+  for (uint8_t channels : {1, 2}) {
+    // The recorder's 512-byte-per-channel block_align.
+    const size_t frames_per_block =
+        pcm_utils::ima_adpcm_wav_frames_per_block(512 * channels, channels);
+    const auto bytes =
+        test_signal::to_bytes(test_signal::tone(FRAMES, channels));
+    std::vector<uint8_t> block(512 * channels);
+    pcm_utils::ImaAdpcmState states[2];
+    const double ns = host_bench::ns_per_call([&] {
+      for (size_t f = 0; f + frames_per_block <= FRAMES;
+           f += frames_per_block) {
+        pcm_utils::ima_adpcm_encode_wav_block(states, channels,
+                                              bytes.data() + f * channels * 2,
+                                              frames_per_block, block.data());
+      }
+      keep(block[0]);
+    });
+    report_per_sample(channels == 1 ? "adpcm_encode_wav_block mono"
+                                    : "adpcm_encode_wav_block stereo",
+                      ns,
+                      FRAMES / frames_per_block * frames_per_block * channels);
+  }
+}
+
+namespace {
+
+/// Encodes pcm, interleaved 16-bit frames, once the way the recorder would
+/// and returns the encoded size; each call starts a new stream.
+using Encoder = size_t (*)(const std::vector<uint8_t> &pcm, uint8_t channels,
+                           std::vector<uint8_t> *out);
+
+size_t encode_ulaw(const std::vector<uint8_t> &pcm, uint8_t channels,
+                   std::vector<uint8_t> *out) {
+  out->resize(pcm.size() / 2);
+  return pcm_utils::encode_ulaw(pcm.data(), out->data(), pcm.size() / 2);
+}
+
+size_t encode_ima_adpcm(const std::vector<uint8_t> &pcm, uint8_t channels,
+                        std::vector<uint8_t> *out) {
+  // The recorder's 512-byte-per-channel WAV blocks.
+  const size_t block_align = 512 * channels;
+  const size_t frames_per_block =
+      pcm_utils::ima_adpcm_wav_frames_per_block(block_align, channels);
+  const size_t frames = pcm.size() / 2 / channels;
+  out->resize((frames / frames_per_block + 1) * block_align);
+  pcm_utils::ImaAdpcmState states[2];
+  std::vector<uint8_t> last(frames_per_block * channels * 2);
+  size_t size = 0;
+  for (size_t f = 0; f < frames; f += frames_per_block) {
+    const uint8_t *in = pcm.data() + f * channels * 2;
+    if (f + frames_per_block > frames) {
+      // The last block is padded with silence, as the recorder pads it.
+      std::copy(in, pcm.data() + pcm.size(), last.begin());
+      in = last.data();
+    }
+    size += pcm_utils::ima_adpcm_encode_wav_block(
+        states, channels, in, frames_per_block, out->data() + size);
+  }
+  return size;
+}
+
+size_t encode_flac(const std::vector<uint8_t> &pcm, uint8_t channels,
+                   std::vector<uint8_t> *out) {
+  // The recorder's 4096-frame FLAC blocks.
+  constexpr uint16_t BLOCK = 4096;
+  static std::vector<uint32_t> work(
+      (pcm_utils::flac_encoder_work_size(BLOCK) + 3) / 4);
+  pcm_utils::FlacEncoder encoder(channels, 16000, BLOCK,
+                                 reinterpret_cast<uint8_t *>(work.data()));
+  const size_t frames = pcm.size() / 2 / channels;
+  out->resize((frames / BLOCK + 1) *
+              pcm_utils::flac_max_frame_size(BLOCK, channels));
+  size_t size = 0;
+  for (size_t f = 0; f < frames; f += BLOCK) {
+    size += encoder.encode_frame(pcm.data() + f * channels * 2,
+                                 std::min<size_t>(BLOCK, frames - f),
+                                 out->data() + size);
+  }
+  return size;
+}
+
+void report_codec(const std::string &name, Encoder encoder,
+                  const std::vector<uint8_t> &pcm, uint8_t channels) {
+  std::vector<uint8_t> out;
+  const size_t encoded = encoder(pcm, channels, &out);
+  const double seconds = pcm.size() / 2.0 / channels / 16000.0;
+  const double ns = host_bench::ns_per_call([&] {
+    encoder(pcm, channels, &out);
+    keep(out[0]);
+  });
+  host_bench::report(name.c_str(), "us per second of audio",
+                     ns / 1000.0 / seconds, "us");
+  host_bench::report(name.c_str(), "compression ratio",
+                     static_cast<double>(pcm.size()) / encoded, "x");
+  CHECK(encoded > 0 && encoded < pcm.size());
+}
+
+} // namespace
+
+TEST(bench_recorder_codecs) {
+  // Speech-like audio over a noise floor, and the loud stereo test tone.
+  const auto speech = test_signal::fixture_pcm("vad_speech.wav");
+  const auto tone = test_signal::to_bytes(test_signal::tone(FRAMES, 2));
+  const struct {
+    const char *name;
+    Encoder encoder;
+  } codecs[] = {
+      {"mu-law", encode_ulaw},
+      {"IMA-ADPCM", encode_ima_adpcm},
+      {"FLAC", encode_flac},
+  };
+  for (const auto &codec : codecs) {
+    report_codec(std::string(codec.name) + " speech mono", codec.encoder,
+                 speech, 1);
+    report_codec(std::string(codec.name) + " tone stereo", codec.encoder, tone,
+                 2);
+  }
+}
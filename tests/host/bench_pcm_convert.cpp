@@ -0,0 +1,110 @@
+// Times the pcm_utils kernels against the per-sample reference. The kernels
+// are written for the ESP32's in-order cores, where word loads beat byte
+// loads; a host compiler vectorises the reference loops, so on the host the
+// reference can come out ahead. Compare runs of the same machine only.
+
+#include "host_bench.h"
+
+#include "esphome/components/pcm_utils/pcm_convert.h"
+#include "pcm_reference.h"
+#include "test_signal.h"
+
+#include <vector>
+
+using namespace esphome;
+using namespace pcm_reference;
+using host_bench::keep;
+
+namespace {
+
+// One 32 ms chunk of 16 kHz stereo, the streamer's default, from an
+// unaligned buffer so the prologue is included.
+constexpr size_t SAMPLES = 1024;
+
+template <typename Kernel, typename Reference>
+void compare(const char *name, Kernel kernel, Reference reference) {
+  auto input = test_signal::random_bytes(SAMPLES * 4 + 1, 1);
+  std::vector<uint8_t> output(SAMPLES * 4 + 1);
+  const uint8_t *in = input.data() + 1;
+  uint8_t *out = output.data() + 1;
+  const double kernel_ns = host_bench::ns_per_call([&] {
+    kernel(in, out);
+    keep(output[1]);
+  });
+  const double reference_ns = host_bench::ns_per_call([&] {
+    reference(in, out);
+    keep(output[1]);
+  });
+  host_bench::report(name, "kernel ns/sample", kernel_ns / SAMPLES, "ns");
+  host_bench::report(name, "scalar reference ns/sample",
+                     reference_ns / SAMPLES, "ns");
+  host_bench::report(name, "speedup", reference_ns / kernel_ns, "x");
+  CHECK(kernel_ns > 0);
+}
+
+} // namespace
+
+TEST(bench_swap_bytes) {
+  compare(
+      "swap_bytes_16",
+      [](const uint8_t *in, uint8_t *out) {
+        pcm_utils::swap_bytes_16(out, SAMPLES);
+      },
+      [](const uint8_t *in, uint8_t *out) {
+        reference_swap(out, SAMPLES, 2);
+      });
+  compare(
+      "swap_bytes_24",
+      [](const uint8_t *in, uint8_t *out) {
+        pcm_utils::swap_bytes_24(out, SAMPLES);
+      },
+      [](const uint8_t *in, uint8_t *out) {
+        reference_swap(out, SAMPLES, 3);
+      });
+  compare(
+      "swap_bytes_32",
+      [](const uint8_t *in, uint8_t *out) {
+        pcm_utils::swap_bytes_32(out, SAMPLES);
+      },
+      [](const uint8_t *in, uint8_t *out) {
+        reference_swap(out, SAMPLES, 4);
+      });
+}
+
+TEST(bench_convert) {
+  compare(
+      "convert_32_to_16",
+      [](const uint8_t *in, uint8_t *out) {
+        pcm_utils::convert_32_to_16(in, out, SAMPLES);
+      },
+      [](const uint8_t *in, uint8_t *out) {
+        reference_32_to_16(in, out, SAMPLES);
+      });
+  compare(
+      "convert_32_to_24",
+      [](const uint8_t *in, uint8_t *out) {
+        pcm_utils::convert_32_to_24(in, out, SAMPLES);
+      },
+      [](const uint8_t *in, uint8_t *out) {
+        reference_32_to_24(in, out, SAMPLES);
+      });
+}
+
+TEST(bench_downmix) {
+  compare(
+      "downmix_stereo_to_mono_16",
+      [](const uint8_t *in, uint8_t *out) {
+        pcm_utils::downmix_stereo_to_mono_16(in, out, SAMPLES / 2);
+      },
+      [](const uint8_t *in, uint8_t *out) {
+        reference_downmix_16(in, out, SAMPLES / 2);
+      });
+  compare(
+      "downmix_stereo_to_mono_32",
+      [](const uint8_t *in, uint8_t *out) {
+        pcm_utils::downmix_stereo_to_mono_32(in, out, SAMPLES / 2);
+      },
+      [](const uint8_t *in, uint8_t *out) {
+        reference_downmix_32(in, out, SAMPLES / 2);
+      });
+}
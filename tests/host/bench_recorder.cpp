@@ -0,0 +1,57 @@
+// Times the recorder's writer task end to end on the fake card, with and
+// without header commits. Each card write and fsync costs a fixed 2 ms, so
+// the figures show what the commits add in card operations rather than
+// what a real card's FAT updates would cost; on a device, compare
+// max_write_time and bytes_dropped instead.
+
+#include "host_bench.h"
+#include "recorder_rig.h"
+
+#include <chrono>
+
+using namespace esphome;
+using namespace recorder_test;
+
+namespace {
+
+/// Records seconds of audio as fast as the writer drains it, moving the
+/// clock on by the audio's duration as it goes so commits fall due as they
+/// would in real time. Returns the write throughput in MB/s.
+double record_mb_per_s(uint32_t commit_interval_ms, uint32_t seconds) {
+  fakes::reset_sd_card();
+  fakes::sd_card().write_delay_us = 2000;
+  Rig rig;
+  rig.recorder->set_header_commit_interval_ms(commit_interval_ms);
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  const auto start = std::chrono::steady_clock::now();
+  REQUIRE(rig.recorder->start_recording());
+  for (uint32_t chunk = 0; chunk < seconds * 50; chunk++) {
+    rig.feed(320);
+    fakes::advance_time_ms(20);
+  }
+  rig.recorder->stop_recording();
+  REQUIRE(rig.wait_idle());
+  const double elapsed = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  CHECK_EQ(rig.recorder->bytes_dropped_total_.load(), 0u);
+  return seconds * 32000.0 / elapsed / 1e6;
+}
+
+} // namespace
+
+TEST(bench_header_commits) {
+  const uint32_t seconds = host_test::quick() ? 2 : 30;
+  const double none = record_mb_per_s(0, seconds);
+  const double every_10s = record_mb_per_s(10000, seconds);
+  const double every_1s = record_mb_per_s(1000, seconds);
+  host_bench::report("16 kHz mono, 4KB blocks", "no commits MB/s", none,
+                     "MB/s");
+  host_bench::report("16 kHz mono, 4KB blocks", "commit every 10s MB/s",
+                     every_10s, "MB/s");
+  host_bench::report("16 kHz mono, 4KB blocks", "commit every 1s MB/s",
+                     every_1s, "MB/s");
+  host_bench::report("16 kHz mono, 4KB blocks", "1s commit cost",
+                     100.0 * (none - every_1s) / none, "%");
+}
@@ -0,0 +1,109 @@
+// Times SpscRing against the mutex-guarded RingBuffer fake it replaced,
+// which stands in for ESPHome's critical-section ring: first the cost of
+// one chunk in and out on a single thread, then throughput with a producer
+// and a consumer thread. Compare runs of the same machine only.
+
+#include "host_bench.h"
+
+#include "esphome/components/pcm_utils/spsc_ring.h"
+#include "esphome/core/ring_buffer.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace esphome;
+using host_bench::keep;
+
+namespace {
+
+// One 20 ms chunk of 16 kHz mono 16-bit audio, through a 64 KB ring.
+constexpr size_t CHUNK = 640;
+constexpr size_t CAPACITY = 64 << 10;
+
+/// Bytes moved through a ring in the two-thread case, in whole chunks.
+size_t stream_bytes() {
+  return (host_test::quick() ? 4 << 20 : 256 << 20) / CHUNK * CHUNK;
+}
+
+/// Moves stream_bytes() from a producer thread to this one in CHUNK pieces
+/// and returns the throughput in MB/s. write and read return the bytes they
+/// moved, zero when the ring is full or empty.
+template <typename Write, typename Read>
+double throughput(Write write, Read read) {
+  const size_t total = stream_bytes();
+  const auto start = std::chrono::steady_clock::now();
+  std::thread producer([&] {
+    std::vector<uint8_t> chunk(CHUNK, 0x5a);
+    for (size_t sent = 0; sent < total;) {
+      const size_t n = write(chunk.data());
+      if (n == 0) {
+        std::this_thread::yield();
+      }
+      sent += n;
+    }
+  });
+  std::vector<uint8_t> chunk(CHUNK);
+  for (size_t received = 0; received < total;) {
+    const size_t n = read(chunk.data());
+    if (n == 0) {
+      std::this_thread::yield();
+    }
+    received += n;
+  }
+  producer.join();
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  return static_cast<double>(total) / seconds / 1e6;
+}
+
+} // namespace
+
+TEST(bench_chunk_round_trip) {
+  std::vector<uint8_t> storage(CAPACITY);
+  pcm_utils::SpscRing spsc(storage.data(), storage.size());
+  auto ring_buffer = RingBuffer::create(CAPACITY);
+  std::vector<uint8_t> in(CHUNK, 0x5a);
+  std::vector<uint8_t> out(CHUNK);
+
+  const double spsc_ns = host_bench::ns_per_call([&] {
+    spsc.write(in.data(), CHUNK, 2);
+    spsc.read(out.data(), CHUNK);
+    keep(out[0]);
+  });
+  const double ring_buffer_ns = host_bench::ns_per_call([&] {
+    ring_buffer->write_without_replacement(in.data(), CHUNK);
+    ring_buffer->read(out.data(), CHUNK);
+    keep(out[0]);
+  });
+  host_bench::report("chunk in and out", "SpscRing ns", spsc_ns, "ns");
+  host_bench::report("chunk in and out", "RingBuffer ns", ring_buffer_ns,
+                     "ns");
+  host_bench::report("chunk in and out", "speedup", ring_buffer_ns / spsc_ns,
+                     "x");
+  CHECK_EQ(spsc.overrun_bytes(), 0u);
+}
+
+TEST(bench_two_thread_throughput) {
+  std::vector<uint8_t> storage(CAPACITY);
+  pcm_utils::SpscRing spsc(storage.data(), storage.size());
+  auto ring_buffer = RingBuffer::create(CAPACITY);
+
+  const double spsc_mbps = throughput(
+      [&](const uint8_t *chunk) {
+        return spsc.free() >= CHUNK ? spsc.write(chunk, CHUNK) : 0;
+      },
+      [&](uint8_t *chunk) { return spsc.read(chunk, CHUNK); });
+  const double ring_buffer_mbps = throughput(
+      [&](const uint8_t *chunk) {
+        return ring_buffer->write_without_replacement(chunk, CHUNK, 0, false);
+      },
+      [&](uint8_t *chunk) { return ring_buffer->read(chunk, CHUNK); });
+  host_bench::report("producer to consumer", "SpscRing MB/s", spsc_mbps,
+                     "MB/s");
+  host_bench::report("producer to consumer", "RingBuffer MB/s",
+                     ring_buffer_mbps, "MB/s");
+  CHECK_EQ(spsc.overrun_bytes(), 0u);
+  CHECK_EQ(spsc.read_position(), stream_bytes());
+}
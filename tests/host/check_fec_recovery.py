@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Recover lost packets from real streamer datagrams with the receiver's FEC.
+
+test_udp_audio_streamer captures the datagrams of an FEC stream, one lost
+on the way and with chunks that grow part way, into a file of length-prefixed
+datagrams. This feeds them to scripts/udp_audio_receiver.py's FecReassembler:
+
+- the datagram the streamer lost is rebuilt from its group's parity, padded
+  out to a longer member of the group, and
+- dropping any one datagram of any later complete group rebuilds it byte for
+  byte.
+
+Usage: check_fec_recovery.py <receiver script> <captured datagrams>
+Exits 77, which ctest reports as skipped, if numpy is not installed.
+"""
+from __future__ import annotations
+
+import importlib.util
+import pathlib
+import sys
+
+try:
+    import numpy  # noqa: F401  (the receiver needs it)
+except ImportError:
+    print("numpy is not installed; skipping")
+    sys.exit(77)
+
+
+def load_receiver(path: pathlib.Path):
+    spec = importlib.util.spec_from_file_location("udp_audio_receiver", path)
+    module = importlib.util.module_from_spec(spec)
+    # Its dataclasses look their module up by name.
+    sys.modules[spec.name] = module
+    spec.loader.exec_module(module)
+    return module
+
+
+def read_datagrams(path: pathlib.Path) -> list[bytes]:
+    data = path.read_bytes()
+    datagrams = []
+    offset = 0
+    while offset < len(data):
+        length = int.from_bytes(data[offset : offset + 2], "big")
+        datagrams.append(data[offset + 2 : offset + 2 + length])
+        offset += 2 + length
+    return datagrams
+
+
+def recover(rx, datagrams: list[bytes]) -> list[bytes]:
+    """Every packet the receiver passes on, in order, for these datagrams."""
+    fec = rx.FecReassembler()
+    passed = []
+    for datagram in datagrams:
+        header = rx.parse_header(datagram)
+        if header.flags & rx.FLAG_PARITY:
+            passed += fec.add_parity(header, datagram[header.header_length :])
+        else:
+            passed += fec.add_packet(header.sequence, datagram)
+    return passed
+
+
+def main() -> int:
+    rx = load_receiver(pathlib.Path(sys.argv[1]))
+    datagrams = read_datagrams(pathlib.Path(sys.argv[2]))
+    data = {}
+    groups = []
+    for datagram in datagrams:
+        header = rx.parse_header(datagram)
+        assert header is not None, "malformed datagram"
+        if header.flags & rx.FLAG_PARITY:
+            count = rx.FEC_DESCRIPTOR.unpack_from(datagram, header.header_length)[0]
+            groups.append((header.sequence, count))
+        else:
+            data[header.sequence] = datagram
+    lost = [
+        first + i
+        for first, count in groups
+        for i in range(count)
+        if first + i not in data
+    ]
+    assert len(lost) == 1, f"expected one lost datagram, found {lost}"
+
+    # Parity precedes the first packet of the next group, so the receiver
+    # finds the streamer's lost datagram as soon as the parity arrives.
+    rebuilt = [p for p in recover(rx, datagrams) if p not in data.values()]
+    assert len(rebuilt) == 1, f"rebuilt {len(rebuilt)} datagrams, expected 1"
+    assert rx.parse_header(rebuilt[0]).sequence == lost[0]
+    # The chunk grew right after the loss, so the parity was padded out to a
+    # longer packet than the one it rebuilt.
+    first, count = next(g for g in groups if 0 <= lost[0] - g[0] < g[1])
+    longest = max(len(data[s]) for s in range(first, first + count) if s in data)
+    assert len(rebuilt[0]) < longest, "the lost packet's group is all one size"
+
+    # The receiver only starts keeping packets once it has seen parity, so
+    # the first group is never recoverable.
+    checked = 0
+    for first, count in groups[1:]:
+        members = [first + i for i in range(count)]
+        if any(sequence not in data for sequence in members):
+            continue
+        for sequence in members:
+            kept = [d for d in datagrams if d is not data[sequence]]
+            passed = recover(rx, kept)
+            assert data[sequence] in passed, f"packet {sequence} not rebuilt"
+            checked += 1
+    assert checked > 0, "no complete groups"
+    print(f"rebuilt packet {lost[0]} and {checked} dropped packets")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,126 @@
+#pragma once
+
+// Decoders for the pcm_utils codecs, written from the format specifications
+// rather than from the encoders, so the tests can round-trip audio through
+// them.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace codec_reference {
+
+/// G.711 mu-law to a 16-bit linear sample: the middle of the code's
+/// quantisation interval.
+inline int16_t ulaw_to_linear(uint8_t code) {
+  code = ~code;
+  const int exponent = (code >> 4) & 0x07;
+  const int mantissa = code & 0x0F;
+  const int magnitude = (((mantissa << 3) + 0x84) << exponent) - 0x84;
+  return static_cast<int16_t>((code & 0x80) ? -magnitude : magnitude);
+}
+
+struct ImaState {
+  int32_t predictor{0};
+  int32_t index{0};
+};
+
+/// Decodes one IMA-ADPCM nibble, advancing state.
+inline int16_t ima_decode(ImaState &state, uint8_t code) {
+  static const int8_t INDEX_TABLE[16] = {-1, -1, -1, -1, 2, 4, 6, 8,
+                                         -1, -1, -1, -1, 2, 4, 6, 8};
+  static const int16_t STEP_TABLE[89] = {
+      7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+      19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+      50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+      2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+      5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+      15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+  const int32_t step = STEP_TABLE[state.index];
+  int32_t delta = step >> 3;
+  if (code & 4) {
+    delta += step;
+  }
+  if (code & 2) {
+    delta += step >> 1;
+  }
+  if (code & 1) {
+    delta += step >> 2;
+  }
+  state.predictor += (code & 8) ? -delta : delta;
+  state.predictor = std::clamp<int32_t>(state.predictor, INT16_MIN, INT16_MAX);
+  state.index = std::clamp<int32_t>(state.index + INDEX_TABLE[code], 0, 88);
+  return static_cast<int16_t>(state.predictor);
+}
+
+inline int16_t le16s(const uint8_t *p) {
+  return static_cast<int16_t>(p[0] | p[1] << 8);
+}
+
+/// Decodes a block from ima_adpcm_encode_block(): per-channel headers of
+/// the state before the block, then interleaved nibbles, low nibble first.
+/// Leaves states as they are after the block.
+inline std::vector<int16_t> decode_ima_block(const uint8_t *block,
+                                             size_t frames, int channels,
+                                             std::vector<ImaState> *states) {
+  states->resize(channels);
+  for (int ch = 0; ch < channels; ch++) {
+    (*states)[ch].predictor = le16s(block + 4 * ch);
+    (*states)[ch].index = block[4 * ch + 2];
+  }
+  const uint8_t *data = block + 4 * channels;
+  std::vector<int16_t> out(frames * channels);
+  for (size_t i = 0; i < out.size(); i++) {
+    const uint8_t code = (i & 1) ? data[i / 2] >> 4 : data[i / 2] & 0x0F;
+    out[i] = ima_decode((*states)[i % channels], code);
+  }
+  return out;
+}
+
+/// Decodes a WAV IMA-ADPCM block (Microsoft/IMA layout): per-channel
+/// headers holding the first sample, then for each channel in turn four
+/// bytes of eight samples.
+inline std::vector<int16_t> decode_ima_wav_block(const uint8_t *block,
+                                                 size_t frames_per_block,
+                                                 int channels) {
+  std::vector<ImaState> states(channels);
+  std::vector<int16_t> out(frames_per_block * channels);
+  for (int ch = 0; ch < channels; ch++) {
+    states[ch].predictor = le16s(block + 4 * ch);
+    states[ch].index = block[4 * ch + 2];
+    out[ch] = static_cast<int16_t>(states[ch].predictor);
+  }
+  const uint8_t *data = block + 4 * channels;
+  for (size_t group = 0; group < (frames_per_block - 1) / 8; group++) {
+    for (int ch = 0; ch < channels; ch++) {
+      for (int i = 0; i < 8; i++) {
+        const uint8_t byte = data[i / 2];
+        const uint8_t code = (i & 1) ? byte >> 4 : byte & 0x0F;
+        const size_t frame = 1 + group * 8 + i;
+        out[frame * channels + ch] = ima_decode(states[ch], code);
+      }
+      data += 4;
+    }
+  }
+  return out;
+}
+
+/// Signal-to-noise ratio in dB of decoded against original.
+inline double snr_db(const std::vector<int16_t> &original,
+                     const std::vector<int16_t> &decoded) {
+  double signal = 0;
+  double noise = 0;
+  for (size_t i = 0; i < original.size(); i++) {
+    signal += static_cast<double>(original[i]) * original[i];
+    const double error = static_cast<double>(original[i]) - decoded[i];
+    noise += error * error;
+  }
+  return noise == 0 ? 200.0 : 10.0 * std::log10(signal / noise);
+}
+
+} // namespace codec_reference
@@ -0,0 +1,208 @@
+#pragma once
+
+// Stand-in for Bosch's BSEC2 library and the bme68x driver under it. Types,
+// constants and functions are the subset bme68x_bsec2 uses, with the
+// library's names and values; behind them sits a deterministic model, so
+// the component's scheduling, publishing and state handling can run on the
+// host. It isn't a gas model: readings are whatever the test sets.
+
+#include <cstdint>
+
+#define BSEC_MAX_WORKBUFFER_SIZE (4096)
+#define BSEC_MAX_PHYSICAL_SENSOR (8)
+#define BSEC_MAX_PROPERTY_BLOB_SIZE (2277)
+#define BSEC_MAX_STATE_BLOB_SIZE (221)
+#define BSEC_NUMBER_OUTPUTS (19)
+#define BSEC_INSTANCE_SIZE (3272)
+#define BSEC_SAMPLE_RATE_ULP (0.0033333f)
+#define BSEC_SAMPLE_RATE_LP (0.33333f)
+#define BSEC_TOTAL_HEAT_DUR (140)
+#define BSEC_CHECK_INPUT(x, shift) ((x) & (1 << ((shift)-1)))
+
+enum bsec_library_return_t {
+  BSEC_OK = 0,
+  BSEC_E_DOSTEPS_INVALIDINPUT = -1,
+  BSEC_E_CONFIG_FAIL = -32,
+  BSEC_E_PARSE_SECTIONEXCEEDSWORKBUFFER = -34,
+  BSEC_E_SET_INVALIDLENGTH = -41,
+  BSEC_I_SU_SUBSCRIBEDOUTPUTGATES = 100,
+};
+
+enum bsec_virtual_sensor_t {
+  BSEC_OUTPUT_IAQ = 1,
+  BSEC_OUTPUT_STATIC_IAQ = 2,
+  BSEC_OUTPUT_CO2_EQUIVALENT = 3,
+  BSEC_OUTPUT_BREATH_VOC_EQUIVALENT = 4,
+  BSEC_OUTPUT_RAW_TEMPERATURE = 6,
+  BSEC_OUTPUT_RAW_PRESSURE = 7,
+  BSEC_OUTPUT_RAW_HUMIDITY = 8,
+  BSEC_OUTPUT_RAW_GAS = 9,
+  BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE = 14,
+  BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY = 15,
+};
+
+enum bsec_physical_sensor_t {
+  BSEC_INPUT_PRESSURE = 1,
+  BSEC_INPUT_HUMIDITY = 2,
+  BSEC_INPUT_TEMPERATURE = 3,
+  BSEC_INPUT_GASRESISTOR = 4,
+  BSEC_INPUT_HEATSOURCE = 14,
+  BSEC_INPUT_PROFILE_PART = 18,
+};
+
+struct bsec_version_t {
+  uint8_t major;
+  uint8_t minor;
+  uint8_t major_bugfix;
+  uint8_t minor_bugfix;
+};
+
+struct bsec_input_t {
+  int64_t time_stamp;
+  float signal;
+  uint8_t signal_dimensions;
+  uint8_t sensor_id;
+};
+
+struct bsec_output_t {
+  int64_t time_stamp;
+  float signal;
+  uint8_t signal_dimensions;
+  uint8_t sensor_id;
+  uint8_t accuracy;
+};
+
+struct bsec_sensor_configuration_t {
+  float sample_rate;
+  uint8_t sensor_id;
+};
+
+struct bsec_bme_settings_t {
+  int64_t next_call;
+  uint32_t process_data;
+  uint16_t heater_temperature;
+  uint16_t heater_duration;
+  uint16_t heater_temperature_profile[10];
+  uint16_t heater_duration_profile[10];
+  uint8_t heater_profile_len;
+  uint8_t run_gas;
+  uint8_t pressure_oversampling;
+  uint8_t temperature_oversampling;
+  uint8_t humidity_oversampling;
+  uint8_t trigger_measurement;
+  uint8_t op_mode;
+};
+
+bsec_library_return_t bsec_init_m(void *inst);
+bsec_library_return_t bsec_get_version_m(void *inst,
+                                         bsec_version_t *bsec_version_p);
+bsec_library_return_t
+bsec_set_configuration_m(void *inst, const uint8_t *serialized_settings,
+                         uint32_t n_serialized_settings, uint8_t *work_buffer,
+                         uint32_t n_work_buffer_size);
+bsec_library_return_t bsec_update_subscription_m(
+    void *inst, const bsec_sensor_configuration_t *requested_virtual_sensors,
+    uint8_t n_requested_virtual_sensors,
+    bsec_sensor_configuration_t *required_sensor_settings,
+    uint8_t *n_required_sensor_settings);
+bsec_library_return_t
+bsec_sensor_control_m(void *inst, int64_t time_stamp,
+                      bsec_bme_settings_t *sensor_settings);
+bsec_library_return_t bsec_do_steps_m(void *inst, const bsec_input_t *inputs,
+                                      uint8_t n_inputs, bsec_output_t *outputs,
+                                      uint8_t *n_outputs);
+bsec_library_return_t bsec_get_state_m(void *inst, uint8_t state_set_id,
+                                       uint8_t *serialized_state,
+                                       uint32_t n_serialized_state_max,
+                                       uint8_t *work_buffer,
+                                       uint32_t n_work_buffer,
+                                       uint32_t *n_serialized_state);
+bsec_library_return_t bsec_set_state_m(void *inst,
+                                       const uint8_t *serialized_state,
+                                       uint32_t n_serialized_state,
+                                       uint8_t *work_buffer,
+                                       uint32_t n_work_buffer_size);
+
+#define BME68X_OK INT8_C(0)
+#define BME68X_E_COM_FAIL INT8_C(-2)
+#define BME68X_ENABLE UINT8_C(0x01)
+#define BME68X_SLEEP_MODE UINT8_C(0)
+#define BME68X_FORCED_MODE UINT8_C(1)
+#define BME68X_PARALLEL_MODE UINT8_C(2)
+#define BME68X_NEW_DATA_MSK UINT8_C(0x80)
+#define BME68X_GASM_VALID_MSK UINT8_C(0x20)
+#define BME68X_HEAT_STAB_MSK UINT8_C(0x10)
+
+struct bme68x_dev {
+  uint8_t op_mode;
+};
+
+struct bme68x_conf {
+  uint8_t os_hum;
+  uint8_t os_temp;
+  uint8_t os_pres;
+  uint8_t filter;
+  uint8_t odr;
+};
+
+struct bme68x_heatr_conf {
+  uint8_t enable;
+  uint16_t heatr_temp;
+  uint16_t heatr_dur;
+  uint16_t *heatr_temp_prof;
+  uint16_t *heatr_dur_prof;
+  uint8_t profile_len;
+  uint16_t shared_heatr_dur;
+};
+
+struct bme68x_data {
+  uint8_t status;
+  uint8_t gas_index;
+  uint8_t meas_index;
+  uint8_t res_heat;
+  uint8_t idac;
+  uint8_t gas_wait;
+  float temperature;
+  float pressure;
+  float humidity;
+  float gas_resistance;
+};
+
+int8_t bme68x_init(struct bme68x_dev *dev);
+int8_t bme68x_get_conf(struct bme68x_conf *conf, struct bme68x_dev *dev);
+int8_t bme68x_set_conf(struct bme68x_conf *conf, struct bme68x_dev *dev);
+int8_t bme68x_set_heatr_conf(uint8_t op_mode,
+                             const struct bme68x_heatr_conf *conf,
+                             struct bme68x_dev *dev);
+int8_t bme68x_set_op_mode(uint8_t op_mode, struct bme68x_dev *dev);
+int8_t bme68x_get_op_mode(uint8_t *op_mode, struct bme68x_dev *dev);
+uint32_t bme68x_get_meas_dur(uint8_t op_mode, struct bme68x_conf *conf,
+                             struct bme68x_dev *dev);
+int8_t bme68x_get_data(uint8_t op_mode, struct bme68x_data *data,
+                       uint8_t *n_data, struct bme68x_dev *dev);
+
+namespace esphome {
+namespace fakes {
+
+/// What the modelled sensor reads and how quickly the modelled library
+/// calibrates. Each do-steps call counts one step per instance; IAQ
+/// accuracy is steps / steps_per_accuracy, capped at 3, and survives a
+/// get-state/set-state round trip.
+struct Bsec {
+  float temperature{21.5f};
+  float humidity{45.0f};
+  float pressure{101325.0f};
+  float gas_resistance{120000.0f};
+  float iaq{50.0f};
+  uint32_t steps_per_accuracy{2};
+  /// Interval between sensor_control calls, in ms.
+  uint32_t period_ms{3000};
+  /// bme68x_init() returns this.
+  int8_t init_status{BME68X_OK};
+};
+
+Bsec &bsec();
+void reset_bsec();
+
+} // namespace fakes
+} // namespace esphome
@@ -0,0 +1,3 @@
+#pragma once
+
+#define SDMMC_SECTOR_SIZE 512
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "driver/sdmmc_types.h"
+#include "hal/gpio_types.h"
+
+#include <cstdint>
+
+#define SDMMC_HOST_SLOT_0 0
+#define SDMMC_HOST_SLOT_1 1
+
+esp_err_t sdmmc_host_set_card_clk(int slot, uint32_t freq_khz);
+
+#define SDMMC_HOST_DEFAULT()                                                   \
+  {                                                                            \
+    .flags = SDMMC_HOST_FLAG_8BIT | SDMMC_HOST_FLAG_4BIT |                     \
+             SDMMC_HOST_FLAG_1BIT | SDMMC_HOST_FLAG_DDR,                       \
+    .slot = SDMMC_HOST_SLOT_1, .max_freq_khz = SDMMC_FREQ_DEFAULT,             \
+    .io_voltage = 3.3f, .set_card_clk = &sdmmc_host_set_card_clk,              \
+    .command_timeout_ms = 0,                                                   \
+  }
+
+#define SDMMC_SLOT_FLAG_INTERNAL_PULLUP (1 << 0)
+
+typedef struct {
+  gpio_num_t clk;
+  gpio_num_t cmd;
+  gpio_num_t d0;
+  gpio_num_t d1;
+  gpio_num_t d2;
+  gpio_num_t d3;
+  gpio_num_t cd;
+  gpio_num_t wp;
+  uint8_t width;
+  uint32_t flags;
+} sdmmc_slot_config_t;
+
+#define SDMMC_SLOT_CONFIG_DEFAULT()                                            \
+  {                                                                            \
+    .clk = GPIO_NUM_NC, .cmd = GPIO_NUM_NC, .d0 = GPIO_NUM_NC,                 \
+    .d1 = GPIO_NUM_NC, .d2 = GPIO_NUM_NC, .d3 = GPIO_NUM_NC,                   \
+    .cd = GPIO_NUM_NC, .wp = GPIO_NUM_NC, .width = 0, .flags = 0,              \
+  }
+
+esp_err_t sdmmc_host_init();
+esp_err_t sdmmc_host_init_slot(int slot, const sdmmc_slot_config_t *config);
+esp_err_t sdmmc_host_deinit();
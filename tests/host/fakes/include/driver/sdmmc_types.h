@@ -0,0 +1,47 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#define SDMMC_HOST_FLAG_1BIT (1 << 0)
+#define SDMMC_HOST_FLAG_4BIT (1 << 1)
+#define SDMMC_HOST_FLAG_8BIT (1 << 2)
+#define SDMMC_HOST_FLAG_SPI (1 << 3)
+#define SDMMC_HOST_FLAG_DDR (1 << 4)
+
+#define SDMMC_FREQ_DEFAULT 20000
+#define SDMMC_FREQ_HIGHSPEED 40000
+#define SDMMC_FREQ_PROBING 400
+
+typedef struct {
+  uint32_t flags;
+  int slot;
+  int max_freq_khz;
+  float io_voltage;
+  esp_err_t (*set_card_clk)(int slot, uint32_t freq_khz);
+  int command_timeout_ms;
+} sdmmc_host_t;
+
+typedef struct {
+  int csd_ver;
+  int mmc_ver;
+  int capacity;
+  int sector_size;
+  int read_block_len;
+  int card_command_class;
+  int tr_speed;
+} sdmmc_csd_t;
+
+typedef struct {
+  sdmmc_host_t host;
+  uint32_t ocr;
+  sdmmc_csd_t csd;
+  uint16_t rca;
+  uint32_t is_mmc : 1;
+  uint32_t is_ddr : 1;
+  uint32_t log_bus_width : 2;
+  uint32_t max_freq_khz;
+  int real_freq_khz;
+} sdmmc_card_t;
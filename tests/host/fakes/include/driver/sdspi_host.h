@@ -0,0 +1,38 @@
+#pragma once
+
+#include "driver/sdmmc_types.h"
+#include "driver/spi_common.h"
+#include "hal/gpio_types.h"
+
+typedef int sdspi_dev_handle_t;
+
+esp_err_t sdspi_host_set_card_clk(sdspi_dev_handle_t handle,
+                                  uint32_t freq_khz);
+
+#define SDSPI_HOST_DEFAULT()                                                   \
+  {                                                                            \
+    .flags = SDMMC_HOST_FLAG_SPI, .slot = SPI2_HOST,                           \
+    .max_freq_khz = SDMMC_FREQ_DEFAULT, .io_voltage = 3.3f,                    \
+    .set_card_clk = &sdspi_host_set_card_clk, .command_timeout_ms = 0,        \
+  }
+
+typedef struct {
+  spi_host_device_t host_id;
+  gpio_num_t gpio_cs;
+  gpio_num_t gpio_cd;
+  gpio_num_t gpio_wp;
+  gpio_num_t gpio_int;
+} sdspi_device_config_t;
+
+#define SDSPI_DEVICE_CONFIG_DEFAULT()                                          \
+  {                                                                            \
+    .host_id = SPI2_HOST, .gpio_cs = GPIO_NUM_NC, .gpio_cd = GPIO_NUM_NC,      \
+    .gpio_wp = GPIO_NUM_NC, .gpio_int = GPIO_NUM_NC,                           \
+  }
+
+#define SDSPI_DEFAULT_DMA SPI_DMA_CH_AUTO
+
+esp_err_t sdspi_host_init();
+esp_err_t sdspi_host_init_device(const sdspi_device_config_t *dev_config,
+                                 sdspi_dev_handle_t *out_handle);
+esp_err_t sdspi_host_deinit();
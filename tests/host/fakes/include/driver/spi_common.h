@@ -0,0 +1,39 @@
+#pragma once
+
+#include "esp_err.h"
+#include "hal/gpio_types.h"
+
+#include <cstdint>
+
+typedef enum {
+  SPI1_HOST = 0,
+  SPI2_HOST = 1,
+  SPI3_HOST = 2,
+} spi_host_device_t;
+
+typedef enum {
+  SPI_DMA_DISABLED = 0,
+  SPI_DMA_CH1 = 1,
+  SPI_DMA_CH2 = 2,
+  SPI_DMA_CH_AUTO = 3,
+} spi_dma_chan_t;
+
+#define SPICOMMON_BUSFLAG_MASTER (1 << 0)
+
+typedef struct {
+  int mosi_io_num;
+  int miso_io_num;
+  int sclk_io_num;
+  int quadwp_io_num;
+  int quadhd_io_num;
+  int max_transfer_sz;
+  uint32_t flags;
+  int intr_flags;
+} spi_bus_config_t;
+
+/// Fails with ESP_ERR_INVALID_STATE if the bus is already initialised, as
+/// the real driver does.
+esp_err_t spi_bus_initialize(spi_host_device_t host_id,
+                             const spi_bus_config_t *bus_config,
+                             spi_dma_chan_t dma_chan);
+esp_err_t spi_bus_free(spi_host_device_t host_id);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+/// Microseconds on the same clock as esphome::micros().
+int64_t esp_timer_get_time();
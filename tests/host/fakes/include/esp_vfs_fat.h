@@ -0,0 +1,36 @@
+#pragma once
+
+#include "driver/sdmmc_host.h"
+#include "driver/sdspi_host.h"
+
+#include <cstddef>
+#include <cstdint>
+
+typedef struct {
+  bool format_if_mount_failed;
+  int max_files;
+  size_t allocation_unit_size;
+  bool disk_status_check_enable;
+} esp_vfs_fat_mount_config_t;
+
+typedef esp_vfs_fat_mount_config_t esp_vfs_fat_sdmmc_mount_config_t;
+
+// The card's file system is the host directory named by base_path, which
+// the test creates beforehand.
+esp_err_t esp_vfs_fat_sdmmc_mount(const char *base_path,
+                                  const sdmmc_host_t *host_config,
+                                  const void *slot_config,
+                                  const esp_vfs_fat_mount_config_t *config,
+                                  sdmmc_card_t **out_card);
+esp_err_t esp_vfs_fat_sdspi_mount(const char *base_path,
+                                  const sdmmc_host_t *host_config,
+                                  const sdspi_device_config_t *slot_config,
+                                  const esp_vfs_fat_mount_config_t *config,
+                                  sdmmc_card_t **out_card);
+esp_err_t esp_vfs_fat_sdcard_unmount(const char *base_path,
+                                     sdmmc_card_t *card);
+esp_err_t esp_vfs_fat_info(const char *base_path, uint64_t *out_total_bytes,
+                           uint64_t *out_free_bytes);
+esp_err_t esp_vfs_fat_create_contiguous_file(const char *base_path,
+                                             const char *full_path,
+                                             uint64_t size, bool alloc_now);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace audio {
+
+class AudioStreamInfo {
+public:
+  AudioStreamInfo() : AudioStreamInfo(16, 1, 16000) {}
+  AudioStreamInfo(uint8_t bits_per_sample, uint8_t channels,
+                  uint32_t sample_rate)
+      : bits_per_sample_(bits_per_sample), channels_(channels),
+        sample_rate_(sample_rate),
+        bytes_per_sample_((bits_per_sample + 7) / 8) {}
+
+  uint8_t get_bits_per_sample() const { return this->bits_per_sample_; }
+  uint8_t get_channels() const { return this->channels_; }
+  uint32_t get_sample_rate() const { return this->sample_rate_; }
+  size_t get_bytes_per_sample() const { return this->bytes_per_sample_; }
+
+  uint32_t bytes_to_ms(size_t bytes) const {
+    return bytes * 1000 / (this->sample_rate_ * this->bytes_per_sample_ *
+                           this->channels_);
+  }
+  uint32_t bytes_to_frames(size_t bytes) const {
+    return (bytes / this->bytes_per_sample_) / this->channels_;
+  }
+  uint32_t bytes_to_samples(size_t bytes) const {
+    return bytes / this->bytes_per_sample_;
+  }
+  size_t frames_to_bytes(uint32_t frames) const {
+    return frames * this->bytes_per_sample_ * this->channels_;
+  }
+  size_t samples_to_bytes(uint32_t samples) const {
+    return samples * this->bytes_per_sample_;
+  }
+  uint32_t ms_to_frames(uint32_t ms) const {
+    return (ms * this->sample_rate_) / 1000;
+  }
+  uint32_t ms_to_samples(uint32_t ms) const {
+    return (ms * this->channels_ * this->sample_rate_) / 1000;
+  }
+  size_t ms_to_bytes(uint32_t ms) const {
+    return (ms * this->bytes_per_sample_ * this->channels_ *
+            this->sample_rate_) /
+           1000;
+  }
+  uint32_t frames_to_microseconds(uint32_t frames) const {
+    return (frames * 1000000 + (this->sample_rate_ >> 1)) /
+           this->sample_rate_;
+  }
+  uint32_t frames_to_milliseconds_with_remainder(uint32_t *frames) const {
+    const uint32_t ms = (*frames * 1000) / this->sample_rate_;
+    *frames -= this->ms_to_frames(ms);
+    return ms;
+  }
+
+  bool operator==(const AudioStreamInfo &rhs) const {
+    return this->bits_per_sample_ == rhs.bits_per_sample_ &&
+           this->channels_ == rhs.channels_ &&
+           this->sample_rate_ == rhs.sample_rate_;
+  }
+  bool operator!=(const AudioStreamInfo &rhs) const { return !(*this == rhs); }
+
+protected:
+  uint8_t bits_per_sample_;
+  uint8_t channels_;
+  uint32_t sample_rate_;
+  size_t bytes_per_sample_;
+};
+
+} // namespace audio
+} // namespace esphome
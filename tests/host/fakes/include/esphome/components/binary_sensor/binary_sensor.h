@@ -0,0 +1,33 @@
+#pragma once
+
+#include "esphome/core/log.h"
+
+#include <vector>
+
+namespace esphome {
+namespace binary_sensor {
+
+class BinarySensor {
+public:
+  virtual ~BinarySensor() = default;
+
+  void publish_state(bool state);
+  void publish_initial_state(bool state);
+  bool has_state() const { return this->has_state_; }
+
+  bool state{false};
+
+  /// Test read-back: every state published, oldest first.
+  std::vector<bool> history;
+
+protected:
+  bool has_state_{false};
+};
+
+} // namespace binary_sensor
+} // namespace esphome
+
+#define LOG_BINARY_SENSOR(prefix, type, obj)                                   \
+  if (::esphome::fakes::log_object_set(obj)) {                                 \
+    ESP_LOGCONFIG(TAG, "%s%s", prefix, type);                                  \
+  }
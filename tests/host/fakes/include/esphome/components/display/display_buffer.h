@@ -0,0 +1,68 @@
+#pragma once
+
+#include "esphome/core/application.h"
+#include "esphome/core/color.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+
+#include <functional>
+
+namespace esphome {
+namespace display {
+
+enum DisplayType {
+  DISPLAY_TYPE_BINARY = 1,
+  DISPLAY_TYPE_GRAYSCALE = 2,
+  DISPLAY_TYPE_COLOR = 3,
+};
+
+static constexpr Color COLOR_OFF(0, 0, 0, 0);
+static constexpr Color COLOR_ON(255, 255, 255, 255);
+
+class Display;
+using display_writer_t = std::function<void(Display &)>;
+
+/// The drawing side of esphome::display::Display that the drivers here
+/// implement or call, without rotation, pages or fonts.
+class Display : public PollingComponent {
+public:
+  virtual void fill(Color color);
+  virtual void clear() { this->fill(COLOR_OFF); }
+  virtual DisplayType get_display_type() = 0;
+  virtual void draw_pixel_at(int x, int y, Color color) = 0;
+
+  int get_width() { return this->get_width_internal(); }
+  int get_height() { return this->get_height_internal(); }
+  int get_native_width() { return this->get_width_internal(); }
+  int get_native_height() { return this->get_height_internal(); }
+
+  void set_writer(display_writer_t &&writer) {
+    this->writer_ = std::move(writer);
+  }
+
+protected:
+  virtual int get_width_internal() = 0;
+  virtual int get_height_internal() = 0;
+  /// Runs the writer, as the display's lambda runs for the current page.
+  void do_update_();
+
+  display_writer_t writer_;
+};
+
+class DisplayBuffer : public Display {
+public:
+  void draw_pixel_at(int x, int y, Color color) override {
+    this->draw_absolute_pixel_internal(x, y, color);
+  }
+
+protected:
+  virtual void draw_absolute_pixel_internal(int x, int y, Color color) = 0;
+};
+
+} // namespace display
+} // namespace esphome
+
+#define LOG_DISPLAY(prefix, type, obj)                                         \
+  if (::esphome::fakes::log_object_set(obj)) {                                 \
+    ESP_LOGCONFIG(TAG, prefix type);                                           \
+  }
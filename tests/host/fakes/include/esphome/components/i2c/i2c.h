@@ -0,0 +1,71 @@
+#pragma once
+
+#include "esphome/core/log.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace esphome {
+namespace i2c {
+
+enum ErrorCode {
+  NO_ERROR = 0,
+  ERROR_OK = 0,
+  ERROR_INVALID_ARGUMENT = 1,
+  ERROR_NOT_ACKNOWLEDGED = 2,
+  ERROR_TIMEOUT = 3,
+  ERROR_NOT_INITIALIZED = 4,
+  ERROR_TOO_LARGE = 5,
+  ERROR_UNKNOWN = 6,
+  ERROR_CRC = 7,
+};
+
+/// A bus with one device on it that has 16-bit register addresses. A read
+/// returns the bytes stored at the register, zero-filled past their end;
+/// writes are logged in order.
+class I2CBus {
+public:
+  ErrorCode read_register16(uint8_t address, uint16_t a_register,
+                            uint8_t *data, size_t len);
+  ErrorCode write_register16(uint8_t address, uint16_t a_register,
+                             const uint8_t *data, size_t len);
+
+  // Test control and read-back.
+
+  std::map<uint16_t, std::vector<uint8_t>> registers;
+  /// Transfers touching these registers aren't acknowledged.
+  std::set<uint16_t> failing_registers;
+  /// Every transfer fails while false, as with no device on the bus.
+  bool present{true};
+
+  struct Write {
+    uint16_t a_register;
+    std::vector<uint8_t> data;
+  };
+  std::vector<Write> writes;
+  std::vector<uint16_t> reads;
+};
+
+class I2CDevice {
+public:
+  void set_i2c_address(uint8_t address) { this->address_ = address; }
+  void set_i2c_bus(I2CBus *bus) { this->bus_ = bus; }
+
+  ErrorCode read_register16(uint16_t a_register, uint8_t *data, size_t len,
+                            bool stop = true);
+  ErrorCode write_register16(uint16_t a_register, const uint8_t *data,
+                             size_t len, bool stop = true);
+
+protected:
+  uint8_t address_{0x00};
+  I2CBus *bus_{nullptr};
+};
+
+} // namespace i2c
+} // namespace esphome
+
+#define LOG_I2C_DEVICE(this)                                                   \
+  ESP_LOGCONFIG(TAG, "  Address: 0x%02X", this->address_);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "esphome/components/audio/audio.h"
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace esphome {
+namespace microphone {
+
+/// Stand-in for the microphone source a component is given. Audio comes
+/// from the test through emit(), on whatever thread it calls from, just as
+/// the I2S task delivers it on a device.
+class MicrophoneSource {
+public:
+  MicrophoneSource() = default;
+  explicit MicrophoneSource(const audio::AudioStreamInfo &info,
+                            bool passive = false)
+      : info_(info), passive_(passive) {}
+
+  void add_data_callback(
+      std::function<void(const std::vector<uint8_t> &)> &&data_callback);
+  audio::AudioStreamInfo get_audio_stream_info() { return this->info_; }
+  bool is_passive() const { return this->passive_; }
+  bool is_running() const { return this->running_; }
+  void start();
+  void stop();
+
+  // Test control.
+
+  void set_audio_stream_info(const audio::AudioStreamInfo &info) {
+    this->info_ = info;
+  }
+  /// Hands data to every registered callback, whether or not start() was
+  /// called: the test plays the part of the I2S driver and decides when
+  /// audio flows.
+  void emit(const std::vector<uint8_t> &data);
+  int start_count() const { return this->start_count_; }
+  size_t callback_count() const;
+
+protected:
+  audio::AudioStreamInfo info_;
+  bool passive_{false};
+  bool running_{false};
+  int start_count_{0};
+  mutable std::mutex mutex_;
+  std::vector<std::function<void(const std::vector<uint8_t> &)>> callbacks_;
+};
+
+} // namespace microphone
+} // namespace esphome
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "esphome/core/log.h"
+
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace sensor {
+
+class Sensor {
+public:
+  void publish_state(float state);
+  bool has_state() const { return this->has_state_; }
+  float get_state() const { return this->state; }
+  float get_raw_state() const { return this->raw_state; }
+
+  float state{NAN};
+  float raw_state{NAN};
+
+  /// Test read-back: every value published, oldest first.
+  std::vector<float> history() const;
+
+protected:
+  bool has_state_{false};
+  mutable std::mutex mutex_;
+  std::vector<float> history_;
+};
+
+} // namespace sensor
+} // namespace esphome
+
+#define LOG_SENSOR(prefix, type, obj)                                          \
+  if (::esphome::fakes::log_object_set(obj)) {                                 \
+    ESP_LOGCONFIG(TAG, "%s%s", prefix, type);                                  \
+  }
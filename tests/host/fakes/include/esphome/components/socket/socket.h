@@ -0,0 +1,84 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace esphome {
+namespace socket {
+
+/// A BSD socket on the host stack, as ESPHome's BSD socket implementation
+/// wraps it. Sends go through the fault hook (see fakes below) first.
+class Socket {
+public:
+  explicit Socket(int fd) : fd_(fd) {}
+  Socket(const Socket &) = delete;
+  Socket &operator=(const Socket &) = delete;
+  virtual ~Socket();
+
+  int bind(const struct sockaddr *addr, socklen_t addrlen);
+  int connect(const struct sockaddr *addr, socklen_t addrlen);
+  int close();
+  int getsockopt(int level, int optname, void *optval, socklen_t *optlen);
+  int setsockopt(int level, int optname, const void *optval,
+                 socklen_t optlen);
+  int listen(int backlog);
+  std::unique_ptr<Socket> accept(struct sockaddr *addr, socklen_t *addrlen);
+
+  ssize_t read(void *buf, size_t len);
+  ssize_t recvfrom(void *buf, size_t len, struct sockaddr *addr,
+                   socklen_t *addr_len);
+  ssize_t write(const void *buf, size_t len);
+  ssize_t writev(const struct iovec *iov, int iovcnt);
+  ssize_t sendto(const void *buf, size_t len, int flags,
+                 const struct sockaddr *to, socklen_t tolen);
+
+  int setblocking(bool blocking);
+  int get_fd() const { return this->fd_; }
+
+protected:
+  int fd_;
+};
+
+std::unique_ptr<Socket> socket(int domain, int type, int protocol);
+/// An IPv4 socket, as on a firmware built without IPv6.
+std::unique_ptr<Socket> socket_ip(int type, int protocol);
+
+/// Fills addr from a numeric IPv4 or IPv6 address and returns its length,
+/// or 0 if the address doesn't parse or addrlen is too small.
+socklen_t set_sockaddr(struct sockaddr *addr, socklen_t addrlen,
+                       const std::string &ip_address, uint16_t port);
+
+} // namespace socket
+
+namespace fakes {
+
+/// Called before each write, writev or sendto with the socket's type
+/// (SOCK_STREAM or SOCK_DGRAM) and the bytes offered. It returns how many of
+/// them the call may send, which may be fewer for a short write, or a
+/// negated errno (e.g. -EAGAIN) to fail the call without sending anything.
+using SendHook = std::function<ssize_t(int type, size_t len)>;
+
+/// Installs the hook; an empty one passes everything through.
+void set_send_hook(SendHook hook);
+
+struct SocketStats {
+  int created{0};
+  int closed{0};
+  int connects{0};
+  /// The address length passed to the latest connect().
+  socklen_t last_connect_len{0};
+};
+SocketStats socket_stats();
+void reset_socket_stats();
+
+} // namespace fakes
+} // namespace esphome
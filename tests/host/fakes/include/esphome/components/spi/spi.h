@@ -0,0 +1,106 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace spi {
+
+enum BitOrder {
+  BIT_ORDER_LSB_FIRST,
+  BIT_ORDER_MSB_FIRST,
+};
+
+enum ClockPolarity : bool {
+  CLOCK_POLARITY_LOW = false,
+  CLOCK_POLARITY_HIGH = true,
+};
+
+enum ClockPhase : bool {
+  CLOCK_PHASE_LEADING,
+  CLOCK_PHASE_TRAILING,
+};
+
+enum DataRate : uint32_t {
+  DATA_RATE_1KHZ = 1000,
+  DATA_RATE_75KHZ = 75000,
+  DATA_RATE_200KHZ = 200000,
+  DATA_RATE_1MHZ = 1000000,
+  DATA_RATE_2MHZ = 2000000,
+  DATA_RATE_4MHZ = 4000000,
+  DATA_RATE_8MHZ = 8000000,
+  DATA_RATE_10MHZ = 10000000,
+  DATA_RATE_20MHZ = 20000000,
+  DATA_RATE_40MHZ = 40000000,
+  DATA_RATE_80MHZ = 80000000,
+};
+
+/// A bus that logs every transaction. Each byte is recorded with the level
+/// of the watched pin at the moment it went out, which for a display is its
+/// data/command line.
+class SPIComponent {
+public:
+  void watch_pin(GPIOPin *pin) { this->watched_pin_ = pin; }
+
+  struct Byte {
+    uint8_t value;
+    bool pin_level;
+  };
+  struct Transaction {
+    std::vector<Byte> bytes;
+  };
+  std::vector<Transaction> transactions;
+  bool in_transaction{false};
+
+  void begin_transaction();
+  void end_transaction();
+  void write(const uint8_t *data, size_t len);
+
+protected:
+  GPIOPin *watched_pin_{nullptr};
+};
+
+template <BitOrder BIT_ORDER, ClockPolarity CLOCK_POLARITY,
+          ClockPhase CLOCK_PHASE, DataRate DATA_RATE>
+class SPIDevice {
+public:
+  void set_spi_parent(SPIComponent *parent) { this->parent_ = parent; }
+  void set_cs_pin(GPIOPin *cs) { this->cs_ = cs; }
+
+  void spi_setup() {
+    if (this->cs_ != nullptr) {
+      this->cs_->setup();
+      this->cs_->digital_write(true);
+    }
+  }
+  void enable() {
+    if (this->cs_ != nullptr) {
+      this->cs_->digital_write(false);
+    }
+    this->parent_->begin_transaction();
+  }
+  void disable() {
+    this->parent_->end_transaction();
+    if (this->cs_ != nullptr) {
+      this->cs_->digital_write(true);
+    }
+  }
+  void write_byte(uint8_t data) { this->parent_->write(&data, 1); }
+  void write_array(const uint8_t *data, size_t length) {
+    this->parent_->write(data, length);
+  }
+  void write_array(const std::vector<uint8_t> &data) {
+    this->parent_->write(data.data(), data.size());
+  }
+
+protected:
+  SPIComponent *parent_{nullptr};
+  GPIOPin *cs_{nullptr};
+};
+
+} // namespace spi
+} // namespace esphome
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace split_buffer {
+
+/// The real buffer spreads itself over several allocations to fit in
+/// fragmented memory; on the host one vector will do.
+class SplitBuffer {
+public:
+  bool init(size_t total_length) {
+    this->data_.assign(total_length, 0);
+    return true;
+  }
+  void free() { this->data_.clear(); }
+  uint8_t &operator[](size_t index) { return this->data_.at(index); }
+  uint8_t operator[](size_t index) const { return this->data_.at(index); }
+  void fill(uint8_t value) {
+    this->data_.assign(this->data_.size(), value);
+  }
+  size_t size() const { return this->data_.size(); }
+
+protected:
+  std::vector<uint8_t> data_;
+};
+
+} // namespace split_buffer
+} // namespace esphome
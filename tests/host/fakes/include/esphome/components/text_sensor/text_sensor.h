@@ -0,0 +1,32 @@
+#pragma once
+
+#include "esphome/core/log.h"
+
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace text_sensor {
+
+class TextSensor {
+public:
+  void publish_state(const std::string &state);
+  bool has_state() const { return this->has_state_; }
+  std::string get_state() const { return this->state; }
+
+  std::string state;
+
+  /// Test read-back: every state published, oldest first.
+  std::vector<std::string> history;
+
+protected:
+  bool has_state_{false};
+};
+
+} // namespace text_sensor
+} // namespace esphome
+
+#define LOG_TEXT_SENSOR(prefix, type, obj)                                     \
+  if (::esphome::fakes::log_object_set(obj)) {                                 \
+    ESP_LOGCONFIG(TAG, "%s%s", prefix, type);                                  \
+  }
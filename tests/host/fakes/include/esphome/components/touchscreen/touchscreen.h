@@ -0,0 +1,62 @@
+#pragma once
+
+#include "esphome/components/display/display_buffer.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace esphome {
+namespace touchscreen {
+
+struct TouchPoint {
+  uint8_t id;
+  int16_t x_raw{0}, y_raw{0}, z_raw{0};
+};
+
+/// The driver-facing half of esphome::touchscreen::Touchscreen, on a
+/// simplified polling model: update() marks the panel touched when there is
+/// no interrupt to do it, and loop() then asks the driver for touches.
+/// Calibration, mirroring and triggers are left out; tests read the raw
+/// positions.
+class Touchscreen : public PollingComponent {
+public:
+  void set_display(display::Display *display) { this->display_ = display; }
+  void set_swap_xy(bool swap) { this->swap_x_y_ = swap; }
+  void set_calibration(int16_t x_min, int16_t x_max, int16_t y_min,
+                       int16_t y_max) {
+    this->x_raw_min_ = x_min;
+    this->x_raw_max_ = x_max;
+    this->y_raw_min_ = y_min;
+    this->y_raw_max_ = y_max;
+  }
+  int16_t get_x_raw_max() const { return this->x_raw_max_; }
+  int16_t get_y_raw_max() const { return this->y_raw_max_; }
+
+  void update() override;
+  void loop() override;
+
+  /// Touches reported by the latest update_touches(), in id order.
+  std::vector<TouchPoint> get_touches() const;
+
+protected:
+  void attach_interrupt_(InternalGPIOPin *irq_pin,
+                         esphome::gpio::InterruptType type);
+  void add_raw_touch_position_(uint8_t id, int16_t x_raw, int16_t y_raw,
+                               int16_t z_raw = 0);
+  virtual void update_touches() = 0;
+
+  static void gpio_intr_(bool *touched) { *touched = true; }
+
+  display::Display *display_{nullptr};
+  int16_t x_raw_min_{0}, x_raw_max_{0}, y_raw_min_{0}, y_raw_max_{0};
+  bool swap_x_y_{false};
+  bool has_interrupt_{false};
+  bool touched_{false};
+  std::map<uint8_t, TouchPoint> touches_;
+};
+
+} // namespace touchscreen
+} // namespace esphome
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "esphome/core/component.h"
+
+#include <cstdint>
+
+namespace esphome {
+
+class Application {
+public:
+  uint32_t get_loop_component_start_time() const {
+    return this->loop_component_start_time_;
+  }
+  void set_loop_component_start_time(uint32_t time) {
+    this->loop_component_start_time_ = time;
+  }
+
+  /// Counts calls and records the longest time between two of them, so a
+  /// test can tell whether a long-running call would starve the watchdog.
+  void feed_wdt(uint32_t time = 0);
+  uint32_t get_wdt_feeds() const { return this->wdt_feeds_; }
+  /// Longest gap in ms between two feeds, or since reset_wdt_stats().
+  uint32_t get_longest_wdt_gap_ms() const;
+  void reset_wdt_stats();
+
+protected:
+  uint32_t loop_component_start_time_{0};
+  uint32_t wdt_feeds_{0};
+  uint32_t last_wdt_feed_ms_{0};
+  uint32_t longest_wdt_gap_ms_{0};
+};
+
+extern Application App; // NOLINT
+
+} // namespace esphome
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+namespace automation {
+
+// Mirrors the action interface the recorder's actions are declared against.
+struct ActionContext {};
+
+class Action {
+public:
+  virtual ~Action() = default;
+  virtual void play(ActionContext &ctx) = 0;
+  void play_next(ActionContext &ctx) {
+    if (this->next_ != nullptr) {
+      this->next_->play(ctx);
+    }
+  }
+  void set_next(Action *next) { this->next_ = next; }
+
+protected:
+  Action *next_{nullptr};
+};
+
+using esphome::Parented;
+
+} // namespace automation
+} // namespace esphome
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+
+struct Color {
+  uint8_t r{0};
+  uint8_t g{0};
+  uint8_t b{0};
+  uint8_t w{0};
+
+  constexpr Color() = default;
+  constexpr Color(uint8_t red, uint8_t green, uint8_t blue, uint8_t white = 0)
+      : r(red), g(green), b(blue), w(white) {}
+
+  constexpr bool operator==(const Color &rhs) const {
+    return this->r == rhs.r && this->g == rhs.g && this->b == rhs.b &&
+           this->w == rhs.w;
+  }
+};
+
+static constexpr Color COLOR_BLACK(0, 0, 0, 0);
+static constexpr Color COLOR_WHITE(255, 255, 255, 255);
+
+} // namespace esphome
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#include "esphome/core/log.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace esphome {
+
+namespace setup_priority {
+static constexpr float BUS = 1000.0f;
+static constexpr float IO = 900.0f;
+static constexpr float HARDWARE = 800.0f;
+static constexpr float DATA = 600.0f;
+static constexpr float PROCESSOR = 400.0f;
+static constexpr float BLUETOOTH = 350.0f;
+static constexpr float AFTER_BLUETOOTH = 300.0f;
+static constexpr float WIFI = 250.0f;
+static constexpr float AFTER_WIFI = 200.0f;
+static constexpr float AFTER_CONNECTION = 100.0f;
+static constexpr float LATE = -100.0f;
+} // namespace setup_priority
+
+/// The parts of esphome::Component the components here use. Timeouts and
+/// intervals go to a scheduler that fakes::run_scheduler() (or
+/// fakes::loop_once()) runs against millis(); status flags are plain
+/// members a test can read back.
+class Component {
+public:
+  virtual ~Component();
+
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual float get_setup_priority() const { return setup_priority::DATA; }
+  virtual bool can_proceed() { return true; }
+  virtual void on_shutdown() {}
+  virtual void on_safe_shutdown() {}
+
+  void mark_failed() { this->failed_ = true; }
+  void mark_failed(const char *message);
+  bool is_failed() const { return this->failed_; }
+
+  void status_set_warning(const char *message = nullptr);
+  void status_clear_warning() { this->warning_ = false; }
+  bool status_has_warning() const { return this->warning_; }
+  void status_set_error(const char *message = nullptr);
+  void status_clear_error() { this->error_ = false; }
+  bool status_has_error() const { return this->error_; }
+  void status_momentary_error(const std::string &name, uint32_t length = 5000);
+
+  void enable_loop() { this->loop_enabled_ = true; }
+  void disable_loop() { this->loop_enabled_ = false; }
+  bool is_loop_enabled() const { return this->loop_enabled_; }
+
+protected:
+  void set_timeout(const std::string &name, uint32_t timeout,
+                   std::function<void()> &&f);
+  void set_timeout(uint32_t timeout, std::function<void()> &&f);
+  bool cancel_timeout(const std::string &name);
+  void set_interval(const std::string &name, uint32_t interval,
+                    std::function<void()> &&f);
+  void set_interval(uint32_t interval, std::function<void()> &&f);
+  bool cancel_interval(const std::string &name);
+  void defer(std::function<void()> &&f);
+
+  bool failed_{false};
+  bool warning_{false};
+  bool error_{false};
+  bool loop_enabled_{true};
+};
+
+class PollingComponent : public Component {
+public:
+  PollingComponent() = default;
+  explicit PollingComponent(uint32_t update_interval)
+      : update_interval_(update_interval) {}
+
+  virtual void update() = 0;
+  virtual void set_update_interval(uint32_t update_interval) {
+    this->update_interval_ = update_interval;
+  }
+  uint32_t get_update_interval() const { return this->update_interval_; }
+
+protected:
+  uint32_t update_interval_{1000};
+};
+
+namespace fakes {
+
+/// Runs every timeout, interval and deferred call that is due by millis().
+/// Returns the number run.
+size_t run_scheduler();
+/// Calls component->loop() (if its loop is enabled) with the application's
+/// loop start time set, then runs the scheduler.
+void loop_once(Component *component);
+/// Scheduled items still pending for the component.
+size_t scheduled_count(const Component *component);
+
+} // namespace fakes
+} // namespace esphome
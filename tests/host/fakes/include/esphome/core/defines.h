@@ -0,0 +1,13 @@
+#pragma once
+
+// The feature flags an ESP-IDF firmware using every component in this repo
+// would be generated with.
+#define USE_ESP32
+#define USE_ESP_IDF
+#define USE_SENSOR
+#define USE_BINARY_SENSOR
+#define USE_TEXT_SENSOR
+#define USE_BSEC2
+
+// Everything is compiled in; HOST_TEST_LOG picks what is printed.
+#define ESPHOME_LOG_LEVEL ESPHOME_LOG_LEVEL_VERY_VERBOSE
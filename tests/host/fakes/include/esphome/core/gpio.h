@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace esphome {
+
+namespace gpio {
+
+enum Flags : uint8_t {
+  FLAG_NONE = 0x00,
+  FLAG_INPUT = 0x01,
+  FLAG_OUTPUT = 0x02,
+  FLAG_OPEN_DRAIN = 0x04,
+  FLAG_PULLUP = 0x08,
+  FLAG_PULLDOWN = 0x10,
+};
+
+enum InterruptType : uint8_t {
+  INTERRUPT_RISING_EDGE = 1,
+  INTERRUPT_FALLING_EDGE = 2,
+  INTERRUPT_ANY_EDGE = 3,
+  INTERRUPT_LOW_LEVEL = 4,
+  INTERRUPT_HIGH_LEVEL = 5,
+};
+
+} // namespace gpio
+
+class GPIOPin {
+public:
+  virtual ~GPIOPin() = default;
+  virtual void setup() = 0;
+  virtual void pin_mode(gpio::Flags flags) = 0;
+  virtual bool digital_read() = 0;
+  virtual void digital_write(bool value) = 0;
+  virtual std::string dump_summary() const = 0;
+  virtual bool is_internal() { return false; }
+};
+
+class ISRInternalGPIOPin {};
+
+class InternalGPIOPin : public GPIOPin {
+public:
+  template <typename T>
+  void attach_interrupt(void (*func)(T *), T *arg,
+                        gpio::InterruptType type) const {
+    this->attach_interrupt(reinterpret_cast<void (*)(void *)>(func), arg,
+                           type);
+  }
+  virtual void detach_interrupt() const = 0;
+  virtual uint8_t get_pin() const = 0;
+  bool is_internal() override { return true; }
+
+protected:
+  virtual void attach_interrupt(void (*func)(void *), void *arg,
+                                gpio::InterruptType type) const = 0;
+};
+
+namespace fakes {
+
+/// A pin that remembers everything done to it. Output writes are logged
+/// with the millis() they happened at and read back as the level; an input
+/// level is set with set_level(), which fires an attached interrupt on the
+/// matching edge.
+class FakePin : public InternalGPIOPin {
+public:
+  explicit FakePin(uint8_t pin = 0) : pin_(pin) {}
+
+  void setup() override { this->setup_count++; }
+  void pin_mode(gpio::Flags flags) override { this->mode = flags; }
+  bool digital_read() override { return this->level_; }
+  void digital_write(bool value) override;
+  std::string dump_summary() const override;
+  void detach_interrupt() const override;
+  uint8_t get_pin() const override { return this->pin_; }
+
+  void set_level(bool level);
+  bool interrupt_attached() const { return this->isr_ != nullptr; }
+
+  struct Write {
+    bool value;
+    uint32_t time_ms;
+  };
+  std::vector<Write> writes;
+  int setup_count{0};
+  gpio::Flags mode{gpio::FLAG_NONE};
+  mutable gpio::InterruptType interrupt_type{};
+
+protected:
+  void attach_interrupt(void (*func)(void *), void *arg,
+                        gpio::InterruptType type) const override;
+
+  uint8_t pin_;
+  bool level_{false};
+  mutable void (*isr_)(void *){nullptr};
+  mutable void *isr_arg_{nullptr};
+};
+
+} // namespace fakes
+} // namespace esphome
+
+#define LOG_PIN(prefix, pin)                                                   \
+  if (::esphome::fakes::log_object_set(pin)) {                                 \
+    ESP_LOGCONFIG(TAG, prefix "%s", (pin)->dump_summary().c_str());            \
+  }
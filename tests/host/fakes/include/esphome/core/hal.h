@@ -0,0 +1,26 @@
+#pragma once
+
+#include "esphome/core/gpio.h"
+
+#include <cstdint>
+
+#define IRAM_ATTR
+#define PROGMEM
+#define HOT __attribute__((hot))
+
+namespace esphome {
+
+// The clock runs in real time from process start, plus whatever the test
+// skipped ahead; FreeRTOS ticks and esp_timer_get_time() follow it too.
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+namespace fakes {
+
+/// Moves every clock forward without waiting, e.g. to expire a timeout.
+void advance_time_ms(uint32_t ms);
+
+} // namespace fakes
+} // namespace esphome
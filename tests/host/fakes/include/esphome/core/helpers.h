@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace esphome {
+
+/// Heap allocator standing in for the PSRAM/internal RAM one. Allocations
+/// can be made to fail, to exercise the components' out-of-memory paths.
+template <class T> class RAMAllocator {
+public:
+  enum Flags {
+    NONE = 0,
+    ALLOC_EXTERNAL = 1 << 0,
+    ALLOC_INTERNAL = 1 << 1,
+    ALLOW_FAILURE = 1 << 2,
+  };
+
+  RAMAllocator() = default;
+  RAMAllocator(uint8_t flags) : flags_(flags) {}
+
+  T *allocate(size_t n) {
+    if (fail_next_allocations > 0) {
+      fail_next_allocations--;
+      return nullptr;
+    }
+    return static_cast<T *>(std::malloc(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t /*n*/) { std::free(p); }
+
+  /// Test control: the next this many allocate() calls for this element
+  /// type return nullptr.
+  static inline int fail_next_allocations = 0;
+
+protected:
+  uint8_t flags_{NONE};
+};
+
+template <typename T> class Parented {
+public:
+  Parented() = default;
+  Parented(T *parent) : parent_(parent) {}
+
+  T *get_parent() const { return this->parent_; }
+  void set_parent(T *parent) { this->parent_ = parent; }
+
+protected:
+  T *parent_{nullptr};
+};
+
+std::string format_hex_pretty(const uint8_t *data, size_t length,
+                              char separator = '.', bool show_length = true);
+
+} // namespace esphome
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+
+#include <cinttypes>
+#include <string>
+
+#define ESPHOME_LOG_LEVEL_NONE 0
+#define ESPHOME_LOG_LEVEL_ERROR 1
+#define ESPHOME_LOG_LEVEL_WARN 2
+#define ESPHOME_LOG_LEVEL_INFO 3
+#define ESPHOME_LOG_LEVEL_CONFIG 4
+#define ESPHOME_LOG_LEVEL_DEBUG 5
+#define ESPHOME_LOG_LEVEL_VERBOSE 6
+#define ESPHOME_LOG_LEVEL_VERY_VERBOSE 7
+
+namespace esphome {
+namespace fakes {
+
+/// Formats one log line. It is printed to stderr if its level is at or below
+/// the HOST_TEST_LOG environment variable (a level name, "warn" by default)
+/// and kept for log_contains() either way.
+void log(int level, const char *tag, int line, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/// Whether any line logged since the last clear_log() contains text.
+bool log_contains(const std::string &text);
+/// Lines logged at exactly this level since the last clear_log().
+size_t log_count(int level);
+void clear_log();
+
+/// Whether a LOG_* macro was handed an object. ESPHome's macros compare it
+/// against nullptr in place, which GCC flags as always true when it is this.
+inline bool log_object_set(const void *obj) { return obj != nullptr; }
+
+} // namespace fakes
+} // namespace esphome
+
+#define ESP_LOGE(tag, ...)                                                     \
+  ::esphome::fakes::log(ESPHOME_LOG_LEVEL_ERROR, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGW(tag, ...)                                                     \
+  ::esphome::fakes::log(ESPHOME_LOG_LEVEL_WARN, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGI(tag, ...)                                                     \
+  ::esphome::fakes::log(ESPHOME_LOG_LEVEL_INFO, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...)                                                \
+  ::esphome::fakes::log(ESPHOME_LOG_LEVEL_CONFIG, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGD(tag, ...)                                                     \
+  ::esphome::fakes::log(ESPHOME_LOG_LEVEL_DEBUG, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGV(tag, ...)                                                     \
+  ::esphome::fakes::log(ESPHOME_LOG_LEVEL_VERBOSE, tag, __LINE__, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...)                                                    \
+  ::esphome::fakes::log(ESPHOME_LOG_LEVEL_VERY_VERBOSE, tag, __LINE__,         \
+                        __VA_ARGS__)
+
+#define YESNO(b) ((b) ? "YES" : "NO")
+#define ONOFF(b) ((b) ? "ON" : "OFF")
+#define TRUEFALSE(b) ((b) ? "TRUE" : "FALSE")
+
+#define LOG_UPDATE_INTERVAL(this)                                              \
+  ESP_LOGCONFIG(TAG, "  Update Interval: %.1fs",                               \
+                this->get_update_interval() / 1000.0f)
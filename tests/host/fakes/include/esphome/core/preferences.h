@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+namespace esphome {
+
+class ESPPreferenceBackend {
+public:
+  virtual ~ESPPreferenceBackend() = default;
+  virtual bool save(const uint8_t *data, size_t len) = 0;
+  virtual bool load(uint8_t *data, size_t len) = 0;
+};
+
+class ESPPreferenceObject {
+public:
+  ESPPreferenceObject() = default;
+  ESPPreferenceObject(ESPPreferenceBackend *backend) : backend_(backend) {}
+
+  template <typename T> bool save(const T *src) {
+    if (this->backend_ == nullptr) {
+      return false;
+    }
+    return this->backend_->save(reinterpret_cast<const uint8_t *>(src),
+                                sizeof(T));
+  }
+
+  template <typename T> bool load(T *dest) {
+    if (this->backend_ == nullptr) {
+      return false;
+    }
+    return this->backend_->load(reinterpret_cast<uint8_t *>(dest), sizeof(T));
+  }
+
+protected:
+  ESPPreferenceBackend *backend_{nullptr};
+};
+
+class ESPPreferences {
+public:
+  virtual ~ESPPreferences() = default;
+  virtual ESPPreferenceObject make_preference(size_t length, uint32_t type,
+                                              bool in_flash) = 0;
+  virtual ESPPreferenceObject make_preference(size_t length,
+                                              uint32_t type) = 0;
+  virtual bool sync() = 0;
+  virtual bool reset() = 0;
+
+  template <typename T, std::enable_if_t<std::is_trivially_copyable_v<T>,
+                                         bool> = true>
+  ESPPreferenceObject make_preference(uint32_t type, bool in_flash) {
+    return this->make_preference(sizeof(T), type, in_flash);
+  }
+
+  template <typename T, std::enable_if_t<std::is_trivially_copyable_v<T>,
+                                         bool> = true>
+  ESPPreferenceObject make_preference(uint32_t type) {
+    return this->make_preference(sizeof(T), type);
+  }
+};
+
+extern ESPPreferences *global_preferences; // NOLINT
+
+namespace fakes {
+
+/// Flash stand-in: records live in memory for the life of the process, so
+/// a second component instance sees what the first one saved, as after a
+/// reboot. A record only loads with the length it was saved with.
+class FakePreferences : public ESPPreferences {
+public:
+  ESPPreferenceObject make_preference(size_t length, uint32_t type,
+                                      bool in_flash) override;
+  ESPPreferenceObject make_preference(size_t length, uint32_t type) override {
+    return this->make_preference(length, type, false);
+  }
+  bool sync() override { return true; }
+  bool reset() override;
+
+  /// The saved bytes for a type, empty if none.
+  std::vector<uint8_t> stored(uint32_t type) const;
+  uint32_t save_count(uint32_t type) const;
+
+protected:
+  class Backend;
+  struct Record {
+    std::vector<uint8_t> data;
+    uint32_t saves{0};
+    bool in_flash{false};
+  };
+  std::map<uint32_t, Record> records_;
+  std::vector<Backend *> backends_;
+};
+
+FakePreferences &preferences();
+
+} // namespace fakes
+} // namespace esphome
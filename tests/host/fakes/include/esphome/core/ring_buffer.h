@@ -0,0 +1,49 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace esphome {
+
+/// Byte ring with the interface of esphome::RingBuffer. The real one wraps a
+/// FreeRTOS byte ring buffer, which takes a critical section on every call;
+/// this one takes a mutex, so comparing it with a lock-free ring on the host
+/// keeps the shape of the cost, if not its size.
+class RingBuffer {
+public:
+  static std::unique_ptr<RingBuffer> create(size_t len);
+
+  /// Reads up to len bytes, waiting up to ticks_to_wait for any to arrive.
+  size_t read(void *data, size_t len, TickType_t ticks_to_wait = 0);
+  /// Writes all of data, discarding the oldest queued bytes to make room.
+  size_t write(const void *data, size_t len);
+  /// Writes what fits within ticks_to_wait without discarding anything.
+  size_t write_without_replacement(const void *data, size_t len,
+                                   TickType_t ticks_to_wait = 0,
+                                   bool write_partial = true);
+
+  size_t available() const;
+  size_t free() const;
+  BaseType_t reset();
+
+protected:
+  explicit RingBuffer(size_t len) : storage_(len) {}
+
+  size_t discard_bytes_(size_t len);
+  void put_(const uint8_t *data, size_t len);
+
+  std::vector<uint8_t> storage_;
+  size_t head_{0};
+  size_t fill_{0};
+  mutable std::mutex mutex_;
+  std::condition_variable readable_;
+  std::condition_variable writable_;
+};
+
+} // namespace esphome
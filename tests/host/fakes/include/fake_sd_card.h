@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace fakes {
+
+/// The SD card behind the esp_vfs_fat, sdmmc and sdspi fakes.
+///
+/// Mounted as a file system, the card is the host directory given as the
+/// mount point; writes, pwrites and fsyncs to files under it pass through
+/// the fake (the test binaries link with --wrap for those calls), so they
+/// see the card's latency and faults. Initialised for raw access, its
+/// sectors live in an image file.
+struct SdCard {
+  /// Bus clock at or below which the card works. Initialising above it
+  /// fails with a CRC error, and so does every sector write once the clock
+  /// is raised above it.
+  std::atomic<uint32_t> max_clock_khz{UINT32_MAX};
+  /// Size reported by esp_vfs_fat_info(); free space is this minus the
+  /// bytes in the mounted directory's files.
+  std::atomic<uint64_t> capacity_bytes{uint64_t{32} << 30};
+  /// Added to every write, pwrite, fsync and sector write.
+  std::atomic<uint32_t> write_delay_us{0};
+  /// The next this many writes fail: file writes with EIO, sector writes
+  /// with ESP_ERR_TIMEOUT.
+  std::atomic<int> fail_writes{0};
+  /// The next this many file writes are cut short to half their length,
+  /// with errno left set to EIO as a stale value from an earlier call.
+  std::atomic<int> short_writes{0};
+
+  // Read back by tests.
+  std::atomic<uint32_t> clock_khz{0};
+  std::atomic<int> init_attempts{0};
+  std::atomic<int> write_errors{0};
+  std::atomic<uint32_t> writes{0};
+  std::string mount_point;
+  bool mounted{false};
+};
+
+SdCard &sd_card();
+/// Unmounts and restores every setting to its default.
+void reset_sd_card();
+/// Backs raw sector access with an existing image file, whose size sets
+/// the card's capacity. Returns false if it can't be opened.
+bool attach_sd_image(const std::string &path);
+
+} // namespace fakes
+} // namespace esphome
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#include <cstdint>
+
+typedef void (*TaskFunction_t)(void *);
+
+/// Starts the task on a new thread; priority and core are recorded but have
+/// no effect.
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name,
+                                   uint32_t stack_depth, void *parameters,
+                                   UBaseType_t priority,
+                                   TaskHandle_t *created_task,
+                                   BaseType_t core_id);
+/// Deleting the calling task (nullptr) ends its thread. Deleting another
+/// task waits until that task next enters a FreeRTOS call, where it ends.
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t increment);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit,
+                          TickType_t ticks_to_wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+namespace esphome {
+namespace fakes {
+
+/// Tasks created and not yet deleted.
+int live_task_count();
+/// The priority and core the named task was last created with, or false if
+/// no task of that name was created.
+bool task_config(const char *name, UBaseType_t *priority, BaseType_t *core);
+
+} // namespace fakes
+} // namespace esphome
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "driver/sdmmc_types.h"
+
+#include <cstddef>
+
+esp_err_t sdmmc_card_init(const sdmmc_host_t *host, sdmmc_card_t *out_card);
+esp_err_t sdmmc_write_sectors(sdmmc_card_t *card, const void *src,
+                              size_t start_sector, size_t sector_count);
+esp_err_t sdmmc_read_sectors(sdmmc_card_t *card, void *dst,
+                             size_t start_sector, size_t sector_count);
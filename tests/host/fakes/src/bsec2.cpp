@@ -0,0 +1,247 @@
+#include <bsec2.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace fakes {
+
+namespace {
+
+Bsec model;
+
+constexpr uint32_t STATE_MAGIC = 0x42534543; // "BSEC"
+
+// What the library keeps in its instance buffer.
+struct Instance {
+  uint32_t steps;
+  uint32_t subscribed; // bit per virtual sensor id
+  float sample_rate;
+};
+static_assert(sizeof(Instance) <= BSEC_INSTANCE_SIZE);
+
+struct SerializedState {
+  uint32_t magic;
+  uint32_t steps;
+};
+static_assert(sizeof(SerializedState) <= BSEC_MAX_STATE_BLOB_SIZE);
+
+Instance *instance(void *inst) { return static_cast<Instance *>(inst); }
+
+uint8_t accuracy(const Instance *inst) {
+  const uint32_t per_step = std::max<uint32_t>(model.steps_per_accuracy, 1);
+  return static_cast<uint8_t>(std::min<uint32_t>(inst->steps / per_step, 3));
+}
+
+} // namespace
+
+Bsec &bsec() { return model; }
+
+void reset_bsec() { model = Bsec{}; }
+
+} // namespace fakes
+} // namespace esphome
+
+using esphome::fakes::Instance;
+using esphome::fakes::model;
+
+bsec_library_return_t bsec_init_m(void *inst) {
+  std::memset(inst, 0, sizeof(Instance));
+  return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_version_m(void * /*inst*/,
+                                         bsec_version_t *bsec_version_p) {
+  *bsec_version_p = {2, 6, 1, 0};
+  return BSEC_OK;
+}
+
+bsec_library_return_t
+bsec_set_configuration_m(void * /*inst*/, const uint8_t * /*serialized*/,
+                         uint32_t n_serialized_settings, uint8_t * /*work*/,
+                         uint32_t n_work_buffer_size) {
+  if (n_serialized_settings > n_work_buffer_size) {
+    return BSEC_E_PARSE_SECTIONEXCEEDSWORKBUFFER;
+  }
+  return BSEC_OK;
+}
+
+bsec_library_return_t bsec_update_subscription_m(
+    void *inst, const bsec_sensor_configuration_t *requested_virtual_sensors,
+    uint8_t n_requested_virtual_sensors,
+    bsec_sensor_configuration_t * /*required_sensor_settings*/,
+    uint8_t *n_required_sensor_settings) {
+  auto *state = esphome::fakes::instance(inst);
+  state->subscribed = 0;
+  for (uint8_t i = 0; i < n_requested_virtual_sensors; i++) {
+    state->subscribed |= 1u << requested_virtual_sensors[i].sensor_id;
+    state->sample_rate = requested_virtual_sensors[i].sample_rate;
+  }
+  *n_required_sensor_settings = 0;
+  return state->subscribed == 0 ? BSEC_I_SU_SUBSCRIBEDOUTPUTGATES : BSEC_OK;
+}
+
+bsec_library_return_t bsec_sensor_control_m(void * /*inst*/,
+                                            int64_t time_stamp,
+                                            bsec_bme_settings_t *settings) {
+  std::memset(settings, 0, sizeof(*settings));
+  settings->next_call =
+      time_stamp + static_cast<int64_t>(model.period_ms) * 1000000;
+  settings->op_mode = BME68X_FORCED_MODE;
+  settings->trigger_measurement = 1;
+  settings->run_gas = 1;
+  settings->heater_temperature = 320;
+  settings->heater_duration = 197;
+  settings->temperature_oversampling = 2;
+  settings->pressure_oversampling = 5;
+  settings->humidity_oversampling = 1;
+  settings->process_data = (1u << (BSEC_INPUT_TEMPERATURE - 1)) |
+                           (1u << (BSEC_INPUT_HUMIDITY - 1)) |
+                           (1u << (BSEC_INPUT_PRESSURE - 1)) |
+                           (1u << (BSEC_INPUT_GASRESISTOR - 1)) |
+                           (1u << (BSEC_INPUT_HEATSOURCE - 1));
+  return BSEC_OK;
+}
+
+bsec_library_return_t bsec_do_steps_m(void *inst, const bsec_input_t *inputs,
+                                      uint8_t n_inputs, bsec_output_t *outputs,
+                                      uint8_t *n_outputs) {
+  if (n_inputs == 0) {
+    return BSEC_E_DOSTEPS_INVALIDINPUT;
+  }
+  auto *state = esphome::fakes::instance(inst);
+  state->steps++;
+  const uint8_t accuracy = esphome::fakes::accuracy(state);
+  const int64_t time_stamp = inputs[0].time_stamp;
+  // The compensated readings follow the inputs, less the heat source.
+  float temperature = model.temperature;
+  float humidity = model.humidity;
+  float heat_source = 0.0f;
+  for (uint8_t i = 0; i < n_inputs; i++) {
+    if (inputs[i].sensor_id == BSEC_INPUT_TEMPERATURE) {
+      temperature = inputs[i].signal;
+    } else if (inputs[i].sensor_id == BSEC_INPUT_HUMIDITY) {
+      humidity = inputs[i].signal;
+    } else if (inputs[i].sensor_id == BSEC_INPUT_HEATSOURCE) {
+      heat_source = inputs[i].signal;
+    }
+  }
+
+  struct {
+    uint8_t id;
+    float signal;
+    uint8_t accuracy;
+  } const produced[] = {
+      {BSEC_OUTPUT_IAQ, model.iaq, accuracy},
+      {BSEC_OUTPUT_STATIC_IAQ, model.iaq, accuracy},
+      {BSEC_OUTPUT_CO2_EQUIVALENT, 500.0f + model.iaq * 4.0f, accuracy},
+      {BSEC_OUTPUT_BREATH_VOC_EQUIVALENT, model.iaq / 100.0f, accuracy},
+      {BSEC_OUTPUT_RAW_PRESSURE, model.pressure, 0},
+      {BSEC_OUTPUT_RAW_GAS, model.gas_resistance, 0},
+      {BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE,
+       temperature - heat_source, 0},
+      {BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY, humidity, 0},
+  };
+  uint8_t count = 0;
+  for (const auto &output : produced) {
+    if ((state->subscribed & (1u << output.id)) == 0 || count >= *n_outputs) {
+      continue;
+    }
+    outputs[count++] = {time_stamp, output.signal, 1, output.id,
+                        output.accuracy};
+  }
+  *n_outputs = count;
+  return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_state_m(void *inst, uint8_t /*state_set_id*/,
+                                       uint8_t *serialized_state,
+                                       uint32_t n_serialized_state_max,
+                                       uint8_t * /*work_buffer*/,
+                                       uint32_t /*n_work_buffer*/,
+                                       uint32_t *n_serialized_state) {
+  esphome::fakes::SerializedState state{esphome::fakes::STATE_MAGIC,
+                                        esphome::fakes::instance(inst)->steps};
+  if (n_serialized_state_max < sizeof(state)) {
+    return BSEC_E_SET_INVALIDLENGTH;
+  }
+  std::memset(serialized_state, 0, n_serialized_state_max);
+  std::memcpy(serialized_state, &state, sizeof(state));
+  *n_serialized_state = n_serialized_state_max;
+  return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_state_m(void *inst,
+                                       const uint8_t *serialized_state,
+                                       uint32_t n_serialized_state,
+                                       uint8_t * /*work_buffer*/,
+                                       uint32_t /*n_work_buffer_size*/) {
+  esphome::fakes::SerializedState state;
+  if (n_serialized_state < sizeof(state)) {
+    return BSEC_E_SET_INVALIDLENGTH;
+  }
+  std::memcpy(&state, serialized_state, sizeof(state));
+  if (state.magic != esphome::fakes::STATE_MAGIC) {
+    return BSEC_E_CONFIG_FAIL;
+  }
+  esphome::fakes::instance(inst)->steps = state.steps;
+  return BSEC_OK;
+}
+
+int8_t bme68x_init(struct bme68x_dev *dev) {
+  dev->op_mode = BME68X_SLEEP_MODE;
+  return model.init_status;
+}
+
+int8_t bme68x_get_conf(struct bme68x_conf *conf, struct bme68x_dev * /*dev*/) {
+  std::memset(conf, 0, sizeof(*conf));
+  return BME68X_OK;
+}
+
+int8_t bme68x_set_conf(struct bme68x_conf * /*conf*/,
+                       struct bme68x_dev * /*dev*/) {
+  return BME68X_OK;
+}
+
+int8_t bme68x_set_heatr_conf(uint8_t /*op_mode*/,
+                             const struct bme68x_heatr_conf * /*conf*/,
+                             struct bme68x_dev * /*dev*/) {
+  return BME68X_OK;
+}
+
+int8_t bme68x_set_op_mode(uint8_t op_mode, struct bme68x_dev *dev) {
+  dev->op_mode = op_mode;
+  return BME68X_OK;
+}
+
+int8_t bme68x_get_op_mode(uint8_t *op_mode, struct bme68x_dev *dev) {
+  *op_mode = dev->op_mode;
+  return BME68X_OK;
+}
+
+uint32_t bme68x_get_meas_dur(uint8_t /*op_mode*/, struct bme68x_conf * /*conf*/,
+                             struct bme68x_dev * /*dev*/) {
+  // A forced-mode TPH measurement with the oversampling above, in us.
+  return 10000;
+}
+
+int8_t bme68x_get_data(uint8_t /*op_mode*/, struct bme68x_data *data,
+                       uint8_t *n_data, struct bme68x_dev *dev) {
+  if (dev->op_mode == BME68X_SLEEP_MODE) {
+    *n_data = 0;
+    return BME68X_OK;
+  }
+  // A forced measurement returns the sensor to sleep once read.
+  if (dev->op_mode == BME68X_FORCED_MODE) {
+    dev->op_mode = BME68X_SLEEP_MODE;
+  }
+  std::memset(data, 0, sizeof(*data));
+  data->status = BME68X_NEW_DATA_MSK | BME68X_GASM_VALID_MSK |
+                 BME68X_HEAT_STAB_MSK;
+  data->temperature = model.temperature;
+  data->pressure = model.pressure;
+  data->humidity = model.humidity;
+  data->gas_resistance = model.gas_resistance;
+  *n_data = 1;
+  return BME68X_OK;
+}
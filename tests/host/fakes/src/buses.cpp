@@ -0,0 +1,77 @@
+#include "esphome/components/i2c/i2c.h"
+#include "esphome/components/spi/spi.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+
+namespace i2c {
+
+ErrorCode I2CBus::read_register16(uint8_t /*address*/, uint16_t a_register,
+                                  uint8_t *data, size_t len) {
+  this->reads.push_back(a_register);
+  if (!this->present || this->failing_registers.count(a_register) != 0) {
+    return ERROR_NOT_ACKNOWLEDGED;
+  }
+  std::memset(data, 0, len);
+  const auto it = this->registers.find(a_register);
+  if (it != this->registers.end()) {
+    std::memcpy(data, it->second.data(), std::min(len, it->second.size()));
+  }
+  return ERROR_OK;
+}
+
+ErrorCode I2CBus::write_register16(uint8_t /*address*/, uint16_t a_register,
+                                   const uint8_t *data, size_t len) {
+  if (!this->present || this->failing_registers.count(a_register) != 0) {
+    return ERROR_NOT_ACKNOWLEDGED;
+  }
+  this->writes.push_back({a_register, std::vector<uint8_t>(data, data + len)});
+  return ERROR_OK;
+}
+
+ErrorCode I2CDevice::read_register16(uint16_t a_register, uint8_t *data,
+                                     size_t len, bool /*stop*/) {
+  if (this->bus_ == nullptr) {
+    return ERROR_NOT_INITIALIZED;
+  }
+  return this->bus_->read_register16(this->address_, a_register, data, len);
+}
+
+ErrorCode I2CDevice::write_register16(uint16_t a_register,
+                                      const uint8_t *data, size_t len,
+                                      bool /*stop*/) {
+  if (this->bus_ == nullptr) {
+    return ERROR_NOT_INITIALIZED;
+  }
+  return this->bus_->write_register16(this->address_, a_register, data, len);
+}
+
+} // namespace i2c
+
+namespace spi {
+
+void SPIComponent::begin_transaction() {
+  this->transactions.emplace_back();
+  this->in_transaction = true;
+}
+
+void SPIComponent::end_transaction() { this->in_transaction = false; }
+
+void SPIComponent::write(const uint8_t *data, size_t len) {
+  // Bytes sent outside enable()/disable() would go nowhere on a device;
+  // they still get a transaction of their own so a test can see them.
+  if (!this->in_transaction) {
+    this->transactions.emplace_back();
+  }
+  const bool level =
+      this->watched_pin_ != nullptr && this->watched_pin_->digital_read();
+  auto &bytes = this->transactions.back().bytes;
+  for (size_t i = 0; i < len; i++) {
+    bytes.push_back({data[i], level});
+  }
+}
+
+} // namespace spi
+} // namespace esphome
@@ -0,0 +1,47 @@
+#include "esphome/core/hal.h"
+
+#include <esp_timer.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace esphome {
+
+namespace {
+
+const auto START = std::chrono::steady_clock::now();
+std::atomic<uint64_t> skipped_us{0};
+
+uint64_t now_us() {
+  const auto elapsed = std::chrono::steady_clock::now() - START;
+  return std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+             .count() +
+         skipped_us.load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+uint32_t millis() { return static_cast<uint32_t>(now_us() / 1000); }
+uint32_t micros() { return static_cast<uint32_t>(now_us()); }
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+namespace fakes {
+
+void advance_time_ms(uint32_t ms) {
+  skipped_us.fetch_add(uint64_t{ms} * 1000, std::memory_order_relaxed);
+}
+
+} // namespace fakes
+} // namespace esphome
+
+int64_t esp_timer_get_time() {
+  return static_cast<int64_t>(esphome::now_us());
+}
@@ -0,0 +1,202 @@
+#include "esphome/core/application.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace esphome {
+
+Application App; // NOLINT
+
+namespace {
+
+struct ScheduledItem {
+  const Component *owner;
+  std::string name;
+  uint32_t due_ms;
+  uint32_t interval_ms;
+  bool repeat;
+  uint64_t order;
+  std::function<void()> callback;
+};
+
+std::mutex scheduler_mutex;
+std::vector<ScheduledItem> scheduled;
+uint64_t next_order = 0;
+
+bool is_due(uint32_t due_ms, uint32_t now) {
+  return static_cast<int32_t>(now - due_ms) >= 0;
+}
+
+void schedule(const Component *owner, const std::string &name,
+              uint32_t delay_ms, bool repeat, std::function<void()> &&f) {
+  std::lock_guard<std::mutex> lock(scheduler_mutex);
+  if (!name.empty()) {
+    // A named item replaces the pending one of the same name and kind.
+    scheduled.erase(std::remove_if(scheduled.begin(), scheduled.end(),
+                                   [&](const ScheduledItem &item) {
+                                     return item.owner == owner &&
+                                            item.repeat == repeat &&
+                                            item.name == name;
+                                   }),
+                    scheduled.end());
+  }
+  scheduled.push_back({owner, name, millis() + delay_ms, delay_ms, repeat,
+                       next_order++, std::move(f)});
+}
+
+bool cancel(const Component *owner, const std::string &name, bool repeat) {
+  std::lock_guard<std::mutex> lock(scheduler_mutex);
+  const auto it = std::remove_if(
+      scheduled.begin(), scheduled.end(), [&](const ScheduledItem &item) {
+        return item.owner == owner && item.repeat == repeat &&
+               item.name == name;
+      });
+  const bool found = it != scheduled.end();
+  scheduled.erase(it, scheduled.end());
+  return found;
+}
+
+} // namespace
+
+Component::~Component() {
+  std::lock_guard<std::mutex> lock(scheduler_mutex);
+  scheduled.erase(std::remove_if(scheduled.begin(), scheduled.end(),
+                                 [this](const ScheduledItem &item) {
+                                   return item.owner == this;
+                                 }),
+                  scheduled.end());
+}
+
+void Component::mark_failed(const char *message) {
+  ESP_LOGE("component", "Component was marked as failed: %s", message);
+  this->mark_failed();
+}
+
+void Component::status_set_warning(const char *message) {
+  if (message != nullptr && !this->warning_) {
+    ESP_LOGW("component", "Warning set: %s", message);
+  }
+  this->warning_ = true;
+}
+
+void Component::status_set_error(const char *message) {
+  if (message != nullptr && !this->error_) {
+    ESP_LOGE("component", "Error set: %s", message);
+  }
+  this->error_ = true;
+}
+
+void Component::status_momentary_error(const std::string &name,
+                                       uint32_t length) {
+  this->status_set_error();
+  this->set_timeout(name, length, [this]() { this->status_clear_error(); });
+}
+
+void Component::set_timeout(const std::string &name, uint32_t timeout,
+                            std::function<void()> &&f) {
+  schedule(this, name, timeout, false, std::move(f));
+}
+
+void Component::set_timeout(uint32_t timeout, std::function<void()> &&f) {
+  schedule(this, "", timeout, false, std::move(f));
+}
+
+bool Component::cancel_timeout(const std::string &name) {
+  return cancel(this, name, false);
+}
+
+void Component::set_interval(const std::string &name, uint32_t interval,
+                             std::function<void()> &&f) {
+  schedule(this, name, interval, true, std::move(f));
+}
+
+void Component::set_interval(uint32_t interval, std::function<void()> &&f) {
+  schedule(this, "", interval, true, std::move(f));
+}
+
+bool Component::cancel_interval(const std::string &name) {
+  return cancel(this, name, true);
+}
+
+void Component::defer(std::function<void()> &&f) {
+  schedule(this, "", 0, false, std::move(f));
+}
+
+void Application::feed_wdt(uint32_t time) {
+  const uint32_t now = time != 0 ? time : millis();
+  if (this->wdt_feeds_ > 0 || this->last_wdt_feed_ms_ != 0) {
+    this->longest_wdt_gap_ms_ =
+        std::max(this->longest_wdt_gap_ms_, now - this->last_wdt_feed_ms_);
+  }
+  this->last_wdt_feed_ms_ = now;
+  this->wdt_feeds_++;
+}
+
+uint32_t Application::get_longest_wdt_gap_ms() const {
+  // The time since the latest feed counts too: a call still running hasn't
+  // fed the watchdog yet.
+  return std::max(this->longest_wdt_gap_ms_,
+                  millis() - this->last_wdt_feed_ms_);
+}
+
+void Application::reset_wdt_stats() {
+  this->wdt_feeds_ = 0;
+  this->last_wdt_feed_ms_ = millis();
+  this->longest_wdt_gap_ms_ = 0;
+}
+
+namespace fakes {
+
+size_t run_scheduler() {
+  const uint32_t now = millis();
+  std::vector<ScheduledItem> due;
+  {
+    std::lock_guard<std::mutex> lock(scheduler_mutex);
+    for (auto it = scheduled.begin(); it != scheduled.end();) {
+      if (!is_due(it->due_ms, now)) {
+        ++it;
+        continue;
+      }
+      due.push_back(*it);
+      if (it->repeat) {
+        it->due_ms = now + std::max<uint32_t>(it->interval_ms, 1);
+        ++it;
+      } else {
+        it = scheduled.erase(it);
+      }
+    }
+  }
+  std::sort(due.begin(), due.end(),
+            [](const ScheduledItem &a, const ScheduledItem &b) {
+              if (a.due_ms != b.due_ms) {
+                return static_cast<int32_t>(a.due_ms - b.due_ms) < 0;
+              }
+              return a.order < b.order;
+            });
+  for (auto &item : due) {
+    item.callback();
+  }
+  return due.size();
+}
+
+void loop_once(Component *component) {
+  App.set_loop_component_start_time(millis());
+  if (component->is_loop_enabled() && !component->is_failed()) {
+    component->loop();
+  }
+  run_scheduler();
+}
+
+size_t scheduled_count(const Component *component) {
+  std::lock_guard<std::mutex> lock(scheduler_mutex);
+  return std::count_if(scheduled.begin(), scheduled.end(),
+                       [component](const ScheduledItem &item) {
+                         return item.owner == component;
+                       });
+}
+
+} // namespace fakes
+} // namespace esphome
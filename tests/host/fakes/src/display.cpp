@@ -0,0 +1,62 @@
+#include "esphome/components/display/display_buffer.h"
+#include "esphome/components/touchscreen/touchscreen.h"
+
+namespace esphome {
+
+namespace display {
+
+void Display::fill(Color color) {
+  for (int y = 0; y < this->get_height_internal(); y++) {
+    for (int x = 0; x < this->get_width_internal(); x++) {
+      this->draw_pixel_at(x, y, color);
+    }
+  }
+}
+
+void Display::do_update_() {
+  if (this->writer_) {
+    this->writer_(*this);
+  }
+}
+
+} // namespace display
+
+namespace touchscreen {
+
+void Touchscreen::update() {
+  if (!this->has_interrupt_) {
+    this->touched_ = true;
+  }
+}
+
+void Touchscreen::loop() {
+  if (!this->touched_) {
+    return;
+  }
+  this->touched_ = false;
+  this->touches_.clear();
+  this->update_touches();
+}
+
+std::vector<TouchPoint> Touchscreen::get_touches() const {
+  std::vector<TouchPoint> touches;
+  for (const auto &entry : this->touches_) {
+    touches.push_back(entry.second);
+  }
+  return touches;
+}
+
+void Touchscreen::attach_interrupt_(InternalGPIOPin *irq_pin,
+                                    esphome::gpio::InterruptType type) {
+  irq_pin->attach_interrupt(Touchscreen::gpio_intr_, &this->touched_, type);
+  this->has_interrupt_ = true;
+  this->touched_ = true;
+}
+
+void Touchscreen::add_raw_touch_position_(uint8_t id, int16_t x_raw,
+                                          int16_t y_raw, int16_t z_raw) {
+  this->touches_[id] = {id, x_raw, y_raw, z_raw};
+}
+
+} // namespace touchscreen
+} // namespace esphome
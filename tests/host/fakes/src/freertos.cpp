@@ -0,0 +1,192 @@
+#include "esphome/core/hal.h"
+
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Thrown inside a task to unwind it when the task is deleted.
+struct TaskExit {};
+
+struct Task {
+  std::string name;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  uint32_t notifications{0};
+  bool delete_requested{false};
+};
+
+struct TaskConfig {
+  UBaseType_t priority;
+  BaseType_t core;
+};
+
+std::mutex registry_mutex;
+std::map<std::string, TaskConfig> configs;
+int live_tasks = 0;
+
+thread_local Task *current_task = nullptr;
+
+// Threads that aren't tasks (the test's main thread) get a record too, so
+// they can take notifications and delay like one.
+Task *current() {
+  if (current_task == nullptr) {
+    thread_local Task outside_task;
+    current_task = &outside_task;
+  }
+  return current_task;
+}
+
+void exit_if_deleted(Task *task) {
+  if (task->delete_requested) {
+    throw TaskExit{};
+  }
+}
+
+// Waits on the task's condition variable until pred holds, the deadline
+// passes (millis() time) or the task is deleted. Returns pred().
+template <typename Pred>
+bool wait_until(Task *task, std::unique_lock<std::mutex> &lock,
+                uint32_t deadline_ms, bool forever, Pred pred) {
+  while (!pred()) {
+    exit_if_deleted(task);
+    if (forever) {
+      task->wake.wait(lock);
+      continue;
+    }
+    const int32_t remaining =
+        static_cast<int32_t>(deadline_ms - esphome::millis());
+    if (remaining <= 0) {
+      break;
+    }
+    // Short slices, so a skip of the fake clock is noticed.
+    task->wake.wait_for(
+        lock, std::chrono::milliseconds(std::min<int32_t>(remaining, 5)));
+  }
+  exit_if_deleted(task);
+  return pred();
+}
+
+void sleep_until_ms(uint32_t deadline_ms) {
+  Task *task = current();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  wait_until(task, lock, deadline_ms, false, [] { return false; });
+}
+
+} // namespace
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name,
+                                   uint32_t /*stack_depth*/, void *parameters,
+                                   UBaseType_t priority,
+                                   TaskHandle_t *created_task,
+                                   BaseType_t core_id) {
+  auto *task = new Task;
+  task->name = name;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    configs[name] = {priority, core_id};
+    live_tasks++;
+  }
+  if (created_task != nullptr) {
+    *created_task = task;
+  }
+  task->thread = std::thread([task, task_code, parameters] {
+    current_task = task;
+    try {
+      task_code(parameters);
+    } catch (const TaskExit &) {
+    }
+  });
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+  Task *task = handle == nullptr ? current() : static_cast<Task *>(handle);
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    live_tasks--;
+  }
+  if (task == current()) {
+    // The thread unwinds back to its entry point and ends there; nothing
+    // joins it, so it is detached and its record kept.
+    task->thread.detach();
+    throw TaskExit{};
+  }
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->delete_requested = true;
+  }
+  task->wake.notify_all();
+  if (task->thread.joinable()) {
+    task->thread.join();
+  }
+  delete task;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  sleep_until_ms(esphome::millis() + ticks);
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t increment) {
+  *previous_wake_time += increment;
+  sleep_until_ms(*previous_wake_time);
+}
+
+TickType_t xTaskGetTickCount() { return esphome::millis(); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return current(); }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit,
+                          TickType_t ticks_to_wait) {
+  Task *task = current();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  wait_until(task, lock, esphome::millis() + ticks_to_wait,
+             ticks_to_wait == portMAX_DELAY,
+             [task] { return task->notifications > 0; });
+  const uint32_t count = task->notifications;
+  if (count > 0) {
+    task->notifications = clear_count_on_exit ? 0 : count - 1;
+  }
+  return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+  auto *task = static_cast<Task *>(handle);
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+  }
+  task->wake.notify_all();
+  return pdPASS;
+}
+
+namespace esphome {
+namespace fakes {
+
+int live_task_count() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  return live_tasks;
+}
+
+bool task_config(const char *name, UBaseType_t *priority, BaseType_t *core) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  const auto it = configs.find(name);
+  if (it == configs.end()) {
+    return false;
+  }
+  *priority = it->second.priority;
+  *core = it->second.core;
+  return true;
+}
+
+} // namespace fakes
+} // namespace esphome
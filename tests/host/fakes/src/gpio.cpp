@@ -0,0 +1,58 @@
+#include "esphome/core/gpio.h"
+#include "esphome/core/hal.h"
+
+namespace esphome {
+namespace fakes {
+
+void FakePin::digital_write(bool value) {
+  this->level_ = value;
+  this->writes.push_back({value, millis()});
+}
+
+std::string FakePin::dump_summary() const {
+  return "GPIO" + std::to_string(this->pin_);
+}
+
+void FakePin::attach_interrupt(void (*func)(void *), void *arg,
+                               gpio::InterruptType type) const {
+  this->isr_ = func;
+  this->isr_arg_ = arg;
+  this->interrupt_type = type;
+}
+
+void FakePin::detach_interrupt() const {
+  this->isr_ = nullptr;
+  this->isr_arg_ = nullptr;
+}
+
+void FakePin::set_level(bool level) {
+  const bool previous = this->level_;
+  this->level_ = level;
+  if (this->isr_ == nullptr) {
+    return;
+  }
+  bool fire = false;
+  switch (this->interrupt_type) {
+  case gpio::INTERRUPT_RISING_EDGE:
+    fire = !previous && level;
+    break;
+  case gpio::INTERRUPT_FALLING_EDGE:
+    fire = previous && !level;
+    break;
+  case gpio::INTERRUPT_ANY_EDGE:
+    fire = previous != level;
+    break;
+  case gpio::INTERRUPT_LOW_LEVEL:
+    fire = !level;
+    break;
+  case gpio::INTERRUPT_HIGH_LEVEL:
+    fire = level;
+    break;
+  }
+  if (fire) {
+    this->isr_(this->isr_arg_);
+  }
+}
+
+} // namespace fakes
+} // namespace esphome
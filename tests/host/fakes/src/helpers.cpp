@@ -0,0 +1,27 @@
+#include "esphome/core/helpers.h"
+
+#include <cstdio>
+
+namespace esphome {
+
+std::string format_hex_pretty(const uint8_t *data, size_t length,
+                              char separator, bool show_length) {
+  if (data == nullptr || length == 0) {
+    return "";
+  }
+  std::string ret;
+  char byte[4];
+  for (size_t i = 0; i < length; i++) {
+    snprintf(byte, sizeof(byte), "%02X", data[i]);
+    ret += byte;
+    if (separator != '\0' && i + 1 < length) {
+      ret += separator;
+    }
+  }
+  if (show_length && length > 4) {
+    ret += " (" + std::to_string(length) + ")";
+  }
+  return ret;
+}
+
+} // namespace esphome
@@ -0,0 +1,91 @@
+#include "esphome/core/log.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+namespace esphome {
+namespace fakes {
+
+namespace {
+
+const char *const LEVEL_LETTERS = "-EWICDVV";
+const char *const LEVEL_NAMES[] = {"none",  "error",   "warn",
+                                   "info",  "config",  "debug",
+                                   "verbose", "very_verbose"};
+// Enough to look back over any one test; older lines are dropped.
+constexpr size_t MAX_KEPT_LINES = 100000;
+
+std::mutex log_mutex;
+std::deque<std::string> kept_lines;
+size_t level_counts[ESPHOME_LOG_LEVEL_VERY_VERBOSE + 1];
+
+int print_level() {
+  static const int level = [] {
+    const char *env = std::getenv("HOST_TEST_LOG");
+    if (env == nullptr) {
+      return ESPHOME_LOG_LEVEL_WARN;
+    }
+    for (int i = 0; i <= ESPHOME_LOG_LEVEL_VERY_VERBOSE; i++) {
+      if (strcasecmp(env, LEVEL_NAMES[i]) == 0) {
+        return i;
+      }
+    }
+    return std::clamp(std::atoi(env), 0, ESPHOME_LOG_LEVEL_VERY_VERBOSE);
+  }();
+  return level;
+}
+
+} // namespace
+
+void log(int level, const char *tag, int line, const char *format, ...) {
+  // Verbose lines sit on hot paths; format them only when asked to print.
+  if (level > std::max(print_level(), ESPHOME_LOG_LEVEL_DEBUG)) {
+    return;
+  }
+  char message[512];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+
+  char formatted[600];
+  snprintf(formatted, sizeof(formatted), "[%c][%s:%d]: %s",
+           LEVEL_LETTERS[level], tag, line, message);
+
+  std::lock_guard<std::mutex> lock(log_mutex);
+  if (level <= print_level()) {
+    fprintf(stderr, "%s\n", formatted);
+  }
+  kept_lines.emplace_back(formatted);
+  if (kept_lines.size() > MAX_KEPT_LINES) {
+    kept_lines.pop_front();
+  }
+  level_counts[level]++;
+}
+
+bool log_contains(const std::string &text) {
+  std::lock_guard<std::mutex> lock(log_mutex);
+  return std::any_of(kept_lines.begin(), kept_lines.end(),
+                     [&text](const std::string &line) {
+                       return line.find(text) != std::string::npos;
+                     });
+}
+
+size_t log_count(int level) {
+  std::lock_guard<std::mutex> lock(log_mutex);
+  return level_counts[level];
+}
+
+void clear_log() {
+  std::lock_guard<std::mutex> lock(log_mutex);
+  kept_lines.clear();
+  std::fill(std::begin(level_counts), std::end(level_counts), 0);
+}
+
+} // namespace fakes
+} // namespace esphome
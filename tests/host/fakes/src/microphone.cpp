@@ -0,0 +1,36 @@
+#include "esphome/components/microphone/microphone_source.h"
+
+namespace esphome {
+namespace microphone {
+
+void MicrophoneSource::add_data_callback(
+    std::function<void(const std::vector<uint8_t> &)> &&data_callback) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->callbacks_.push_back(std::move(data_callback));
+}
+
+void MicrophoneSource::start() {
+  this->running_ = true;
+  this->start_count_++;
+}
+
+void MicrophoneSource::stop() { this->running_ = false; }
+
+void MicrophoneSource::emit(const std::vector<uint8_t> &data) {
+  std::vector<std::function<void(const std::vector<uint8_t> &)>> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    callbacks = this->callbacks_;
+  }
+  for (auto &callback : callbacks) {
+    callback(data);
+  }
+}
+
+size_t MicrophoneSource::callback_count() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->callbacks_.size();
+}
+
+} // namespace microphone
+} // namespace esphome
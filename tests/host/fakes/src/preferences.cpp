@@ -0,0 +1,75 @@
+#include "esphome/core/preferences.h"
+
+#include <cstring>
+
+namespace esphome {
+
+namespace fakes {
+
+class FakePreferences::Backend : public ESPPreferenceBackend {
+public:
+  Backend(FakePreferences *owner, uint32_t type, size_t length, bool in_flash)
+      : owner_(owner), type_(type), length_(length), in_flash_(in_flash) {}
+
+  bool save(const uint8_t *data, size_t len) override {
+    if (len != this->length_) {
+      return false;
+    }
+    auto &record = this->owner_->records_[this->type_];
+    record.data.assign(data, data + len);
+    record.saves++;
+    record.in_flash = this->in_flash_;
+    return true;
+  }
+
+  bool load(uint8_t *data, size_t len) override {
+    const auto it = this->owner_->records_.find(this->type_);
+    if (len != this->length_ || it == this->owner_->records_.end() ||
+        it->second.data.size() != len) {
+      return false;
+    }
+    std::memcpy(data, it->second.data.data(), len);
+    return true;
+  }
+
+protected:
+  FakePreferences *owner_;
+  uint32_t type_;
+  size_t length_;
+  bool in_flash_;
+};
+
+ESPPreferenceObject FakePreferences::make_preference(size_t length,
+                                                     uint32_t type,
+                                                     bool in_flash) {
+  // Backends live as long as the store, like the real ones.
+  auto *backend = new Backend(this, type, length, in_flash);
+  this->backends_.push_back(backend);
+  return ESPPreferenceObject(backend);
+}
+
+bool FakePreferences::reset() {
+  this->records_.clear();
+  return true;
+}
+
+std::vector<uint8_t> FakePreferences::stored(uint32_t type) const {
+  const auto it = this->records_.find(type);
+  return it == this->records_.end() ? std::vector<uint8_t>{} : it->second.data;
+}
+
+uint32_t FakePreferences::save_count(uint32_t type) const {
+  const auto it = this->records_.find(type);
+  return it == this->records_.end() ? 0 : it->second.saves;
+}
+
+FakePreferences &preferences() {
+  static FakePreferences store;
+  return store;
+}
+
+} // namespace fakes
+
+ESPPreferences *global_preferences = &fakes::preferences(); // NOLINT
+
+} // namespace esphome
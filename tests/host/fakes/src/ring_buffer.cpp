@@ -0,0 +1,102 @@
+#include "esphome/core/ring_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace esphome {
+
+std::unique_ptr<RingBuffer> RingBuffer::create(size_t len) {
+  return std::unique_ptr<RingBuffer>(new RingBuffer(len));
+}
+
+size_t RingBuffer::read(void *data, size_t len, TickType_t ticks_to_wait) {
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  if (ticks_to_wait > 0) {
+    this->readable_.wait_for(lock, std::chrono::milliseconds(ticks_to_wait),
+                             [this] { return this->fill_ > 0; });
+  }
+  const size_t count = std::min(len, this->fill_);
+  auto *out = static_cast<uint8_t *>(data);
+  const size_t size = this->storage_.size();
+  const size_t tail = (this->head_ + size - this->fill_) % size;
+  const size_t first = std::min(count, size - tail);
+  std::memcpy(out, this->storage_.data() + tail, first);
+  std::memcpy(out + first, this->storage_.data(), count - first);
+  this->fill_ -= count;
+  lock.unlock();
+  this->writable_.notify_all();
+  return count;
+}
+
+size_t RingBuffer::write(const void *data, size_t len) {
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  const auto *in = static_cast<const uint8_t *>(data);
+  const size_t size = this->storage_.size();
+  if (len > size) {
+    in += len - size;
+    len = size;
+  }
+  if (len > size - this->fill_) {
+    this->discard_bytes_(len - (size - this->fill_));
+  }
+  this->put_(in, len);
+  lock.unlock();
+  this->readable_.notify_all();
+  return len;
+}
+
+size_t RingBuffer::write_without_replacement(const void *data, size_t len,
+                                             TickType_t ticks_to_wait,
+                                             bool write_partial) {
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  const size_t size = this->storage_.size();
+  const size_t wanted = write_partial ? 1 : std::min(len, size);
+  if (ticks_to_wait > 0) {
+    this->writable_.wait_for(
+        lock, std::chrono::milliseconds(ticks_to_wait),
+        [this, size, wanted] { return size - this->fill_ >= wanted; });
+  }
+  const size_t room = size - this->fill_;
+  if (room < wanted) {
+    return 0;
+  }
+  const size_t count = std::min(len, room);
+  this->put_(static_cast<const uint8_t *>(data), count);
+  lock.unlock();
+  this->readable_.notify_all();
+  return count;
+}
+
+size_t RingBuffer::available() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->fill_;
+}
+
+size_t RingBuffer::free() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->storage_.size() - this->fill_;
+}
+
+BaseType_t RingBuffer::reset() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->fill_ = 0;
+  return pdPASS;
+}
+
+size_t RingBuffer::discard_bytes_(size_t len) {
+  const size_t count = std::min(len, this->fill_);
+  this->fill_ -= count;
+  return count;
+}
+
+void RingBuffer::put_(const uint8_t *data, size_t len) {
+  const size_t size = this->storage_.size();
+  const size_t first = std::min(len, size - this->head_);
+  std::memcpy(this->storage_.data() + this->head_, data, first);
+  std::memcpy(this->storage_.data(), data + first, len - first);
+  this->head_ = (this->head_ + len) % size;
+  this->fill_ += len;
+}
+
+} // namespace esphome
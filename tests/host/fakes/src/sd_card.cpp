@@ -0,0 +1,401 @@
+#include "fake_sd_card.h"
+
+#include "esphome/core/hal.h"
+
+#include <driver/sdmmc_defs.h>
+#include <driver/sdmmc_host.h>
+#include <driver/sdspi_host.h>
+#include <driver/spi_common.h>
+#include <esp_vfs_fat.h>
+#include <sdmmc_cmd.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+
+extern "C" {
+ssize_t __real_write(int fd, const void *buf, size_t count);
+ssize_t __real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+int __real_fsync(int fd);
+ssize_t __wrap_write(int fd, const void *buf, size_t count);
+ssize_t __wrap_pwrite(int fd, const void *buf, size_t count, off_t offset);
+int __wrap_fsync(int fd);
+}
+
+namespace esphome {
+namespace fakes {
+
+namespace {
+
+SdCard card;
+std::mutex card_mutex;
+int image_fd = -1;
+bool spi_bus_in_use[3];
+
+// Whether fd is a file on the mounted card. Only those see the card's
+// latency and faults, never the test's own output.
+bool on_card(int fd) {
+  if (!card.mounted || card.mount_point.empty()) {
+    return false;
+  }
+  char link[64];
+  char target[PATH_MAX];
+  snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+  const ssize_t len = readlink(link, target, sizeof(target) - 1);
+  if (len <= 0) {
+    return false;
+  }
+  target[len] = '\0';
+  const std::string &mount = card.mount_point;
+  return std::strncmp(target, mount.c_str(), mount.size()) == 0 &&
+         (target[mount.size()] == '/' || target[mount.size()] == '\0');
+}
+
+void apply_delay() {
+  const uint32_t delay_us = card.write_delay_us.load();
+  if (delay_us != 0) {
+    delayMicroseconds(delay_us);
+  }
+}
+
+// Takes one from counter if it is positive.
+bool take(std::atomic<int> &counter) {
+  int value = counter.load();
+  while (value > 0) {
+    if (counter.compare_exchange_weak(value, value - 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Runs a file write through the card: returns how many of count bytes to
+// write, or -1 with errno set for a failed write.
+ssize_t card_write_length(size_t count) {
+  card.writes++;
+  apply_delay();
+  if (card.clock_khz.load() > card.max_clock_khz.load() ||
+      take(card.fail_writes)) {
+    card.write_errors++;
+    errno = EIO;
+    return -1;
+  }
+  if (count > 1 && take(card.short_writes)) {
+    errno = EIO;
+    return static_cast<ssize_t>(count / 2);
+  }
+  return static_cast<ssize_t>(count);
+}
+
+esp_err_t init_card(const sdmmc_host_t *host, sdmmc_card_t *out) {
+  card.init_attempts++;
+  const uint32_t freq_khz = static_cast<uint32_t>(host->max_freq_khz);
+  if (freq_khz > card.max_clock_khz.load()) {
+    return ESP_ERR_INVALID_CRC;
+  }
+  std::memset(out, 0, sizeof(*out));
+  out->host = *host;
+  out->csd.capacity =
+      static_cast<int>(card.capacity_bytes.load() / SDMMC_SECTOR_SIZE);
+  out->csd.sector_size = SDMMC_SECTOR_SIZE;
+  out->log_bus_width = (host->flags & SDMMC_HOST_FLAG_4BIT)   ? 2
+                       : (host->flags & SDMMC_HOST_FLAG_8BIT) ? 3
+                                                              : 0;
+  out->max_freq_khz = freq_khz;
+  out->real_freq_khz = static_cast<int>(freq_khz);
+  card.clock_khz = freq_khz;
+  return ESP_OK;
+}
+
+esp_err_t mount(const char *base_path, const sdmmc_host_t *host,
+                sdmmc_card_t **out_card) {
+  std::error_code ec;
+  if (!std::filesystem::is_directory(base_path, ec)) {
+    card.init_attempts++;
+    return ESP_ERR_TIMEOUT;
+  }
+  auto *out = static_cast<sdmmc_card_t *>(std::calloc(1, sizeof(sdmmc_card_t)));
+  const esp_err_t ret = init_card(host, out);
+  if (ret != ESP_OK) {
+    std::free(out);
+    return ret;
+  }
+  {
+    std::lock_guard<std::mutex> lock(card_mutex);
+    card.mount_point = std::filesystem::canonical(base_path).string();
+  }
+  card.mounted = true;
+  *out_card = out;
+  return ESP_OK;
+}
+
+} // namespace
+
+SdCard &sd_card() { return card; }
+
+void reset_sd_card() {
+  std::lock_guard<std::mutex> lock(card_mutex);
+  card.mounted = false;
+  card.mount_point.clear();
+  card.max_clock_khz = UINT32_MAX;
+  card.capacity_bytes = uint64_t{32} << 30;
+  card.write_delay_us = 0;
+  card.fail_writes = 0;
+  card.short_writes = 0;
+  card.clock_khz = 0;
+  card.init_attempts = 0;
+  card.write_errors = 0;
+  card.writes = 0;
+  if (image_fd >= 0) {
+    ::close(image_fd);
+    image_fd = -1;
+  }
+  std::fill(std::begin(spi_bus_in_use), std::end(spi_bus_in_use), false);
+}
+
+bool attach_sd_image(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDWR);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(card_mutex);
+  if (image_fd >= 0) {
+    ::close(image_fd);
+  }
+  image_fd = fd;
+  card.capacity_bytes = static_cast<uint64_t>(st.st_size);
+  return true;
+}
+
+} // namespace fakes
+} // namespace esphome
+
+using esphome::fakes::card;
+
+ssize_t __wrap_write(int fd, const void *buf, size_t count) {
+  if (!esphome::fakes::on_card(fd)) {
+    return __real_write(fd, buf, count);
+  }
+  const ssize_t length = esphome::fakes::card_write_length(count);
+  if (length < 0) {
+    return -1;
+  }
+  // After a short write the stale errno must survive the real call.
+  const int stale = errno;
+  const ssize_t written = __real_write(fd, buf, length);
+  errno = stale;
+  return written;
+}
+
+ssize_t __wrap_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+  if (!esphome::fakes::on_card(fd)) {
+    return __real_pwrite(fd, buf, count, offset);
+  }
+  const ssize_t length = esphome::fakes::card_write_length(count);
+  if (length < 0) {
+    return -1;
+  }
+  const int stale = errno;
+  const ssize_t written = __real_pwrite(fd, buf, length, offset);
+  errno = stale;
+  return written;
+}
+
+int __wrap_fsync(int fd) {
+  if (esphome::fakes::on_card(fd)) {
+    esphome::fakes::apply_delay();
+    if (card.clock_khz.load() > card.max_clock_khz.load()) {
+      card.write_errors++;
+      errno = EIO;
+      return -1;
+    }
+  }
+  return __real_fsync(fd);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+  case ESP_OK:
+    return "ESP_OK";
+  case ESP_FAIL:
+    return "ESP_FAIL";
+  case ESP_ERR_NO_MEM:
+    return "ESP_ERR_NO_MEM";
+  case ESP_ERR_INVALID_ARG:
+    return "ESP_ERR_INVALID_ARG";
+  case ESP_ERR_INVALID_STATE:
+    return "ESP_ERR_INVALID_STATE";
+  case ESP_ERR_INVALID_SIZE:
+    return "ESP_ERR_INVALID_SIZE";
+  case ESP_ERR_NOT_FOUND:
+    return "ESP_ERR_NOT_FOUND";
+  case ESP_ERR_NOT_SUPPORTED:
+    return "ESP_ERR_NOT_SUPPORTED";
+  case ESP_ERR_TIMEOUT:
+    return "ESP_ERR_TIMEOUT";
+  case ESP_ERR_INVALID_RESPONSE:
+    return "ESP_ERR_INVALID_RESPONSE";
+  case ESP_ERR_INVALID_CRC:
+    return "ESP_ERR_INVALID_CRC";
+  default:
+    return "UNKNOWN ERROR";
+  }
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id,
+                             const spi_bus_config_t * /*bus_config*/,
+                             spi_dma_chan_t /*dma_chan*/) {
+  if (esphome::fakes::spi_bus_in_use[host_id]) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  esphome::fakes::spi_bus_in_use[host_id] = true;
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host_id) {
+  if (!esphome::fakes::spi_bus_in_use[host_id]) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  esphome::fakes::spi_bus_in_use[host_id] = false;
+  return ESP_OK;
+}
+
+esp_err_t sdmmc_host_set_card_clk(int /*slot*/, uint32_t freq_khz) {
+  card.clock_khz = freq_khz;
+  return ESP_OK;
+}
+
+esp_err_t sdspi_host_set_card_clk(sdspi_dev_handle_t /*handle*/,
+                                  uint32_t freq_khz) {
+  card.clock_khz = freq_khz;
+  return ESP_OK;
+}
+
+esp_err_t sdmmc_host_init() { return ESP_OK; }
+esp_err_t sdmmc_host_init_slot(int /*slot*/,
+                               const sdmmc_slot_config_t * /*config*/) {
+  return ESP_OK;
+}
+esp_err_t sdmmc_host_deinit() { return ESP_OK; }
+
+esp_err_t sdspi_host_init() { return ESP_OK; }
+esp_err_t sdspi_host_init_device(const sdspi_device_config_t *dev_config,
+                                 sdspi_dev_handle_t *out_handle) {
+  *out_handle = dev_config->host_id;
+  return ESP_OK;
+}
+esp_err_t sdspi_host_deinit() { return ESP_OK; }
+
+esp_err_t sdmmc_card_init(const sdmmc_host_t *host, sdmmc_card_t *out_card) {
+  if (esphome::fakes::image_fd < 0) {
+    card.init_attempts++;
+    return ESP_ERR_TIMEOUT;
+  }
+  return esphome::fakes::init_card(host, out_card);
+}
+
+esp_err_t sdmmc_write_sectors(sdmmc_card_t *out_card, const void *src,
+                              size_t start_sector, size_t sector_count) {
+  card.writes++;
+  esphome::fakes::apply_delay();
+  if (start_sector + sector_count >
+      static_cast<size_t>(out_card->csd.capacity)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (card.clock_khz.load() > card.max_clock_khz.load()) {
+    card.write_errors++;
+    return ESP_ERR_INVALID_CRC;
+  }
+  if (esphome::fakes::take(card.fail_writes)) {
+    card.write_errors++;
+    return ESP_ERR_TIMEOUT;
+  }
+  const size_t len = sector_count * SDMMC_SECTOR_SIZE;
+  if (__real_pwrite(esphome::fakes::image_fd, src, len,
+                    static_cast<off_t>(start_sector) * SDMMC_SECTOR_SIZE) !=
+      static_cast<ssize_t>(len)) {
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+esp_err_t sdmmc_read_sectors(sdmmc_card_t *out_card, void *dst,
+                             size_t start_sector, size_t sector_count) {
+  if (start_sector + sector_count >
+      static_cast<size_t>(out_card->csd.capacity)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  const size_t len = sector_count * SDMMC_SECTOR_SIZE;
+  if (::pread(esphome::fakes::image_fd, dst, len,
+              static_cast<off_t>(start_sector) * SDMMC_SECTOR_SIZE) !=
+      static_cast<ssize_t>(len)) {
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdmmc_mount(const char *base_path,
+                                  const sdmmc_host_t *host_config,
+                                  const void * /*slot_config*/,
+                                  const esp_vfs_fat_mount_config_t * /*config*/,
+                                  sdmmc_card_t **out_card) {
+  return esphome::fakes::mount(base_path, host_config, out_card);
+}
+
+esp_err_t esp_vfs_fat_sdspi_mount(
+    const char *base_path, const sdmmc_host_t *host_config,
+    const sdspi_device_config_t * /*slot_config*/,
+    const esp_vfs_fat_mount_config_t * /*config*/, sdmmc_card_t **out_card) {
+  return esphome::fakes::mount(base_path, host_config, out_card);
+}
+
+esp_err_t esp_vfs_fat_sdcard_unmount(const char * /*base_path*/,
+                                     sdmmc_card_t *out_card) {
+  card.mounted = false;
+  std::free(out_card);
+  return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_info(const char *base_path, uint64_t *out_total_bytes,
+                           uint64_t *out_free_bytes) {
+  if (!card.mounted) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  uint64_t used = 0;
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator(base_path, ec)) {
+    if (entry.is_regular_file(ec)) {
+      used += entry.file_size(ec);
+    }
+  }
+  const uint64_t total = card.capacity_bytes.load();
+  *out_total_bytes = total;
+  *out_free_bytes = used < total ? total - used : 0;
+  return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_create_contiguous_file(const char * /*base_path*/,
+                                             const char *full_path,
+                                             uint64_t size,
+                                             bool /*alloc_now*/) {
+  const int fd = ::open(full_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return ESP_FAIL;
+  }
+  const int ret = ::ftruncate(fd, static_cast<off_t>(size));
+  ::close(fd);
+  return ret == 0 ? ESP_OK : ESP_ERR_NO_MEM;
+}
@@ -0,0 +1,48 @@
+#include "esphome/components/binary_sensor/binary_sensor.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/text_sensor/text_sensor.h"
+
+namespace esphome {
+
+namespace sensor {
+
+void Sensor::publish_state(float state) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->raw_state = state;
+  this->state = state;
+  this->has_state_ = true;
+  this->history_.push_back(state);
+}
+
+std::vector<float> Sensor::history() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->history_;
+}
+
+} // namespace sensor
+
+namespace binary_sensor {
+
+void BinarySensor::publish_state(bool state) {
+  this->state = state;
+  this->has_state_ = true;
+  this->history.push_back(state);
+}
+
+void BinarySensor::publish_initial_state(bool state) {
+  this->has_state_ = false;
+  this->publish_state(state);
+}
+
+} // namespace binary_sensor
+
+namespace text_sensor {
+
+void TextSensor::publish_state(const std::string &state) {
+  this->state = state;
+  this->has_state_ = true;
+  this->history.push_back(state);
+}
+
+} // namespace text_sensor
+} // namespace esphome
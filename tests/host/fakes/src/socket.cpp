@@ -0,0 +1,241 @@
+#include "esphome/components/socket/socket.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace esphome {
+
+namespace {
+
+std::mutex socket_mutex;
+fakes::SendHook send_hook;
+fakes::SocketStats stats;
+
+// Asks the hook how much of len bytes the socket may send. Returns -1 with
+// errno set when the call is to fail.
+ssize_t allowed_bytes(int fd, size_t len) {
+  fakes::SendHook hook;
+  {
+    std::lock_guard<std::mutex> lock(socket_mutex);
+    hook = send_hook;
+  }
+  if (!hook) {
+    return static_cast<ssize_t>(len);
+  }
+  int type = 0;
+  socklen_t type_len = sizeof(type);
+  ::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &type_len);
+  const ssize_t allowed = hook(type, len);
+  if (allowed < 0) {
+    errno = static_cast<int>(-allowed);
+    return -1;
+  }
+  return std::min<ssize_t>(allowed, static_cast<ssize_t>(len));
+}
+
+// lwIP only takes the exact length of a sockaddr_in or sockaddr_in6, where
+// the host stack would also accept a longer buffer.
+bool valid_addr_len(socklen_t len) {
+  if (len == sizeof(struct sockaddr_in) || len == sizeof(struct sockaddr_in6)) {
+    return true;
+  }
+  errno = EINVAL;
+  return false;
+}
+
+} // namespace
+
+namespace socket {
+
+Socket::~Socket() { this->close(); }
+
+int Socket::bind(const struct sockaddr *addr, socklen_t addrlen) {
+  if (!valid_addr_len(addrlen)) {
+    return -1;
+  }
+  return ::bind(this->fd_, addr, addrlen);
+}
+
+int Socket::connect(const struct sockaddr *addr, socklen_t addrlen) {
+  {
+    std::lock_guard<std::mutex> lock(socket_mutex);
+    stats.connects++;
+    stats.last_connect_len = addrlen;
+  }
+  if (!valid_addr_len(addrlen)) {
+    return -1;
+  }
+  return ::connect(this->fd_, addr, addrlen);
+}
+
+int Socket::close() {
+  if (this->fd_ < 0) {
+    return 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(socket_mutex);
+    stats.closed++;
+  }
+  const int ret = ::close(this->fd_);
+  this->fd_ = -1;
+  return ret;
+}
+
+int Socket::getsockopt(int level, int optname, void *optval,
+                       socklen_t *optlen) {
+  return ::getsockopt(this->fd_, level, optname, optval, optlen);
+}
+
+int Socket::setsockopt(int level, int optname, const void *optval,
+                       socklen_t optlen) {
+  return ::setsockopt(this->fd_, level, optname, optval, optlen);
+}
+
+int Socket::listen(int backlog) { return ::listen(this->fd_, backlog); }
+
+std::unique_ptr<Socket> Socket::accept(struct sockaddr *addr,
+                                       socklen_t *addrlen) {
+  const int fd = ::accept(this->fd_, addr, addrlen);
+  if (fd < 0) {
+    return nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lock(socket_mutex);
+    stats.created++;
+  }
+  return std::make_unique<Socket>(fd);
+}
+
+ssize_t Socket::read(void *buf, size_t len) {
+  return ::read(this->fd_, buf, len);
+}
+
+ssize_t Socket::recvfrom(void *buf, size_t len, struct sockaddr *addr,
+                         socklen_t *addr_len) {
+  return ::recvfrom(this->fd_, buf, len, 0, addr, addr_len);
+}
+
+ssize_t Socket::write(const void *buf, size_t len) {
+  const ssize_t allowed = allowed_bytes(this->fd_, len);
+  if (allowed < 0) {
+    return -1;
+  }
+  return ::send(this->fd_, buf, allowed, MSG_NOSIGNAL);
+}
+
+ssize_t Socket::writev(const struct iovec *iov, int iovcnt) {
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    total += iov[i].iov_len;
+  }
+  ssize_t allowed = allowed_bytes(this->fd_, total);
+  if (allowed < 0) {
+    return -1;
+  }
+  // Cut the vector down to what the hook allows.
+  std::vector<struct iovec> trimmed;
+  for (int i = 0; i < iovcnt && allowed > 0; i++) {
+    struct iovec part = iov[i];
+    part.iov_len = std::min<size_t>(part.iov_len, allowed);
+    allowed -= part.iov_len;
+    trimmed.push_back(part);
+  }
+  struct msghdr msg {};
+  msg.msg_iov = trimmed.data();
+  msg.msg_iovlen = trimmed.size();
+  return ::sendmsg(this->fd_, &msg, MSG_NOSIGNAL);
+}
+
+ssize_t Socket::sendto(const void *buf, size_t len, int flags,
+                       const struct sockaddr *to, socklen_t tolen) {
+  if (to != nullptr && !valid_addr_len(tolen)) {
+    return -1;
+  }
+  const ssize_t allowed = allowed_bytes(this->fd_, len);
+  if (allowed < 0) {
+    return -1;
+  }
+  return ::sendto(this->fd_, buf, allowed, flags | MSG_NOSIGNAL, to, tolen);
+}
+
+int Socket::setblocking(bool blocking) {
+  int flags = ::fcntl(this->fd_, F_GETFL, 0);
+  if (flags < 0) {
+    return -1;
+  }
+  flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+  return ::fcntl(this->fd_, F_SETFL, flags);
+}
+
+std::unique_ptr<Socket> socket(int domain, int type, int protocol) {
+  const int fd = ::socket(domain, type, protocol);
+  if (fd < 0) {
+    return nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lock(socket_mutex);
+    stats.created++;
+  }
+  return std::make_unique<Socket>(fd);
+}
+
+std::unique_ptr<Socket> socket_ip(int type, int protocol) {
+  return socket(AF_INET, type, protocol);
+}
+
+socklen_t set_sockaddr(struct sockaddr *addr, socklen_t addrlen,
+                       const std::string &ip_address, uint16_t port) {
+  if (ip_address.find(':') != std::string::npos) {
+    if (addrlen < sizeof(struct sockaddr_in6)) {
+      errno = EINVAL;
+      return 0;
+    }
+    auto *addr6 = reinterpret_cast<struct sockaddr_in6 *>(addr);
+    std::memset(addr6, 0, sizeof(*addr6));
+    addr6->sin6_family = AF_INET6;
+    addr6->sin6_port = htons(port);
+    if (inet_pton(AF_INET6, ip_address.c_str(), &addr6->sin6_addr) != 1) {
+      return 0;
+    }
+    return sizeof(struct sockaddr_in6);
+  }
+  if (addrlen < sizeof(struct sockaddr_in)) {
+    errno = EINVAL;
+    return 0;
+  }
+  auto *addr4 = reinterpret_cast<struct sockaddr_in *>(addr);
+  std::memset(addr4, 0, sizeof(*addr4));
+  addr4->sin_family = AF_INET;
+  addr4->sin_port = htons(port);
+  if (inet_pton(AF_INET, ip_address.c_str(), &addr4->sin_addr) != 1) {
+    return 0;
+  }
+  return sizeof(struct sockaddr_in);
+}
+
+} // namespace socket
+
+namespace fakes {
+
+void set_send_hook(SendHook hook) {
+  std::lock_guard<std::mutex> lock(socket_mutex);
+  send_hook = std::move(hook);
+}
+
+SocketStats socket_stats() {
+  std::lock_guard<std::mutex> lock(socket_mutex);
+  return stats;
+}
+
+void reset_socket_stats() {
+  std::lock_guard<std::mutex> lock(socket_mutex);
+  stats = SocketStats{};
+}
+
+} // namespace fakes
+} // namespace esphome
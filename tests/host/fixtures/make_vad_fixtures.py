@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Write the WAV fixtures the voice activity detector tests read.
+
+All are 16 kHz mono 16-bit and fully determined by this script, so rerunning
+it reproduces the committed files byte for byte.
+
+vad_speech.wav     2.5 s: a -70 dBFS noise floor, with a voiced segment
+                   (140 Hz harmonics, syllable envelope, about -20 dBFS)
+                   from 0.76 s to 1.76 s
+vad_fricative.wav  1 s of white noise at -53 dBFS: quiet but busy
+vad_hum.wav        1 s of 100 Hz hum at -53 dBFS: as quiet, but smooth
+"""
+from __future__ import annotations
+
+import math
+import pathlib
+import random
+import struct
+import wave
+
+RATE = 16000
+FULL_SCALE = 32767.0
+
+
+def rms_for(dbfs: float) -> float:
+    return FULL_SCALE * 10.0 ** (dbfs / 20.0)
+
+
+def noise(seconds: float, dbfs: float, seed: int) -> list[float]:
+    rng = random.Random(seed)
+    level = rms_for(dbfs)
+    return [rng.gauss(0.0, level) for _ in range(int(seconds * RATE))]
+
+
+def voiced(seconds: float, dbfs: float) -> list[float]:
+    f0 = 140.0
+    harmonics = range(1, int(3500 / f0) + 1)
+    # The 1/k harmonic series, normalised to the requested RMS.
+    power = sum(0.5 / (k * k) for k in harmonics)
+    scale = rms_for(dbfs) / math.sqrt(power)
+    out = []
+    for n in range(int(seconds * RATE)):
+        t = n / RATE
+        envelope = 0.6 + 0.4 * abs(math.sin(math.pi * 4.0 * t))
+        value = sum(math.sin(2.0 * math.pi * f0 * k * t) / k for k in harmonics)
+        out.append(scale * envelope * value)
+    return out
+
+
+def hum(seconds: float, dbfs: float) -> list[float]:
+    amplitude = rms_for(dbfs) * math.sqrt(2.0)
+    return [amplitude * math.sin(2.0 * math.pi * 100.0 * n / RATE) for n in range(int(seconds * RATE))]
+
+
+def write(path: pathlib.Path, samples: list[float]) -> None:
+    clipped = [max(-32768, min(32767, round(s))) for s in samples]
+    with wave.open(str(path), "wb") as wav:
+        wav.setnchannels(1)
+        wav.setsampwidth(2)
+        wav.setframerate(RATE)
+        wav.writeframes(struct.pack(f"<{len(clipped)}h", *clipped))
+
+
+def main() -> None:
+    here = pathlib.Path(__file__).resolve().parent
+
+    speech = noise(2.5, -70.0, seed=1)
+    start = int(0.76 * RATE)
+    for n, s in enumerate(voiced(1.0, -20.0)):
+        speech[start + n] += s
+    write(here / "vad_speech.wav", speech)
+
+    write(here / "vad_fricative.wav", noise(1.0, -53.0, seed=2))
+    write(here / "vad_hum.wav", hum(1.0, -53.0))
+
+
+if __name__ == "__main__":
+    main()
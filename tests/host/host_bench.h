@@ -0,0 +1,47 @@
+#pragma once
+
+// Timing helpers for the bench_*.cpp benchmarks. A benchmark is an ordinary
+// test binary whose cases time something and report it; with --quick each
+// measurement runs briefly, so ctest only checks that it still works.
+
+#include "host_test.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace host_bench {
+
+/// Keeps the compiler from optimising away a result nobody reads.
+template <typename T> inline void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// Calls fn repeatedly for about 200 ms (10 ms with --quick), after one
+/// warm-up call, and returns the mean time per call in nanoseconds.
+template <typename F> double ns_per_call(F &&fn) {
+  using clock = std::chrono::steady_clock;
+  const auto budget = std::chrono::milliseconds(host_test::quick() ? 10 : 200);
+  fn();
+  uint64_t calls = 0;
+  const auto start = clock::now();
+  auto now = start;
+  do {
+    for (int i = 0; i < 16; i++) {
+      fn();
+    }
+    calls += 16;
+    now = clock::now();
+  } while (now - start < budget);
+  return std::chrono::duration<double, std::nano>(now - start).count() /
+         static_cast<double>(calls);
+}
+
+/// Prints one result line: the case, what was measured, and the figure.
+inline void report(const char *name, const char *metric, double value,
+                   const char *unit) {
+  printf("  %-32s %-28s %10.3f %s\n", name, metric, value, unit);
+  fflush(stdout);
+}
+
+} // namespace host_bench
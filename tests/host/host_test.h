@@ -0,0 +1,84 @@
+#pragma once
+
+// A minimal test runner for the host harness: TEST() registers a case,
+// CHECK()/CHECK_EQ() record a failure and carry on, REQUIRE() records one
+// and ends the case. Each binary runs all its cases, or those whose names
+// contain the first argument; --quick asks benchmarks for a short run.
+
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace host_test {
+
+struct Case {
+  const char *name;
+  void (*run)();
+};
+
+std::vector<Case> &cases();
+void fail(const char *file, int line, const std::string &message);
+/// True when the binary was started with --quick.
+bool quick();
+/// A fresh directory under the system temp dir, removed at exit.
+std::string temp_dir();
+
+struct Registrar {
+  Registrar(const char *name, void (*run)()) { cases().push_back({name, run}); }
+};
+
+struct Abort {};
+
+template <typename T> std::string show(const T &value) {
+  std::ostringstream out;
+  if constexpr (std::is_arithmetic_v<T>) {
+    out << +value;
+  } else if constexpr (requires { out << value; }) {
+    out << value;
+  } else {
+    out << "?";
+  }
+  return out.str();
+}
+
+template <typename A, typename B>
+std::string describe(const char *a_expr, const char *b_expr, const A &a,
+                     const B &b) {
+  return std::string(a_expr) + " == " + b_expr + " (" + show(a) + " vs " +
+         show(b) + ")";
+}
+
+} // namespace host_test
+
+#define TEST(name)                                                             \
+  static void name();                                                          \
+  static ::host_test::Registrar name##_registrar(#name, name);                 \
+  static void name()
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      ::host_test::fail(__FILE__, __LINE__, #cond);                            \
+    }                                                                          \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                         \
+  do {                                                                         \
+    const auto check_a_ = (a);                                                 \
+    const auto check_b_ = (b);                                                 \
+    if (!(check_a_ == check_b_)) {                                             \
+      ::host_test::fail(__FILE__, __LINE__,                                    \
+                        ::host_test::describe(#a, #b, check_a_, check_b_));    \
+    }                                                                          \
+  } while (0)
+
+#define REQUIRE(cond)                                                          \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      ::host_test::fail(__FILE__, __LINE__, #cond);                            \
+      throw ::host_test::Abort{};                                              \
+    }                                                                          \
+  } while (0)
@@ -0,0 +1,102 @@
+#include "host_test.h"
+
+#include "esphome/components/socket/socket.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+#include "fake_sd_card.h"
+
+#include <bsec2.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace host_test {
+
+namespace {
+
+int failures_in_case = 0;
+bool quick_run = false;
+std::vector<std::string> temp_dirs;
+
+// Every case starts from fresh fakes.
+void reset_fakes() {
+  esphome::fakes::clear_log();
+  esphome::fakes::reset_sd_card();
+  esphome::fakes::reset_socket_stats();
+  esphome::fakes::set_send_hook({});
+  esphome::fakes::preferences().reset();
+  esphome::fakes::reset_bsec();
+}
+
+} // namespace
+
+std::vector<Case> &cases() {
+  static std::vector<Case> all;
+  return all;
+}
+
+void fail(const char *file, int line, const std::string &message) {
+  failures_in_case++;
+  fprintf(stderr, "%s:%d: check failed: %s\n", file, line, message.c_str());
+}
+
+bool quick() { return quick_run; }
+
+std::string temp_dir() {
+  std::string pattern =
+      (std::filesystem::temp_directory_path() / "host_test.XXXXXX").string();
+  if (mkdtemp(pattern.data()) == nullptr) {
+    fail(__FILE__, __LINE__, "mkdtemp failed");
+    throw Abort{};
+  }
+  temp_dirs.push_back(pattern);
+  return pattern;
+}
+
+} // namespace host_test
+
+int main(int argc, char **argv) {
+  const char *filter = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--quick") == 0) {
+      host_test::quick_run = true;
+    } else {
+      filter = argv[i];
+    }
+  }
+
+  int failed = 0;
+  int run = 0;
+  for (const auto &test : host_test::cases()) {
+    if (filter != nullptr && std::strstr(test.name, filter) == nullptr) {
+      continue;
+    }
+    run++;
+    host_test::reset_fakes();
+    host_test::failures_in_case = 0;
+    printf("[ RUN  ] %s\n", test.name);
+    fflush(stdout);
+    try {
+      test.run();
+    } catch (const host_test::Abort &) {
+    }
+    if (host_test::failures_in_case > 0) {
+      failed++;
+    }
+    printf("[ %s ] %s\n", host_test::failures_in_case > 0 ? "FAIL" : " OK ",
+           test.name);
+    fflush(stdout);
+  }
+  printf("%d of %d case(s) passed\n", run - failed, run);
+
+  std::error_code ec;
+  for (const auto &dir : host_test::temp_dirs) {
+    std::filesystem::remove_all(dir, ec);
+  }
+  fflush(stdout);
+  fflush(stderr);
+  // Sender and writer tasks a case left running are detached threads;
+  // leave without running destructors under them.
+  _Exit(failed == 0 && run > 0 ? 0 : 1);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Straightforward per-sample versions of the pcm_utils kernels, which the
+// tests check the kernels against and the benchmarks compare them with.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace pcm_reference {
+
+inline void reference_swap(uint8_t *data, size_t samples, size_t width) {
+  for (size_t i = 0; i < samples; i++) {
+    std::reverse(data + i * width, data + (i + 1) * width);
+  }
+}
+
+inline void reference_32_to_16(const uint8_t *in, uint8_t *out,
+                               size_t samples) {
+  for (size_t i = 0; i < samples; i++) {
+    out[2 * i] = in[4 * i + 2];
+    out[2 * i + 1] = in[4 * i + 3];
+  }
+}
+
+inline void reference_32_to_24(const uint8_t *in, uint8_t *out,
+                               size_t samples) {
+  for (size_t i = 0; i < samples; i++) {
+    std::memcpy(out + 3 * i, in + 4 * i + 1, 3);
+  }
+}
+
+inline void reference_downmix_16(const uint8_t *in, uint8_t *out,
+                                 size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    int16_t l, r;
+    std::memcpy(&l, in + 4 * i, 2);
+    std::memcpy(&r, in + 4 * i + 2, 2);
+    const int16_t mono = static_cast<int16_t>((int32_t{l} + r) >> 1);
+    std::memcpy(out + 2 * i, &mono, 2);
+  }
+}
+
+inline void reference_downmix_32(const uint8_t *in, uint8_t *out,
+                                 size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    int32_t l, r;
+    std::memcpy(&l, in + 8 * i, 4);
+    std::memcpy(&r, in + 8 * i + 4, 4);
+    const int32_t mono = static_cast<int32_t>((int64_t{l} + r) >> 1);
+    std::memcpy(out + 4 * i, &mono, 4);
+  }
+}
+
+} // namespace pcm_reference
@@ -0,0 +1,207 @@
+#pragma once
+
+// Shared setup for the microphone_recorder tests: a recorder on the fake
+// card, mounted on a fresh temp directory, fed a deterministic signal by a
+// fake microphone from the test thread.
+
+#include "esphome/components/microphone_recorder/microphone_recorder.h"
+#include "esphome/components/pcm_utils/raw_index.h"
+#include "esphome/components/pcm_utils/wav_header.h"
+#include "esphome/core/application.h"
+#include "esphome/core/hal.h"
+#include "fake_sd_card.h"
+#include "host_test.h"
+#include "test_signal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace recorder_test {
+
+using esphome::microphone_recorder::MicrophoneRecorder;
+
+/// Opens up the recorder's internals that the tests read back.
+class TestRecorder : public MicrophoneRecorder {
+public:
+  using MicrophoneRecorder::active_path_;
+  using MicrophoneRecorder::bytes_dropped_total_;
+  using MicrophoneRecorder::free_space_mb_;
+  using MicrophoneRecorder::oldest_sequence_;
+  using MicrophoneRecorder::queue_high_water_;
+  using MicrophoneRecorder::ring_;
+  using MicrophoneRecorder::segment_source_bytes_;
+  using MicrophoneRecorder::state_;
+  using MicrophoneRecorder::task_handle_;
+};
+
+using namespace test_signal;
+
+inline std::vector<uint8_t> read_file(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+inline uint16_t le16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+struct Rig {
+  esphome::audio::AudioStreamInfo info;
+  esphome::microphone::MicrophoneSource mic;
+  std::string dir;
+  std::unique_ptr<TestRecorder> recorder;
+  /// The card image behind a raw region, once use_raw_image() made one.
+  std::string image;
+  /// Next frame the microphone delivers.
+  uint64_t frame{0};
+
+  explicit Rig(esphome::audio::AudioStreamInfo stream_info = {16, 1, 16000})
+      : info(stream_info), mic(stream_info), dir(host_test::temp_dir()),
+        recorder(std::make_unique<TestRecorder>()) {
+    this->recorder->set_microphone_source(&this->mic);
+    this->recorder->set_sd_pins(1, 2, 3, 4, 5, 6);
+    this->recorder->set_mount_point(this->dir);
+    this->recorder->set_max_duration_ms(0);
+    this->recorder->set_write_block_size(4096);
+    this->recorder->set_buffer_duration_ms(2000);
+  }
+
+  ~Rig() {
+    this->recorder->stop_recording();
+    this->wait_idle();
+    if (this->recorder->task_handle_ != nullptr) {
+      vTaskDelete(this->recorder->task_handle_);
+    }
+  }
+
+  void set_up() { this->recorder->setup(); }
+
+  /// Mounts card, e.g. another rig's, in place of a fresh directory.
+  void use_card(const std::string &card) {
+    this->dir = card;
+    this->recorder->set_mount_point(card);
+  }
+
+  /// Records into a raw region filling a blank card image of
+  /// data_bytes plus the partition table sector the region starts after.
+  bool use_raw_image(uint64_t data_bytes) {
+    this->image = host_test::temp_dir() + "/card.img";
+    std::ofstream(this->image, std::ios::binary).close();
+    std::filesystem::resize_file(
+        this->image, data_bytes + esphome::pcm_utils::RAW_SECTOR_SIZE);
+    this->recorder->set_raw_region(1, 0);
+    return esphome::fakes::attach_sd_image(this->image);
+  }
+
+  /// Delivers frames of audio in chunks of chunk_frames, running the main
+  /// loop after each. Delivery waits while the ring is over half full, so
+  /// nothing is dropped unless the writer stalls for longer than that.
+  void feed(uint64_t frames, uint32_t chunk_frames = 320) {
+    const uint64_t end = this->frame + frames;
+    while (this->frame < end) {
+      const uint64_t n = std::min<uint64_t>(chunk_frames, end - this->frame);
+      this->mic.emit(signal_bytes(this->frame, this->frame + n,
+                                  this->info.get_channels(),
+                                  this->info.get_bits_per_sample()));
+      this->frame += n;
+      esphome::fakes::loop_once(this->recorder.get());
+      auto *ring = this->recorder->ring_.get();
+      while (ring != nullptr && ring->available() > ring->capacity() / 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+
+  /// Delivers frames in chunks of chunk_frames at the pace a microphone
+  /// would, running the main loop after each, without waiting on the
+  /// writer. Returns the longest a delivery took, in microseconds.
+  int64_t stream(uint64_t frames, uint32_t chunk_frames = 320) {
+    using clock = std::chrono::steady_clock;
+    const uint64_t end = this->frame + frames;
+    const uint32_t rate = this->info.get_sample_rate();
+    const auto start = clock::now();
+    const uint64_t first = this->frame;
+    int64_t longest = 0;
+    while (this->frame < end) {
+      const uint64_t n = std::min<uint64_t>(chunk_frames, end - this->frame);
+      const auto chunk = signal_bytes(this->frame, this->frame + n,
+                                      this->info.get_channels(),
+                                      this->info.get_bits_per_sample());
+      const auto before = clock::now();
+      this->mic.emit(chunk);
+      longest = std::max<int64_t>(
+          longest, std::chrono::duration_cast<std::chrono::microseconds>(
+                       clock::now() - before)
+                       .count());
+      this->frame += n;
+      esphome::fakes::loop_once(this->recorder.get());
+      std::this_thread::sleep_until(
+          start + std::chrono::microseconds((this->frame - first) * 1000000 /
+                                            rate));
+    }
+    return longest;
+  }
+
+  /// Runs the main loop until the writer task is idle again.
+  bool wait_idle(uint32_t timeout_ms = 10000) {
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(timeout_ms);
+    while (this->recorder->state_.load() !=
+           esphome::microphone_recorder::STATE_IDLE) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    esphome::fakes::loop_once(this->recorder.get());
+    return true;
+  }
+
+  /// Recording file names on the card, oldest first.
+  std::vector<std::string> files() const {
+    std::vector<std::string> names;
+    for (const auto &entry : std::filesystem::directory_iterator(this->dir)) {
+      names.push_back(entry.path().filename().string());
+    }
+    std::sort(names.begin(), names.end(),
+              [](const std::string &a, const std::string &b) {
+                return a.size() != b.size() ? a.size() < b.size() : a < b;
+              });
+    return names;
+  }
+
+  std::vector<uint8_t> read(const std::string &name) const {
+    return read_file(this->dir + "/" + name);
+  }
+
+  /// The audio in a recording: its data chunk, as its header places it.
+  std::vector<uint8_t> audio(const std::string &name) const {
+    const auto file = this->read(name);
+    esphome::pcm_utils::WavLayout layout;
+    if (!esphome::pcm_utils::parse_wav_header(file.data(), file.size(),
+                                              &layout) ||
+        layout.data_offset + layout.data_bytes > file.size()) {
+      return {};
+    }
+    return {file.begin() + layout.data_offset,
+            file.begin() + layout.data_offset + layout.data_bytes};
+  }
+
+  /// The audio of every recording on the card, joined oldest first.
+  std::vector<uint8_t> joined() const {
+    std::vector<uint8_t> out;
+    for (const auto &name : this->files()) {
+      const auto part = this->audio(name);
+      out.insert(out.end(), part.begin(), part.end());
+    }
+    return out;
+  }
+};
+
+} // namespace recorder_test
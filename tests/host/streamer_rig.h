@@ -0,0 +1,360 @@
+#pragma once
+
+// Shared setup for the udp_audio_streamer tests: a streamer fed the test
+// signal by a fake microphone, sending to receivers on the loopback
+// interface that the test reads back.
+
+#include "esphome/components/udp_audio_streamer/udp_audio_streamer.h"
+#include "esphome/core/hal.h"
+#include "host_test.h"
+#include "test_signal.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace streamer_test {
+
+using esphome::udp_audio_streamer::UDPAudioStreamer;
+using namespace test_signal;
+
+/// Opens up the streamer's internals that the tests read back.
+class TestStreamer : public UDPAudioStreamer {
+public:
+  using UDPAudioStreamer::bytes_dropped_total_;
+  using UDPAudioStreamer::destinations_;
+  using UDPAudioStreamer::drop_head_;
+  using UDPAudioStreamer::reconnects_total_;
+  using UDPAudioStreamer::send_chunk_;
+  using UDPAudioStreamer::ring_;
+  using UDPAudioStreamer::task_handle_;
+};
+
+inline uint32_t be32(const uint8_t *p) {
+  return static_cast<uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/// A datagram, or TCP frame, split at its header.
+struct Packet {
+  uint8_t flags{0};
+  uint8_t codec{0};
+  uint8_t channels{0};
+  uint8_t bits_per_sample{0};
+  uint32_t sequence{0};
+  uint32_t frame_counter{0};
+  uint32_t capture_time_us{0};
+  uint32_t sample_rate{0};
+  std::vector<uint8_t> bytes;
+  std::vector<uint8_t> payload;
+  /// When the receiver read it; only UdpReceiver sets this.
+  std::chrono::steady_clock::time_point arrival{};
+};
+
+/// Parses a packet sent with packet_header; returns false if the header is
+/// malformed.
+inline bool parse_packet(const std::vector<uint8_t> &bytes, Packet *packet) {
+  using namespace esphome::udp_audio_streamer;
+  if (bytes.size() < PACKET_HEADER_SIZE || bytes[0] != PACKET_MAGIC_0 ||
+      bytes[1] != PACKET_MAGIC_1 || bytes[2] != PACKET_HEADER_VERSION ||
+      bytes[4] > bytes.size()) {
+    return false;
+  }
+  packet->flags = bytes[3];
+  packet->codec = bytes[5];
+  packet->channels = bytes[6];
+  packet->bits_per_sample = bytes[7];
+  packet->sequence = be32(&bytes[8]);
+  packet->frame_counter = be32(&bytes[12]);
+  packet->capture_time_us = be32(&bytes[16]);
+  packet->sample_rate = be32(&bytes[20]);
+  packet->bytes = bytes;
+  packet->payload.assign(bytes.begin() + bytes[4], bytes.end());
+  return true;
+}
+
+/// Rebuilds the one datagram of a parity packet's group that did not
+/// arrive, as packet_header.h describes: the XOR of the parity body with
+/// every datagram that did. received holds the datagrams that arrived, by
+/// sequence number. Returns false unless exactly one is missing.
+inline bool recover_from_parity(
+    const Packet &parity,
+    const std::map<uint32_t, std::vector<uint8_t>> &received,
+    std::vector<uint8_t> *lost) {
+  using namespace esphome::udp_audio_streamer;
+  if (parity.payload.size() < FEC_DESCRIPTOR_SIZE) {
+    return false;
+  }
+  const uint8_t count = parity.payload[0];
+  uint16_t length = static_cast<uint16_t>(parity.payload[2] << 8 |
+                                          parity.payload[3]);
+  std::vector<uint8_t> body(parity.payload.begin() + FEC_DESCRIPTOR_SIZE,
+                            parity.payload.end());
+  int missing = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const auto it = received.find(parity.sequence + i);
+    if (it == received.end()) {
+      missing++;
+      continue;
+    }
+    length ^= static_cast<uint16_t>(it->second.size());
+    for (size_t j = 0; j < it->second.size() && j < body.size(); j++) {
+      body[j] ^= it->second[j];
+    }
+  }
+  if (missing != 1 || length > body.size()) {
+    return false;
+  }
+  lost->assign(body.begin(), body.begin() + length);
+  return true;
+}
+
+/// Swaps 16-bit samples between byte orders.
+inline std::vector<uint8_t> swap16(std::vector<uint8_t> bytes) {
+  for (size_t i = 0; i + 1 < bytes.size(); i += 2) {
+    std::swap(bytes[i], bytes[i + 1]);
+  }
+  return bytes;
+}
+
+inline sockaddr_in loopback(uint16_t port) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  return addr;
+}
+
+inline uint16_t bound_port(int fd) {
+  sockaddr_in addr{};
+  socklen_t len = sizeof(addr);
+  ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+  return ntohs(addr.sin_port);
+}
+
+/// Waits up to timeout_ms for fd to become readable.
+inline bool wait_readable(int fd, int timeout_ms) {
+  pollfd entry{fd, POLLIN, 0};
+  return ::poll(&entry, 1, timeout_ms) > 0;
+}
+
+/// A UDP socket on an ephemeral loopback port. It talks to the host stack
+/// directly, so the send hook never applies to it.
+class UdpReceiver {
+public:
+  UdpReceiver() {
+    this->fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    int size = 4 << 20;
+    ::setsockopt(this->fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    sockaddr_in addr = loopback(0);
+    ::bind(this->fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    this->port_ = bound_port(this->fd_);
+  }
+  ~UdpReceiver() { ::close(this->fd_); }
+
+  uint16_t port() const { return this->port_; }
+
+  /// Every datagram that arrives until none has for quiet_ms.
+  std::vector<std::vector<uint8_t>> receive(int quiet_ms = 50) {
+    std::vector<std::vector<uint8_t>> datagrams;
+    this->arrivals_.clear();
+    uint8_t buffer[65536];
+    while (wait_readable(this->fd_, quiet_ms)) {
+      ssize_t n = ::recv(this->fd_, buffer, sizeof(buffer), 0);
+      if (n < 0) {
+        break;
+      }
+      datagrams.emplace_back(buffer, buffer + n);
+      this->arrivals_.push_back(std::chrono::steady_clock::now());
+    }
+    return datagrams;
+  }
+
+  /// Like receive(), parsing each datagram; malformed ones are left out.
+  std::vector<Packet> packets(int quiet_ms = 50) {
+    std::vector<Packet> parsed;
+    const auto datagrams = this->receive(quiet_ms);
+    for (size_t i = 0; i < datagrams.size(); i++) {
+      Packet packet;
+      if (parse_packet(datagrams[i], &packet)) {
+        packet.arrival = this->arrivals_[i];
+        parsed.push_back(std::move(packet));
+      }
+    }
+    return parsed;
+  }
+
+protected:
+  int fd_{-1};
+  uint16_t port_{0};
+  std::vector<std::chrono::steady_clock::time_point> arrivals_;
+};
+
+/// A TCP listener on an ephemeral loopback port that accepts one connection
+/// and splits its byte stream into length-prefixed frames. A receive_buffer
+/// above zero fixes the connection's receive buffer at about that size, so
+/// a receiver that stops reading soon pushes back on the sender.
+class TcpReceiver {
+public:
+  explicit TcpReceiver(int receive_buffer = 0) {
+    this->listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (receive_buffer > 0) {
+      ::setsockopt(this->listen_fd_, SOL_SOCKET, SO_RCVBUF, &receive_buffer,
+                   sizeof(receive_buffer));
+    }
+    sockaddr_in addr = loopback(0);
+    ::bind(this->listen_fd_, reinterpret_cast<sockaddr *>(&addr),
+           sizeof(addr));
+    ::listen(this->listen_fd_, 4);
+    this->port_ = bound_port(this->listen_fd_);
+  }
+  ~TcpReceiver() {
+    if (this->fd_ >= 0) {
+      ::close(this->fd_);
+    }
+    ::close(this->listen_fd_);
+  }
+
+  uint16_t port() const { return this->port_; }
+
+  /// Every frame that arrives until no bytes have for quiet_ms. A trailing
+  /// partial frame stays buffered for the next call.
+  std::vector<std::vector<uint8_t>> receive(int quiet_ms = 50) {
+    if (this->fd_ < 0) {
+      if (!wait_readable(this->listen_fd_, quiet_ms)) {
+        return {};
+      }
+      this->fd_ = ::accept(this->listen_fd_, nullptr, nullptr);
+    }
+    uint8_t buffer[16384];
+    while (wait_readable(this->fd_, quiet_ms)) {
+      ssize_t n = ::recv(this->fd_, buffer, sizeof(buffer), 0);
+      if (n <= 0) {
+        break;
+      }
+      this->stream_.insert(this->stream_.end(), buffer, buffer + n);
+    }
+
+    std::vector<std::vector<uint8_t>> frames;
+    size_t offset = 0;
+    while (this->stream_.size() - offset >= 2) {
+      const size_t length =
+          static_cast<size_t>(this->stream_[offset]) << 8 |
+          this->stream_[offset + 1];
+      if (this->stream_.size() - offset - 2 < length) {
+        break;
+      }
+      frames.emplace_back(this->stream_.begin() + offset + 2,
+                          this->stream_.begin() + offset + 2 + length);
+      offset += 2 + length;
+    }
+    this->stream_.erase(this->stream_.begin(), this->stream_.begin() + offset);
+    return frames;
+  }
+
+  /// Resets the connection mid-stream, dropping whatever part of a frame
+  /// it had buffered, and accepts the next one on the following receive().
+  void disconnect() {
+    linger reset{1, 0};
+    ::setsockopt(this->fd_, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    ::close(this->fd_);
+    this->fd_ = -1;
+    this->stream_.clear();
+  }
+
+  /// Bytes of a frame whose rest hasn't arrived yet.
+  size_t buffered() const { return this->stream_.size(); }
+
+  std::vector<Packet> packets(int quiet_ms = 50) {
+    std::vector<Packet> parsed;
+    for (const auto &frame : this->receive(quiet_ms)) {
+      Packet packet;
+      if (parse_packet(frame, &packet)) {
+        parsed.push_back(std::move(packet));
+      }
+    }
+    return parsed;
+  }
+
+protected:
+  int listen_fd_{-1};
+  int fd_{-1};
+  uint16_t port_{0};
+  std::vector<uint8_t> stream_;
+};
+
+/// The payloads of packets, concatenated in the order given.
+inline std::vector<uint8_t> payloads(const std::vector<Packet> &packets) {
+  std::vector<uint8_t> out;
+  for (const auto &packet : packets) {
+    out.insert(out.end(), packet.payload.begin(), packet.payload.end());
+  }
+  return out;
+}
+
+/// True if the packets' sequence numbers run on from first without a gap.
+inline bool consecutive(const std::vector<Packet> &packets,
+                        uint32_t first = 0) {
+  for (size_t i = 0; i < packets.size(); i++) {
+    if (packets[i].sequence != first + i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct Rig {
+  esphome::audio::AudioStreamInfo info;
+  esphome::microphone::MicrophoneSource mic;
+  std::unique_ptr<TestStreamer> streamer;
+  /// Next frame the microphone delivers.
+  uint64_t frame{0};
+
+  /// A streamer with packet headers and little-endian payloads, so what
+  /// arrives compares directly with signal_bytes(). Destinations are left
+  /// to the test.
+  explicit Rig(esphome::audio::AudioStreamInfo stream_info = {16, 1, 16000})
+      : info(stream_info), mic(stream_info),
+        streamer(std::make_unique<TestStreamer>()) {
+    this->streamer->set_microphone_source(&this->mic);
+    this->streamer->set_packet_header(true);
+    this->streamer->set_byte_order(
+        esphome::udp_audio_streamer::WIRE_BYTE_ORDER_LITTLE_ENDIAN);
+    this->streamer->set_chunk_duration(20);
+  }
+
+  void set_up() {
+    this->streamer->setup();
+    esphome::fakes::loop_once(this->streamer.get());
+  }
+
+  /// The signal the microphone delivered for frames [first, last).
+  std::vector<uint8_t> expected(uint64_t first, uint64_t last) const {
+    return signal_bytes(first, last, this->info.get_channels(),
+                        this->info.get_bits_per_sample());
+  }
+
+  /// Delivers frames of audio in chunks of chunk_frames, running the main
+  /// loop after each.
+  void feed(uint64_t frames, uint32_t chunk_frames = 320) {
+    const uint64_t end = this->frame + frames;
+    while (this->frame < end) {
+      const uint64_t n = std::min<uint64_t>(chunk_frames, end - this->frame);
+      this->mic.emit(this->expected(this->frame, this->frame + n));
+      this->frame += n;
+      esphome::fakes::loop_once(this->streamer.get());
+    }
+  }
+};
+
+} // namespace streamer_test
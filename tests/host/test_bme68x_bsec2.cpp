@@ -0,0 +1,136 @@
+#include "esphome/components/bme68x_bsec2/bme68x_bsec2.h"
+#include "esphome/core/hal.h"
+#include "host_test.h"
+
+#include <algorithm>
+
+using namespace esphome;
+using bme68x_bsec2::BME68xBSEC2Component;
+
+namespace {
+
+constexpr uint32_t STATE_HASH = 0x68B5EC2;
+
+// The I2C and SPI variants only differ in how they reach the chip, which
+// the library fake stands in for.
+class TestBsec2 : public BME68xBSEC2Component {
+public:
+  uint32_t get_hash() override { return STATE_HASH; }
+};
+
+struct Rig {
+  TestBsec2 bme{};
+  sensor::Sensor temperature, humidity, pressure, gas, iaq, accuracy;
+  text_sensor::TextSensor accuracy_text;
+
+  Rig() {
+    bme.set_temperature_sensor(&temperature);
+    bme.set_humidity_sensor(&humidity);
+    bme.set_pressure_sensor(&pressure);
+    bme.set_gas_resistance_sensor(&gas);
+    bme.set_iaq_sensor(&iaq);
+    bme.set_iaq_accuracy_sensor(&accuracy);
+    bme.set_iaq_accuracy_text_sensor(&accuracy_text);
+  }
+
+  /// Runs the main loop for ms of fake time, 5 ms per iteration.
+  void run(uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += 5) {
+      fakes::loop_once(&bme);
+      fakes::advance_time_ms(5);
+    }
+  }
+};
+
+bool contains(const std::vector<float> &values, float value) {
+  return std::find(values.begin(), values.end(), value) != values.end();
+}
+
+} // namespace
+
+TEST(publishes_every_subscribed_output) {
+  Rig rig;
+  rig.bme.setup();
+  REQUIRE(!rig.bme.is_failed());
+  rig.run(4000);
+
+  CHECK(contains(rig.temperature.history(), 21.5f));
+  CHECK(contains(rig.humidity.history(), 45.0f));
+  CHECK(contains(rig.pressure.history(), 1013.25f));
+  CHECK(contains(rig.gas.history(), 120000.0f));
+  CHECK(contains(rig.iaq.history(), 50.0f));
+  CHECK(rig.accuracy.has_state());
+  CHECK(!rig.bme.status_has_error());
+  CHECK(!rig.bme.status_has_warning());
+}
+
+TEST(compensation_sources_and_offset_feed_the_library) {
+  Rig rig;
+  sensor::Sensor outside_temperature, outside_humidity;
+  outside_temperature.publish_state(30.0f);
+  outside_humidity.publish_state(60.0f);
+  rig.bme.set_temperature_compensation_source(&outside_temperature);
+  rig.bme.set_humidity_compensation_source(&outside_humidity);
+  rig.bme.set_temperature_offset(2.0f);
+  rig.bme.setup();
+  rig.run(100);
+
+  CHECK(contains(rig.temperature.history(), 28.0f));
+  CHECK(contains(rig.humidity.history(), 60.0f));
+}
+
+TEST(no_sensors_fails_setup) {
+  TestBsec2 bme{};
+  bme.setup();
+  CHECK(bme.is_failed());
+}
+
+TEST(accuracy_text_follows_calibration) {
+  fakes::bsec().steps_per_accuracy = 1;
+  Rig rig;
+  rig.bme.setup();
+  rig.run(4 * 3000 + 500);
+
+  CHECK(rig.accuracy_text.history ==
+        (std::vector<std::string>{"Uncertain", "Calibrating", "Calibrated"}));
+  // Numeric accuracy only publishes on change.
+  CHECK(rig.accuracy.history() == (std::vector<float>{1, 2, 3}));
+}
+
+TEST(state_is_saved_once_calibrated_and_restored) {
+  fakes::bsec().steps_per_accuracy = 1;
+  {
+    Rig rig;
+    rig.bme.set_state_save_interval(60000);
+    fakes::advance_time_ms(60000);
+    rig.bme.setup();
+    rig.run(3000 + 500);
+    CHECK_EQ(fakes::preferences().save_count(STATE_HASH), 0u);
+    rig.run(3000);
+    REQUIRE(fakes::preferences().save_count(STATE_HASH) == 1);
+    rig.run(2 * 3000);
+    CHECK_EQ(fakes::preferences().save_count(STATE_HASH), 1u);
+  }
+
+  // A second instance, as after a reboot, starts out calibrated.
+  Rig rig;
+  rig.bme.setup();
+  CHECK(fakes::log_contains("Loaded state"));
+  rig.run(500);
+  REQUIRE(!rig.accuracy.history().empty());
+  CHECK_EQ(rig.accuracy.history().front(), 3.0f);
+}
+
+TEST(state_save_repeats_after_the_interval) {
+  fakes::bsec().steps_per_accuracy = 1;
+  Rig rig;
+  rig.bme.set_state_save_interval(20000);
+  fakes::advance_time_ms(20000);
+  rig.bme.setup();
+  rig.run(3 * 3000 + 500);
+  REQUIRE(fakes::preferences().save_count(STATE_HASH) == 1);
+  rig.run(15000);
+  CHECK_EQ(fakes::preferences().save_count(STATE_HASH), 1u);
+  rig.run(6000);
+  CHECK_EQ(fakes::preferences().save_count(STATE_HASH), 2u);
+}
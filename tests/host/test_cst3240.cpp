@@ -0,0 +1,169 @@
+#include "esphome/components/cst3240/binary_sensor/cst3240_button.h"
+#include "esphome/components/cst3240/touchscreen/cst3240_touchscreen.h"
+#include "host_test.h"
+
+using namespace esphome;
+using cst3240::CST3240Touchscreen;
+
+namespace {
+
+// Exposes the button hook the board code calls.
+class TestTouchscreen : public CST3240Touchscreen {
+public:
+  using CST3240Touchscreen::update_button_state_;
+};
+
+std::vector<uint8_t> touch_data(int count, uint16_t x, uint16_t y,
+                                uint8_t pressure) {
+  std::vector<uint8_t> data(cst3240::CST3240_TOUCH_DATA_LEN, 0);
+  data[5] = count;
+  const uint8_t offsets[] = {0, 7, 12, 17, 22};
+  for (int i = 0; i < count; i++) {
+    uint8_t *p = &data[offsets[i]];
+    const uint16_t px = x + i * 10, py = y + i * 10;
+    p[0] = 0x06 | (i << 4);
+    p[1] = px >> 4;
+    p[2] = py >> 4;
+    p[3] = (px & 0x0F) << 4 | (py & 0x0F);
+    p[4] = pressure;
+  }
+  return data;
+}
+
+struct Rig {
+  i2c::I2CBus bus;
+  fakes::FakePin reset{4};
+  fakes::FakePin irq{5};
+  TestTouchscreen touch;
+
+  Rig() {
+    bus.registers[0xD204] = {0x34, 0x12, 0x40, 0x32};
+    bus.registers[0xD1F8] = {0xE0, 0x01, 0x10, 0x01};
+    touch.set_i2c_bus(&bus);
+    touch.set_i2c_address(0x5A);
+    touch.set_reset_pin(&reset);
+    touch.set_interrupt_pin(&irq);
+  }
+
+  void set_up() {
+    touch.setup();
+    fakes::advance_time_ms(400);
+    fakes::run_scheduler();
+  }
+};
+
+} // namespace
+
+TEST(setup_resets_then_reads_resolution_after_400ms) {
+  Rig rig;
+  rig.touch.setup();
+  REQUIRE(rig.reset.writes.size() == 3);
+  CHECK(rig.reset.writes[0].value);
+  CHECK(!rig.reset.writes[1].value);
+  CHECK(rig.reset.writes[2].value);
+  CHECK(!rig.touch.can_proceed());
+
+  fakes::run_scheduler();
+  CHECK(!rig.touch.can_proceed());
+  fakes::advance_time_ms(400);
+  fakes::run_scheduler();
+
+  CHECK(rig.touch.can_proceed());
+  CHECK(!rig.touch.is_failed());
+  CHECK_EQ(rig.touch.get_x_raw_max(), 480);
+  CHECK_EQ(rig.touch.get_y_raw_max(), 272);
+  CHECK(rig.irq.interrupt_attached());
+  CHECK_EQ(rig.irq.interrupt_type, gpio::INTERRUPT_FALLING_EDGE);
+}
+
+TEST(swap_xy_swaps_the_read_resolution) {
+  Rig rig;
+  rig.touch.set_swap_xy(true);
+  rig.set_up();
+  CHECK_EQ(rig.touch.get_x_raw_max(), 272);
+  CHECK_EQ(rig.touch.get_y_raw_max(), 480);
+}
+
+TEST(failed_communication_test_marks_failed) {
+  Rig rig;
+  rig.bus.failing_registers.insert(0xD000);
+  rig.set_up();
+  CHECK(rig.touch.is_failed());
+  CHECK(rig.touch.can_proceed());
+}
+
+TEST(interrupt_touch_decodes_points_and_syncs) {
+  Rig rig;
+  rig.set_up();
+  rig.bus.registers[0xD000] = touch_data(2, 0x123, 0x0AB, 40);
+  rig.bus.writes.clear();
+
+  rig.irq.set_level(true);
+  rig.irq.set_level(false);
+  fakes::loop_once(&rig.touch);
+
+  const auto touches = rig.touch.get_touches();
+  REQUIRE(touches.size() == 2);
+  CHECK_EQ(touches[0].id, 0);
+  CHECK_EQ(touches[0].x_raw, 0x123);
+  CHECK_EQ(touches[0].y_raw, 0x0AB);
+  CHECK_EQ(touches[0].z_raw, 40);
+  CHECK_EQ(touches[1].x_raw, 0x123 + 10);
+  CHECK_EQ(touches[1].y_raw, 0x0AB + 10);
+
+  REQUIRE(rig.bus.writes.size() == 1);
+  CHECK_EQ(rig.bus.writes[0].a_register, cst3240::CST3240_REG_SYNC_SIGNAL);
+  CHECK(rig.bus.writes[0].data == std::vector<uint8_t>{0xAB});
+}
+
+TEST(released_and_invalid_counts_report_no_touches) {
+  Rig rig;
+  rig.set_up();
+  auto data = touch_data(1, 100, 100, 10);
+  data[0] = 0x00; // released
+  rig.bus.registers[0xD000] = data;
+  rig.irq.set_level(true);
+  rig.irq.set_level(false);
+  fakes::loop_once(&rig.touch);
+  CHECK(rig.touch.get_touches().empty());
+
+  data = touch_data(1, 100, 100, 10);
+  data[5] = 7; // more points than the chip has
+  rig.bus.registers[0xD000] = data;
+  rig.irq.set_level(true);
+  rig.irq.set_level(false);
+  fakes::loop_once(&rig.touch);
+  CHECK(rig.touch.get_touches().empty());
+  CHECK(!rig.touch.status_has_warning());
+}
+
+TEST(failed_touch_read_sets_warning) {
+  Rig rig;
+  rig.set_up();
+  rig.bus.failing_registers.insert(0xD000);
+  rig.irq.set_level(true);
+  rig.irq.set_level(false);
+  fakes::loop_once(&rig.touch);
+  CHECK(rig.touch.status_has_warning());
+
+  rig.bus.failing_registers.clear();
+  rig.bus.registers[0xD000] = touch_data(1, 1, 1, 1);
+  rig.irq.set_level(true);
+  rig.irq.set_level(false);
+  fakes::loop_once(&rig.touch);
+  CHECK(!rig.touch.status_has_warning());
+}
+
+TEST(button_publishes_state_changes_only) {
+  Rig rig;
+  cst3240::CST3240Button button;
+  button.set_parent(&rig.touch);
+  button.setup();
+  CHECK(button.has_state());
+  CHECK(!button.state);
+
+  rig.touch.update_button_state_(true);
+  rig.touch.update_button_state_(true);
+  rig.touch.update_button_state_(false);
+  CHECK(button.history == (std::vector<bool>{false, true, false}));
+}
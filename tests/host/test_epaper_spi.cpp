@@ -0,0 +1,177 @@
+#include "esphome/components/epaper_spi/epaper_spi_spectra_e6.h"
+#include "host_test.h"
+
+#include <algorithm>
+
+using namespace esphome;
+using epaper_spi::EPaperSpectraE6;
+
+namespace {
+
+constexpr uint16_t WIDTH = 64;
+constexpr uint16_t HEIGHT = 32;
+constexpr size_t BUFFER_LENGTH = WIDTH * HEIGHT / 2;
+
+// [command, argument count, arguments...], as display.py flattens it.
+const uint8_t INIT_SEQUENCE[] = {
+    0x01, 0x01, 0x3F,                                  //
+    0x00, 0x02, 0x5F, 0x69,                            //
+    0x61, 0x04, 0x00, WIDTH, 0x00, HEIGHT,             //
+    0x0A, epaper_spi::DELAY_FLAG,                      //
+    0xE3, 0x01, 0x2F,                                  //
+};
+
+struct Command {
+  uint8_t command;
+  std::vector<uint8_t> data;
+};
+
+struct Rig {
+  spi::SPIComponent bus;
+  fakes::FakePin dc{11};
+  fakes::FakePin reset{12};
+  fakes::FakePin busy{13};
+  EPaperSpectraE6 display{"spectra-e6", WIDTH, HEIGHT, INIT_SEQUENCE,
+                          sizeof(INIT_SEQUENCE)};
+
+  Rig() {
+    bus.watch_pin(&dc);
+    display.set_spi_parent(&bus);
+    display.set_dc_pin(&dc);
+    display.set_reset_pin(&reset);
+    display.set_busy_pin(&busy);
+    display.setup();
+  }
+
+  /// Runs the loop until the display goes back to idle, letting time pass
+  /// between iterations for the reset pulses.
+  bool run_until_idle(int max_iterations = 1000) {
+    for (int i = 0; i < max_iterations; i++) {
+      fakes::loop_once(&display);
+      if (!display.is_loop_enabled()) {
+        return true;
+      }
+      fakes::advance_time_ms(20);
+    }
+    return false;
+  }
+
+  /// The bus traffic as commands (DC low) with their data (DC high).
+  std::vector<Command> commands() const {
+    std::vector<Command> out;
+    for (const auto &transaction : bus.transactions) {
+      for (const auto &byte : transaction.bytes) {
+        if (!byte.pin_level) {
+          out.push_back({byte.value, {}});
+        } else if (!out.empty()) {
+          out.back().data.push_back(byte.value);
+        }
+      }
+    }
+    return out;
+  }
+};
+
+const Command *find(const std::vector<Command> &commands, uint8_t command) {
+  for (const auto &c : commands) {
+    if (c.command == command) {
+      return &c;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+TEST(update_runs_the_full_refresh_sequence) {
+  Rig rig;
+  rig.display.update();
+  REQUIRE(rig.run_until_idle());
+
+  const auto commands = rig.commands();
+  std::vector<uint8_t> order;
+  for (const auto &c : commands) {
+    order.push_back(c.command);
+  }
+  CHECK(order == (std::vector<uint8_t>{0x01, 0x00, 0x61, 0xE3, 0x10, 0x04,
+                                       0x06, 0x12, 0x02, 0x07}));
+  const auto *resolution = find(commands, 0x61);
+  REQUIRE(resolution != nullptr);
+  CHECK(resolution->data == (std::vector<uint8_t>{0x00, WIDTH, 0x00, HEIGHT}));
+  const auto *booster = find(commands, 0x06);
+  REQUIRE(booster != nullptr);
+  CHECK(booster->data == (std::vector<uint8_t>{0x6F, 0x1F, 0x17, 0x27}));
+  const auto *sleep = find(commands, 0x07);
+  REQUIRE(sleep != nullptr);
+  CHECK(sleep->data == std::vector<uint8_t>{0xA5});
+
+  // The buffer starts cleared to white, two pixels per byte.
+  const auto *image = find(commands, 0x10);
+  REQUIRE(image != nullptr);
+  CHECK_EQ(image->data.size(), BUFFER_LENGTH);
+  CHECK(std::all_of(image->data.begin(), image->data.end(),
+                    [](uint8_t b) { return b == 0x11; }));
+}
+
+TEST(reset_pulses_twice_for_the_reset_duration) {
+  Rig rig;
+  rig.reset.writes.clear();
+  rig.display.update();
+  REQUIRE(rig.run_until_idle());
+
+  REQUIRE(rig.reset.writes.size() == 4);
+  CHECK(!rig.reset.writes[0].value);
+  CHECK(rig.reset.writes[1].value);
+  CHECK(!rig.reset.writes[2].value);
+  CHECK(rig.reset.writes[3].value);
+  for (size_t i = 1; i < rig.reset.writes.size(); i++) {
+    CHECK(rig.reset.writes[i].time_ms - rig.reset.writes[i - 1].time_ms >=
+          200);
+  }
+}
+
+TEST(pixels_map_to_the_six_colour_palette) {
+  Rig rig;
+  rig.display.set_writer([](display::Display &it) {
+    it.draw_pixel_at(0, 0, Color(255, 0, 0));   // red
+    it.draw_pixel_at(1, 0, Color(0, 0, 255));   // blue
+    it.draw_pixel_at(2, 0, Color(255, 255, 0)); // yellow
+    it.draw_pixel_at(3, 0, Color(0, 255, 0));   // green
+    it.draw_pixel_at(4, 0, Color(20, 20, 20));  // black
+    it.draw_pixel_at(5, 0, Color(0, 200, 200)); // cyan shows as green
+    it.draw_pixel_at(WIDTH, 0, Color(0, 0, 0)); // off the panel
+  });
+  rig.display.update();
+  REQUIRE(rig.run_until_idle());
+
+  const auto commands = rig.commands();
+  const auto *image = find(commands, 0x10);
+  REQUIRE(image != nullptr);
+  REQUIRE(image->data.size() == BUFFER_LENGTH);
+  CHECK_EQ(image->data[0], 0x35);
+  CHECK_EQ(image->data[1], 0x26);
+  CHECK_EQ(image->data[2], 0x06);
+  CHECK_EQ(image->data[3], 0x11);
+  CHECK_EQ(image->data[WIDTH / 2], 0x11);
+}
+
+TEST(busy_panel_holds_the_sequence) {
+  Rig rig;
+  rig.busy.set_level(true);
+  rig.display.update();
+  CHECK(!rig.run_until_idle(100));
+  CHECK(rig.commands().size() == 0);
+
+  rig.busy.set_level(false);
+  REQUIRE(rig.run_until_idle());
+  CHECK(rig.commands().back().command == 0x07);
+}
+
+TEST(update_while_refreshing_is_refused) {
+  Rig rig;
+  rig.busy.set_level(true);
+  rig.display.update();
+  fakes::loop_once(&rig.display);
+  rig.display.update();
+  CHECK(fakes::log_contains("Display already in state"));
+}
@@ -0,0 +1,505 @@
+#include "recorder_rig.h"
+
+using namespace esphome;
+using namespace recorder_test;
+
+TEST(records_a_pcm_wav_file) {
+  Rig rig;
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  rig.feed(1000);
+  REQUIRE(rig.recorder->start_recording());
+  const uint64_t first = rig.frame;
+  rig.feed(16000);
+  const uint64_t last = rig.frame;
+  rig.recorder->stop_recording();
+  REQUIRE(rig.wait_idle());
+
+  const auto names = rig.files();
+  REQUIRE(names.size() == 1);
+  const auto file = rig.read(names[0]);
+  REQUIRE(file.size() >= 44);
+  CHECK(std::memcmp(file.data(), "RIFF", 4) == 0);
+  CHECK(std::memcmp(file.data() + 8, "WAVE", 4) == 0);
+  CHECK_EQ(le32(&file[4]), file.size() - 8);
+  CHECK_EQ(le16(&file[22]), 1);
+  CHECK_EQ(le32(&file[24]), 16000u);
+  CHECK_EQ(le16(&file[34]), 16);
+  CHECK_EQ(le32(&file[40]), file.size() - 44);
+  CHECK(std::vector<uint8_t>(file.begin() + 44, file.end()) ==
+        signal_bytes(first, last, 1, 16));
+  CHECK_EQ(rig.recorder->bytes_dropped_total_.load(), 0u);
+  CHECK(fakes::log_contains("Recording finished"));
+}
+
+TEST(missing_card_fails_setup) {
+  Rig rig;
+  rig.recorder->set_mount_point(rig.dir + "/absent");
+  rig.set_up();
+  CHECK(rig.recorder->is_failed());
+}
+
+TEST(mount_halves_the_clock_until_the_card_answers) {
+  Rig rig;
+  rig.recorder->set_bus_frequency_khz(40000);
+  fakes::sd_card().max_clock_khz = 12000;
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  // 40 and 20 MHz fail with CRC errors; 10 MHz works.
+  CHECK_EQ(fakes::sd_card().init_attempts.load(), 3);
+  CHECK_EQ(fakes::sd_card().clock_khz.load(), 10000u);
+  CHECK(fakes::log_contains("retrying at 10000 kHz"));
+}
+
+TEST(mount_gives_up_below_the_lowest_clock) {
+  Rig rig;
+  rig.recorder->set_bus_frequency_khz(40000);
+  fakes::sd_card().max_clock_khz = 4000;
+  rig.set_up();
+  CHECK(rig.recorder->is_failed());
+  // 40, 20, 10 and 5 MHz, and no lower.
+  CHECK_EQ(fakes::sd_card().init_attempts.load(), 4);
+}
+
+TEST(max_duration_stops_the_recording) {
+  Rig rig;
+  rig.recorder->set_max_duration_ms(200);
+  rig.set_up();
+  REQUIRE(rig.recorder->start_recording());
+  rig.feed(1600);
+  fakes::advance_time_ms(200);
+  rig.feed(160);
+  CHECK(!rig.recorder->is_recording());
+  REQUIRE(rig.wait_idle());
+  CHECK_EQ(rig.files().size(), 1u);
+}
+
+TEST(preallocated_file_is_cut_back_to_the_audio) {
+  Rig rig;
+  rig.recorder->set_max_duration_ms(10000);
+  rig.recorder->set_preallocate(true);
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  REQUIRE(rig.recorder->start_recording());
+  // The header and 10s of 16-bit mono, rounded up to the 4KB write block.
+  const auto names = rig.files();
+  REQUIRE(names.size() == 1);
+  CHECK_EQ(std::filesystem::file_size(rig.dir + "/" + names[0]), 323584u);
+  const uint64_t first = rig.frame;
+  rig.feed(16000);
+  const uint64_t last = rig.frame;
+  rig.recorder->stop_recording();
+  REQUIRE(rig.wait_idle());
+
+  const auto file = rig.read(names[0]);
+  CHECK_EQ(file.size(), 44u + 32000);
+  CHECK_EQ(le32(&file[4]), file.size() - 8);
+  CHECK_EQ(le32(&file[40]), 32000u);
+  CHECK(std::vector<uint8_t>(file.begin() + 44, file.end()) ==
+        signal_bytes(first, last, 1, 16));
+}
+
+TEST(pre_roll_leads_each_recording_without_overlap) {
+  Rig rig;
+  rig.recorder->set_pre_roll_ms(200);
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  rig.feed(4000);
+  REQUIRE(rig.recorder->start_recording());
+  // The first recording opens with the full 3200 frames of pre-roll.
+  const uint64_t first = rig.frame - 3200;
+  rig.feed(8000);
+  const uint64_t stopped = rig.frame;
+  rig.recorder->stop_recording();
+  REQUIRE(rig.wait_idle());
+  // The second starts sooner than the pre-roll after the stop, so it opens
+  // where the first one ended.
+  rig.feed(1000);
+  fakes::advance_time_ms(1000);
+  REQUIRE(rig.recorder->start_recording());
+  rig.feed(4000);
+  const uint64_t last = rig.frame;
+  rig.recorder->stop_recording();
+  REQUIRE(rig.wait_idle());
+
+  const auto names = rig.files();
+  REQUIRE(names.size() == 2);
+  const auto one = rig.read(names[0]);
+  const auto two = rig.read(names[1]);
+  REQUIRE(one.size() >= 44);
+  REQUIRE(two.size() >= 44);
+  CHECK(std::vector<uint8_t>(one.begin() + 44, one.end()) ==
+        signal_bytes(first, stopped, 1, 16));
+  CHECK(std::vector<uint8_t>(two.begin() + 44, two.end()) ==
+        signal_bytes(stopped, last, 1, 16));
+  CHECK_EQ(rig.recorder->bytes_dropped_total_.load(), 0u);
+}
+
+TEST(self_test_feeds_the_watchdog_between_writes) {
+  fakes::sd_card().write_delay_us = 2000;
+  Rig rig;
+  rig.recorder->set_self_test_size(1 << 20);
+  App.reset_wdt_stats();
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  CHECK(fakes::log_contains("Card self-test:"));
+  // 256 blocks of 4096 bytes and the sync.
+  CHECK(App.get_wdt_feeds() >= 257);
+  CHECK(App.get_longest_wdt_gap_ms() < 100);
+}
+
+TEST(self_test_short_write_does_not_lower_the_clock) {
+  Rig rig;
+  rig.recorder->set_self_test_size(64 << 10);
+  // The short write leaves a stale EIO in errno.
+  fakes::sd_card().short_writes = 1;
+  rig.set_up();
+  CHECK(fakes::log_contains("Card self-test failed"));
+  CHECK(!fakes::log_contains("lowered the clock"));
+}
+
+TEST(self_test_io_error_lowers_the_clock_and_retries) {
+  Rig rig;
+  rig.recorder->set_self_test_size(64 << 10);
+  fakes::sd_card().fail_writes = 1;
+  rig.set_up();
+  CHECK(fakes::log_contains("lowered the clock"));
+  CHECK(fakes::log_contains("Card self-test:"));
+  CHECK(!fakes::log_contains("Card self-test failed"));
+}
+
+namespace {
+
+/// The current index of the raw region use_raw_image() sets up, which
+/// starts at sector 1.
+bool read_raw_index(const std::vector<uint8_t> &image,
+                    pcm_utils::RawIndex *index) {
+  bool found = false;
+  for (size_t i = 0; i < pcm_utils::RAW_INDEX_SECTORS; i++) {
+    pcm_utils::RawIndex copy;
+    if (pcm_utils::parse_raw_index(
+            &image[(1 + i) * pcm_utils::RAW_SECTOR_SIZE], &copy) &&
+        (!found || copy.generation > index->generation)) {
+      *index = copy;
+      found = true;
+    }
+  }
+  return found;
+}
+
+/// A recording's audio, read out of the ring of data sectors.
+std::vector<uint8_t> raw_audio(const std::vector<uint8_t> &image,
+                               const pcm_utils::RawIndex &index,
+                               const pcm_utils::RawRecording &recording) {
+  constexpr size_t SECTOR = pcm_utils::RAW_SECTOR_SIZE;
+  const size_t data = (1 + pcm_utils::RAW_INDEX_SECTORS) * SECTOR;
+  std::vector<uint8_t> out;
+  for (uint64_t p = recording.start; p < recording.start + recording.length;
+       p++) {
+    const uint64_t sector = p / SECTOR % index.data_sectors;
+    out.push_back(image[data + sector * SECTOR + p % SECTOR]);
+  }
+  return out;
+}
+
+} // namespace
+
+TEST(raw_recordings_read_back_through_the_index) {
+  Rig rig;
+  REQUIRE(rig.use_raw_image(1 << 20));
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  // Twelve 100KB recordings through a ring of just under 1MB, so the last
+  // ones wrap over the first.
+  std::vector<std::pair<uint64_t, uint64_t>> recorded;
+  for (int i = 0; i < 12; i++) {
+    REQUIRE(rig.recorder->start_recording());
+    const uint64_t first = rig.frame;
+    rig.feed(51200, 3200);
+    recorded.emplace_back(first, rig.frame);
+    rig.recorder->stop_recording();
+    REQUIRE(rig.wait_idle());
+    rig.feed(1000);
+  }
+
+  const auto image = read_file(rig.image);
+  pcm_utils::RawIndex index;
+  REQUIRE(read_raw_index(image, &index));
+  std::vector<pcm_utils::RawRecording> listed;
+  for (const auto &recording : index.recordings) {
+    if (recording.sequence != 0) {
+      listed.push_back(recording);
+    }
+  }
+  std::sort(listed.begin(), listed.end(),
+            [](const pcm_utils::RawRecording &a,
+               const pcm_utils::RawRecording &b) {
+              return a.sequence < b.sequence;
+            });
+  REQUIRE(listed.size() == recorded.size());
+  size_t intact = 0;
+  for (size_t i = 0; i < listed.size(); i++) {
+    CHECK_EQ(listed[i].length, 102400u);
+    CHECK_EQ(listed[i].flags, pcm_utils::RAW_RECORDING_COMPLETE);
+    CHECK_EQ(listed[i].sample_rate, 16000u);
+    CHECK_EQ(listed[i].channels, 1);
+    CHECK_EQ(listed[i].bits_per_sample, 16);
+    if (listed[i].start < index.oldest_position) {
+      continue;
+    }
+    // Whatever the index still vouches for is exactly what was recorded.
+    CHECK(raw_audio(image, index, listed[i]) ==
+          signal_bytes(recorded[i].first, recorded[i].second, 1, 16));
+    intact++;
+  }
+  // The ring holds ten of them once the 1/64 reserved ahead of a commit
+  // is given up, so the first two are gone.
+  CHECK_EQ(intact, 10u);
+}
+
+TEST(raw_free_space_counts_only_listed_recordings) {
+  Rig rig;
+  REQUIRE(rig.use_raw_image(8 << 20));
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  // 8MB less the two index sectors.
+  CHECK_EQ(rig.recorder->free_space_mb_.load(), 7u);
+
+  // Forty 100KB recordings; the index lists only the last 14 of them, so
+  // the room the first 26 took is free again.
+  for (int i = 0; i < 40; i++) {
+    REQUIRE(rig.recorder->start_recording());
+    rig.feed(51200, 3200);
+    rig.recorder->stop_recording();
+    REQUIRE(rig.wait_idle());
+  }
+  // The index commit that closed the last recording refreshed it.
+  CHECK_EQ(rig.recorder->free_space_mb_.load(),
+           static_cast<uint32_t>(((8u << 20) - 1024 - 14 * 102400) >> 20));
+}
+
+TEST(slow_card_stalls_the_writer_not_the_microphone) {
+  Rig rig;
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  REQUIRE(rig.recorder->start_recording());
+  const uint64_t first = rig.frame;
+  // Each 4KB write, 128ms of audio, takes 250ms for the first second, so
+  // the staging ring fills while the writer is stuck in the card; then the
+  // card speeds up and the writer catches up.
+  fakes::sd_card().write_delay_us = 250000;
+  const int64_t stalled = rig.stream(16000);
+  // About half a second of audio backed up behind the card.
+  CHECK(rig.recorder->queue_high_water_.load() > 8192);
+  fakes::sd_card().write_delay_us = 0;
+  const int64_t recovered = rig.stream(8000);
+  const uint64_t last = rig.frame;
+  rig.recorder->stop_recording();
+  REQUIRE(rig.wait_idle());
+
+  // The callback only copies into the ring; a generous bound still tells
+  // it apart from one that waits on a 250ms write.
+  CHECK(stalled < 50000);
+  CHECK(recovered < 50000);
+  CHECK_EQ(rig.recorder->bytes_dropped_total_.load(), 0u);
+  const auto names = rig.files();
+  REQUIRE(names.size() == 1);
+  const auto file = rig.read(names[0]);
+  REQUIRE(file.size() >= 44);
+  CHECK_EQ(le32(&file[40]), file.size() - 44);
+  CHECK(std::vector<uint8_t>(file.begin() + 44, file.end()) ==
+        signal_bytes(first, last, 1, 16));
+}
+
+namespace {
+
+/// Feeds frames in randomly sized chunks, so segment cuts land mid-chunk.
+void feed_unevenly(Rig *rig, uint64_t frames, uint32_t seed) {
+  std::mt19937 rng(seed);
+  const uint64_t end = rig->frame + frames;
+  while (rig->frame < end) {
+    const uint32_t n = static_cast<uint32_t>(
+        std::min<uint64_t>(rng() % 600 + 1, end - rig->frame));
+    rig->feed(n, n);
+  }
+}
+
+} // namespace
+
+TEST(timed_segments_join_to_the_recorded_stream) {
+  Rig rig;
+  rig.recorder->set_max_files(10);
+  rig.recorder->set_segment(500, 0, 0);
+  rig.recorder->set_pre_roll_ms(200);
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  feed_unevenly(&rig, 4000, 1);
+  REQUIRE(rig.recorder->start_recording());
+  // The recording starts with the 3200 frames of pre-roll.
+  const uint64_t first = rig.frame - 3200;
+  feed_unevenly(&rig, 37000, 2);
+  const uint64_t last = rig.frame;
+  rig.recorder->stop_recording();
+  REQUIRE(rig.wait_idle());
+
+  // 40200 frames make five full 8000-frame segments and a short sixth.
+  const auto names = rig.files();
+  REQUIRE(names.size() == 6);
+  for (size_t i = 0; i + 1 < names.size(); i++) {
+    CHECK_EQ(rig.audio(names[i]).size(), 16000u);
+  }
+  CHECK_EQ(rig.audio(names[5]).size(), 400u);
+  CHECK(rig.joined() == signal_bytes(first, last, 1, 16));
+  CHECK_EQ(rig.recorder->bytes_dropped_total_.load(), 0u);
+}
+
+TEST(sized_segments_join_to_the_recorded_stream) {
+  Rig rig({32, 2, 16000});
+  rig.recorder->set_bits_per_sample(32);
+  rig.recorder->set_max_files(10);
+  rig.recorder->set_segment(0, 65536, 0);
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  REQUIRE(rig.recorder->start_recording());
+  const uint64_t first = rig.frame;
+  feed_unevenly(&rig, 30000, 3);
+  const uint64_t last = rig.frame;
+  rig.recorder->stop_recording();
+  REQUIRE(rig.wait_idle());
+
+  // As many whole 8-byte frames as fit after the 68-byte header.
+  const auto names = rig.files();
+  REQUIRE(names.size() == 4);
+  for (size_t i = 0; i + 1 < names.size(); i++) {
+    CHECK(rig.read(names[i]).size() <= 65536u);
+    CHECK_EQ(rig.audio(names[i]).size(), (65536u - 68) / 8 * 8);
+  }
+  CHECK(rig.joined() == signal_bytes(first, last, 2, 32));
+}
+
+TEST(committed_header_survives_an_interrupted_recording) {
+  Rig rig;
+  rig.recorder->set_max_duration_ms(10000);
+  rig.recorder->set_preallocate(true);
+  rig.recorder->set_header_commit_interval_ms(100);
+  rig.set_up();
+  REQUIRE(!rig.recorder->is_failed());
+  REQUIRE(rig.recorder->start_recording());
+  const uint64_t first = rig.frame;
+  rig.feed(16000);
+  // The first block written after the interval commits the header.
+  fakes::advance_time_ms(150);
+  rig.feed(4096);
+  const uint64_t last = rig.frame;
+  const auto names = rig.files();
+  REQUIRE(names.size() == 1);
+  // Wait for the commit to reach the card, however far behind the writer
+  // runs; until then the header claims no audio.
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (le32(&rig.read(names[0])[40]) == 0 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // Pull the card here, mid-recording: the snapshot still has the rest of
+  // the preallocated file after the audio.
+  const std::string card = host_test::temp_dir();
+  std::filesystem::copy(rig.dir, card);
+  const auto snapshot = read_file(card + "/" + names[0]);
+  REQUIRE(snapshot.size() > 300000);
+  const uint32_t committed = le32(&snapshot[40]);
+  REQUIRE(committed > 0);
+
+  Rig rebooted;
+  rebooted.use_card(card);
+  rebooted.set_up();
+  REQUIRE(!rebooted.recorder->is_failed());
+  CHECK(fakes::log_contains("Recovered unfinished recording"));
+  REQUIRE(rebooted.files() == names);
+
+  // What comes back is a consistent file holding exactly the committed
+  // audio, and none of the preallocated tail.
+  const auto file = rebooted.read(names[0]);
+  const auto audio = rebooted.audio(names[0]);
+  CHECK_EQ(file.size(), 44 + audio.size());
+  CHECK_EQ(le32(&file[4]), file.size() - 8);
+  CHECK_EQ(audio.size(), committed);
+  CHECK(audio.size() <= 2 * (last - first));
+  CHECK(audio == signal_bytes(first, first + audio.size() / 2, 1, 16));
+}
+
+TEST(recovery_trims_the_header_to_a_truncated_file) {
+  Rig rig;
+  rig.set_up();
+  REQUIRE(rig.recorder->start_recording());
+  const uint64_t first = rig.frame;
+  rig.feed(16000);
+  rig.recorder->stop_recording();
+  REQUIRE(rig.wait_idle());
+  const auto names = rig.files();
+  REQUIRE(names.size() == 1);
+  // Lose the last 1001 bytes, so the cut also splits a frame.
+  const std::string path = rig.dir + "/" + names[0];
+  std::filesystem::resize_file(path, 44 + 32000 - 1001);
+  // And an empty file, as if the card was pulled before its first write.
+  std::ofstream(rig.dir + "/rec-1.wav").close();
+
+  Rig rebooted;
+  rebooted.use_card(rig.dir);
+  rebooted.set_up();
+  CHECK(rebooted.files() == names);
+  CHECK(fakes::log_contains("Removed empty"));
+  const auto file = rebooted.read(names[0]);
+  CHECK_EQ(file.size(), 44u + 30998);
+  CHECK_EQ(le32(&file[40]), 30998u);
+  CHECK(rebooted.audio(names[0]) ==
+        signal_bytes(first, first + 15499, 1, 16));
+}
+
+TEST(wide_and_multichannel_pcm_is_bit_exact) {
+  // A 32-bit source written at each width, with frames of 3 to 32 bytes
+  // that mostly don't divide the 4KB write block.
+  const struct {
+    uint8_t bits;
+    uint8_t channels;
+  } formats[] = {{16, 2}, {24, 1}, {24, 2}, {24, 4},
+                 {24, 6}, {32, 1}, {32, 4}, {32, 8}};
+  uint32_t seed = 10;
+  for (const auto &format : formats) {
+    Rig rig({32, format.channels, 16000});
+    rig.recorder->set_bits_per_sample(format.bits);
+    rig.recorder->set_pre_roll_ms(100);
+    rig.set_up();
+    REQUIRE(!rig.recorder->is_failed());
+    feed_unevenly(&rig, 3000, seed++);
+    REQUIRE(rig.recorder->start_recording());
+    const uint64_t first = rig.frame - 1600;
+    feed_unevenly(&rig, 20000, seed++);
+    const uint64_t last = rig.frame;
+    rig.recorder->stop_recording();
+    REQUIRE(rig.wait_idle());
+
+    const auto names = rig.files();
+    REQUIRE(names.size() == 1);
+    const auto file = rig.read(names[0]);
+    const bool extensible = format.bits > 16 || format.channels > 2;
+    const size_t header = extensible ? 68 : 44;
+    const uint16_t block_align = format.channels * format.bits / 8;
+    REQUIRE(file.size() > header);
+    CHECK_EQ(le16(&file[20]), extensible ? 0xFFFE : 1);
+    CHECK_EQ(le16(&file[22]), format.channels);
+    CHECK_EQ(le32(&file[28]), 16000u * block_align);
+    CHECK_EQ(le16(&file[32]), block_align);
+    CHECK_EQ(le16(&file[34]), format.bits);
+    if (extensible) {
+      // Valid bits, then the KSDATAFORMAT_SUBTYPE_PCM GUID.
+      CHECK_EQ(le16(&file[38]), format.bits);
+      CHECK_EQ(le16(&file[44]), 1);
+    }
+    CHECK_EQ(le32(&file[header - 4]), file.size() - header);
+    CHECK(rig.audio(names[0]) ==
+          signal_bytes(first, last, format.channels, format.bits));
+    CHECK_EQ(rig.recorder->bytes_dropped_total_.load(), 0u);
+  }
+}
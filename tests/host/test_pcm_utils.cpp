@@ -0,0 +1,450 @@
+#include "host_test.h"
+
+#include "esphome/components/pcm_utils/g711.h"
+#include "esphome/components/pcm_utils/ima_adpcm.h"
+#include "esphome/components/pcm_utils/latency_histogram.h"
+#include "esphome/components/pcm_utils/pcm_convert.h"
+#include "esphome/components/pcm_utils/spsc_ring.h"
+#include "esphome/components/pcm_utils/wav_header.h"
+#include "codec_reference.h"
+#include "pcm_reference.h"
+#include "test_signal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace esphome;
+using namespace codec_reference;
+using namespace pcm_reference;
+using namespace test_signal;
+
+namespace {
+
+// Sample counts around the kernels' four-byte steps, and every alignment
+// of input and output, so the prologue, the word loop and the tail all run.
+constexpr size_t COUNTS[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 255, 1024};
+
+} // namespace
+
+TEST(swaps_match_the_reference) {
+  for (size_t width : {2, 3, 4}) {
+    for (size_t count : COUNTS) {
+      for (size_t offset = 0; offset < 4; offset++) {
+        auto data = random_bytes(count * width + offset, count + width);
+        auto expected = data;
+        reference_swap(expected.data() + offset, count, width);
+        pcm_utils::swap_bytes(data.data() + offset, count, width * 8);
+        CHECK(data == expected);
+      }
+    }
+  }
+}
+
+TEST(conversions_match_the_reference) {
+  for (size_t count : COUNTS) {
+    for (size_t in_offset = 0; in_offset < 4; in_offset++) {
+      for (size_t out_offset = 0; out_offset < 4; out_offset++) {
+        const auto input = random_bytes(count * 4 + in_offset, count);
+        const uint8_t *in = input.data() + in_offset;
+
+        std::vector<uint8_t> got(count * 2 + out_offset);
+        std::vector<uint8_t> want(got.size());
+        pcm_utils::convert_32_to_16(in, got.data() + out_offset, count);
+        reference_32_to_16(in, want.data() + out_offset, count);
+        CHECK(got == want);
+
+        got.assign(count * 3 + out_offset, 0);
+        want.assign(got.size(), 0);
+        pcm_utils::convert_32_to_24(in, got.data() + out_offset, count);
+        reference_32_to_24(in, want.data() + out_offset, count);
+        CHECK(got == want);
+      }
+    }
+  }
+}
+
+TEST(downmixes_match_the_reference) {
+  for (size_t frames : COUNTS) {
+    for (size_t in_offset = 0; in_offset < 4; in_offset++) {
+      for (size_t out_offset = 0; out_offset < 4; out_offset++) {
+        const auto input = random_bytes(frames * 8 + in_offset, frames + 7);
+        const uint8_t *in = input.data() + in_offset;
+
+        std::vector<uint8_t> got(frames * 2 + out_offset);
+        std::vector<uint8_t> want(got.size());
+        pcm_utils::downmix_stereo_to_mono_16(in, got.data() + out_offset,
+                                             frames);
+        reference_downmix_16(in, want.data() + out_offset, frames);
+        CHECK(got == want);
+
+        got.assign(frames * 4 + out_offset, 0);
+        want.assign(got.size(), 0);
+        pcm_utils::downmix_stereo_to_mono_32(in, got.data() + out_offset,
+                                             frames);
+        reference_downmix_32(in, want.data() + out_offset, frames);
+        CHECK(got == want);
+      }
+    }
+  }
+}
+
+TEST(kernels_run_in_place) {
+  for (size_t count : COUNTS) {
+    auto data = random_bytes(count * 4, count + 3);
+    std::vector<uint8_t> want(count * 2);
+    reference_32_to_16(data.data(), want.data(), count);
+    pcm_utils::convert_32_to_16(data.data(), data.data(), count);
+    CHECK(std::vector<uint8_t>(data.begin(), data.begin() + count * 2) ==
+          want);
+
+    data = random_bytes(count * 4, count + 4);
+    want.assign(count * 3, 0);
+    reference_32_to_24(data.data(), want.data(), count);
+    pcm_utils::convert_32_to_24(data.data(), data.data(), count);
+    CHECK(std::vector<uint8_t>(data.begin(), data.begin() + count * 3) ==
+          want);
+
+    data = random_bytes(count * 4, count + 5);
+    want.assign(count * 2, 0);
+    reference_downmix_16(data.data(), want.data(), count);
+    pcm_utils::downmix_stereo_to_mono_16(data.data(), data.data(), count);
+    CHECK(std::vector<uint8_t>(data.begin(), data.begin() + count * 2) ==
+          want);
+  }
+}
+
+TEST(ulaw_round_trip_stays_within_half_a_step) {
+  for (int32_t x = INT16_MIN; x <= INT16_MAX; x++) {
+    const uint8_t code = pcm_utils::linear_to_ulaw(static_cast<int16_t>(x));
+    const int exponent = (static_cast<uint8_t>(~code) >> 4) & 0x07;
+    // The encoder clips magnitudes above 32635.
+    const int32_t clipped = std::clamp<int32_t>(x, -32635, 32635);
+    const int32_t error = ulaw_to_linear(code) - clipped;
+    if (std::abs(error) > (4 << exponent)) {
+      CHECK_EQ(error, 0);
+      return;
+    }
+  }
+  // Every code decodes to a value that encodes back to the same code; mu-law
+  // has two zeros, 0x7F and 0xFF, and the encoder only emits 0xFF.
+  for (int code = 0; code < 256; code++) {
+    if (code == 0x7F) {
+      continue;
+    }
+    CHECK_EQ(pcm_utils::linear_to_ulaw(ulaw_to_linear(code)), code);
+  }
+}
+
+TEST(ulaw_buffer_encoder_matches_per_sample) {
+  const auto samples = test_signal::tone(1001, 1);
+  auto bytes = to_bytes(samples);
+  bytes.insert(bytes.begin(), 0); // unaligned
+  std::vector<uint8_t> out(samples.size());
+  CHECK_EQ(pcm_utils::encode_ulaw(bytes.data() + 1, out.data(), samples.size()),
+           samples.size());
+  for (size_t i = 0; i < samples.size(); i++) {
+    CHECK_EQ(out[i], pcm_utils::linear_to_ulaw(samples[i]));
+  }
+  std::vector<int16_t> decoded;
+  for (uint8_t code : out) {
+    decoded.push_back(ulaw_to_linear(code));
+  }
+  CHECK(snr_db(samples, decoded) > 30.0);
+}
+
+TEST(adpcm_blocks_round_trip_as_one_stream) {
+  for (int channels : {1, 2}) {
+    const size_t frames = 512;
+    const auto samples = tone(frames * 8, channels);
+    const auto bytes = to_bytes(samples);
+    pcm_utils::ImaAdpcmState states[2];
+    std::vector<uint8_t> block(
+        pcm_utils::ima_adpcm_block_size(frames, channels));
+    std::vector<int16_t> decoded;
+    std::vector<ImaState> decoder;
+    for (size_t b = 0; b < 8; b++) {
+      CHECK_EQ(pcm_utils::ima_adpcm_encode_block(
+                   states, channels, bytes.data() + b * frames * channels * 2,
+                   frames, block.data()),
+               block.size());
+      // Each block starts from the state the previous one left, so it
+      // decodes on its own to the same samples as a continuous stream.
+      for (int ch = 0; ch < channels && b > 0; ch++) {
+        CHECK_EQ(le16s(block.data() + 4 * ch), decoder[ch].predictor);
+        CHECK_EQ(block[4 * ch + 2], decoder[ch].index);
+      }
+      const auto part =
+          decode_ima_block(block.data(), frames, channels, &decoder);
+      decoded.insert(decoded.end(), part.begin(), part.end());
+    }
+    // About 24 dB for this tone; a decoder out of step with the encoder
+    // would be far below.
+    CHECK(snr_db(samples, decoded) > 20.0);
+  }
+}
+
+TEST(adpcm_wav_blocks_round_trip) {
+  for (int channels : {1, 2}) {
+    const size_t block_align = 256 * channels;
+    const size_t frames =
+        pcm_utils::ima_adpcm_wav_frames_per_block(block_align, channels);
+    CHECK_EQ(frames, 505u);
+    const auto samples = tone(frames * 4, channels);
+    const auto bytes = to_bytes(samples);
+    pcm_utils::ImaAdpcmState states[2];
+    std::vector<uint8_t> block(block_align);
+    std::vector<int16_t> decoded;
+    for (size_t b = 0; b < 4; b++) {
+      const size_t first = b * frames * channels;
+      CHECK_EQ(pcm_utils::ima_adpcm_encode_wav_block(
+                   states, channels, bytes.data() + first * 2, frames,
+                   block.data()),
+               block_align);
+      const auto part = decode_ima_wav_block(block.data(), frames, channels);
+      // The header carries each channel's first sample exactly.
+      for (int ch = 0; ch < channels; ch++) {
+        CHECK_EQ(part[ch], samples[first + ch]);
+      }
+      decoded.insert(decoded.end(), part.begin(), part.end());
+    }
+    // About 24 dB for this tone; a decoder out of step with the encoder
+    // would be far below.
+    CHECK(snr_db(samples, decoded) > 20.0);
+  }
+}
+
+namespace {
+
+// Bytes through the ring in each stress run: some thousands of laps of a
+// ring small enough that the two threads keep meeting at the wrap.
+constexpr size_t STRESS_BYTES = 8 << 20;
+constexpr size_t STRESS_CAPACITY = 4096;
+
+/// The byte at position i of the stress stream; 251 is prime, so the
+/// pattern never lines up with the ring.
+inline uint8_t stress_byte(size_t i) { return static_cast<uint8_t>(i % 251); }
+
+/// Runs a producer and a consumer thread through a ring until STRESS_BYTES
+/// have passed, each moving randomly sized pieces: produce(ring, position,
+/// len) offers up to len bytes and returns how many it queued, and
+/// consume(ring, out, len) takes up to len. Returns the first position the
+/// consumer saw the wrong byte at, or STRESS_BYTES.
+template <typename Produce, typename Consume>
+size_t stress(pcm_utils::SpscRing *ring, Produce produce, Consume consume) {
+  std::thread producer([&] {
+    std::mt19937 rng(1);
+    size_t position = 0;
+    while (position < STRESS_BYTES) {
+      const size_t len =
+          std::min<size_t>(rng() % 700 + 1, STRESS_BYTES - position);
+      const size_t queued = produce(ring, position, len);
+      if (queued == 0) {
+        std::this_thread::yield();
+      }
+      position += queued;
+    }
+  });
+
+  std::mt19937 rng(2);
+  std::vector<uint8_t> out(1024);
+  size_t position = 0;
+  size_t mismatch = STRESS_BYTES;
+  while (position < STRESS_BYTES) {
+    const size_t got = consume(ring, out.data(), rng() % out.size() + 1);
+    if (got == 0) {
+      std::this_thread::yield();
+    }
+    for (size_t i = 0; i < got && mismatch == STRESS_BYTES; i++) {
+      if (out[i] != stress_byte(position + i)) {
+        mismatch = position + i;
+      }
+    }
+    position += got;
+  }
+  producer.join();
+  return mismatch;
+}
+
+} // namespace
+
+TEST(spsc_ring_copies_across_threads_in_order) {
+  std::vector<uint8_t> storage(STRESS_CAPACITY);
+  pcm_utils::SpscRing ring(storage.data(), storage.size());
+  std::vector<uint8_t> pattern(1024);
+  const size_t mismatch = stress(
+      &ring,
+      [&](pcm_utils::SpscRing *r, size_t position, size_t len) {
+        // Only offer what fits, so nothing counts as an overrun.
+        len = std::min(len, r->free());
+        for (size_t i = 0; i < len; i++) {
+          pattern[i] = stress_byte(position + i);
+        }
+        return r->write(pattern.data(), len);
+      },
+      [](pcm_utils::SpscRing *r, uint8_t *out, size_t len) {
+        return r->read(out, len);
+      });
+  CHECK_EQ(mismatch, STRESS_BYTES);
+  CHECK_EQ(ring.overrun_bytes(), 0u);
+  CHECK_EQ(ring.available(), 0u);
+  CHECK_EQ(ring.write_position(), STRESS_BYTES);
+  CHECK_EQ(ring.read_position(), STRESS_BYTES);
+}
+
+TEST(spsc_ring_regions_work_in_place_across_threads) {
+  std::vector<uint8_t> storage(STRESS_CAPACITY);
+  pcm_utils::SpscRing ring(storage.data(), storage.size());
+  const size_t mismatch = stress(
+      &ring,
+      [](pcm_utils::SpscRing *r, size_t position, size_t len) {
+        uint8_t *first = nullptr;
+        uint8_t *second = nullptr;
+        size_t first_len = 0;
+        size_t second_len = 0;
+        len = std::min(len, r->write_regions(&first, &first_len, &second,
+                                             &second_len));
+        for (size_t i = 0; i < len; i++) {
+          uint8_t *byte = i < first_len ? first + i : second + i - first_len;
+          *byte = stress_byte(position + i);
+        }
+        r->commit_write(len);
+        return len;
+      },
+      [](pcm_utils::SpscRing *r, uint8_t *out, size_t len) {
+        uint8_t *first = nullptr;
+        uint8_t *second = nullptr;
+        size_t first_len = 0;
+        size_t second_len = 0;
+        const size_t total =
+            r->peek(len, &first, &first_len, &second, &second_len);
+        std::memcpy(out, first, first_len);
+        std::memcpy(out + first_len, second, second_len);
+        r->consume(total);
+        return total;
+      });
+  CHECK_EQ(mismatch, STRESS_BYTES);
+  CHECK_EQ(ring.overrun_bytes(), 0u);
+  CHECK_EQ(ring.read_position(), STRESS_BYTES);
+}
+
+TEST(spsc_ring_counts_what_a_full_ring_drops) {
+  std::vector<uint8_t> storage(STRESS_CAPACITY);
+  pcm_utils::SpscRing ring(storage.data(), storage.size());
+  std::atomic<size_t> offered{0};
+  std::atomic<bool> done{false};
+  // Four-byte frames, each tagged with its index, written whole or not at
+  // all while the consumer lags behind.
+  std::thread producer([&] {
+    for (uint32_t frame = 0; frame < (1 << 20); frame++) {
+      ring.write(reinterpret_cast<const uint8_t *>(&frame), 4, 4);
+      offered.fetch_add(4, std::memory_order_relaxed);
+    }
+    done.store(true, std::memory_order_release);
+  });
+  uint32_t previous = 0;
+  size_t received = 0;
+  bool ordered = true;
+  while (!done.load(std::memory_order_acquire) || ring.available() > 0) {
+    uint32_t frames[64];
+    const size_t got = ring.read(reinterpret_cast<uint8_t *>(frames),
+                                 (received % 7 + 1) * 4);
+    REQUIRE(got % 4 == 0);
+    for (size_t i = 0; i < got / 4; i++) {
+      ordered &= received == 0 || frames[i] > previous;
+      previous = frames[i];
+      received += 4;
+    }
+  }
+  producer.join();
+  CHECK(ordered);
+  CHECK_EQ(received + ring.overrun_bytes(), offered.load());
+  CHECK_EQ(received, ring.read_position());
+}
+
+TEST(wav_header_is_little_endian) {
+  // Every multi-byte field gets a value whose bytes all differ, so a field
+  // stored in host order on a big-endian target would show up here.
+  uint8_t header[pcm_utils::WAV_HEADER_SIZE];
+  REQUIRE(pcm_utils::write_wav_header(header, 2, 0x00012345, 16,
+                                      0x01020304) == sizeof(header));
+  const uint8_t expected[] = {
+      'R',  'I',  'F',  'F',  0x28, 0x03, 0x02, 0x01, // RIFF, size
+      'W',  'A',  'V',  'E',  'f',  'm',  't',  ' ',  //
+      0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, // fmt size, PCM, 2 ch
+      0x45, 0x23, 0x01, 0x00, 0x14, 0x8d, 0x04, 0x00, // rate, byte rate
+      0x04, 0x00, 0x10, 0x00, 'd',  'a',  't',  'a',  // align, bits
+      0x04, 0x03, 0x02, 0x01,                         // data size
+  };
+  static_assert(sizeof(expected) == sizeof(header));
+  CHECK(std::memcmp(header, expected, sizeof(header)) == 0);
+
+  pcm_utils::WavLayout layout;
+  REQUIRE(pcm_utils::parse_wav_header(header, sizeof(header), &layout));
+  CHECK_EQ(layout.data_bytes, 0x01020304u);
+  CHECK_EQ(layout.block_align, 4);
+}
+
+TEST(latency_buckets_cover_every_value) {
+  // Walk the bucket edges across the whole uint32_t range: each value must
+  // land in a bucket whose upper bound is at or above it and at most an
+  // eighth beyond, and buckets must rise with the value.
+  size_t last = 0;
+  for (uint64_t v = 0; v <= UINT32_MAX; v = v < 64 ? v + 1 : v + v / 37) {
+    const auto us = static_cast<uint32_t>(v);
+    const size_t bucket = pcm_utils::LatencyHistogram::bucket_for(us);
+    REQUIRE(bucket < pcm_utils::LATENCY_BUCKETS);
+    const uint32_t upper = pcm_utils::LatencyHistogram::bucket_upper(bucket);
+    CHECK(upper >= us);
+    CHECK(upper - us <= us / pcm_utils::LATENCY_SUB_BUCKETS);
+    CHECK(bucket >= last);
+    last = bucket;
+  }
+  CHECK_EQ(pcm_utils::LatencyHistogram::bucket_for(UINT32_MAX),
+           pcm_utils::LATENCY_BUCKETS - 1);
+  CHECK_EQ(pcm_utils::LatencyHistogram::bucket_upper(
+               pcm_utils::LATENCY_BUCKETS - 1),
+           UINT32_MAX);
+}
+
+TEST(latency_percentiles_track_exact_ones) {
+  // Long-tailed latencies, as a card write shows them: mostly a few
+  // milliseconds with the odd stall two orders of magnitude longer.
+  std::mt19937 rng(7);
+  std::lognormal_distribution<double> latency(std::log(3000.0), 1.0);
+  std::vector<uint32_t> samples(100000);
+  pcm_utils::LatencyHistogram histogram;
+  for (uint32_t &us : samples) {
+    us = static_cast<uint32_t>(latency(rng));
+    histogram.record(us);
+  }
+  std::sort(samples.begin(), samples.end());
+
+  pcm_utils::LatencyCounts counts;
+  histogram.snapshot(&counts);
+  REQUIRE(counts.total() == samples.size());
+  for (float fraction : {0.0f, 0.5f, 0.9f, 0.99f, 0.999f, 1.0f}) {
+    const size_t rank = std::max<size_t>(
+        1, static_cast<size_t>(std::ceil(static_cast<double>(fraction) * samples.size())));
+    const uint32_t exact = samples[rank - 1];
+    const uint32_t estimate = counts.percentile(fraction);
+    CHECK(estimate >= exact);
+    CHECK(estimate - exact <= exact / pcm_utils::LATENCY_SUB_BUCKETS);
+  }
+
+  // A later snapshot less this one holds only what came in between.
+  for (int i = 0; i < 10; i++) {
+    histogram.record(1000000);
+  }
+  pcm_utils::LatencyCounts later;
+  histogram.snapshot(&later);
+  later.subtract(counts);
+  CHECK_EQ(later.total(), 10u);
+  CHECK_EQ(later.percentile(0.5f),
+           pcm_utils::LatencyHistogram::bucket_upper(
+               pcm_utils::LatencyHistogram::bucket_for(1000000)));
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+// The deterministic test signal the fake microphones deliver: every sample
+// differs from its neighbours, so a dropped, repeated or misplaced sample
+// shows up in a byte comparison. Also a tone for the codecs and the WAV
+// fixtures for tests that need audio that sounds like something.
+
+#include "host_test.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace test_signal {
+
+/// The full-scale 32-bit sample of a frame and channel. A source narrower
+/// than 32 bits carries its top bits, as an I2S microphone does.
+inline int32_t sample_at(uint64_t frame, int channel) {
+  return static_cast<int32_t>(static_cast<uint32_t>(frame) * 2654435761u +
+                              static_cast<uint32_t>(channel) * 40503u);
+}
+
+/// Appends a sample, little-endian, in its top bits bits.
+inline void put_sample(std::vector<uint8_t> &out, int32_t sample, int bits) {
+  const uint32_t value = static_cast<uint32_t>(sample) >> (32 - bits);
+  for (int i = 0; i < bits / 8; i++) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+/// Frames [first, last) as bits-wide samples.
+inline std::vector<uint8_t> signal_bytes(uint64_t first, uint64_t last,
+                                         int channels, int bits) {
+  std::vector<uint8_t> out;
+  out.reserve((last - first) * channels * bits / 8);
+  for (uint64_t f = first; f < last; f++) {
+    for (int c = 0; c < channels; c++) {
+      put_sample(out, sample_at(f, c), bits);
+    }
+  }
+  return out;
+}
+
+/// len bytes of noise, the same for the same seed.
+inline std::vector<uint8_t> random_bytes(size_t len, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> out(len);
+  for (auto &byte : out) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  return out;
+}
+
+/// Interleaved 16-bit frames of a tone for codecs to chew on: 440 Hz with a
+/// quieter 3 kHz partial, at a different phase on each channel.
+inline std::vector<int16_t> tone(size_t frames, int channels,
+                                 double rate = 16000.0) {
+  std::vector<int16_t> out(frames * channels);
+  for (size_t f = 0; f < frames; f++) {
+    for (int c = 0; c < channels; c++) {
+      const double t = f / rate;
+      const double phase = c * 1.3;
+      out[f * channels + c] = static_cast<int16_t>(
+          12000.0 * std::sin(2 * M_PI * 440.0 * t + phase) +
+          3000.0 * std::sin(2 * M_PI * 3000.0 * t + phase));
+    }
+  }
+  return out;
+}
+
+/// Samples as little-endian bytes.
+inline std::vector<uint8_t> to_bytes(const std::vector<int16_t> &samples) {
+  std::vector<uint8_t> out(samples.size() * 2);
+  for (size_t i = 0; i < samples.size(); i++) {
+    const uint16_t value = static_cast<uint16_t>(samples[i]);
+    out[2 * i] = static_cast<uint8_t>(value);
+    out[2 * i + 1] = static_cast<uint8_t>(value >> 8);
+  }
+  return out;
+}
+
+inline uint32_t le32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+/// The samples of a 16 kHz mono 16-bit WAV file in tests/host/fixtures, as
+/// the little-endian bytes a microphone would deliver.
+inline std::vector<uint8_t> fixture_pcm(const char *name) {
+  std::ifstream in(std::string(HOST_TEST_FIXTURES_DIR) + "/" + name,
+                   std::ios::binary);
+  const std::vector<uint8_t> file{std::istreambuf_iterator<char>(in),
+                                  std::istreambuf_iterator<char>()};
+  REQUIRE(file.size() >= 12 && std::memcmp(file.data(), "RIFF", 4) == 0 &&
+          std::memcmp(&file[8], "WAVE", 4) == 0);
+  bool format_ok = false;
+  for (size_t offset = 12; offset + 8 <= file.size();) {
+    const uint32_t size = le32(&file[offset + 4]);
+    const uint8_t *body = &file[offset + 8];
+    REQUIRE(offset + 8 + size <= file.size());
+    if (std::memcmp(&file[offset], "fmt ", 4) == 0) {
+      // PCM, one channel, 16000 Hz, 16 bits.
+      format_ok = size >= 16 && body[0] == 1 && body[2] == 1 &&
+                  le32(body + 4) == 16000 && body[14] == 16;
+    } else if (std::memcmp(&file[offset], "data", 4) == 0) {
+      REQUIRE(format_ok);
+      return {body, body + size};
+    }
+    offset += 8 + size + (size & 1);
+  }
+  REQUIRE(false);
+  return {};
+}
+
+} // namespace test_signal
@@ -0,0 +1,584 @@
+#include "streamer_rig.h"
+
+using namespace esphome;
+using namespace streamer_test;
+
+TEST(udp_packets_carry_the_signal_in_sequence) {
+  UdpReceiver receiver;
+  Rig rig;
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  REQUIRE(!rig.streamer->is_failed());
+  rig.feed(3200);
+
+  const auto packets = receiver.packets();
+  // 20 ms chunks of 320 frames.
+  REQUIRE(packets.size() == 10);
+  CHECK(consecutive(packets));
+  CHECK_EQ(packets[0].frame_counter, 0u);
+  CHECK_EQ(packets[9].frame_counter, 2880u);
+  CHECK_EQ(packets[0].sample_rate, 16000u);
+  CHECK_EQ(packets[0].channels, 1);
+  CHECK_EQ(packets[0].bits_per_sample, 16);
+  CHECK(payloads(packets) == rig.expected(0, 3200));
+}
+
+TEST(udp_connect_passes_the_ipv4_address_length) {
+  UdpReceiver receiver;
+  Rig rig;
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  CHECK_EQ(fakes::socket_stats().connects, 1);
+  CHECK_EQ(fakes::socket_stats().last_connect_len,
+           static_cast<socklen_t>(sizeof(sockaddr_in)));
+  CHECK(!fakes::log_contains("Failed to connect UDP socket"));
+}
+
+TEST(big_endian_payloads_are_swapped) {
+  UdpReceiver receiver;
+  Rig rig;
+  rig.streamer->set_byte_order(udp_audio_streamer::WIRE_BYTE_ORDER_BIG_ENDIAN);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  rig.feed(1280);
+
+  const auto packets = receiver.packets();
+  REQUIRE(packets.size() == 4);
+  CHECK_EQ(packets[0].flags & udp_audio_streamer::PACKET_FLAG_LITTLE_ENDIAN,
+           0);
+  CHECK(payloads(packets) == swap16(rig.expected(0, 1280)));
+}
+
+TEST(every_destination_gets_the_same_packets) {
+  UdpReceiver first;
+  UdpReceiver second;
+  Rig rig;
+  rig.streamer->add_destination("127.0.0.1", first.port(), 1);
+  rig.streamer->add_destination("127.0.0.1", second.port(), 1);
+  rig.set_up();
+  REQUIRE(!rig.streamer->is_failed());
+  rig.feed(3200);
+  CHECK_EQ(fakes::socket_stats().connects, 2);
+
+  const auto a = first.packets();
+  const auto b = second.packets();
+  REQUIRE(a.size() == 10);
+  REQUIRE(b.size() == a.size());
+  CHECK(consecutive(a));
+  for (size_t i = 0; i < a.size(); i++) {
+    CHECK(a[i].bytes == b[i].bytes);
+  }
+  CHECK(payloads(a) == rig.expected(0, 3200));
+}
+
+TEST(an_unreachable_destination_does_not_hold_back_the_others) {
+  UdpReceiver receiver;
+  uint16_t closed_port = 0;
+  {
+    UdpReceiver closed;
+    closed_port = closed.port();
+  }
+  Rig rig;
+  rig.streamer->add_destination("127.0.0.1", closed_port, 1);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  rig.feed(3200);
+
+  const auto packets = receiver.packets();
+  REQUIRE(packets.size() == 10);
+  CHECK(consecutive(packets));
+  CHECK(payloads(packets) == rig.expected(0, 3200));
+}
+
+TEST(tcp_frames_carry_the_signal_in_sequence) {
+  TcpReceiver receiver;
+  Rig rig;
+  rig.streamer->set_transport(udp_audio_streamer::TRANSPORT_TCP);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  REQUIRE(!rig.streamer->is_failed());
+  // The connection opens on the first send and completes on a later one.
+  rig.feed(3200);
+  CHECK_EQ(fakes::socket_stats().last_connect_len,
+           static_cast<socklen_t>(sizeof(sockaddr_in)));
+
+  const auto packets = receiver.packets();
+  REQUIRE(!packets.empty());
+  CHECK(consecutive(packets));
+  const uint32_t first = packets[0].frame_counter;
+  CHECK(payloads(packets) ==
+        rig.expected(first, first + 320 * packets.size()));
+  CHECK(fakes::log_contains("Connected to 127.0.0.1"));
+}
+
+TEST(unparsable_destination_fails_setup) {
+  Rig rig;
+  rig.streamer->add_destination("not-an-address", 5000, 1);
+  rig.set_up();
+  CHECK(rig.streamer->is_failed());
+}
+
+TEST(tcp_would_block_skips_are_counted_as_dropped) {
+  TcpReceiver receiver;
+  Rig rig;
+  rig.streamer->set_transport(udp_audio_streamer::TRANSPORT_TCP);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  rig.feed(960);
+  REQUIRE(rig.streamer->destinations_[0].connected);
+
+  // The socket polls writable, but the next two sends fail with EAGAIN.
+  int refusals = 2;
+  fakes::set_send_hook([&](int type, size_t len) -> ssize_t {
+    if (type == SOCK_STREAM && refusals > 0) {
+      refusals--;
+      return -EAGAIN;
+    }
+    return static_cast<ssize_t>(len);
+  });
+  rig.feed(1600);
+  CHECK_EQ(refusals, 0);
+  CHECK_EQ(rig.streamer->bytes_dropped_total_.load(), 2u * 640);
+
+  const auto packets = receiver.packets();
+  REQUIRE(!packets.empty());
+  uint32_t missing_frames = 0;
+  uint32_t missing_packets = 0;
+  for (size_t i = 0; i < packets.size(); i++) {
+    const uint32_t start = packets[i].frame_counter;
+    CHECK(packets[i].payload == rig.expected(start, start + 320));
+    if (i > 0) {
+      missing_frames += start - packets[i - 1].frame_counter - 320;
+      missing_packets += packets[i].sequence - packets[i - 1].sequence - 1;
+    }
+  }
+  // The skipped chunks show up as a gap in the sequence and frame counter,
+  // and nothing else is missing.
+  CHECK_EQ(missing_packets, 2u);
+  CHECK_EQ(missing_frames, 640u);
+}
+
+TEST(tcp_full_connection_keeps_audio_queued) {
+  TcpReceiver receiver(4096);
+  Rig rig;
+  rig.streamer->set_transport(udp_audio_streamer::TRANSPORT_TCP);
+  rig.streamer->set_buffer_duration(2000);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  // Audio is held back until the connection completes.
+  while (rig.frame < 3200 && !rig.streamer->destinations_[0].connected) {
+    rig.feed(320);
+  }
+  REQUIRE(rig.streamer->destinations_[0].connected);
+  int send_buffer = 4096;
+  const int fd = rig.streamer->destinations_[0].socket->get_fd();
+  ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &send_buffer, sizeof(send_buffer));
+
+  // A second of audio, far more than both socket buffers hold, while the
+  // receiver isn't reading.
+  rig.feed(16000 - rig.frame);
+  CHECK(rig.streamer->ring_->available() > 8000);
+
+  std::vector<Packet> packets;
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (payloads(packets).size() < 32000 &&
+         std::chrono::steady_clock::now() < deadline) {
+    for (auto &packet : receiver.packets(5)) {
+      packets.push_back(std::move(packet));
+    }
+    esphome::fakes::loop_once(rig.streamer.get());
+  }
+  CHECK(consecutive(packets));
+  CHECK(payloads(packets) == rig.expected(0, 16000));
+  CHECK_EQ(rig.streamer->bytes_dropped_total_.load(), 0u);
+}
+
+TEST(tcp_reconnect_resumes_on_a_frame_boundary) {
+  TcpReceiver receiver;
+  Rig rig;
+  rig.streamer->set_transport(udp_audio_streamer::TRANSPORT_TCP);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  rig.feed(960);
+  REQUIRE(rig.streamer->destinations_[0].connected);
+  const auto before = receiver.packets();
+  REQUIRE(!before.empty());
+  REQUIRE(rig.streamer->ring_->available() == 0);
+
+  // The next frame only gets its first 100 bytes out before the socket
+  // stops taking more, and the receiver then resets the connection.
+  constexpr size_t SENT = 100;
+  bool cut = false;
+  fakes::set_send_hook([&](int type, size_t len) -> ssize_t {
+    if (type != SOCK_STREAM) {
+      return static_cast<ssize_t>(len);
+    }
+    if (!cut) {
+      cut = true;
+      return SENT;
+    }
+    return -EAGAIN;
+  });
+  rig.feed(320);
+  REQUIRE(cut);
+  CHECK(receiver.receive().empty());
+  CHECK_EQ(receiver.buffered(), SENT);
+  receiver.disconnect();
+  fakes::set_send_hook({});
+
+  // The unsent tail is dropped with the connection.
+  rig.feed(320);
+  CHECK(!rig.streamer->destinations_[0].connected);
+  CHECK_EQ(rig.streamer->reconnects_total_.load(), 1u);
+  CHECK_EQ(rig.streamer->bytes_dropped_total_.load(),
+           udp_audio_streamer::STREAM_FRAME_PREFIX_SIZE +
+               udp_audio_streamer::PACKET_HEADER_SIZE + 640 - SENT);
+
+  // Once the backoff expires the new connection starts on a length prefix,
+  // with the audio queued meanwhile.
+  fakes::advance_time_ms(250);
+  rig.feed(3200);
+  REQUIRE(rig.streamer->destinations_[0].connected);
+  const auto after = receiver.packets();
+  REQUIRE(!after.empty());
+  CHECK_EQ(receiver.buffered(), 0u);
+  CHECK_EQ(after[0].sequence, before.back().sequence + 2);
+  CHECK_EQ(after[0].frame_counter, before.back().frame_counter + 640);
+  CHECK(consecutive(after, after[0].sequence));
+  for (const auto &packet : after) {
+    CHECK(packet.payload ==
+          rig.expected(packet.frame_counter, packet.frame_counter + 320));
+  }
+}
+
+TEST(overflow_gaps_are_placed_where_they_happened) {
+  UdpReceiver receiver;
+  Rig rig;
+  rig.streamer->set_overflow_policy(
+      udp_audio_streamer::OVERFLOW_POLICY_DROP_NEWEST);
+  // 256-frame chunks tile the ring, so both gaps fall between packets; a
+  // packet's single frame counter can't mark a gap inside its payload.
+  rig.streamer->set_chunk_duration(16);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  auto *ring = rig.streamer->ring_.get();
+  REQUIRE(ring->capacity() % 512 == 0);
+
+  // Overflow the ring twice before the sender reaches the first gap: fill
+  // it, send one chunk, then deliver more than that chunk freed.
+  auto emit = [&](uint64_t frames) {
+    rig.mic.emit(rig.expected(rig.frame, rig.frame + frames));
+    rig.frame += frames;
+  };
+  while (ring->free() > 0) {
+    emit(256);
+  }
+  emit(100);
+  REQUIRE(rig.streamer->send_chunk_(0));
+  emit(512);
+  CHECK_EQ(rig.streamer->drop_head_.load(), 2u);
+
+  const uint64_t delivered = rig.frame;
+  for (int i = 0; i < 100 && ring->available() >= 512; i++) {
+    fakes::loop_once(rig.streamer.get());
+  }
+  const auto packets = receiver.packets();
+  REQUIRE(packets.size() > 20);
+  CHECK(consecutive(packets));
+  // Every payload is the audio captured at its frame counter, so both gaps
+  // sit exactly where the ring dropped audio.
+  uint32_t sent_frames = 0;
+  for (const auto &packet : packets) {
+    const uint32_t start = packet.frame_counter;
+    CHECK(packet.payload == rig.expected(start, start + 256));
+    sent_frames += 256;
+  }
+  const uint32_t dropped_frames = rig.streamer->bytes_dropped_total_.load() / 2;
+  CHECK_EQ(dropped_frames, 100u + 256);
+  CHECK_EQ(sent_frames + dropped_frames + ring->available() / 2, delivered);
+}
+
+// Runs a real-time capture: the microphone delivers a 20 ms chunk every
+// 20 ms from its own thread while the main loop only gets to run every
+// loop_interval_ms. Returns the longest gap between packet arrivals.
+static uint32_t longest_gap_ms(Rig &rig, UdpReceiver &receiver,
+                               uint32_t loop_interval_ms) {
+  using namespace std::chrono;
+  std::atomic<bool> capturing{true};
+  std::vector<Packet> packets;
+  std::thread reader([&] {
+    while (capturing.load()) {
+      for (auto &packet : receiver.packets(10)) {
+        packets.push_back(std::move(packet));
+      }
+    }
+  });
+  std::thread microphone([&] {
+    auto next = steady_clock::now();
+    for (int i = 0; i < 50; i++) {
+      rig.mic.emit(rig.expected(rig.frame, rig.frame + 320));
+      rig.frame += 320;
+      next += milliseconds(20);
+      std::this_thread::sleep_until(next);
+    }
+    std::this_thread::sleep_for(milliseconds(loop_interval_ms + 50));
+    capturing.store(false);
+  });
+  while (capturing.load()) {
+    fakes::loop_once(rig.streamer.get());
+    std::this_thread::sleep_for(milliseconds(loop_interval_ms));
+  }
+  microphone.join();
+  reader.join();
+
+  CHECK(payloads(packets) == rig.expected(0, rig.frame));
+  uint32_t longest = 0;
+  for (size_t i = 1; i < packets.size(); i++) {
+    longest = std::max<uint32_t>(
+        longest, duration_cast<milliseconds>(packets[i].arrival -
+                                             packets[i - 1].arrival)
+                     .count());
+  }
+  return longest;
+}
+
+TEST(sender_task_paces_packets_despite_a_slow_loop) {
+  UdpReceiver receiver;
+  Rig rig;
+  rig.streamer->set_sender_task(19, 1, 4096);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  REQUIRE(rig.streamer->task_handle_ != nullptr);
+  // Packets follow the microphone's 20 ms cadence, not the 200 ms loop.
+  const uint32_t gap = longest_gap_ms(rig, receiver, 200);
+  CHECK(gap < 100);
+}
+
+TEST(inline_sending_follows_the_loop) {
+  UdpReceiver receiver;
+  Rig rig;
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  // The baseline the sender task improves on: packets leave in bursts, one
+  // per pass of the loop.
+  const uint32_t gap = longest_gap_ms(rig, receiver, 200);
+  CHECK(gap >= 150);
+}
+
+namespace {
+
+// The detector settings the YAML defaults compile to: -50 dBFS, 25% and
+// 500 ms at 16 kHz.
+constexpr uint32_t VAD_ENERGY = 10737;
+constexpr uint32_t VAD_ZERO_CROSSINGS = 16384;
+constexpr uint32_t VAD_HANGOVER_FRAMES = 8000;
+constexpr size_t VAD_BLOCK = 320;
+
+// Where make_vad_fixtures.py put the voiced segment in vad_speech.wav.
+constexpr size_t SPEECH_START = 12160;
+constexpr size_t SPEECH_END = 28160;
+
+/// The gate state after each 20 ms block of a fixture, using the defaults.
+std::vector<bool> vad_gate(const char *fixture) {
+  udp_audio_streamer::VoiceActivityDetector vad;
+  vad.set_energy_threshold(VAD_ENERGY);
+  vad.set_zero_crossing_threshold(VAD_ZERO_CROSSINGS);
+  vad.set_hangover_frames(VAD_HANGOVER_FRAMES);
+  const auto pcm = fixture_pcm(fixture);
+  std::vector<bool> open;
+  for (size_t offset = 0; offset + VAD_BLOCK * 2 <= pcm.size();
+       offset += VAD_BLOCK * 2) {
+    open.push_back(vad.process(pcm.data() + offset, VAD_BLOCK, 2, 1));
+  }
+  return open;
+}
+
+} // namespace
+
+TEST(vad_opens_on_speech_and_closes_after_the_hangover) {
+  const auto open = vad_gate("vad_speech.wav");
+  REQUIRE(open.size() == 125);
+  const size_t first = SPEECH_START / VAD_BLOCK;
+  const size_t last = SPEECH_END / VAD_BLOCK - 1;
+  const size_t hangover = VAD_HANGOVER_FRAMES / VAD_BLOCK;
+  for (size_t i = 0; i < open.size(); i++) {
+    if (i < first) {
+      CHECK(!open[i]); // the noise floor
+    } else if (i <= last) {
+      CHECK(open[i]); // voiced, through the syllable dips
+    } else if (i < last + hangover) {
+      CHECK(open[i]);
+    } else {
+      CHECK(!open[i]);
+    }
+  }
+}
+
+TEST(vad_lets_quiet_noise_through_but_not_quiet_hum) {
+  // Both sit 3 dB under the energy threshold; only the noise crosses zero
+  // often enough to count as a fricative.
+  for (bool open : vad_gate("vad_fricative.wav")) {
+    CHECK(open);
+  }
+  for (bool open : vad_gate("vad_hum.wav")) {
+    CHECK(!open);
+  }
+}
+
+TEST(vad_gated_stream_starts_with_the_pre_roll) {
+  UdpReceiver receiver;
+  Rig rig;
+  rig.streamer->set_vad(VAD_ENERGY, VAD_ZERO_CROSSINGS, 500, 250, 1000);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  REQUIRE(!rig.streamer->is_failed());
+  const auto pcm = fixture_pcm("vad_speech.wav");
+  for (size_t offset = 0; offset < pcm.size(); offset += VAD_BLOCK * 2) {
+    rig.mic.emit(std::vector<uint8_t>(pcm.begin() + offset,
+                                      pcm.begin() + offset + VAD_BLOCK * 2));
+    fakes::loop_once(rig.streamer.get());
+  }
+
+  std::vector<Packet> audio;
+  for (auto &packet : receiver.packets()) {
+    if (packet.flags & udp_audio_streamer::PACKET_FLAG_KEEPALIVE) {
+      CHECK(packet.payload.empty());
+    } else {
+      audio.push_back(std::move(packet));
+    }
+  }
+  REQUIRE(!audio.empty());
+  CHECK(consecutive(audio, audio[0].sequence));
+
+  // The 250 ms before the onset block goes out first, and the audio runs
+  // on without a gap until the gate closes after the hangover. Less than a
+  // chunk can still be queued then; it stays behind as pre-roll.
+  const size_t pre_roll = 4000;
+  const size_t first = audio[0].frame_counter;
+  CHECK(first + pre_roll + VAD_BLOCK >= SPEECH_START);
+  CHECK(first + pre_roll <= SPEECH_START);
+  const auto sent = payloads(audio);
+  const size_t last = first + sent.size() / 2;
+  const size_t closed = SPEECH_END - VAD_BLOCK + VAD_HANGOVER_FRAMES;
+  CHECK(last <= closed);
+  CHECK(last + VAD_BLOCK > closed);
+  REQUIRE(2 * last <= pcm.size());
+  CHECK(sent == std::vector<uint8_t>(pcm.begin() + 2 * first,
+                                     pcm.begin() + 2 * last));
+}
+
+TEST(fec_recovers_one_lost_packet_per_group) {
+  UdpReceiver receiver;
+  Rig rig;
+  rig.streamer->set_fec_group_size(4);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  REQUIRE(!rig.streamer->is_failed());
+  // Eight groups of four 20 ms packets.
+  rig.feed(32 * 320);
+
+  std::map<uint32_t, std::vector<uint8_t>> sent;
+  std::vector<Packet> parities;
+  for (const auto &packet : receiver.packets()) {
+    if (packet.flags & udp_audio_streamer::PACKET_FLAG_PARITY) {
+      parities.push_back(packet);
+    } else {
+      sent[packet.sequence] = packet.bytes;
+    }
+  }
+  REQUIRE(sent.size() == 32);
+  REQUIRE(parities.size() == 8);
+
+  // Lose one data packet at random from each of the first six groups, two
+  // from the seventh and only the parity packet of the last.
+  std::mt19937 rng(7);
+  auto received = sent;
+  for (uint32_t group = 0; group < 6; group++) {
+    received.erase(group * 4 + rng() % 4);
+  }
+  received.erase(24);
+  received.erase(26);
+  parities.pop_back();
+
+  int recovered = 0;
+  for (const auto &parity : parities) {
+    CHECK_EQ(parity.payload[0], 4);
+    std::vector<uint8_t> lost;
+    if (recover_from_parity(parity, received, &lost)) {
+      Packet packet;
+      REQUIRE(parse_packet(lost, &packet));
+      CHECK(lost == sent[packet.sequence]);
+      received[packet.sequence] = lost;
+      recovered++;
+    }
+  }
+  CHECK_EQ(recovered, 6);
+  CHECK_EQ(received.size(), 30u);
+  CHECK_EQ(received.count(24), 0u);
+  CHECK_EQ(received.count(26), 0u);
+
+  // Everything outside the doubly hit group plays out as sent.
+  std::vector<Packet> playable;
+  for (const auto &entry : received) {
+    Packet packet;
+    REQUIRE(parse_packet(entry.second, &packet));
+    if (entry.first < 24) {
+      playable.push_back(std::move(packet));
+    }
+  }
+  CHECK(consecutive(playable));
+  CHECK(payloads(playable) == rig.expected(0, 24 * 320));
+}
+
+TEST(fec_parity_packets_fit_the_max_packet_size) {
+  UdpReceiver receiver;
+  Rig rig;
+  rig.streamer->set_fec_group_size(4);
+  // 20 ms chunks, 664-byte packets, may grow until a packet or its group's
+  // parity would pass 1000 bytes.
+  constexpr size_t MAX_PACKET_SIZE = 1000;
+  rig.streamer->set_adaptive_chunk(128, MAX_PACKET_SIZE);
+  rig.streamer->add_destination("127.0.0.1", receiver.port(), 1);
+  rig.set_up();
+  REQUIRE(!rig.streamer->is_failed());
+
+  // A datagram of the second group is refused for lack of buffers, which
+  // loses it and grows the chunk.
+  int sends = 0;
+  fakes::set_send_hook([&](int type, size_t len) -> ssize_t {
+    return ++sends == 7 ? -ENOBUFS : static_cast<ssize_t>(len);
+  });
+  rig.feed(16000);
+  fakes::set_send_hook({});
+
+  const auto datagrams = receiver.receive();
+  REQUIRE(!datagrams.empty());
+  size_t largest_data = 0;
+  size_t largest_parity = 0;
+  for (const auto &datagram : datagrams) {
+    Packet packet;
+    REQUIRE(parse_packet(datagram, &packet));
+    size_t &largest = packet.flags & udp_audio_streamer::PACKET_FLAG_PARITY
+                          ? largest_parity
+                          : largest_data;
+    largest = std::max(largest, datagram.size());
+  }
+  CHECK(largest_data > udp_audio_streamer::PACKET_HEADER_SIZE + 640);
+  CHECK(largest_parity <= MAX_PACKET_SIZE);
+  CHECK_EQ(largest_parity, largest_data +
+                               udp_audio_streamer::PACKET_HEADER_SIZE +
+                               udp_audio_streamer::FEC_DESCRIPTOR_SIZE);
+
+  // check_fec_recovery.py runs these, length-prefixed as over TCP, through
+  // the receiver script's own recovery.
+  std::FILE *capture = std::fopen("fec_datagrams.bin", "wb");
+  REQUIRE(capture != nullptr);
+  for (const auto &datagram : datagrams) {
+    const uint8_t prefix[] = {static_cast<uint8_t>(datagram.size() >> 8),
+                              static_cast<uint8_t>(datagram.size())};
+    std::fwrite(prefix, 1, sizeof(prefix), capture);
+    std::fwrite(datagram.data(), 1, datagram.size(), capture);
+  }
+  std::fclose(capture);
+}